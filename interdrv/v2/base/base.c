@@ -970,6 +970,10 @@ static int __init base_init(void)
 		goto cleanup;
 	}
 
+	rc = vb_blk_cache_init();
+	if (rc)
+		goto cleanup;
+
 	rc = platform_driver_register(&base_driver);
 	chip_id = cvi_base_read_chip_id();
 	pr_notice("CVITEK CHIP ID = %d\n", chip_id);
@@ -993,6 +997,7 @@ static void __exit base_exit(void)
 {
 	platform_driver_unregister(&base_driver);
 	vb_cleanup();
+	vb_blk_cache_exit();
 	base_cleanup();
 
 	iounmap(top_base);
@@ -727,7 +727,7 @@ EXPORT_SYMBOL_GPL(vb_dqbuf);
 int32_t vb_done_handler(MMF_CHN_S chn, enum CHN_TYPE_E chn_type, VB_BLK blk)
 {
 	MMF_BIND_DEST_S stBindDest;
-	CVI_S32 ret;
+	CVI_S32 ret, qret = CVI_SUCCESS;
 	CVI_U8 i;
 
 	_handle_snap(chn, chn_type, blk);
@@ -735,7 +735,10 @@ int32_t vb_done_handler(MMF_CHN_S chn, enum CHN_TYPE_E chn_type, VB_BLK blk)
 	if (chn_type == CHN_TYPE_OUT) {
 		if (sys_get_bindbysrc(&chn, &stBindDest) == CVI_SUCCESS) {
 			for (i = 0; i < stBindDest.u32Num; ++i) {
-				vb_qbuf(stBindDest.astMmfChn[i], CHN_TYPE_IN, blk);
+				// keep the first refusal, e.g. -ENOBUFS if the dst queue is full
+				ret = vb_qbuf(stBindDest.astMmfChn[i], CHN_TYPE_IN, blk);
+				if (ret != CVI_SUCCESS && qret == CVI_SUCCESS)
+					qret = ret;
 				CVI_TRACE_BASE(CVI_BASE_DBG_DEBUG,
 						" Mod(%s) chn(%d) dev(%d) -> Mod(%s) chn(%d) dev(%d)\n"
 					     , sys_get_modname(chn.enModId), chn.s32ChnId, chn.s32DevId
@@ -754,7 +757,7 @@ int32_t vb_done_handler(MMF_CHN_S chn, enum CHN_TYPE_E chn_type, VB_BLK blk)
 	}
 	ret = vb_release_block(blk);
 
-	return ret;
+	return (ret != CVI_SUCCESS) ? ret : qret;
 }
 EXPORT_SYMBOL_GPL(vb_done_handler);
 
@@ -1,6 +1,8 @@
 #include "cvi_sys_proc.h"
+#include "sys.h"
 
 #define SYS_PROC_NAME			"sys"
+#define SYS_ION_PROC_NAME		"sys_ion"
 #define SYS_PROC_PERMS			(0644)
 #define GENERATE_STRING(STRING)	(#STRING),
 
@@ -125,6 +127,33 @@ static const struct file_operations _sys_proc_fops = {
 };
 #endif
 
+static int _sys_ion_proc_show(struct seq_file *m, void *v)
+{
+	return sys_ion_show(m);
+}
+
+static int _sys_ion_proc_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, _sys_ion_proc_show, NULL);
+}
+
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(5, 10, 0))
+static const struct proc_ops _sys_ion_proc_fops = {
+	.proc_open = _sys_ion_proc_open,
+	.proc_read = seq_read,
+	.proc_lseek = seq_lseek,
+	.proc_release = single_release,
+};
+#else
+static const struct file_operations _sys_ion_proc_fops = {
+	.owner = THIS_MODULE,
+	.open = _sys_ion_proc_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+#endif
+
 int sys_proc_init(struct proc_dir_entry *_proc_dir, void *shm)
 {
 	int rc = 0;
@@ -134,6 +163,11 @@ int sys_proc_init(struct proc_dir_entry *_proc_dir, void *shm)
 		CVI_TRACE_BASE(CVI_BASE_DBG_ERR, "sys proc creation failed\n");
 		rc = -1;
 	}
+	/* sys loads before base, so base makes the ion report's entry too */
+	if (proc_create_data(SYS_ION_PROC_NAME, 0444, _proc_dir, &_sys_ion_proc_fops, NULL) == NULL) {
+		CVI_TRACE_BASE(CVI_BASE_DBG_ERR, "sys_ion proc creation failed\n");
+		rc = -1;
+	}
 
 	shared_mem = shm;
 	return rc;
@@ -142,6 +176,7 @@ int sys_proc_init(struct proc_dir_entry *_proc_dir, void *shm)
 int sys_proc_remove(struct proc_dir_entry *_proc_dir)
 {
 	remove_proc_entry(SYS_PROC_NAME, _proc_dir);
+	remove_proc_entry(SYS_ION_PROC_NAME, _proc_dir);
 	shared_mem = NULL;
 
 	return 0;
@@ -1,7 +1,9 @@
 #include <linux/module.h>
-#include <linux/hashtable.h>
+#include <linux/rbtree.h>
+#include <linux/spinlock.h>
 #include <linux/uaccess.h>
 #include <linux/slab.h>
+#include <linux/mm.h>
 
 #include "sys.h"
 #include "vb.h"
@@ -13,15 +15,35 @@ module_param(vb_max_pools, uint, 0644);
 uint32_t vb_pool_max_blk = 64;
 module_param(vb_pool_max_blk, uint, 0644);
 
+#ifdef DRV_TEST
+// cvi_buffer bytes written by blk release and motion passing, read by vb_test
+atomic64_t vb_buf_touch_bytes = ATOMIC64_INIT(0);
+#define VB_BUF_TOUCH(n)	atomic64_add(n, &vb_buf_touch_bytes)
+#else
+#define VB_BUF_TOUCH(n)
+#endif
+
 static struct cvi_vb_cfg stVbConfig;
 static struct vb_pool *vbPool;
 static atomic_t ref_count = ATOMIC_INIT(0);
-static struct mutex getVB_lock;
 static struct mutex poolLock;
 
+/* common pools sorted by (blk_size, pool_id) for best-fit lookup. */
+static VB_POOL commPoolSorted[VB_COMM_POOL_MAX_CNT];
+static uint32_t commPoolSortedSize[VB_COMM_POOL_MAX_CNT];
+static uint32_t commPoolSortedCnt;
+
 static DEFINE_MUTEX(g_lock);
 
-DEFINE_HASHTABLE(vb_hash, 6);
+/* index of all blks keyed by phy_addr, protected by vb_index_lock. */
+static struct rb_root vb_index = RB_ROOT;
+static DEFINE_RWLOCK(vb_index_lock);
+
+/* vb_s of static/external blks. blks of a pool live in its blkArray.
+ * Lives as long as the module: external blks may be created before vb init
+ * and outlive vb exit.
+ */
+static struct kmem_cache *vb_cache;
 
 #define CHECK_VB_HANDLE_NULL(x)							\
 	do {									\
@@ -72,23 +94,93 @@ static inline bool isPoolInited(VB_POOL poolId)
 	return (vbPool[poolId].memBase == 0) ? CVI_FALSE : CVI_TRUE;
 }
 
-static bool _vb_hash_find(uint64_t u64PhyAddr, struct vb_s **vb, bool del)
+static void __vb_index_add(struct vb_s *vb)
 {
-	bool is_found = false;
+	struct rb_node **link, *parent = NULL;
 	struct vb_s *obj;
 
-	hash_for_each_possible(vb_hash, obj, node, u64PhyAddr) {
-		if (obj->phy_addr == u64PhyAddr) {
-			if (del)
-				hash_del(&obj->node);
-			is_found = true;
+	link = &vb_index.rb_node;
+	while (*link) {
+		parent = *link;
+		obj = rb_entry(parent, struct vb_s, node);
+		if (vb->phy_addr < obj->phy_addr)
+			link = &parent->rb_left;
+		else
+			link = &parent->rb_right;
+	}
+	rb_link_node(&vb->node, parent, link);
+	rb_insert_color(&vb->node, &vb_index);
+}
+
+static void _vb_index_add(struct vb_s *vb)
+{
+	write_lock(&vb_index_lock);
+	__vb_index_add(vb);
+	write_unlock(&vb_index_lock);
+}
+
+static void _vb_index_del(struct vb_s *vb)
+{
+	write_lock(&vb_index_lock);
+	rb_erase(&vb->node, &vb_index);
+	RB_CLEAR_NODE(&vb->node);
+	write_unlock(&vb_index_lock);
+}
+
+static void _vb_index_add_pool(struct vb_pool *pool)
+{
+	uint32_t i;
+
+	write_lock(&vb_index_lock);
+	for (i = 0; i < pool->blk_cnt; ++i)
+		__vb_index_add(&pool->blkArray[i]);
+	write_unlock(&vb_index_lock);
+}
+
+static void _vb_index_del_pool(struct vb_pool *pool)
+{
+	uint32_t i;
+
+	write_lock(&vb_index_lock);
+	for (i = 0; i < pool->blk_cnt; ++i)
+		rb_erase(&pool->blkArray[i].node, &vb_index);
+	write_unlock(&vb_index_lock);
+}
+
+/* _vb_index_find: look up the blk of the phy-addr given.
+ *
+ * @param u64PhyAddr: the phy-addr to look up.
+ * @param contain: false to match the start address of blk only.
+ *                 true to match any address within the blk.
+ * @return: the blk if found. otherwise, NULL. The blk stays valid only as
+ *          long as the caller holds a reference or keeps its pool alive.
+ */
+static struct vb_s *_vb_index_find(uint64_t u64PhyAddr, bool contain)
+{
+	struct rb_node *n;
+	struct vb_s *obj, *floor = NULL;
+
+	read_lock(&vb_index_lock);
+	n = vb_index.rb_node;
+	while (n) {
+		obj = rb_entry(n, struct vb_s, node);
+		if (u64PhyAddr < obj->phy_addr) {
+			n = n->rb_left;
+		} else if (u64PhyAddr > obj->phy_addr) {
+			floor = obj;
+			n = n->rb_right;
+		} else {
+			floor = obj;
 			break;
 		}
 	}
+	// floor may be erased and freed once the lock is dropped, check it here.
+	if (floor && floor->phy_addr != u64PhyAddr
+	    && !(contain && (u64PhyAddr - floor->phy_addr) < floor->size))
+		floor = NULL;
+	read_unlock(&vb_index_lock);
 
-	if (is_found)
-		*vb = obj;
-	return is_found;
+	return floor;
 }
 
 static bool _is_vb_all_released(void)
@@ -109,14 +201,16 @@ static bool _is_vb_all_released(void)
 int32_t vb_print_pool(VB_POOL poolId)
 {
 	struct vb_s *vb;
-	int bkt, i;
-	struct hlist_node *tmp;
+	struct rb_node *n;
+	int i;
 	char str[64];
 
 	CHECK_VB_POOL_VALID_STRONG(poolId);
 
 	mutex_lock(&vbPool[poolId].lock);
-	hash_for_each_safe(vb_hash, bkt, tmp, vb, node) {
+	read_lock(&vb_index_lock);
+	for (n = rb_first(&vb_index); n; n = rb_next(n)) {
+		vb = rb_entry(n, struct vb_s, node);
 		if (vb->vb_pool == poolId) {
 			sprintf(str, "Pool[%d] vb paddr(%#llx) usr_cnt(%d) /",
 				vb->vb_pool, vb->phy_addr, vb->usr_cnt.counter);
@@ -130,6 +224,7 @@ int32_t vb_print_pool(VB_POOL poolId)
 			CVI_TRACE_BASE(CVI_BASE_DBG_INFO, "%s\n", str);
 		}
 	}
+	read_unlock(&vb_index_lock);
 	mutex_unlock(&vbPool[poolId].lock);
 	return 0;
 }
@@ -160,22 +255,48 @@ static int32_t _vb_set_config(struct cvi_vb_cfg *vb_cfg)
 	return 0;
 }
 
+static void _vb_build_comm_pool_index(void)
+{
+	uint32_t i, j;
+	VB_POOL pool;
+
+	commPoolSortedCnt = 0;
+	for (i = 0; i < VB_COMM_POOL_MAX_CNT && i < vb_max_pools; ++i) {
+		if (!isPoolInited(i) || vbPool[i].ownerID != POOL_OWNER_COMMON)
+			continue;
+
+		// insertion sort, equal blk_size keeps ascending pool id.
+		pool = i;
+		for (j = commPoolSortedCnt; j > 0; --j) {
+			if (commPoolSortedSize[j - 1] <= vbPool[pool].blk_size)
+				break;
+			commPoolSorted[j] = commPoolSorted[j - 1];
+			commPoolSortedSize[j] = commPoolSortedSize[j - 1];
+		}
+		commPoolSorted[j] = pool;
+		commPoolSortedSize[j] = vbPool[pool].blk_size;
+		commPoolSortedCnt++;
+	}
+}
+
 static void _vb_cleanup(void)
 {
-	struct vb_s *vb;
-	int bkt, i;
-	struct hlist_node *tmp;
+	int i;
 	struct vb_pool *pstPool;
 	struct vb_req *req, *req_tmp;
 
-
-	// free vb pool
+	// free vb pool. static/external blks stay with their holders until
+	// released, see vb_blk_cache_exit.
 	for (i = 0; i < vb_max_pools; ++i) {
 		if (isPoolInited(i)) {
 			pstPool = &vbPool[i];
 			mutex_lock(&pstPool->lock);
+			_vb_index_del_pool(pstPool);
 			FIFO_EXIT(&pstPool->freeList);
-			sys_ion_free(pstPool->memBase);
+			kvfree(pstPool->blkArray);
+			pstPool->blkArray = NULL;
+			if (!pstPool->bIsExternal)
+				sys_ion_free(pstPool->memBase);
 			mutex_unlock(&pstPool->lock);
 			mutex_destroy(&pstPool->lock);
 			// free reqQ
@@ -190,19 +311,43 @@ static void _vb_cleanup(void)
 			mutex_destroy(&pstPool->reqQ_lock);
 		}
 	}
+	commPoolSortedCnt = 0;
 	vfree(vbPool);
 	vbPool = NULL;
 
-	// free vb blk
-	hash_for_each_safe(vb_hash, bkt, tmp, vb, node) {
+	mutex_destroy(&poolLock);
+}
+
+int32_t vb_blk_cache_init(void)
+{
+	vb_cache = kmem_cache_create("cvi_vb_s", sizeof(struct vb_s), 0, 0, NULL);
+	if (!vb_cache) {
+		CVI_TRACE_BASE(CVI_BASE_DBG_ERR, "vb_cache create fail!\n");
+		return -ENOMEM;
+	}
+	return 0;
+}
+
+/* vb_blk_cache_exit: free the static/external blks never released, then
+ * the cache. Called on module exit, after vb_cleanup.
+ */
+void vb_blk_cache_exit(void)
+{
+	struct vb_s *vb, *tmp;
+	struct rb_root root;
+
+	write_lock(&vb_index_lock);
+	root = vb_index;
+	vb_index = RB_ROOT;
+	write_unlock(&vb_index_lock);
+	rbtree_postorder_for_each_entry_safe(vb, tmp, &root, node) {
 		if (vb->vb_pool == VB_STATIC_POOLID)
 			sys_ion_free(vb->phy_addr);
-		hash_del(&vb->node);
-		vfree(vb);
+		kmem_cache_free(vb_cache, vb);
 	}
 
-	mutex_destroy(&getVB_lock);
-	mutex_destroy(&poolLock);
+	kmem_cache_destroy(vb_cache);
+	vb_cache = NULL;
 }
 
 static int32_t _vb_create_pool(struct cvi_vb_pool_cfg *config, bool isComm)
@@ -226,9 +371,18 @@ static int32_t _vb_create_pool(struct cvi_vb_pool_cfg *config, bool isComm)
 	}
 	config->mem_base = vbPool[poolId].memBase;
 
+	vbPool[poolId].blkArray = kvcalloc(config->blk_cnt, sizeof(struct vb_s), GFP_KERNEL);
+	if (!vbPool[poolId].blkArray) {
+		CVI_TRACE_BASE(CVI_BASE_DBG_ERR, "blkArray alloc fail!\n");
+		sys_ion_free(vbPool[poolId].memBase);
+		vbPool[poolId].memBase = 0;
+		return -ENOMEM;
+	}
+
 	STAILQ_INIT(&vbPool[poolId].reqQ);
 	mutex_init(&vbPool[poolId].reqQ_lock);
 	mutex_init(&vbPool[poolId].lock);
+	spin_lock_init(&vbPool[poolId].freeList_lock);
 	mutex_lock(&vbPool[poolId].lock);
 	vbPool[poolId].poolID = poolId;
 	vbPool[poolId].ownerID = (isComm) ? POOL_OWNER_COMMON : POOL_OWNER_PRIVATE;
@@ -249,7 +403,7 @@ static int32_t _vb_create_pool(struct cvi_vb_pool_cfg *config, bool isComm)
 
 	FIFO_INIT(&vbPool[poolId].freeList, vbPool[poolId].blk_cnt);
 	for (i = 0; i < vbPool[poolId].blk_cnt; ++i) {
-		p = vzalloc(sizeof(*p));
+		p = &vbPool[poolId].blkArray[i];
 		p->phy_addr = vbPool[poolId].memBase + (i * vbPool[poolId].blk_size);
 		p->vir_addr = vbPool[poolId].vmemBase + (p->phy_addr - vbPool[poolId].memBase);
 		p->vb_pool = poolId;
@@ -257,23 +411,51 @@ static int32_t _vb_create_pool(struct cvi_vb_pool_cfg *config, bool isComm)
 		p->magic = CVI_VB_MAGIC;
 		p->mod_ids = 0;
 		p->external = false;
+		p->size = vbPool[poolId].blk_size;
 		FIFO_PUSH(&vbPool[poolId].freeList, p);
-		hash_add(vb_hash, &p->node, p->phy_addr);
 	}
+	_vb_index_add_pool(&vbPool[poolId]);
 	mutex_unlock(&vbPool[poolId].lock);
 
 	return 0;
 }
 
+/* _vb_ex_blk_size: ex pools only give where the planes of a blk start.
+ *                  The blk spans up to its last plane, taken to be no bigger
+ *                  than the plane before it. 0 if single plane.
+ */
+static uint32_t _vb_ex_blk_size(const __u64 *plane)
+{
+	uint64_t last = plane[0], prev = plane[0];
+	int32_t i;
+
+	for (i = 1; i < 3; ++i) {
+		if (plane[i] <= last)
+			continue;
+		prev = last;
+		last = plane[i];
+	}
+	if (last == plane[0])
+		return 0;
+	return (uint32_t)min_t(uint64_t, (last - plane[0]) + (last - prev), U32_MAX);
+}
+
 static int32_t _vb_create_ex_pool(struct cvi_vb_pool_ex_cfg *config)
 {
 	struct vb_s *p;
 	int32_t i;
 	VB_POOL poolId = config->pool_id;
 
+	vbPool[poolId].blkArray = kvcalloc(config->blk_cnt, sizeof(struct vb_s), GFP_KERNEL);
+	if (!vbPool[poolId].blkArray) {
+		CVI_TRACE_BASE(CVI_BASE_DBG_ERR, "blkArray alloc fail!\n");
+		return -ENOMEM;
+	}
+
 	STAILQ_INIT(&vbPool[poolId].reqQ);
 	mutex_init(&vbPool[poolId].reqQ_lock);
 	mutex_init(&vbPool[poolId].lock);
+	spin_lock_init(&vbPool[poolId].freeList_lock);
 	mutex_lock(&vbPool[poolId].lock);
 	vbPool[poolId].poolID = poolId;
 	vbPool[poolId].ownerID = POOL_OWNER_PRIVATE;
@@ -291,7 +473,7 @@ static int32_t _vb_create_ex_pool(struct cvi_vb_pool_ex_cfg *config)
 
 	FIFO_INIT(&vbPool[poolId].freeList, vbPool[poolId].blk_cnt);
 	for (i = 0; i < vbPool[poolId].blk_cnt; ++i) {
-		p = vzalloc(sizeof(*p));
+		p = &vbPool[poolId].blkArray[i];
 		p->phy_addr = config->au64PhyAddr[i][0];
 		p->vir_addr = (void *)config->au64PhyAddr[i][0];
 		p->vb_pool = poolId;
@@ -302,9 +484,10 @@ static int32_t _vb_create_ex_pool(struct cvi_vb_pool_ex_cfg *config)
 		p->buf.phy_addr[0] = config->au64PhyAddr[i][0];
 		p->buf.phy_addr[1] = config->au64PhyAddr[i][1];
 		p->buf.phy_addr[2] = config->au64PhyAddr[i][2];
+		p->size = _vb_ex_blk_size(config->au64PhyAddr[i]);
 		FIFO_PUSH(&vbPool[poolId].freeList, p);
-		hash_add(vb_hash, &p->node, p->phy_addr);
 	}
+	_vb_index_add_pool(&vbPool[poolId]);
 	mutex_unlock(&vbPool[poolId].lock);
 
 	return 0;
@@ -313,23 +496,29 @@ static int32_t _vb_create_ex_pool(struct cvi_vb_pool_ex_cfg *config)
 static void _vb_destroy_pool(VB_POOL poolId)
 {
 	struct vb_pool *pstPool = &vbPool[poolId];
-	struct vb_s *vb, *tmp_vb;
 	struct vb_req *req, *req_tmp;
+	struct vbq freeList;
 
+	// detach freeList so that no blk can be acquired from this pool anymore.
+	spin_lock(&pstPool->freeList_lock);
 	CVI_TRACE_BASE(CVI_BASE_DBG_INFO, "vb destroy pool, pool[%d]: capacity(%d) size(%d).\n"
 		, poolId, FIFO_CAPACITY(&pstPool->freeList), FIFO_SIZE(&pstPool->freeList));
 	if (FIFO_CAPACITY(&pstPool->freeList) != FIFO_SIZE(&pstPool->freeList)) {
+		spin_unlock(&pstPool->freeList_lock);
 		CVI_TRACE_BASE(CVI_BASE_DBG_INFO, "pool(%d) blk should be all released before destroy pool\n", poolId);
 		return;
 	}
+	freeList = pstPool->freeList;
+	pstPool->freeList.fifo = NULL;
+	pstPool->freeList.front = pstPool->freeList.tail = -1;
+	pstPool->freeList.capacity = 0;
+	spin_unlock(&pstPool->freeList_lock);
 
 	mutex_lock(&pstPool->lock);
-	while (!FIFO_EMPTY(&pstPool->freeList)) {
-		FIFO_POP(&pstPool->freeList, &vb);
-		_vb_hash_find(vb->phy_addr, &tmp_vb, true);
-		vfree(vb);
-	}
-	FIFO_EXIT(&pstPool->freeList);
+	_vb_index_del_pool(pstPool);
+	kvfree(pstPool->blkArray);
+	pstPool->blkArray = NULL;
+	FIFO_EXIT(&freeList);
 	if (!pstPool->bIsExternal)
 		sys_ion_free(pstPool->memBase);
 	mutex_unlock(&pstPool->lock);
@@ -372,7 +561,7 @@ static int32_t _vb_init(void)
 			}
 		}
 
-		mutex_init(&getVB_lock);
+		_vb_build_comm_pool_index();
 		mutex_init(&poolLock);
 		CVI_TRACE_BASE(CVI_BASE_DBG_INFO, " -\n");
 	}
@@ -421,26 +610,58 @@ static int32_t _vb_exit(void)
 	return 0;
 }
 
+/* find_vb_pool: best-fit common pool for the size given.
+ *
+ * The smallest blk_size which fits wins, lower pool id on ties.
+ * Pools destroyed after init are skipped.
+ */
 VB_POOL find_vb_pool(uint32_t u32BlkSize)
 {
-	VB_POOL Pool = VB_INVALID_POOLID;
-	int i;
+	uint32_t lo = 0, hi = commPoolSortedCnt, mid;
+	VB_POOL Pool;
+
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (commPoolSortedSize[mid] < u32BlkSize)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
 
-	for (i = 0; i < VB_COMM_POOL_MAX_CNT; ++i) {
-		if (!isPoolInited(i))
-			continue;
-		if (vbPool[i].ownerID != POOL_OWNER_COMMON)
+	for (; lo < commPoolSortedCnt; ++lo) {
+		Pool = commPoolSorted[lo];
+		if (!isPoolInited(Pool))
 			continue;
-		if (u32BlkSize > vbPool[i].blk_size)
+		if (vbPool[Pool].ownerID != POOL_OWNER_COMMON)
 			continue;
-		if ((Pool == VB_INVALID_POOLID)
-			|| (vbPool[Pool].blk_size > vbPool[i].blk_size))
-			Pool = i;
+		return Pool;
 	}
-	return Pool;
+	return VB_INVALID_POOLID;
 }
 EXPORT_SYMBOL_GPL(find_vb_pool);
 
+static VB_BLK _vb_create_block(uint64_t phyAddr, void *virAddr, VB_POOL VbPool, bool isExternal, uint32_t size)
+{
+	struct vb_s *p = NULL;
+
+	p = kmem_cache_zalloc(vb_cache, GFP_KERNEL);
+	if (!p) {
+		CVI_TRACE_BASE(CVI_BASE_DBG_ERR, "kmem_cache_zalloc failed.\n");
+		return VB_INVALID_HANDLE;
+	}
+
+	p->phy_addr = phyAddr;
+	p->vir_addr = virAddr;
+	p->vb_pool = VbPool;
+	atomic_set(&p->usr_cnt, 1);
+	p->magic = CVI_VB_MAGIC;
+	p->mod_ids = 0;
+	p->external = isExternal;
+	p->size = size;
+	_vb_index_add(p);
+	return (VB_BLK)p;
+}
+
 static VB_BLK _vb_get_block_static(uint32_t u32BlkSize)
 {
 	int32_t ret = CVI_SUCCESS;
@@ -454,7 +675,7 @@ static VB_BLK _vb_get_block_static(uint32_t u32BlkSize)
 		return VB_INVALID_HANDLE;
 	}
 
-	return vb_create_block(phy_addr, ion_v, VB_STATIC_POOLID, false);
+	return _vb_create_block(phy_addr, ion_v, VB_STATIC_POOLID, false, u32BlkSize);
 }
 
 /* _vb_get_block: acquice a vb_blk with specific size from pool.
@@ -474,11 +695,11 @@ static VB_BLK _vb_get_block(struct vb_pool *pool, CVI_U32 u32BlkSize, MOD_ID_E m
 		return VB_INVALID_HANDLE;
 	}
 
-	mutex_lock(&pool->lock);
+	spin_lock(&pool->freeList_lock);
 	if (FIFO_EMPTY(&pool->freeList)) {
+		spin_unlock(&pool->freeList_lock);
 		CVI_TRACE_BASE(CVI_BASE_DBG_INFO, "VB_POOL owner(%#x) poolID(%#x) pool is empty.\n",
 			pool->ownerID, pool->poolID);
-		mutex_unlock(&pool->lock);
 		vb_print_pool(pool->poolID);
 		return VB_INVALID_HANDLE;
 	}
@@ -489,7 +710,7 @@ static VB_BLK _vb_get_block(struct vb_pool *pool, CVI_U32 u32BlkSize, MOD_ID_E m
 		(pool->u32FreeBlkCnt < pool->u32MinFreeBlkCnt) ? pool->u32FreeBlkCnt : pool->u32MinFreeBlkCnt;
 	atomic_set(&p->usr_cnt, 1);
 	p->mod_ids = BIT(modId);
-	mutex_unlock(&pool->lock);
+	spin_unlock(&pool->freeList_lock);
 	CVI_TRACE_BASE(CVI_BASE_DBG_DEBUG, "Mod(%s) phy-addr(%#llx).\n", sys_get_modname(modId), p->phy_addr);
 	return (VB_BLK)p;
 }
@@ -654,6 +875,55 @@ int32_t vb_destroy_pool(VB_POOL poolId)
 }
 EXPORT_SYMBOL_GPL(vb_destroy_pool);
 
+/* _vb_clear_buf: reset the cvi_buffer of blk.
+ *
+ * motion_table is only cleared if it has been filled.
+ */
+static void _vb_clear_buf(struct vb_s *vb)
+{
+	struct cvi_buffer *buf = &vb->buf;
+
+	if (vb->motion_valid) {
+		memset(buf, 0, sizeof(*buf));
+		vb->motion_valid = CVI_FALSE;
+		VB_BUF_TOUCH(sizeof(*buf));
+		return;
+	}
+	memset(buf, 0, offsetof(struct cvi_buffer, motion_table));
+	memset(&buf->flags, 0, sizeof(*buf) - offsetof(struct cvi_buffer, flags));
+	VB_BUF_TOUCH(sizeof(*buf) - MO_TBL_SIZE);
+}
+
+/* vb_set_motion: fill motion info of blk.
+ *
+ * @param motion_lv: motion level.
+ * @param motion_table: motion table of MO_TBL_SIZE. NULL if producer has none.
+ */
+void vb_set_motion(struct vb_s *vb, uint8_t motion_lv, const uint8_t *motion_table)
+{
+	vb->buf.motion_lv = motion_lv;
+	if (motion_table) {
+		memcpy(vb->buf.motion_table, motion_table, MO_TBL_SIZE);
+		vb->motion_valid = CVI_TRUE;
+		VB_BUF_TOUCH(MO_TBL_SIZE);
+	} else if (vb->motion_valid) {
+		memset(vb->buf.motion_table, 0, MO_TBL_SIZE);
+		vb->motion_valid = CVI_FALSE;
+		VB_BUF_TOUCH(MO_TBL_SIZE);
+	}
+}
+EXPORT_SYMBOL_GPL(vb_set_motion);
+
+/* vb_copy_motion: pass motion info from src blk to dst blk.
+ *
+ * The table is copied only if src has one.
+ */
+void vb_copy_motion(struct vb_s *dst, const struct vb_s *src)
+{
+	vb_set_motion(dst, src->buf.motion_lv, src->motion_valid ? src->buf.motion_table : NULL);
+}
+EXPORT_SYMBOL_GPL(vb_copy_motion);
+
 /* vb_create_block: create a vb blk per phy-addr given.
  *
  * @param phyAddr: phy-address of the buffer for this new vb.
@@ -663,23 +933,7 @@ EXPORT_SYMBOL_GPL(vb_destroy_pool);
  */
 VB_BLK vb_create_block(uint64_t phyAddr, void *virAddr, VB_POOL VbPool, bool isExternal)
 {
-	struct vb_s *p = NULL;
-
-	p = vmalloc(sizeof(*p));
-	if (!p) {
-		CVI_TRACE_BASE(CVI_BASE_DBG_ERR, "vmalloc failed.\n");
-		return VB_INVALID_HANDLE;
-	}
-
-	p->phy_addr = phyAddr;
-	p->vir_addr = virAddr;
-	p->vb_pool = VbPool;
-	atomic_set(&p->usr_cnt, 1);
-	p->magic = CVI_VB_MAGIC;
-	p->mod_ids = 0;
-	p->external = isExternal;
-	hash_add(vb_hash, &p->node, p->phy_addr);
-	return (VB_BLK)p;
+	return _vb_create_block(phyAddr, virAddr, VbPool, isExternal, 0);
 }
 EXPORT_SYMBOL_GPL(vb_create_block);
 
@@ -692,7 +946,6 @@ VB_BLK vb_get_block_with_id(VB_POOL poolId, uint32_t u32BlkSize, MOD_ID_E modId)
 		return VB_INVALID_POOLID;
 	}
 
-	mutex_lock(&getVB_lock);
 	// common pool
 	if (poolId == VB_INVALID_POOLID) {
 		poolId = find_vb_pool(u32BlkSize);
@@ -723,7 +976,6 @@ VB_BLK vb_get_block_with_id(VB_POOL poolId, uint32_t u32BlkSize, MOD_ID_E modId)
 	blk = _vb_get_block(&vbPool[poolId], u32BlkSize, modId);
 
 get_vb_done:
-	mutex_unlock(&getVB_lock);
 	return blk;
 }
 EXPORT_SYMBOL_GPL(vb_get_block_with_id);
@@ -749,8 +1001,8 @@ int32_t vb_release_block(VB_BLK blk)
 
 		if ((vb->vb_pool == VB_EXTERNAL_POOLID) && vb->external) {
 			CVI_TRACE_BASE(CVI_BASE_DBG_DEBUG, "external buffer phy-addr(%#llx) release.\n", vb->phy_addr);
-			_vb_hash_find(vb->phy_addr, &vb_tmp, true);
-			vfree(vb);
+			_vb_index_del(vb);
+			kmem_cache_free(vb_cache, vb);
 			return 0;
 		}
 
@@ -759,8 +1011,8 @@ int32_t vb_release_block(VB_BLK blk)
 			int32_t ret = 0;
 
 			ret = sys_ion_free(vb->phy_addr);
-			_vb_hash_find(vb->phy_addr, &vb_tmp, true);
-			vfree(vb);
+			_vb_index_del(vb);
+			kmem_cache_free(vb_cache, vb);
 			return ret;
 		}
 
@@ -769,32 +1021,32 @@ int32_t vb_release_block(VB_BLK blk)
 
 			CVI_TRACE_BASE(CVI_BASE_DBG_INFO, "vb usr_cnt is zero.\n");
 			pool = &vbPool[vb->vb_pool];
-			mutex_lock(&pool->lock);
+			spin_lock(&pool->freeList_lock);
 			FIFO_FOREACH(vb_tmp, &pool->freeList, i) {
 				if (vb_tmp->phy_addr == vb->phy_addr) {
-					mutex_unlock(&pool->lock);
+					spin_unlock(&pool->freeList_lock);
 					atomic_set(&vb->usr_cnt, 0);
 					return 0;
 				}
 			}
-			mutex_unlock(&pool->lock);
+			spin_unlock(&pool->freeList_lock);
 		}
 
 		pool = &vbPool[vb->vb_pool];
-		mutex_lock(&pool->lock);
 		if (vb->external) {
 			CVI_U64 addr[3] = {0};
 			memcpy(addr, vb->buf.phy_addr, sizeof(addr));
-			memset(&vb->buf, 0, sizeof(vb->buf));
+			_vb_clear_buf(vb);
 			memcpy(vb->buf.phy_addr, addr, sizeof(addr));
 		} else {
-			memset(&vb->buf, 0, sizeof(vb->buf));
+			_vb_clear_buf(vb);
 		}
 		atomic_set(&vb->usr_cnt, 0);
 		vb->mod_ids = 0;
+		spin_lock(&pool->freeList_lock);
 		FIFO_PUSH(&pool->freeList, vb);
 		++pool->u32FreeBlkCnt;
-		mutex_unlock(&pool->lock);
+		spin_unlock(&pool->freeList_lock);
 
 		mutex_lock(&pool->reqQ_lock);
 		if (!STAILQ_EMPTY(&pool->reqQ)) {
@@ -827,9 +1079,9 @@ EXPORT_SYMBOL_GPL(vb_release_block);
 
 VB_BLK vb_physAddr2Handle(uint64_t u64PhyAddr)
 {
-	struct vb_s *vb = NULL;
+	struct vb_s *vb = _vb_index_find(u64PhyAddr, false);
 
-	if (!_vb_hash_find(u64PhyAddr, &vb, false)) {
+	if (!vb) {
 		CVI_TRACE_BASE(CVI_BASE_DBG_DEBUG, "Cannot find vb corresponding to phyAddr:%#llx\n", u64PhyAddr);
 		return VB_INVALID_HANDLE;
 	} else
@@ -837,6 +1089,24 @@ VB_BLK vb_physAddr2Handle(uint64_t u64PhyAddr)
 }
 EXPORT_SYMBOL_GPL(vb_physAddr2Handle);
 
+/* vb_physAddrWithin2Handle: find the blk whose buffer contains the phy-addr.
+ *
+ * Unlike vb_physAddr2Handle, the address can point anywhere in the blk,
+ * e.g. the chroma plane of a frame. Blks of unknown size (vb_create_block,
+ * single-plane ex pools) only match their start address.
+ */
+VB_BLK vb_physAddrWithin2Handle(uint64_t u64PhyAddr)
+{
+	struct vb_s *vb = _vb_index_find(u64PhyAddr, true);
+
+	if (!vb) {
+		CVI_TRACE_BASE(CVI_BASE_DBG_DEBUG, "Cannot find vb containing phyAddr:%#llx\n", u64PhyAddr);
+		return VB_INVALID_HANDLE;
+	}
+	return (VB_BLK)vb;
+}
+EXPORT_SYMBOL_GPL(vb_physAddrWithin2Handle);
+
 uint64_t vb_handle2PhysAddr(VB_BLK blk)
 {
 	struct vb_s *vb = (struct vb_s *)blk;
@@ -485,6 +485,593 @@ ACQUIRE_BLK_TEST_FAIL:
 	return -1;
 }
 
+#define VB_STRESS_THREAD_MAX	8
+#define VB_STRESS_LOOP		10000
+
+/* Baseline pass: serialize like the acquire path did before getVB_lock was
+ * dropped. One global mutex around acquire, and a mutex standing in for the
+ * pool lock around the freeList push/pop.
+ */
+static DEFINE_MUTEX(vb_stress_global_lock);
+static DEFINE_MUTEX(vb_stress_pool_lock);
+
+struct vb_stress_arg {
+	uint32_t blk_size;
+	bool baseline;
+	uint32_t ops;
+	uint32_t miss;
+	uint64_t *lat_ns;
+	struct completion done;
+};
+
+struct vb_stress_result {
+	uint64_t ops;
+	uint64_t ops_per_sec;
+	uint64_t p99;
+	uint32_t miss;
+};
+
+static VB_BLK _vb_stress_get(struct vb_stress_arg *arg)
+{
+	VB_BLK blk;
+
+	if (!arg->baseline)
+		return vb_get_block_with_id(VB_INVALID_POOLID, arg->blk_size, CVI_ID_USER);
+
+	mutex_lock(&vb_stress_global_lock);
+	mutex_lock(&vb_stress_pool_lock);
+	blk = vb_get_block_with_id(VB_INVALID_POOLID, arg->blk_size, CVI_ID_USER);
+	mutex_unlock(&vb_stress_pool_lock);
+	mutex_unlock(&vb_stress_global_lock);
+	return blk;
+}
+
+static void _vb_stress_put(struct vb_stress_arg *arg, VB_BLK blk)
+{
+	if (!arg->baseline) {
+		vb_release_block(blk);
+		return;
+	}
+
+	mutex_lock(&vb_stress_pool_lock);
+	vb_release_block(blk);
+	mutex_unlock(&vb_stress_pool_lock);
+}
+
+static int _vb_stress_thread(void *data)
+{
+	struct vb_stress_arg *arg = (struct vb_stress_arg *)data;
+	VB_BLK blk;
+	uint64_t t0;
+	uint32_t i;
+
+	for (i = 0; i < VB_STRESS_LOOP; ++i) {
+		t0 = ktime_get_ns();
+		blk = _vb_stress_get(arg);
+		if (blk == VB_INVALID_HANDLE) {
+			arg->miss++;
+			continue;
+		}
+		_vb_stress_put(arg, blk);
+		arg->lat_ns[arg->ops++] = ktime_get_ns() - t0;
+	}
+	complete(&arg->done);
+	return 0;
+}
+
+static bool _vb_all_comm_free(struct cvi_vb_cfg *cfg)
+{
+	struct vb_pool *pool_info;
+	uint32_t i;
+
+	if (vb_get_pool_info(&pool_info))
+		return false;
+
+	for (i = 0; i < cfg->comm_pool_cnt; ++i) {
+		if (pool_info[i].u32FreeBlkCnt != pool_info[i].blk_cnt)
+			return false;
+	}
+	return true;
+}
+
+static int _vb_stress_cmp(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+static int32_t _vb_stress_run(struct cvi_vb_cfg *cfg, uint32_t thread_cnt, bool baseline,
+	struct vb_stress_result *res)
+{
+	struct vb_stress_arg *arg;
+	struct task_struct *tsk;
+	uint64_t *lat_ns, t_start, t_total;
+	uint32_t i, j;
+
+	arg = kcalloc(thread_cnt, sizeof(*arg), GFP_KERNEL);
+	lat_ns = vmalloc(sizeof(uint64_t) * VB_STRESS_LOOP * thread_cnt);
+	if (!arg || !lat_ns) {
+		CVI_TRACE_BASE(CVI_BASE_DBG_ERR, "alloc fail\n");
+		kfree(arg);
+		vfree(lat_ns);
+		return -1;
+	}
+
+	t_start = ktime_get_ns();
+	for (i = 0; i < thread_cnt; ++i) {
+		arg[i].blk_size = cfg->comm_pool[0].blk_size;
+		arg[i].baseline = baseline;
+		arg[i].lat_ns = lat_ns + i * VB_STRESS_LOOP;
+		init_completion(&arg[i].done);
+		tsk = kthread_run(_vb_stress_thread, &arg[i], "vb_stress%d", i);
+		if (IS_ERR(tsk)) {
+			CVI_TRACE_BASE(CVI_BASE_DBG_ERR, "kthread_run fail\n");
+			complete(&arg[i].done);
+		}
+	}
+	for (i = 0; i < thread_cnt; ++i)
+		wait_for_completion(&arg[i].done);
+	t_total = ktime_get_ns() - t_start;
+
+	// compact samples of all threads for percentile.
+	memset(res, 0, sizeof(*res));
+	for (i = 0; i < thread_cnt; ++i) {
+		for (j = 0; j < arg[i].ops; ++j)
+			lat_ns[res->ops++] = arg[i].lat_ns[j];
+		res->miss += arg[i].miss;
+	}
+	sort(lat_ns, res->ops, sizeof(uint64_t), _vb_stress_cmp, NULL);
+	res->p99 = res->ops ? lat_ns[(res->ops * 99) / 100] : 0;
+	res->ops_per_sec = t_total ? div64_u64(res->ops * NSEC_PER_SEC, t_total) : 0;
+
+	CVI_TRACE_BASE(CVI_BASE_DBG_INFO, "%s: threads(%d) ops(%lld) miss(%d) ops/sec(%lld) p99(%lld ns)\n",
+		baseline ? "baseline" : "current", thread_cnt, res->ops, res->miss, res->ops_per_sec, res->p99);
+
+	kfree(arg);
+	vfree(lat_ns);
+	return 0;
+}
+
+/* _vb_stress_test: hammer acquire/release of pool0 from N threads.
+ *
+ * Runs once serialized like the old global-lock path and once on the
+ * current path, and reports ops/sec and p99 latency of one
+ * acquire+release pair for both, plus the ratio.
+ */
+static int32_t _vb_stress_test(void)
+{
+	struct cvi_vb_cfg cfg;
+	struct vb_stress_result base, cur;
+	uint32_t thread_cnt;
+	int32_t ret;
+
+	ret = vb_get_config(&cfg);
+	if (ret) {
+		CVI_TRACE_BASE(CVI_BASE_DBG_ERR, "vb_get_config fail, ret:%d\n", ret);
+		return -1;
+	}
+
+	thread_cnt = min_t(uint32_t, num_online_cpus() * 2, VB_STRESS_THREAD_MAX);
+	if (_vb_stress_run(&cfg, thread_cnt, true, &base))
+		return -1;
+	if (_vb_stress_run(&cfg, thread_cnt, false, &cur))
+		return -1;
+
+	// ratios in percent of baseline.
+	CVI_TRACE_BASE(CVI_BASE_DBG_INFO, "current vs baseline: ops/sec(%lld%%) p99(%lld%%)\n",
+		base.ops_per_sec ? div64_u64(cur.ops_per_sec * 100, base.ops_per_sec) : 0,
+		base.p99 ? div64_u64(cur.p99 * 100, base.p99) : 0);
+
+	if (!_vb_all_comm_free(&cfg)) {
+		CVI_TRACE_BASE(CVI_BASE_DBG_ERR, "free blk accounting mismatch after stress\n");
+		return -1;
+	}
+	CVI_TRACE_BASE(CVI_BASE_DBG_INFO, "vb stress test SUCCESS!\n");
+	return 0;
+}
+
+#define VB_FIND_POOL_LOOP	100000
+
+static VB_POOL _vb_find_pool_linear(struct vb_pool *pool_info, uint32_t u32BlkSize)
+{
+	VB_POOL Pool = VB_INVALID_POOLID;
+	int i;
+
+	for (i = 0; i < VB_COMM_POOL_MAX_CNT; ++i) {
+		if (pool_info[i].memBase == 0)
+			continue;
+		if (pool_info[i].ownerID != POOL_OWNER_COMMON)
+			continue;
+		if (u32BlkSize > pool_info[i].blk_size)
+			continue;
+		if ((Pool == VB_INVALID_POOLID)
+			|| (pool_info[Pool].blk_size > pool_info[i].blk_size))
+			Pool = i;
+	}
+	return Pool;
+}
+
+/* _vb_find_pool_test: check find_vb_pool against the linear best-fit scan
+ *                     with random sizes, and compare the lookup cost.
+ */
+static int32_t _vb_find_pool_test(void)
+{
+	struct cvi_vb_cfg cfg;
+	struct vb_pool *pool_info;
+	uint32_t *sizes, max_size = 0, i;
+	uint64_t t0, t_sorted, t_linear;
+	VB_POOL pool, ref;
+	int32_t ret = 0;
+
+	if (vb_get_config(&cfg) || vb_get_pool_info(&pool_info)) {
+		CVI_TRACE_BASE(CVI_BASE_DBG_ERR, "vb not inited\n");
+		return -1;
+	}
+	for (i = 0; i < cfg.comm_pool_cnt; ++i)
+		max_size = max(max_size, cfg.comm_pool[i].blk_size);
+
+	sizes = vmalloc(sizeof(uint32_t) * VB_FIND_POOL_LOOP);
+	if (!sizes)
+		return -1;
+	// include sizes no pool can serve.
+	for (i = 0; i < VB_FIND_POOL_LOOP; ++i)
+		sizes[i] = get_random_u32() % (max_size + (max_size >> 3)) + 1;
+
+	for (i = 0; i < VB_FIND_POOL_LOOP; ++i) {
+		pool = find_vb_pool(sizes[i]);
+		ref = _vb_find_pool_linear(pool_info, sizes[i]);
+		if (pool != ref) {
+			CVI_TRACE_BASE(CVI_BASE_DBG_ERR, "size(%d) pool(%d) expected(%d)\n", sizes[i], pool, ref);
+			ret = -1;
+			goto FIND_POOL_TEST_DONE;
+		}
+	}
+
+	t0 = ktime_get_ns();
+	for (i = 0; i < VB_FIND_POOL_LOOP; ++i)
+		find_vb_pool(sizes[i]);
+	t_sorted = ktime_get_ns() - t0;
+
+	t0 = ktime_get_ns();
+	for (i = 0; i < VB_FIND_POOL_LOOP; ++i)
+		_vb_find_pool_linear(pool_info, sizes[i]);
+	t_linear = ktime_get_ns() - t0;
+
+	CVI_TRACE_BASE(CVI_BASE_DBG_INFO, "pools(%d) lookups(%d) sorted(%lld ns) linear(%lld ns)\n",
+		cfg.comm_pool_cnt, VB_FIND_POOL_LOOP, t_sorted, t_linear);
+	CVI_TRACE_BASE(CVI_BASE_DBG_INFO, "vb find pool test SUCCESS!\n");
+
+FIND_POOL_TEST_DONE:
+	vfree(sizes);
+	return ret;
+}
+
+#define VB_INDEX_FAKE_BASE	0xF000000000ULL
+#define VB_INDEX_FAKE_STRIDE	0x1000
+#define VB_INDEX_LOOKUP_LOOP	100000
+#define VB_INDEX_RACE_LOOP	100
+
+static int32_t _vb_index_bench(uint32_t blk_cnt)
+{
+	VB_BLK *blk;
+	uint64_t addr, t0, t_exact, t_within;
+	uint32_t i, idx;
+	int32_t ret = 0;
+
+	blk = vmalloc(sizeof(VB_BLK) * blk_cnt);
+	if (!blk)
+		return -1;
+
+	for (i = 0; i < blk_cnt; ++i) {
+		blk[i] = vb_create_block(VB_INDEX_FAKE_BASE + (uint64_t)i * VB_INDEX_FAKE_STRIDE,
+			NULL, VB_EXTERNAL_POOLID, true);
+		if (blk[i] == VB_INVALID_HANDLE) {
+			blk_cnt = i;
+			ret = -1;
+			goto INDEX_BENCH_DONE;
+		}
+	}
+
+	t0 = ktime_get_ns();
+	for (i = 0; i < VB_INDEX_LOOKUP_LOOP; ++i) {
+		idx = get_random_u32() % blk_cnt;
+		addr = VB_INDEX_FAKE_BASE + (uint64_t)idx * VB_INDEX_FAKE_STRIDE;
+		if (vb_physAddr2Handle(addr) != blk[idx]) {
+			CVI_TRACE_BASE(CVI_BASE_DBG_ERR, "lookup phyAddr(%#llx) fail\n", addr);
+			ret = -1;
+			goto INDEX_BENCH_DONE;
+		}
+	}
+	t_exact = ktime_get_ns() - t0;
+
+	// blks created by vb_create_block have unknown size, only start address matches.
+	t0 = ktime_get_ns();
+	for (i = 0; i < VB_INDEX_LOOKUP_LOOP; ++i) {
+		idx = get_random_u32() % blk_cnt;
+		addr = VB_INDEX_FAKE_BASE + (uint64_t)idx * VB_INDEX_FAKE_STRIDE + 0x10;
+		if (vb_physAddrWithin2Handle(addr) != VB_INVALID_HANDLE) {
+			CVI_TRACE_BASE(CVI_BASE_DBG_ERR, "phyAddr(%#llx) should not match blk of unknown size\n", addr);
+			ret = -1;
+			goto INDEX_BENCH_DONE;
+		}
+	}
+	t_within = ktime_get_ns() - t0;
+
+	CVI_TRACE_BASE(CVI_BASE_DBG_INFO, "blks(%d) exact(%lld ns/op) within(%lld ns/op)\n",
+		blk_cnt, div64_u64(t_exact, VB_INDEX_LOOKUP_LOOP), div64_u64(t_within, VB_INDEX_LOOKUP_LOOP));
+
+INDEX_BENCH_DONE:
+	for (i = 0; i < blk_cnt; ++i)
+		vb_release_block(blk[i]);
+	vfree(blk);
+	return ret;
+}
+
+struct vb_index_race_arg {
+	uint64_t base;
+	uint32_t span;
+	VB_POOL pool_id;
+	uint32_t hit;
+	uint32_t err;
+};
+
+/* _vb_index_race_thread: look up addresses of a pool kept alive during the
+ *                        test while other pools churn the index, and check
+ *                        the blk found really holds the address.
+ */
+static int _vb_index_race_thread(void *data)
+{
+	struct vb_index_race_arg *arg = (struct vb_index_race_arg *)data;
+	struct vb_s *vb;
+	uint64_t addr;
+
+	while (!kthread_should_stop()) {
+		addr = arg->base + get_random_u32() % arg->span;
+		vb = (struct vb_s *)vb_physAddrWithin2Handle(addr);
+		if (vb == (struct vb_s *)VB_INVALID_HANDLE || vb->magic != CVI_VB_MAGIC
+		    || vb->vb_pool != arg->pool_id || (addr - vb->phy_addr) >= vb->size)
+			arg->err++;
+		else
+			arg->hit++;
+		cond_resched();
+	}
+	return 0;
+}
+
+#define VB_INDEX_EX_BLK_CNT	8
+#define VB_INDEX_EX_LUMA	0x8000
+
+/* _vb_index_test: lookup cost with 1k/10k/30k live blks, and lookups
+ *                 racing against pool create/destroy.
+ */
+static int32_t _vb_index_test(void)
+{
+	static const uint32_t blk_cnt[] = {1000, 10000, 30000};
+	struct vb_index_race_arg arg = {0};
+	struct cvi_vb_pool_cfg config;
+	struct cvi_vb_pool_ex_cfg *ex_config;
+	struct task_struct *tsk;
+	uint64_t addr;
+	VB_BLK blk;
+	uint32_t i, j;
+	int32_t ret = 0;
+
+	for (i = 0; i < ARRAY_SIZE(blk_cnt); ++i) {
+		if (_vb_index_bench(blk_cnt[i]))
+			return -1;
+	}
+
+	ex_config = vzalloc(sizeof(*ex_config));
+	if (!ex_config)
+		return -1;
+	// nv21 like blks: chroma plane right after luma.
+	ex_config->blk_cnt = VB_INDEX_EX_BLK_CNT;
+	for (j = 0; j < VB_INDEX_EX_BLK_CNT; ++j) {
+		addr = VB_INDEX_FAKE_BASE + (uint64_t)j * VB_INDEX_EX_LUMA * 2;
+		ex_config->au64PhyAddr[j][0] = addr;
+		ex_config->au64PhyAddr[j][1] = addr + VB_INDEX_EX_LUMA;
+	}
+
+	memset(&config, 0, sizeof(config));
+	config.blk_cnt = 4;
+	config.blk_size = 0x10000;
+	config.remap_mode = VB_REMAP_MODE_NONE;
+	strncpy(config.pool_name, "vb_index", sizeof(config.pool_name));
+	if (vb_create_pool(&config)) {
+		vfree(ex_config);
+		return -1;
+	}
+	arg.base = config.mem_base;
+	arg.span = config.blk_cnt * config.blk_size;
+	arg.pool_id = config.pool_id;
+
+	tsk = kthread_run(_vb_index_race_thread, &arg, "vb_index_race");
+	if (IS_ERR(tsk)) {
+		ret = -1;
+		goto INDEX_TEST_DONE;
+	}
+
+	for (i = 0; i < VB_INDEX_RACE_LOOP; ++i) {
+		if (vb_create_ex_pool(ex_config)) {
+			ret = -1;
+			break;
+		}
+
+		j = get_random_u32() % VB_INDEX_EX_BLK_CNT;
+		addr = ex_config->au64PhyAddr[j][1] + 0x10;
+		blk = vb_physAddrWithin2Handle(addr);
+		if (vb_handle2PoolId(blk) != ex_config->pool_id
+		    || ((struct vb_s *)blk)->phy_addr != ex_config->au64PhyAddr[j][0]) {
+			CVI_TRACE_BASE(CVI_BASE_DBG_ERR, "within lookup of ex pool(%d) phyAddr(%#llx) fail\n",
+				ex_config->pool_id, addr);
+			ret = -1;
+		}
+
+		vb_destroy_pool(ex_config->pool_id);
+		if (ret)
+			break;
+	}
+	kthread_stop(tsk);
+
+	if (arg.err) {
+		CVI_TRACE_BASE(CVI_BASE_DBG_ERR, "race lookups hit wrong blk(%d)\n", arg.err);
+		ret = -1;
+	}
+	if (ret == 0) {
+		CVI_TRACE_BASE(CVI_BASE_DBG_INFO, "race loops(%d) hits(%d)\n", VB_INDEX_RACE_LOOP, arg.hit);
+		CVI_TRACE_BASE(CVI_BASE_DBG_INFO, "vb index test SUCCESS!\n");
+	}
+
+INDEX_TEST_DONE:
+	vb_destroy_pool(config.pool_id);
+	vfree(ex_config);
+	return ret;
+}
+
+#define VB_CREATE_POOL_MAX	512
+
+/* _vb_pool_footprint_test: create/destroy ex pools over a fake carveout
+ *                          and report time and vb_s metadata footprint.
+ */
+static int32_t _vb_pool_footprint_test(void)
+{
+	struct cvi_vb_pool_ex_cfg *config;
+	VB_POOL *pool;
+	uint32_t pool_cnt = 0, blk_cnt, i, j;
+	uint64_t t0, t_create, t_destroy, addr = VB_INDEX_FAKE_BASE;
+	int32_t ret = 0;
+
+	blk_cnt = min_t(uint32_t, vb_pool_max_blk, VB_POOL_MAX_BLK);
+	config = vzalloc(sizeof(*config));
+	pool = vmalloc(sizeof(VB_POOL) * VB_CREATE_POOL_MAX);
+	if (!config || !pool) {
+		ret = -1;
+		goto FOOTPRINT_TEST_DONE;
+	}
+
+	t0 = ktime_get_ns();
+	for (i = 0; i < VB_CREATE_POOL_MAX; ++i) {
+		config->blk_cnt = blk_cnt;
+		for (j = 0; j < blk_cnt; ++j) {
+			config->au64PhyAddr[j][0] = addr;
+			addr += VB_INDEX_FAKE_STRIDE;
+		}
+		if (vb_create_ex_pool(config))
+			break;	// out of pool ids
+		pool[pool_cnt++] = config->pool_id;
+	}
+	t_create = ktime_get_ns() - t0;
+
+	t0 = ktime_get_ns();
+	for (i = 0; i < pool_cnt; ++i)
+		vb_destroy_pool(pool[i]);
+	t_destroy = ktime_get_ns() - t0;
+
+	CVI_TRACE_BASE(CVI_BASE_DBG_INFO, "pools(%d) blks/pool(%d) create(%lld us) destroy(%lld us)\n",
+		pool_cnt, blk_cnt, div64_u64(t_create, NSEC_PER_USEC), div64_u64(t_destroy, NSEC_PER_USEC));
+	CVI_TRACE_BASE(CVI_BASE_DBG_INFO, "vb_s(%zu bytes) metadata(%lld KB), page per vb_s(%lld KB)\n",
+		sizeof(struct vb_s),
+		div64_u64((uint64_t)pool_cnt * blk_cnt * sizeof(struct vb_s), 1024),
+		div64_u64((uint64_t)pool_cnt * blk_cnt * PAGE_SIZE, 1024));
+	if (pool_cnt == 0)
+		ret = -1;
+	else
+		CVI_TRACE_BASE(CVI_BASE_DBG_INFO, "vb pool footprint test SUCCESS!\n");
+
+FOOTPRINT_TEST_DONE:
+	vfree(pool);
+	vfree(config);
+	return ret;
+}
+
+#define VB_MOTION_CHN_NUM	8
+#define VB_MOTION_LOOP		10000
+
+/* _vb_motion_loop: qbuf/dqbuf like loop over 8 chns. Each frame passes
+ *                  motion info from the input blk to the chn blk, then
+ *                  releases the chn blk.
+ */
+static int32_t _vb_motion_loop(struct vb_s *vb_in, uint32_t blk_size, uint64_t *duration, uint64_t *bytes)
+{
+	VB_BLK blk;
+	uint64_t t0, b0;
+	uint32_t i, chn;
+
+	b0 = atomic64_read(&vb_buf_touch_bytes);
+	t0 = ktime_get_ns();
+	for (i = 0; i < VB_MOTION_LOOP; ++i) {
+		for (chn = 0; chn < VB_MOTION_CHN_NUM; ++chn) {
+			blk = vb_get_block_with_id(VB_INVALID_POOLID, blk_size, CVI_ID_VPSS);
+			if (blk == VB_INVALID_HANDLE)
+				return -1;
+			vb_copy_motion((struct vb_s *)blk, vb_in);
+			vb_release_block(blk);
+		}
+	}
+	*duration = ktime_get_ns() - t0;
+	*bytes = atomic64_read(&vb_buf_touch_bytes) - b0;
+	return 0;
+}
+
+static int32_t _vb_motion_test(void)
+{
+	struct cvi_vb_cfg cfg;
+	struct vb_s *vb_in, *vb;
+	VB_BLK blk_in, blk;
+	uint8_t table[MO_TBL_SIZE];
+	uint64_t t_none, t_motion, b_none, b_motion;
+	uint32_t blk_size, frames = VB_MOTION_LOOP * VB_MOTION_CHN_NUM;
+	bool match;
+
+	if (vb_get_config(&cfg))
+		return -1;
+	blk_size = cfg.comm_pool[0].blk_size;
+
+	blk_in = vb_get_block_with_id(VB_INVALID_POOLID, blk_size, CVI_ID_VI);
+	if (blk_in == VB_INVALID_HANDLE)
+		return -1;
+	vb_in = (struct vb_s *)blk_in;
+
+	vb_set_motion(vb_in, 0, NULL);
+	if (_vb_motion_loop(vb_in, blk_size, &t_none, &b_none))
+		goto MOTION_TEST_FAIL;
+
+	memset(table, 0x5a, sizeof(table));
+	vb_set_motion(vb_in, 3, table);
+	if (_vb_motion_loop(vb_in, blk_size, &t_motion, &b_motion))
+		goto MOTION_TEST_FAIL;
+
+	// the table must reach the chn blk as is, and be cleared on release.
+	blk = vb_get_block_with_id(VB_INVALID_POOLID, blk_size, CVI_ID_VPSS);
+	if (blk == VB_INVALID_HANDLE)
+		goto MOTION_TEST_FAIL;
+	vb = (struct vb_s *)blk;
+	vb_copy_motion(vb, vb_in);
+	match = vb->buf.motion_lv == 3 && !memcmp(vb->buf.motion_table, table, MO_TBL_SIZE);
+	vb_release_block(blk);
+	if (!match || memchr_inv(vb->buf.motion_table, 0, MO_TBL_SIZE)) {
+		CVI_TRACE_BASE(CVI_BASE_DBG_ERR, "motion table not passed/cleared as expected\n");
+		goto MOTION_TEST_FAIL;
+	}
+
+	CVI_TRACE_BASE(CVI_BASE_DBG_INFO, "chns(%d) frames(%d) cvi_buffer(%zu bytes)\n",
+		VB_MOTION_CHN_NUM, frames, sizeof(struct cvi_buffer));
+	// bytes are counted by vb.c as the cvi_buffer is written, other threads may add to them.
+	CVI_TRACE_BASE(CVI_BASE_DBG_INFO, "no motion: %lld bytes/frame, %lld ns/frame\n",
+		div64_u64(b_none, frames), div64_u64(t_none, frames));
+	CVI_TRACE_BASE(CVI_BASE_DBG_INFO, "motion   : %lld bytes/frame, %lld ns/frame\n",
+		div64_u64(b_motion, frames), div64_u64(t_motion, frames));
+
+	vb_release_block(blk_in);
+	CVI_TRACE_BASE(CVI_BASE_DBG_INFO, "vb motion test SUCCESS!\n");
+	return 0;
+
+MOTION_TEST_FAIL:
+	vb_release_block(blk_in);
+	return -1;
+}
+
 int32_t vb_unit_test(int32_t op)
 {
 	int32_t ret = 0;
@@ -518,6 +1105,32 @@ int32_t vb_unit_test(int32_t op)
 	case 6: {
 		CVI_TRACE_BASE(CVI_BASE_DBG_INFO, "vb acquire blk test\n");
 		ret = _vb_acquire_block_test();
+		break;
+	}
+	case 7: {
+		CVI_TRACE_BASE(CVI_BASE_DBG_INFO, "vb get/release stress test\n");
+		ret = _vb_stress_test();
+		break;
+	}
+	case 8: {
+		CVI_TRACE_BASE(CVI_BASE_DBG_INFO, "vb find pool test\n");
+		ret = _vb_find_pool_test();
+		break;
+	}
+	case 9: {
+		CVI_TRACE_BASE(CVI_BASE_DBG_INFO, "vb phy-addr index test\n");
+		ret = _vb_index_test();
+		break;
+	}
+	case 10: {
+		CVI_TRACE_BASE(CVI_BASE_DBG_INFO, "vb pool footprint test\n");
+		ret = _vb_pool_footprint_test();
+		break;
+	}
+	case 11: {
+		CVI_TRACE_BASE(CVI_BASE_DBG_INFO, "vb motion info test\n");
+		ret = _vb_motion_test();
+		break;
 	}
 	default:
 		break;
@@ -11,9 +11,15 @@ extern "C" {
 
 #include <linux/types.h>
 #include <linux/slab.h>
+#include <linux/kthread.h>
+#include <linux/completion.h>
+#include <linux/sort.h>
+#include <linux/random.h>
 #include "vb.h"
 #include "sys.h"
 
+extern atomic64_t vb_buf_touch_bytes;
+
 int32_t vb_unit_test(int32_t op);
 
 
@@ -26,6 +26,9 @@ struct cvi_dwa_job {
 	MOD_ID_E enModId;
 
 	u64 hw_start_time;
+	u8 client;
+	bool admitted;		// holds a slot of its client's queue
+	u64 queue_ns;
 };
 
 struct cvi_dwa_ctx {
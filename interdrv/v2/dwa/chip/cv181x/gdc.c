@@ -4,6 +4,8 @@
 #include <linux/vmalloc.h>
 #include <linux/clk.h>
 #include <linux/mm.h>
+#include <linux/module.h>
+#include <linux/ktime.h>
 #include <uapi/linux/sched/types.h>
 
 #include <linux/cvi_comm_video.h>
@@ -16,6 +18,7 @@
 #include "dwa_debug.h"
 #include "dwa_platform.h"
 #include "cvi_vip_dwa.h"
+#include "cvi_vip_gdc_proc.h"
 #include "gdc.h"
 #include "ldc.h"
 #include "mesh.h"
@@ -54,6 +57,22 @@ static inline CVI_S32 CHECK_GDC_FORMAT(VIDEO_FRAME_INFO_S imgIn, VIDEO_FRAME_INF
 }
 
 struct cvi_gdc_proc_ctx *gdc_proc_ctx;
+static struct gdc_job_est gdc_est;
+
+/* DDR bandwidth (MB/s) the dwa sustains, used to estimate job latency */
+static int dwa_ddr_mbps = 1000;
+module_param(dwa_ddr_mbps, int, 0644);
+
+static struct gdc_client_stat gdc_client[GDC_CLIENT_MAX];
+static const char *const gdc_client_name[GDC_CLIENT_MAX] = {"VI", "VPSS", "VO", "USER"};
+
+/* Share of the hw each client gets when several have jobs queued */
+static int dwa_client_weight[GDC_CLIENT_MAX] = {4, 4, 2, 1};
+module_param_array(dwa_client_weight, int, NULL, 0644);
+
+/* Max jobs each client may have queued or running */
+static int dwa_client_depth[GDC_CLIENT_MAX] = {4, 4, 4, 8};
+module_param_array(dwa_client_depth, int, NULL, 0644);
 
 int gdc_handle_to_procIdx(struct cvi_dwa_job *job)
 {
@@ -220,6 +239,232 @@ static s32 gdc_rotation_check_size(ROTATION_E enRotation,
 	return CVI_SUCCESS;
 }
 
+static void dwa_clk_enable(struct cvi_dwa_vdev *wdev)
+{
+	// ldc_top
+	if (wdev->clk_sys[1])
+		clk_prepare_enable(wdev->clk_sys[1]);
+	// clk_ldc
+	if (wdev->clk_sys[4])
+		clk_prepare_enable(wdev->clk_sys[4]);
+	if (wdev->clk)
+		clk_prepare_enable(wdev->clk);
+}
+
+static void dwa_clk_disable(struct cvi_dwa_vdev *wdev)
+{
+	if (wdev->clk)
+		clk_disable_unprepare(wdev->clk);
+	if (wdev->clk_sys[4])
+		clk_disable_unprepare(wdev->clk_sys[4]);
+	if (wdev->clk_sys[1])
+		clk_disable_unprepare(wdev->clk_sys[1]);
+}
+
+static u32 gdc_frame_bytes(const VIDEO_FRAME_S *frame)
+{
+	u32 bytes = frame->u32Length[0] + frame->u32Length[1] +
+		    frame->u32Length[2];
+
+	if (bytes)
+		return bytes;
+
+	// user tasks may leave u32Length empty, derive it from the format.
+	bytes = frame->u32Width * frame->u32Height;
+	if (frame->enPixelFormat != PIXEL_FORMAT_YUV_400)
+		bytes += bytes >> 1;
+
+	return bytes;
+}
+
+/* gdc_task_ddr_bytes: bytes one task moves through DDR.
+ *
+ * The engine reads the source frame and the mesh once and writes the
+ * destination frame once, so this is the floor of the task's traffic.
+ *
+ * @param tsk: the gdc task
+ */
+static u32 gdc_task_ddr_bytes(const struct gdc_task *tsk)
+{
+	const VIDEO_FRAME_S *out = &tsk->stTask.stImgOut.stVFrame;
+	u64 mesh_addr = tsk->stTask.au64privateData[0];
+	u32 bytes, mesh_size = 0;
+	SIZE_S size;
+
+	bytes = gdc_frame_bytes(&tsk->stTask.stImgIn.stVFrame) +
+		gdc_frame_bytes(out);
+
+	if (mesh_addr && mesh_addr != DEFAULT_MESH_PADDR) {
+		size.u32Width = out->u32Width;
+		size.u32Height = out->u32Height;
+		mesh_gen_get_1st_size(size, &mesh_size);
+		bytes += mesh_size;
+	}
+
+	return bytes;
+}
+
+static void gdc_est_record_job(u32 task_num, u32 ddr_bytes, u32 hw_us)
+{
+	gdc_est.jobs++;
+	gdc_est.tasks += task_num;
+	gdc_est.ddr_bytes += ddr_bytes;
+	gdc_est.last_task_num = task_num;
+	gdc_est.last_ddr_bytes = ddr_bytes;
+	gdc_est.last_est_us = (dwa_ddr_mbps > 0) ? ddr_bytes / dwa_ddr_mbps : 0;
+	gdc_est.last_hw_us = hw_us;
+}
+
+void gdc_est_record_ldc(bool single_pass)
+{
+	if (single_pass)
+		gdc_est.ldc_single_pass++;
+	else
+		gdc_est.ldc_two_pass++;
+}
+
+void gdc_proc_show_est(struct seq_file *m)
+{
+	seq_printf(m, "%10s%10s%10s%20s%20s%20s%20s\n",
+		   "JobNum", "TaskNum", "LdcPass", "DdrTotal(KB)",
+		   "LastDdr(KB)", "LastEstTm(us)", "LastHwTm(us)");
+	seq_printf(m, "%10u%10u%6u/%-3u%20llu%20u%20u%20u\n",
+		   gdc_est.jobs, gdc_est.tasks,
+		   gdc_est.ldc_single_pass, gdc_est.ldc_two_pass,
+		   gdc_est.ddr_bytes >> 10, gdc_est.last_ddr_bytes >> 10,
+		   gdc_est.last_est_us, gdc_est.last_hw_us);
+}
+
+static u8 gdc_client_of(MOD_ID_E enModId)
+{
+	if (enModId == CVI_ID_VI)
+		return GDC_CLIENT_VI;
+	else if (enModId == CVI_ID_VPSS)
+		return GDC_CLIENT_VPSS;
+	else if (enModId == CVI_ID_VO)
+		return GDC_CLIENT_VO;
+
+	return GDC_CLIENT_USER;
+}
+
+/* gdc_client_reserve: take a queue slot for the client if it has one left.
+ *
+ * The check and the take are one step under wdev->lock, so concurrent
+ * submitters can't both pass on the last slot.
+ */
+static bool gdc_client_reserve(struct cvi_dwa_vdev *wdev, u8 client)
+{
+	unsigned long flags;
+	bool room;
+
+	spin_lock_irqsave(&wdev->lock, flags);
+	room = gdc_client[client].depth < max(dwa_client_depth[client], 1);
+	if (room) {
+		gdc_client[client].depth++;
+		gdc_client[client].max_depth = max(gdc_client[client].max_depth,
+						   gdc_client[client].depth);
+	}
+	spin_unlock_irqrestore(&wdev->lock, flags);
+
+	return room;
+}
+
+static void gdc_client_unreserve(struct cvi_dwa_vdev *wdev, u8 client)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&wdev->lock, flags);
+	gdc_client[client].depth--;
+	spin_unlock_irqrestore(&wdev->lock, flags);
+	wake_up(&wdev->client_wq);
+}
+
+s32 gdc_client_admit(struct cvi_dwa_vdev *wdev, u64 hHandle, MOD_ID_E enModId)
+{
+	struct cvi_dwa_job *job = (struct cvi_dwa_job *)(uintptr_t)hHandle;
+	unsigned long flags;
+
+	if (!job)
+		return CVI_ERR_GDC_NULL_PTR;
+
+	job->client = gdc_client_of(enModId);
+	if (!gdc_client_reserve(wdev, job->client)) {
+		spin_lock_irqsave(&wdev->lock, flags);
+		gdc_client[job->client].drop++;
+		spin_unlock_irqrestore(&wdev->lock, flags);
+		return CVI_ERR_GDC_BUSY;
+	}
+	job->admitted = true;
+
+	return CVI_SUCCESS;
+}
+
+/* gdc_pick_job: choose the next job by smooth weighted round-robin.
+ *
+ * Every client with queued jobs earns its weight, the richest one runs its
+ * oldest job and pays back the sum of the weights. The chosen job is moved
+ * to the head of jobq, where the irq handler expects the running job.
+ */
+static struct cvi_dwa_job *gdc_pick_job(struct cvi_dwa_vdev *wdev)
+{
+	struct cvi_dwa_job *job, *pick = NULL;
+	struct gdc_client_stat *stat;
+	unsigned long flags;
+	int c, best = -1, total = 0;
+	u32 wait_us;
+
+	spin_lock_irqsave(&wdev->lock, flags);
+	for (c = 0; c < GDC_CLIENT_MAX; ++c) {
+		if (!gdc_client[c].queued)
+			continue;
+
+		gdc_client[c].cur_weight += max(dwa_client_weight[c], 1);
+		total += max(dwa_client_weight[c], 1);
+		if (best < 0 || gdc_client[c].cur_weight > gdc_client[best].cur_weight)
+			best = c;
+	}
+
+	if (best >= 0) {
+		list_for_each_entry(job, &wdev->jobq, node) {
+			if (job->client == best) {
+				pick = job;
+				break;
+			}
+		}
+	}
+
+	if (pick) {
+		stat = &gdc_client[best];
+		stat->cur_weight -= total;
+		stat->queued--;
+		wait_us = (u32)((ktime_get_ns() - pick->queue_ns) / NSEC_PER_USEC);
+		stat->wait_us += wait_us;
+		stat->max_wait_us = max(stat->max_wait_us, wait_us);
+		list_move(&pick->node, &wdev->jobq);
+	}
+	spin_unlock_irqrestore(&wdev->lock, flags);
+
+	return pick;
+}
+
+void gdc_proc_show_client(struct seq_file *m)
+{
+	int c;
+
+	seq_printf(m, "%10s%10s%10s%10s%10s%10s%20s%20s\n",
+		   "Client", "Weight", "Depth", "MaxDepth", "JobNum", "Drop",
+		   "AvgWaitTm(us)", "MaxWaitTm(us)");
+	for (c = 0; c < GDC_CLIENT_MAX; ++c)
+		seq_printf(m, "%10s%10d%6u/%-3d%10u%10u%10u%20llu%20u\n",
+			   gdc_client_name[c], dwa_client_weight[c],
+			   gdc_client[c].depth, dwa_client_depth[c],
+			   gdc_client[c].max_depth, gdc_client[c].jobs,
+			   gdc_client[c].drop,
+			   gdc_client[c].jobs ?
+				div_u64(gdc_client[c].wait_us, gdc_client[c].jobs) : 0,
+			   gdc_client[c].max_wait_us);
+}
+
 static void cvi_dwa_submit_hw(struct cvi_dwa_vdev *wdev,
 			      struct cvi_dwa_job *job, struct gdc_task *tsk)
 {
@@ -324,15 +569,6 @@ static void cvi_dwa_submit_hw(struct cvi_dwa_vdev *wdev,
 
 	// TODO: hrtimer_start to detect h/w timeout
 
-	// ldc_top
-	if (wdev->clk_sys[1])
-		clk_prepare_enable(wdev->clk_sys[1]);
-	// clk_ldc
-	if (wdev->clk_sys[4])
-		clk_prepare_enable(wdev->clk_sys[4]);
-	if (wdev->clk)
-		clk_prepare_enable(wdev->clk);
-
 	gdc_proc_record_hw_start(job);
 
 	// ldc_reset();
@@ -387,13 +623,6 @@ static void cvi_dwa_handle_hw_cb(struct cvi_dwa_vdev *wdev, struct cvi_dwa_job *
 
 	CVI_TRACE_DWA(CVI_DBG_DEBUG, "is_internal=%d\n", is_internal);
 
-	if (wdev->clk)
-		clk_disable_unprepare(wdev->clk);
-	if (wdev->clk_sys[4])
-		clk_disable_unprepare(wdev->clk_sys[4]);
-	if (wdev->clk_sys[1])
-		clk_disable_unprepare(wdev->clk_sys[1]);
-
 	/* []internal module]:
 	 *  sync_io or async_io
 	 *  release imgin vb_blk at task done.
@@ -419,17 +648,18 @@ static void cvi_dwa_handle_hw_cb(struct cvi_dwa_vdev *wdev, struct cvi_dwa_job *
 		if (blk_out == VB_INVALID_HANDLE)
 			CVI_TRACE_DWA(CVI_DBG_ERR, "Can't get valid vb_blk.\n");
 		else {
-			// TODO: not handle timeout yet
-			//VB_BLK blk_out_ret = (ret == CVI_SUCCESS) ? blk_out : VB_INVALID_HANDLE;
 			VB_BLK blk_out_ret = blk_out;
 
 			((struct vb_s *)blk_out)->mod_ids &= ~BIT(CVI_ID_GDC);
-			if (isLastTask && (!is_timeout))
+			// a timed out frame still completes, without output, so the
+			// module gets its in-flight count and mesh lock back
+			if (isLastTask && is_timeout) {
+				vb_release_block(blk_out);
+				blk_out_ret = VB_INVALID_HANDLE;
+			}
+			if (isLastTask)
 				_dwa_op_done_cb(enModId, (void *)(uintptr_t)tsk->stTask.au64privateData[2],
 						blk_out_ret);
-
-			//if (ret != CVI_SUCCESS)
-			//	vb_release_block(blk_out);
 		}
 
 		// User space:
@@ -445,9 +675,11 @@ static void cvi_dwa_handle_hw_cb(struct cvi_dwa_vdev *wdev, struct cvi_dwa_job *
 			vfree((void *)(uintptr_t)tsk->stTask.au64privateData[2]);
 		}
 	} else {
-		// release mesh
+		// release mesh, unless the mesh cache keeps it for the next job
 		if (tsk->stTask.au64privateData[0] &&
-		    tsk->stTask.au64privateData[0] != DEFAULT_MESH_PADDR)
+		    tsk->stTask.au64privateData[0] != DEFAULT_MESH_PADDR &&
+		    !mesh_cache_put(&tsk->stTask, tsk->type == GDC_TASK_TYPE_LDC,
+				    tsk->stTask.au64privateData[0]))
 			sys_ion_free(tsk->stTask.au64privateData[0]);
 
 		// release slice buffer
@@ -456,6 +688,48 @@ static void cvi_dwa_handle_hw_cb(struct cvi_dwa_vdev *wdev, struct cvi_dwa_job *
 	}
 }
 
+#ifdef PORTING_TEST
+/* Stands in for the engine in ldc_test: a task completes after the time
+ * its DDR traffic takes at dwa_ddr_mbps, and the registers are left alone.
+ */
+static bool gdc_mock_engine;
+
+void gdc_set_mock_engine(bool enable)
+{
+	gdc_mock_engine = enable;
+}
+
+void gdc_est_get(struct gdc_job_est *est)
+{
+	*est = gdc_est;
+}
+
+static void gdc_mock_submit(struct cvi_dwa_vdev *wdev,
+			    struct cvi_dwa_job *job, struct gdc_task *tsk)
+{
+	u32 us = (dwa_ddr_mbps > 0) ? gdc_task_ddr_bytes(tsk) / dwa_ddr_mbps : 0;
+
+	tsk->state = GDC_TASK_STATE_RUNNING;
+	gdc_proc_record_hw_start(job);
+	usleep_range(us, us + 10);
+	tsk->state = GDC_TASK_STATE_DONE;
+	gdc_proc_record_hw_end(job);
+	complete(&wdev->sem);
+}
+#endif
+
+static void gdc_submit(struct cvi_dwa_vdev *wdev,
+		       struct cvi_dwa_job *job, struct gdc_task *tsk)
+{
+#ifdef PORTING_TEST
+	if (gdc_mock_engine) {
+		gdc_mock_submit(wdev, job, tsk);
+		return;
+	}
+#endif
+	cvi_dwa_submit_hw(wdev, job, tsk);
+}
+
 static int _notify_vpp_sb_mode(struct gdc_task *tsk)
 {
 	struct base_exe_m_cb exe_cb;
@@ -536,18 +810,28 @@ void gdc_job_worker(struct kthread_work *work)
 	struct cvi_dwa_vdev *wdev =
 		container_of(work, struct cvi_dwa_vdev, work);
 	unsigned long flags;
-	struct cvi_dwa_job *job, *tmp_job;
+	struct cvi_dwa_job *job;
 	struct gdc_task *tsk, *tmp_tsk;
 	int ret;
 	unsigned long timeout;
 	CVI_BOOL is_timeout;
 	u8 intr_status;
+	ktime_t job_start;
+	u32 task_num, ddr_bytes;
 
 	CVI_TRACE_DWA(CVI_DBG_DEBUG, "+\n");
 
-	list_for_each_entry_safe(job, tmp_job, &wdev->jobq, node) {
+	while ((job = gdc_pick_job(wdev)) != NULL) {
 		gdc_proc_record_job_start(job);
 
+		/* Clocks stay on across the whole job so that the tasks are
+		 * programmed back to back instead of re-gating per task.
+		 */
+		dwa_clk_enable(wdev);
+		job_start = ktime_get();
+		task_num = 0;
+		ddr_bytes = 0;
+
 		list_for_each_entry_safe(tsk, tmp_tsk, &job->task_list, node) {
 			if (tsk->state == GDC_TASK_STATE_IDLE) {
 				if (tsk->stTask.stBufWrap.bEnable) {
@@ -563,7 +847,7 @@ void gdc_job_worker(struct kthread_work *work)
 						continue;
 					}
 				}
-				cvi_dwa_submit_hw(wdev, job, tsk);
+				gdc_submit(wdev, job, tsk);
 			} else {
 				CVI_TRACE_DWA(CVI_DBG_WARN, "dwa hw busy, not done tsk yet\n");
 				continue;
@@ -580,6 +864,8 @@ void gdc_job_worker(struct kthread_work *work)
 			} else {
 				is_timeout = CVI_FALSE;
 			}
+			task_num++;
+			ddr_bytes += gdc_task_ddr_bytes(tsk);
 			cvi_dwa_handle_hw_cb(wdev, job, tsk, is_timeout);
 			spin_lock_irqsave(&wdev->lock, flags);
 			list_del(&tsk->node);
@@ -587,10 +873,17 @@ void gdc_job_worker(struct kthread_work *work)
 			kfree(tsk);
 			CVI_TRACE_DWA(CVI_DBG_DEBUG, "tsk done, del tsk\n");
 		}
+		dwa_clk_disable(wdev);
+		gdc_est_record_job(task_num, ddr_bytes,
+				   (u32)ktime_us_delta(ktime_get(), job_start));
+
 		spin_lock_irqsave(&wdev->lock, flags);
 		list_del(&job->node);
+		gdc_client[job->client].depth--;
+		gdc_client[job->client].jobs++;
 		wdev->job_done = true;
 		spin_unlock_irqrestore(&wdev->lock, flags);
+		wake_up(&wdev->client_wq);
 
 		if (job->sync_io)
 			wake_up_interruptible(&wdev->cond_queue);
@@ -611,6 +904,7 @@ int cvi_gdc_init(struct cvi_dwa_vdev *wdev)
 	INIT_LIST_HEAD(&wdev->event_list);
 	INIT_LIST_HEAD(&wdev->jobq);
 	init_waitqueue_head(&wdev->cond_queue);
+	init_waitqueue_head(&wdev->client_wq);
 	kthread_init_work(&wdev->work, gdc_job_worker);
 	spin_lock_init(&wdev->lock);
 	init_completion(&wdev->sem);
@@ -731,10 +1025,26 @@ s32 gdc_end_job(struct cvi_dwa_vdev *wdev, u64 hHandle)
 		return CVI_ERR_GDC_NOT_PERMITTED;
 	}
 
+	if (!job->admitted) {
+		job->client = gdc_client_of(job->enModId);
+		if (job->client == GDC_CLIENT_USER) {
+			/* a user batch waits for room rather than crowd out the capture path */
+			ret = wait_event_interruptible(wdev->client_wq,
+						       gdc_client_reserve(wdev, job->client));
+			if (ret)
+				return ret;
+		} else if (!gdc_client_reserve(wdev, job->client)) {
+			return CVI_ERR_GDC_BUSY;
+		}
+		job->admitted = true;
+	}
+
 	gdc_update_proc(job);
 
 	spin_lock_irqsave(&wdev->lock, flags);
+	job->queue_ns = ktime_get_ns();
 	list_add_tail(&job->node, &wdev->jobq);
+	gdc_client[job->client].queued++;
 	wdev->job_done = false;
 	spin_unlock_irqrestore(&wdev->lock, flags);
 
@@ -749,6 +1059,41 @@ s32 gdc_end_job(struct cvi_dwa_vdev *wdev, u64 hHandle)
 	return ret;
 }
 
+s32 gdc_cancel_job(struct cvi_dwa_vdev *wdev, u64 hHandle)
+{
+	struct cvi_dwa_job *job = (struct cvi_dwa_job *)(uintptr_t)hHandle;
+	struct gdc_task *tsk, *tmp;
+	unsigned long flags;
+	struct list_head tasks;
+
+	if (!job)
+		return CVI_ERR_GDC_NULL_PTR;
+
+	INIT_LIST_HEAD(&tasks);
+
+	if (gdc_proc_ctx)
+		gdc_proc_ctx->stJobStatus.u32BeginNum--;
+
+	spin_lock_irqsave(&wdev->lock, flags);
+	list_splice_init(&job->task_list, &tasks);
+	spin_unlock_irqrestore(&wdev->lock, flags);
+
+	list_for_each_entry_safe(tsk, tmp, &tasks, node) {
+		list_del(&tsk->node);
+		// the callback param init_ldc_param() allocated for the task
+		if (tsk->stTask.reserved == CVI_GDC_MAGIC)
+			vfree((void *)(uintptr_t)tsk->stTask.au64privateData[2]);
+		else if (tsk->stTask.au64privateData[0])
+			mesh_cache_task_cancel(tsk->stTask.au64privateData[0]);
+		kfree(tsk);
+	}
+	if (job->admitted)
+		gdc_client_unreserve(wdev, job->client);
+	kfree(job);
+
+	return CVI_SUCCESS;
+}
+
 s32 gdc_add_rotation_task(struct cvi_dwa_vdev *wdev,
 			  struct gdc_task_attr *attr)
 {
@@ -781,6 +1126,8 @@ s32 gdc_add_rotation_task(struct cvi_dwa_vdev *wdev,
 
 	job = (struct cvi_dwa_job *)(uintptr_t)handle;
 	tsk = kzalloc(sizeof(*tsk), GFP_ATOMIC);
+	if (!tsk)
+		return CVI_ERR_GDC_NOBUF;
 
 	memcpy(&tsk->stTask, attr, sizeof(tsk->stTask));
 	tsk->type = GDC_TASK_TYPE_ROT;
@@ -825,6 +1172,8 @@ s32 gdc_add_ldc_task(struct cvi_dwa_vdev *wdev, struct gdc_task_attr *attr)
 
 	job = (struct cvi_dwa_job *)(uintptr_t)handle;
 	tsk = kzalloc(sizeof(*tsk), GFP_ATOMIC);
+	if (!tsk)
+		return CVI_ERR_GDC_NOBUF;
 
 	memcpy(&tsk->stTask, attr, sizeof(tsk->stTask));
 	tsk->type = GDC_TASK_TYPE_LDC;
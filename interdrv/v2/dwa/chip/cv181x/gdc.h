@@ -23,6 +23,14 @@ enum gdc_task_state {
 	GDC_TASK_STATE_MAX,
 };
 
+enum gdc_client {
+	GDC_CLIENT_VI,
+	GDC_CLIENT_VPSS,
+	GDC_CLIENT_VO,
+	GDC_CLIENT_USER,
+	GDC_CLIENT_MAX,
+};
+
 enum gdc_op_id { GDC_OP_MESH_JOB = 0, GDC_OP_MAX };
 
 /* gdc_task: the gdc task.
@@ -41,6 +49,44 @@ struct gdc_task {
 	enum gdc_task_state state;
 };
 
+/* gdc_job_est: DDR traffic and latency estimate of the gdc jobs.
+ *
+ * ddr_bytes: src, dst and mesh bytes moved by all jobs so far.
+ * ldc_single_pass/ldc_two_pass: ldc jobs by the number of passes.
+ * last_est_us: latency of the last job predicted from last_ddr_bytes.
+ * last_hw_us: measured time of the last job, first submit to last irq.
+ */
+struct gdc_job_est {
+	u32 jobs;
+	u32 tasks;
+	u32 ldc_single_pass;
+	u32 ldc_two_pass;
+	u64 ddr_bytes;
+	u32 last_task_num;
+	u32 last_ddr_bytes;
+	u32 last_est_us;
+	u32 last_hw_us;
+};
+
+/* gdc_client_stat: queueing statistics of one gdc client.
+ *
+ * queued: jobs waiting for the hw.
+ * depth: jobs queued or running, bounded by dwa_client_depth.
+ * wait_us: accumulated time the jobs waited before the hw took them.
+ * drop: internal jobs rejected because the client's queue was full.
+ * cur_weight: smooth weighted round-robin state of the scheduler.
+ */
+struct gdc_client_stat {
+	u32 queued;
+	u32 depth;
+	u32 max_depth;
+	u32 jobs;
+	u32 drop;
+	u32 max_wait_us;
+	u64 wait_us;
+	int cur_weight;
+};
+
 /* Begin a gdc job,then add task into the job,gdc will finish all the task in the job.
  *
  * @param phHandle: u64 *phHandle
@@ -96,6 +142,22 @@ s32 gdc_get_buf_wrap(struct cvi_dwa_vdev *wdev, struct dwa_buf_wrap_cfg *cfg);
 int cvi_gdc_init(struct cvi_dwa_vdev *wdev);
 
 void gdc_proc_record_hw_end(struct cvi_dwa_job *job);
+void gdc_est_record_ldc(bool single_pass);
+
+#ifdef PORTING_TEST
+void gdc_set_mock_engine(bool enable);
+void gdc_est_get(struct gdc_job_est *est);
+#endif
+
+/* Reserve a slot of the module's queue for a job begun but not yet ended
+ *
+ * The slot is given back when the job is done or cancelled.
+ *
+ * @param hHandle: the job from gdc_begin_job
+ * @param enModId: the module submitting the job
+ * @return CVI_ERR_GDC_BUSY if the module's queue is full, 0 otherwise
+ */
+s32 gdc_client_admit(struct cvi_dwa_vdev *wdev, u64 hHandle, MOD_ID_E enModId);
 
 int dwa_vpss_sdm_cb_done(struct cvi_dwa_vdev *wdev);
 
@@ -6,12 +6,22 @@
 #include <linux/proc_fs.h>
 #include <linux/seq_file.h>
 #include <linux/dma-buf.h>
+#include <linux/ktime.h>
 #include <linux/version.h>
 
+#include <linux/cvi_comm_video.h>
+#include <linux/cvi_comm_gdc.h>
+#include <linux/dwa_uapi.h>
+
 #include "ion/ion.h"
 #include "ion/cvitek/cvitek_ion_alloc.h"
 
 #include "ldc_test.h"
+#include "dwa_platform.h"
+#include "cvi_vip_dwa.h"
+#include "gdc.h"
+#include "mesh.h"
+#include "sys.h"
 #include "ldc.h"
 #include "ldc_reg.h"
 #include "reg_ldc.h"
@@ -23,6 +33,11 @@
 
 uint8_t ldc_test_enabled;
 
+#ifdef PORTING_TEST
+static u32 ldc_tst_mark;
+static bool ldc_tst_enable_cmdq;
+#endif
+
 #ifdef PORTING_TEST
 void ldc_dump_register(void)
 {
@@ -254,6 +269,257 @@ static int ldc_test1(void)
 	return ret;
 }
 
+/*
+ * Mesh cache cold/warm: look up a 1080p ldc mesh the way the library does.
+ * The cold lookup misses, the mesh is allocated and filled in its place and
+ * handed back by a finished task. The warm lookup has to return the same
+ * mesh without the allocation. Then the cache is flushed under a pinned hit,
+ * as eviction does after the pin expired, and adding a task with that paddr
+ * has to be refused.
+ */
+static int ldc_test_mesh_cache(void)
+{
+	static const char owner;	// stands in for a dwa fd
+	struct gdc_task_attr attr;
+	SIZE_S size = {.u32Width = 1920, .u32Height = 1080};
+	uint64_t mesh;
+	u64 paddr, t;
+	u64 cold_ns, warm_ns;
+	void *mesh_v;
+	u32 mesh_size;
+	int ret = 0;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.stImgIn.stVFrame.u32Width = attr.stImgOut.stVFrame.u32Width = size.u32Width;
+	attr.stImgIn.stVFrame.u32Height = attr.stImgOut.stVFrame.u32Height = size.u32Height;
+	attr.stImgIn.stVFrame.enPixelFormat = PIXEL_FORMAT_NV21;
+	attr.enRotation = ROTATION_0;
+	attr.stLDCAttr.bAspect = CVI_TRUE;
+	attr.stLDCAttr.s32XYRatio = 100;
+	attr.stLDCAttr.s32DistortionRatio = -200;
+	mesh_gen_get_1st_size(size, &mesh_size);
+	mesh_size *= 2;
+
+	// cold: miss, then what the library does before it can add the task
+	t = ktime_get_ns();
+	paddr = mesh_cache_get(&owner, &attr, CVI_DWA_OP_LDC);
+	if (paddr) {
+		CVI_TRACE_DWA(CVI_DBG_ERR, "cold lookup hit 0x%llx\n", paddr);
+		ret = -1;
+		goto out;
+	}
+	if (sys_ion_alloc(&mesh, &mesh_v, (uint8_t *)"ldc_test_mesh", mesh_size, false)) {
+		CVI_TRACE_DWA(CVI_DBG_ERR, "mesh alloc fail\n");
+		ret = -1;
+		goto out;
+	}
+	memset(mesh_v, 0, mesh_size);
+	cold_ns = ktime_get_ns() - t;
+
+	if (mesh_cache_task_get(&owner, mesh) ||
+	    !mesh_cache_put(&attr, true, mesh)) {
+		CVI_TRACE_DWA(CVI_DBG_ERR, "claimed mesh not cached (dwa_mesh_cache_kb 0?)\n");
+		sys_ion_free(mesh);
+		ret = -1;
+		goto out;
+	}
+
+	// warm
+	t = ktime_get_ns();
+	paddr = mesh_cache_get(&owner, &attr, CVI_DWA_OP_LDC);
+	warm_ns = ktime_get_ns() - t;
+	if (paddr != mesh) {
+		CVI_TRACE_DWA(CVI_DBG_ERR, "warm lookup 0x%llx, expect 0x%llx\n",
+			      paddr, (unsigned long long)mesh);
+		ret = -1;
+		goto out;
+	}
+	if (mesh_cache_task_get(&owner, paddr) || !mesh_cache_put(&attr, true, paddr)) {
+		CVI_TRACE_DWA(CVI_DBG_ERR, "warm mesh not held by the task\n");
+		ret = -1;
+	}
+
+	CVI_TRACE_DWA(CVI_DBG_INFO, "%ux%u ldc mesh %u bytes: cold %llu us, warm %llu us\n",
+		      size.u32Width, size.u32Height, mesh_size,
+		      div_u64(cold_ns, NSEC_PER_USEC), div_u64(warm_ns, NSEC_PER_USEC));
+	if (warm_ns >= cold_ns)
+		ret = -1;
+
+	// the pinned mesh goes away before its task is added
+	paddr = mesh_cache_get(&owner, &attr, CVI_DWA_OP_LDC);
+	mesh_cache_flush();
+	if (!paddr || mesh_cache_task_get(&owner, paddr) != -EINVAL) {
+		CVI_TRACE_DWA(CVI_DBG_ERR, "task on a freed mesh 0x%llx accepted\n", paddr);
+		ret = -1;
+	}
+
+out:
+	mesh_cache_release(&owner);
+	CVI_TRACE_DWA(CVI_DBG_INFO, "mesh cache %s\n", ret ? "fail" : "pass");
+
+	return ret;
+}
+
+/* ldc_test_mock_engine: the ddr estimator on the real job path.
+ *
+ * The engine is swapped for the gdc mock, which takes as long as a task's
+ * DDR traffic at dwa_ddr_mbps. A 1920x1088 ldc with 90 degree rotation runs
+ * as the two passes mesh_gdc_do_ldc builds and as the one rotation pass an
+ * identity ldc is cut down to, which has to move less DDR. Then
+ * LDC_TEST_CHAIN rotations run one job per task and chained in one job,
+ * which has to move the same bytes in fewer jobs.
+ *
+ * Run it with vi/vpss/vo stopped, the mock serves every dwa job meanwhile.
+ */
+#define LDC_TEST_CHAIN	4
+
+static void ldc_test_mock_attr(struct gdc_task_attr *attr, u32 w_in, u32 h_in,
+			       ROTATION_E enRotation, u64 mesh)
+{
+	bool swap = (enRotation == ROTATION_90 || enRotation == ROTATION_270);
+
+	memset(attr, 0, sizeof(*attr));
+	attr->enRotation = enRotation;
+	attr->stImgIn.stVFrame.enPixelFormat = PIXEL_FORMAT_NV21;
+	attr->stImgIn.stVFrame.u32Width = w_in;
+	attr->stImgIn.stVFrame.u32Height = h_in;
+	attr->stImgOut.stVFrame.enPixelFormat = PIXEL_FORMAT_NV21;
+	attr->stImgOut.stVFrame.u32Width = swap ? h_in : w_in;
+	attr->stImgOut.stVFrame.u32Height = swap ? w_in : h_in;
+	attr->au64privateData[0] = mesh;
+}
+
+/* Run the tasks as one sync job. Tasks without a mesh are ldc tasks and get
+ * one allocated, which dwa frees when the task is done.
+ */
+static int ldc_test_mock_job(struct cvi_dwa_vdev *wdev, struct gdc_task_attr *attr,
+			     u32 num, u32 mesh_size, struct gdc_job_est *est,
+			     u64 *wall_ns)
+{
+	struct gdc_handle_data data;
+	uint64_t mesh;
+	void *mesh_v;
+	u64 t;
+	s32 ret = CVI_SUCCESS;
+	u32 i, j;
+
+	memset(&data, 0, sizeof(data));
+	ret = gdc_begin_job(wdev, &data);
+	if (ret != CVI_SUCCESS)
+		return ret;
+
+	for (i = 0; i < num; i++) {
+		attr[i].handle = data.handle;
+		if (attr[i].au64privateData[0] == DEFAULT_MESH_PADDR) {
+			ret = gdc_add_rotation_task(wdev, &attr[i]);
+		} else if (sys_ion_alloc(&mesh, &mesh_v, (uint8_t *)"ldc_test_mesh",
+					 mesh_size, false)) {
+			ret = CVI_ERR_GDC_NOBUF;
+		} else {
+			attr[i].au64privateData[0] = mesh;
+			ret = gdc_add_ldc_task(wdev, &attr[i]);
+			if (ret != CVI_SUCCESS) {
+				sys_ion_free(mesh);
+				attr[i].au64privateData[0] = 0;
+			}
+		}
+		if (ret != CVI_SUCCESS)
+			break;
+	}
+	if (ret != CVI_SUCCESS) {
+		gdc_cancel_job(wdev, data.handle);
+		for (j = 0; j < i; j++)
+			if (attr[j].au64privateData[0] != DEFAULT_MESH_PADDR)
+				sys_ion_free(attr[j].au64privateData[0]);
+		CVI_TRACE_DWA(CVI_DBG_ERR, "add task %u fail, ret=%#x\n", i, ret);
+		return ret;
+	}
+
+	t = ktime_get_ns();
+	ret = gdc_end_job(wdev, data.handle);
+	*wall_ns = ktime_get_ns() - t;
+	if (ret != CVI_SUCCESS) {
+		CVI_TRACE_DWA(CVI_DBG_ERR, "end job fail, ret=%#x\n", ret);
+		return ret;
+	}
+	gdc_est_get(est);
+
+	return CVI_SUCCESS;
+}
+
+static int ldc_test_mock_engine(struct cvi_dwa_vdev *wdev)
+{
+	struct gdc_task_attr attr[LDC_TEST_CHAIN];
+	struct gdc_job_est est;
+	SIZE_S size_out = {.u32Width = 1088, .u32Height = 1920};
+	u32 mesh_size, two_pass_bytes, two_pass_us, task_bytes = 0;
+	u64 wall_ns, task_ns = 0;
+	bool fail = false;
+	int ret, i;
+
+	mesh_gen_get_1st_size(size_out, &mesh_size);
+	gdc_set_mock_engine(true);
+
+	// two passes: ldc and rotate into a temp frame, then ldc back
+	ldc_test_mock_attr(&attr[0], 1920, 1088, ROTATION_90, 0);
+	ldc_test_mock_attr(&attr[1], 1088, 1920, ROTATION_0, 0);
+	ret = ldc_test_mock_job(wdev, attr, 2, mesh_size, &est, &wall_ns);
+	if (ret)
+		goto out;
+	two_pass_bytes = est.last_ddr_bytes;
+	two_pass_us = est.last_est_us;
+	CVI_TRACE_DWA(CVI_DBG_INFO, "ldc two pass: %u tasks, ddr %u KB, est %u us, hw %u us\n",
+		      est.last_task_num, est.last_ddr_bytes >> 10,
+		      est.last_est_us, est.last_hw_us);
+
+	// one pass: an identity ldc leaves only the rotation
+	ldc_test_mock_attr(&attr[0], 1920, 1088, ROTATION_90, DEFAULT_MESH_PADDR);
+	ret = ldc_test_mock_job(wdev, attr, 1, 0, &est, &wall_ns);
+	if (ret)
+		goto out;
+	CVI_TRACE_DWA(CVI_DBG_INFO, "ldc one pass: %u tasks, ddr %u KB, est %u us, hw %u us\n",
+		      est.last_task_num, est.last_ddr_bytes >> 10,
+		      est.last_est_us, est.last_hw_us);
+	if (est.last_ddr_bytes >= two_pass_bytes || est.last_est_us > two_pass_us) {
+		CVI_TRACE_DWA(CVI_DBG_ERR, "one pass not cheaper than two\n");
+		fail = true;
+	}
+
+	// one job per task
+	for (i = 0; i < LDC_TEST_CHAIN; i++) {
+		ldc_test_mock_attr(&attr[0], 1920, 1088, ROTATION_90, DEFAULT_MESH_PADDR);
+		ret = ldc_test_mock_job(wdev, attr, 1, 0, &est, &wall_ns);
+		if (ret)
+			goto out;
+		task_bytes += est.last_ddr_bytes;
+		task_ns += wall_ns;
+	}
+
+	// the same tasks chained in one job
+	for (i = 0; i < LDC_TEST_CHAIN; i++)
+		ldc_test_mock_attr(&attr[i], 1920, 1088, ROTATION_90, DEFAULT_MESH_PADDR);
+	ret = ldc_test_mock_job(wdev, attr, LDC_TEST_CHAIN, 0, &est, &wall_ns);
+	if (ret)
+		goto out;
+	CVI_TRACE_DWA(CVI_DBG_INFO, "%d rotations: per task %llu us, chained %llu us, ddr %u KB\n",
+		      LDC_TEST_CHAIN, div_u64(task_ns, NSEC_PER_USEC),
+		      div_u64(wall_ns, NSEC_PER_USEC), est.last_ddr_bytes >> 10);
+	if (est.last_task_num != LDC_TEST_CHAIN || est.last_ddr_bytes != task_bytes) {
+		CVI_TRACE_DWA(CVI_DBG_ERR, "chained job %u tasks %u bytes, expect %u tasks %u bytes\n",
+			      est.last_task_num, est.last_ddr_bytes,
+			      LDC_TEST_CHAIN, task_bytes);
+		fail = true;
+	}
+
+out:
+	gdc_set_mock_engine(false);
+	if (fail)
+		ret = -1;
+	CVI_TRACE_DWA(CVI_DBG_INFO, "mock engine %s\n", ret ? "fail" : "pass");
+
+	return ret;
+}
+
 static void ldc_test_usage(struct seq_file *m)
 {
 	seq_puts(m, "  0: 64x64, memcpy\n");
@@ -263,6 +529,8 @@ static void ldc_test_usage(struct seq_file *m)
 	seq_puts(m, "  4: 1984x1088, 2 pass ldc\n");
 	seq_puts(m, "  5: 320x256, 2 pass ldc\n");
 	seq_puts(m, "  6: 320x256, cmdq, bypass, flat\n");
+	seq_puts(m, "  7: mesh cache, cold/warm lookup\n");
+	seq_puts(m, "  8: mock engine, ldc 2 pass/1 pass, per task/chained\n");
 	seq_puts(m, "100: dump register\n");
 }
 
@@ -298,6 +566,14 @@ static ssize_t ldc_test_proc_write(struct file *file, const char __user *user_bu
 		ldc_test1();
 	break;
 
+	case 7:
+		ldc_test_mesh_cache();
+	break;
+
+	case 8:
+		ldc_test_mock_engine(PDE_DATA(file_inode(file)));
+	break;
+
 	case 100:
 		ldc_dump_register();
 	break;
@@ -327,11 +603,11 @@ static const struct file_operations ldc_test_proc_ops = {
 	.release = single_release,
 };
 #endif
-int32_t ldc_test_proc_init(void)
+int32_t ldc_test_proc_init(struct cvi_dwa_vdev *wdev)
 {
 	int ret = 0;
 
-	if (proc_create(PROC_NAME, 0644, NULL, &ldc_test_proc_ops) == NULL) {
+	if (proc_create_data(PROC_NAME, 0644, NULL, &ldc_test_proc_ops, wdev) == NULL) {
 		CVI_TRACE_DWA(CVI_DBG_ERR, "sclr_test: : proc_init() failed\n");
 		ret = -1;
 	}
@@ -349,7 +625,7 @@ int32_t ldc_test_proc_deinit(void)
 void ldc_dump_register(void)
 {
 }
-int32_t ldc_test_proc_init(void)
+int32_t ldc_test_proc_init(struct cvi_dwa_vdev *wdev)
 {
 	return 0;
 }
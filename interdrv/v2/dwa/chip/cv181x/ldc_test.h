@@ -4,7 +4,9 @@
 extern uint8_t ldc_test_enabled;
 
 void ldc_dump_register(void);
-int32_t ldc_test_proc_init(void);
+struct cvi_dwa_vdev;
+
+int32_t ldc_test_proc_init(struct cvi_dwa_vdev *wdev);
 int32_t ldc_test_proc_deinit(void);
 
 void ldc_test_irq_handler(uint32_t intr_raw_status);
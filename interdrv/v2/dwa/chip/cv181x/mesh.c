@@ -3,18 +3,25 @@
 #include <linux/vmalloc.h>
 #include <linux/clk.h>
 #include <linux/mm.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/jhash.h>
+#include <linux/jiffies.h>
+#include <linux/seq_file.h>
 #include <linux/sched/types.h>
 
 #include <linux/cvi_comm_video.h>
 #include <linux/cvi_comm_gdc.h>
 #include <linux/dwa_uapi.h>
 
+#include <sys.h>
 #include "dwa_debug.h"
 #include "dwa_platform.h"
 #include "cvi_vip_dwa.h"
 #include "gdc.h"
 #include "ldc.h"
 #include "mesh.h"
+#include "cvi_vip_gdc_proc.h"
 
 
 #define LDC_DBG (1 << 0)
@@ -33,6 +40,98 @@ typedef struct COORD2D_INT_HW {
 
 extern struct cvi_gdc_proc_ctx *gdc_proc_ctx;
 
+/* Skip the two-pass mesh when the ldc attr needs no correction */
+static bool dwa_ldc_single_pass = true;
+module_param(dwa_ldc_single_pass, bool, 0644);
+
+/* Memory cap (KB) of the mesh cache, 0 to disable it */
+static int dwa_mesh_cache_kb = 4096;
+module_param(dwa_mesh_cache_kb, int, 0644);
+
+/* How long (ms) a CVI_DWA_GET_MESH hit stays pinned without a task using it */
+static int dwa_mesh_pin_ms = 1000;
+module_param(dwa_mesh_pin_ms, int, 0644);
+
+/* mesh_cache_key: the op and geometry a user mesh was generated for.
+ *
+ * attr holds the union member of the op, LDC for CVI_DWA_OP_LDC; the
+ * rotation ops have none. Zero-filled before use so that hash and memcmp
+ * see no stale padding.
+ */
+struct mesh_cache_key {
+	u32 op;
+	u32 in_width;
+	u32 in_height;
+	u32 out_width;
+	u32 out_height;
+	u32 enPixelFormat;
+	u32 enRotation;
+	union {
+		FISHEYE_ATTR_S stFishEyeAttr;
+		AFFINE_ATTR_S stAffineAttr;
+		LDC_ATTR_S stLDCAttr;
+	} attr;
+};
+
+struct mesh_cache_entry {
+	struct list_head node;
+	struct mesh_cache_key key;
+	u32 hash;
+	u32 size;
+	u32 pins;	// lookups not yet taken by a task
+	u32 tasks;	// queued tasks using the mesh
+	u64 paddr;
+};
+
+/* mesh_cache_pin: a lookup hit, held until a task of the same fd takes the
+ * mesh, the fd is closed or dwa_mesh_pin_ms passes.
+ *
+ * An expired pin no longer holds the entry but stays as a stale one, so a
+ * task the fd adds later with the paddr is refused instead of running on a
+ * mesh eviction may have freed.
+ */
+struct mesh_cache_pin {
+	struct list_head node;
+	struct mesh_cache_entry *ent;	// NULL once stale
+	u64 paddr;
+	const void *owner;
+	unsigned long expire;
+};
+
+/* mesh_cache_claim: a lookup miss. The library is about to generate the
+ * mesh for this key, so the mesh of a task matching it may be cached.
+ */
+struct mesh_cache_claim {
+	struct list_head node;
+	struct mesh_cache_key key;
+	u32 hash;
+	const void *owner;
+};
+
+#define MESH_CACHE_CLAIM_MAX 16
+#define MESH_CACHE_STALE_MAX 64
+
+struct mesh_cache_stat {
+	u32 hit;
+	u32 miss;
+	u32 insert;
+	u32 evict;
+	u32 entries;
+	u32 bytes;
+	u32 pin_expire;
+	u32 stale_reject;
+};
+
+/* lru order, most recently used first */
+static struct list_head mesh_cache_lru = LIST_HEAD_INIT(mesh_cache_lru);
+static struct list_head mesh_cache_pins = LIST_HEAD_INIT(mesh_cache_pins);
+static struct list_head mesh_cache_stale = LIST_HEAD_INIT(mesh_cache_stale);
+static struct list_head mesh_cache_claims = LIST_HEAD_INIT(mesh_cache_claims);
+static u32 mesh_cache_claim_num;
+static u32 mesh_cache_stale_num;
+static DEFINE_MUTEX(mesh_cache_lock);
+static struct mesh_cache_stat mesh_cache_stat;
+
 void mesh_gen_get_1st_size(SIZE_S in_size, u32 *mesh_1st_size)
 {
 	u32 ori_src_width, ori_src_height, src_width_s1, src_height_s1;
@@ -59,6 +158,414 @@ void mesh_gen_get_1st_size(SIZE_S in_size, u32 *mesh_1st_size)
 			 4; // 4 = 4 knots in a mesh
 }
 
+// the op a user task's mesh is generated for, CVI_DWA_OP_NONE if not cacheable
+static u32 mesh_cache_task_op(const struct gdc_task_attr *attr, bool is_ldc)
+{
+	if (is_ldc)
+		return CVI_DWA_OP_LDC;
+
+	switch (attr->enRotation) {
+	case ROTATION_90:
+		return CVI_DWA_OP_ROT_90;
+	case ROTATION_270:
+		return CVI_DWA_OP_ROT_270;
+	case ROTATION_XY_FLIP:
+		return CVI_DWA_OP_XY_FLIP;
+	default:
+		return CVI_DWA_OP_NONE;
+	}
+}
+
+static void mesh_cache_make_key(const struct gdc_task_attr *attr, u32 op,
+				struct mesh_cache_key *key)
+{
+	memset(key, 0, sizeof(*key));
+	key->op = op;
+	key->in_width = attr->stImgIn.stVFrame.u32Width;
+	key->in_height = attr->stImgIn.stVFrame.u32Height;
+	key->out_width = attr->stImgOut.stVFrame.u32Width;
+	key->out_height = attr->stImgOut.stVFrame.u32Height;
+	key->enPixelFormat = attr->stImgIn.stVFrame.enPixelFormat;
+	key->enRotation = attr->enRotation;
+	if (op == CVI_DWA_OP_LDC)
+		key->attr.stLDCAttr = attr->stLDCAttr;
+}
+
+static u32 mesh_cache_entry_size(const struct mesh_cache_key *key)
+{
+	SIZE_S size;
+	u32 mesh_1st_size;
+
+	if (key->op != CVI_DWA_OP_LDC)
+		return CVI_GDC_MESH_SIZE_ROT;
+
+	// two passes, each one about the size of the output frame's mesh
+	size.u32Width = key->out_width;
+	size.u32Height = key->out_height;
+	mesh_gen_get_1st_size(size, &mesh_1st_size);
+
+	return mesh_1st_size * 2;
+}
+
+static struct mesh_cache_entry *mesh_cache_find(const struct mesh_cache_key *key, u32 hash)
+{
+	struct mesh_cache_entry *ent;
+
+	list_for_each_entry(ent, &mesh_cache_lru, node) {
+		if (ent->hash == hash && !memcmp(&ent->key, key, sizeof(*key)))
+			return ent;
+	}
+
+	return NULL;
+}
+
+static struct mesh_cache_entry *mesh_cache_find_paddr(u64 paddr)
+{
+	struct mesh_cache_entry *ent;
+
+	list_for_each_entry(ent, &mesh_cache_lru, node) {
+		if (ent->paddr == paddr)
+			return ent;
+	}
+
+	return NULL;
+}
+
+static void mesh_cache_free_pin(struct mesh_cache_pin *pin)
+{
+	list_del(&pin->node);
+	if (pin->ent)
+		pin->ent->pins--;
+	else
+		mesh_cache_stale_num--;
+	kfree(pin);
+}
+
+// the pin no longer holds its entry, only remembers the paddr it gave out
+static void mesh_cache_stale_pin(struct mesh_cache_pin *pin)
+{
+	pin->ent->pins--;
+	pin->ent = NULL;
+	list_move_tail(&pin->node, &mesh_cache_stale);
+	if (++mesh_cache_stale_num > MESH_CACHE_STALE_MAX)
+		mesh_cache_free_pin(list_first_entry(&mesh_cache_stale,
+						     struct mesh_cache_pin, node));
+}
+
+static void mesh_cache_free_claim(struct mesh_cache_claim *claim)
+{
+	list_del(&claim->node);
+	mesh_cache_claim_num--;
+	kfree(claim);
+}
+
+// unpin the lookups nobody used in time
+static void mesh_cache_expire_pins(void)
+{
+	struct mesh_cache_pin *pin, *tmp;
+
+	list_for_each_entry_safe(pin, tmp, &mesh_cache_pins, node) {
+		if (time_before(jiffies, pin->expire))
+			continue;
+		mesh_cache_stale_pin(pin);
+		mesh_cache_stat.pin_expire++;
+	}
+}
+
+static void mesh_cache_free_entry(struct mesh_cache_entry *ent)
+{
+	list_del(&ent->node);
+	mesh_cache_stat.entries--;
+	mesh_cache_stat.bytes -= ent->size;
+	sys_ion_free(ent->paddr);
+	kfree(ent);
+}
+
+/* mesh_cache_evict: drop idle entries from the lru tail until @need fits.
+ *
+ * Entries pinned by a lookup or used by queued tasks are skipped.
+ *
+ * @param need: bytes the caller is about to add
+ */
+static void mesh_cache_evict(u32 need)
+{
+	struct mesh_cache_entry *ent, *tmp;
+	u32 cap = (u32)dwa_mesh_cache_kb << 10;
+
+	list_for_each_entry_safe_reverse(ent, tmp, &mesh_cache_lru, node) {
+		if (mesh_cache_stat.bytes + need <= cap)
+			break;
+		if (ent->pins || ent->tasks)
+			continue;
+
+		CVI_TRACE_DWA(CVI_DBG_DEBUG, "mesh cache evict 0x%llx\n", ent->paddr);
+		mesh_cache_free_entry(ent);
+		mesh_cache_stat.evict++;
+	}
+}
+
+/* mesh_cache_get: look up the mesh generated for this op and task geometry.
+ *
+ * On a hit the entry is pinned for @owner until one of its tasks takes the
+ * mesh, see mesh_cache_task_get(). On a miss the key is claimed, so the
+ * mesh the library then generates may be cached when its task completes.
+ *
+ * @param owner: the fd asking
+ * @param attr: task attr carrying the in/out frames, rotation and ldc attr
+ * @param op: CVI_DWA_OP_* the mesh is generated for
+ * @return physical address of the cached mesh, 0 on miss
+ */
+u64 mesh_cache_get(const void *owner, const struct gdc_task_attr *attr, u32 op)
+{
+	struct mesh_cache_key key;
+	struct mesh_cache_entry *ent;
+	struct mesh_cache_pin *pin;
+	struct mesh_cache_claim *claim;
+	u64 paddr = 0;
+	u32 hash;
+
+	if (dwa_mesh_cache_kb <= 0)
+		return 0;
+
+	// the op has to be the one of the task, only those meshes are known
+	if (op == CVI_DWA_OP_NONE || op >= CVI_DWA_OP_MAX ||
+	    op != mesh_cache_task_op(attr, op == CVI_DWA_OP_LDC))
+		return 0;
+
+	mesh_cache_make_key(attr, op, &key);
+	hash = jhash(&key, sizeof(key), 0);
+
+	pin = kzalloc(sizeof(*pin), GFP_KERNEL);
+	claim = kzalloc(sizeof(*claim), GFP_KERNEL);
+	if (!pin || !claim) {
+		kfree(pin);
+		kfree(claim);
+		return 0;
+	}
+
+	mutex_lock(&mesh_cache_lock);
+	mesh_cache_expire_pins();
+	ent = mesh_cache_find(&key, hash);
+	if (ent) {
+		pin->ent = ent;
+		pin->paddr = ent->paddr;
+		pin->owner = owner;
+		pin->expire = jiffies + msecs_to_jiffies(max(dwa_mesh_pin_ms, 1));
+		list_add_tail(&pin->node, &mesh_cache_pins);
+		pin = NULL;
+		ent->pins++;
+		list_move(&ent->node, &mesh_cache_lru);
+		paddr = ent->paddr;
+		mesh_cache_stat.hit++;
+	} else {
+		if (mesh_cache_claim_num >= MESH_CACHE_CLAIM_MAX)
+			mesh_cache_free_claim(list_first_entry(&mesh_cache_claims,
+							       struct mesh_cache_claim, node));
+		claim->key = key;
+		claim->hash = hash;
+		claim->owner = owner;
+		list_add_tail(&claim->node, &mesh_cache_claims);
+		mesh_cache_claim_num++;
+		claim = NULL;
+		mesh_cache_stat.miss++;
+	}
+	mutex_unlock(&mesh_cache_lock);
+
+	kfree(pin);
+	kfree(claim);
+
+	return paddr;
+}
+
+static struct mesh_cache_pin *mesh_cache_find_pin(struct list_head *list,
+						  const void *owner, u64 paddr)
+{
+	struct mesh_cache_pin *pin;
+
+	list_for_each_entry(pin, list, node) {
+		if (pin->owner == owner && pin->paddr == paddr)
+			return pin;
+	}
+
+	return NULL;
+}
+
+/* mesh_cache_task_get: a task of @owner is about to be queued with @paddr
+ * as its mesh.
+ *
+ * A cached mesh is then held by the task instead of the lookup's pin. Undo
+ * with mesh_cache_task_cancel() if the task isn't queued after all.
+ *
+ * @return 0 if the task may use @paddr, -EINVAL if the cache gave it to
+ *         @owner and has freed it since the pin expired
+ */
+int mesh_cache_task_get(const void *owner, u64 paddr)
+{
+	struct mesh_cache_entry *ent;
+	struct mesh_cache_pin *pin;
+	int ret = 0;
+
+	mutex_lock(&mesh_cache_lock);
+	mesh_cache_expire_pins();
+	ent = mesh_cache_find_paddr(paddr);
+	pin = mesh_cache_find_pin(&mesh_cache_pins, owner, paddr);
+	if (!pin)
+		pin = mesh_cache_find_pin(&mesh_cache_stale, owner, paddr);
+	if (ent) {
+		ent->tasks++;
+	} else if (pin) {
+		mesh_cache_stat.stale_reject++;
+		ret = -EINVAL;
+	}
+	if (pin)
+		mesh_cache_free_pin(pin);
+	mutex_unlock(&mesh_cache_lock);
+
+	return ret;
+}
+
+/* mesh_cache_put: hand a user mesh back once its task is done.
+ *
+ * A mesh that came from the cache is released by the task. A new mesh is
+ * kept only if a lookup claimed its key, and if the cap allows, evicting
+ * idle entries as needed.
+ *
+ * @param attr: attr of the finished task
+ * @param is_ldc: ldc task if true, rotation task otherwise
+ * @param paddr: physical address of the task's mesh
+ * @return true if the cache owns the mesh, false if the caller must free it
+ */
+bool mesh_cache_put(const struct gdc_task_attr *attr, bool is_ldc, u64 paddr)
+{
+	struct mesh_cache_key key;
+	struct mesh_cache_entry *ent;
+	struct mesh_cache_claim *claim, *found = NULL;
+	u32 hash, size, cap, op;
+	bool owned = false;
+
+	mutex_lock(&mesh_cache_lock);
+	mesh_cache_expire_pins();
+	ent = mesh_cache_find_paddr(paddr);
+	if (ent) {
+		if (ent->tasks)
+			ent->tasks--;
+		owned = true;
+		goto out;
+	}
+
+	op = mesh_cache_task_op(attr, is_ldc);
+	if (op == CVI_DWA_OP_NONE)
+		goto out;
+	mesh_cache_make_key(attr, op, &key);
+	hash = jhash(&key, sizeof(key), 0);
+
+	list_for_each_entry(claim, &mesh_cache_claims, node) {
+		if (claim->hash == hash && !memcmp(&claim->key, &key, sizeof(key))) {
+			found = claim;
+			break;
+		}
+	}
+	if (!found)
+		goto out;
+	mesh_cache_free_claim(found);
+
+	cap = (dwa_mesh_cache_kb > 0) ? (u32)dwa_mesh_cache_kb << 10 : 0;
+	size = mesh_cache_entry_size(&key);
+	if (size > cap || mesh_cache_find(&key, hash))
+		goto out;
+
+	mesh_cache_evict(size);
+	if (mesh_cache_stat.bytes + size > cap)
+		goto out;
+
+	ent = kzalloc(sizeof(*ent), GFP_KERNEL);
+	if (!ent)
+		goto out;
+
+	ent->key = key;
+	ent->hash = hash;
+	ent->size = size;
+	ent->paddr = paddr;
+	list_add(&ent->node, &mesh_cache_lru);
+	mesh_cache_stat.entries++;
+	mesh_cache_stat.bytes += size;
+	mesh_cache_stat.insert++;
+	owned = true;
+out:
+	mutex_unlock(&mesh_cache_lock);
+
+	return owned;
+}
+
+/* mesh_cache_task_cancel: a task holding @paddr was dropped unrun.
+ *
+ * @return true if the mesh belongs to the cache
+ */
+bool mesh_cache_task_cancel(u64 paddr)
+{
+	struct mesh_cache_entry *ent;
+
+	mutex_lock(&mesh_cache_lock);
+	ent = mesh_cache_find_paddr(paddr);
+	if (ent && ent->tasks)
+		ent->tasks--;
+	mutex_unlock(&mesh_cache_lock);
+
+	return ent != NULL;
+}
+
+// the fd is closed, its pins and claims go with it
+void mesh_cache_release(const void *owner)
+{
+	struct mesh_cache_pin *pin, *ptmp;
+	struct mesh_cache_claim *claim, *ctmp;
+
+	mutex_lock(&mesh_cache_lock);
+	list_for_each_entry_safe(pin, ptmp, &mesh_cache_pins, node)
+		if (pin->owner == owner)
+			mesh_cache_free_pin(pin);
+	list_for_each_entry_safe(pin, ptmp, &mesh_cache_stale, node)
+		if (pin->owner == owner)
+			mesh_cache_free_pin(pin);
+	list_for_each_entry_safe(claim, ctmp, &mesh_cache_claims, node)
+		if (claim->owner == owner)
+			mesh_cache_free_claim(claim);
+	mutex_unlock(&mesh_cache_lock);
+}
+
+/* mesh_cache_flush: free every cached mesh.
+ *
+ * Pins of fds still open turn stale, so their tasks are refused rather than
+ * run on a freed mesh. On device removal no fd is left and none remain.
+ */
+void mesh_cache_flush(void)
+{
+	struct mesh_cache_entry *ent, *tmp;
+	struct mesh_cache_pin *pin, *ptmp;
+	struct mesh_cache_claim *claim, *ctmp;
+
+	mutex_lock(&mesh_cache_lock);
+	list_for_each_entry_safe(pin, ptmp, &mesh_cache_pins, node)
+		mesh_cache_stale_pin(pin);
+	list_for_each_entry_safe(claim, ctmp, &mesh_cache_claims, node)
+		mesh_cache_free_claim(claim);
+	list_for_each_entry_safe(ent, tmp, &mesh_cache_lru, node)
+		mesh_cache_free_entry(ent);
+	mutex_unlock(&mesh_cache_lock);
+}
+
+void gdc_proc_show_mesh_cache(struct seq_file *m)
+{
+	seq_printf(m, "%10s%10s%10s%10s%10s%12s%10s%20s%20s\n",
+		   "Hit", "Miss", "Insert", "Evict", "PinExpire", "StaleReject", "Entries", "Bytes(KB)", "Cap(KB)");
+	seq_printf(m, "%10u%10u%10u%10u%10u%12u%10u%20u%20d\n",
+		   mesh_cache_stat.hit, mesh_cache_stat.miss,
+		   mesh_cache_stat.insert, mesh_cache_stat.evict,
+		   mesh_cache_stat.pin_expire, mesh_cache_stat.stale_reject,
+		   mesh_cache_stat.entries, mesh_cache_stat.bytes >> 10,
+		   dwa_mesh_cache_kb);
+}
+
 static int init_ldc_param(const struct vb_s *vb_in, struct vb_s *vb_out,
 			  struct gdc_task_attr *stTask,
 			  PIXEL_FORMAT_E enPixFormat, u64 mesh_addr,
@@ -144,9 +651,7 @@ static int init_ldc_param(const struct vb_s *vb_in, struct vb_s *vb_out,
 	vb_out->buf.s16OffsetRight = stTask->stImgOut.stVFrame.s16OffsetRight;
 	vb_out->buf.u64PTS = stTask->stImgOut.stVFrame.u64PTS;
 	vb_out->buf.frm_num = vb_in->buf.frm_num;
-	vb_out->buf.motion_lv = vb_in->buf.motion_lv;
-	memcpy(vb_out->buf.motion_table, vb_in->buf.motion_table,
-	       MO_TBL_SIZE);
+	vb_copy_motion(vb_out, vb_in);
 
 	_pcbParam = vmalloc(cbParamSize);
 	if (!_pcbParam) {
@@ -185,16 +690,27 @@ static s32 mesh_gdc_do_rot(struct cvi_dwa_vdev *wdev, struct vb_s *vb_in,
 		size_out.u32Height = ALIGN(vb_in->buf.size.u32Width, DEFAULT_ALIGN);
 	}
 
-	pstTask = vmalloc(sizeof(*pstTask));
+	pstTask = kmalloc(sizeof(*pstTask), GFP_KERNEL);
 	if (!pstTask)
 		return CVI_ERR_GDC_NOBUF;
 
+	// start gdc job, a full queue turns the frame away before any work.
+	ret = gdc_begin_job(wdev, &data);
+	if (ret != CVI_SUCCESS)
+		goto ROT_FAIL_EXIT;
+	ret = gdc_client_admit(wdev, data.handle, enModId);
+	if (ret != CVI_SUCCESS) {
+		CVI_TRACE_DWA(CVI_DBG_WARN, "GDC mod(0x%x) queue full\n", enModId);
+		gdc_cancel_job(wdev, data.handle);
+		goto ROT_FAIL_EXIT;
+	}
+
 	// get buf for gdc output.
 	buf_size = vb_in->buf.length[0] + vb_in->buf.length[1] +
 		   vb_in->buf.length[2];
 	blk = vb_get_block_with_id(VB_INVALID_POOLID, buf_size, CVI_ID_GDC);
 	if (blk == VB_INVALID_HANDLE) {
-		vb_release_block((VB_BLK)vb_in);
+		gdc_cancel_job(wdev, data.handle);
 		ret = CVI_ERR_GDC_NOBUF;
 		goto ROT_FAIL_EXIT;
 	}
@@ -209,13 +725,16 @@ static s32 mesh_gdc_do_rot(struct cvi_dwa_vdev *wdev, struct vb_s *vb_in,
 	ret = init_ldc_param(vb_in, vb_out, pstTask, enPixFormat, mesh_addr,
 			     CVI_TRUE, pcbParam, cbParamSize, enRotation);
 	if (ret != CVI_SUCCESS)
-		goto ROT_FAIL_EXIT;
+		goto ROT_FAIL_JOB;
 
-	// start gdc job.
-	gdc_begin_job(wdev, &data);
 	pstTask->handle = data.handle;
 	pstTask->enRotation = enRotation;
-	gdc_add_rotation_task(wdev, pstTask);
+	ret = gdc_add_rotation_task(wdev, pstTask);
+	if (ret != CVI_SUCCESS) {
+		CVI_TRACE_DWA(CVI_DBG_ERR, "add rotation task failed, ret=%#x\n", ret);
+		vfree((void *)(uintptr_t)pstTask->au64privateData[2]);
+		goto ROT_FAIL_JOB;
+	}
 
 	job = (struct cvi_dwa_job *)(uintptr_t)data.handle;
 	job->sync_io = sync_io;
@@ -224,13 +743,38 @@ static s32 mesh_gdc_do_rot(struct cvi_dwa_vdev *wdev, struct vb_s *vb_in,
 	if (ret == CVI_SUCCESS && gdc_proc_ctx)
 		gdc_proc_ctx->stJobInfo[gdc_proc_ctx->u16JobInfoIdx].enModId =
 			enModId;
-
+	goto ROT_FAIL_EXIT;
+
+ROT_FAIL_JOB:
+	gdc_cancel_job(wdev, data.handle);
+	// vb_in goes back to the caller as it came
+	vb_in->mod_ids &= ~BIT(CVI_ID_GDC);
+	vb_in->mod_ids |= BIT(enModId);
+	vb_out->mod_ids &= ~BIT(CVI_ID_GDC);
+	vb_release_block(blk);
 ROT_FAIL_EXIT:
-	vfree(pstTask);
+	kfree(pstTask);
 
 	return ret;
 }
 
+/* mesh_ldc_is_identity: check if the ldc attr leaves the image unchanged.
+ *
+ * Without distortion and center offset the ldc mesh maps every pixel to
+ * itself, so only the rotation remains and one pass of the engine will do.
+ *
+ * @param pstLdcAttr: the LDC_ATTR_S the mesh was generated from
+ */
+static bool mesh_ldc_is_identity(const LDC_ATTR_S *pstLdcAttr)
+{
+	if (!pstLdcAttr)
+		return false;
+
+	return !pstLdcAttr->s32DistortionRatio &&
+	       !pstLdcAttr->s32CenterXOffset &&
+	       !pstLdcAttr->s32CenterYOffset;
+}
+
 static s32 mesh_gdc_do_ldc(struct cvi_dwa_vdev *wdev, const void *pUsageParam,
 			   struct vb_s *vb_in, PIXEL_FORMAT_E enPixFormat,
 			   u64 mesh_addr, bool sync_io,
@@ -242,6 +786,7 @@ static s32 mesh_gdc_do_ldc(struct cvi_dwa_vdev *wdev, const void *pUsageParam,
 	struct gdc_task_attr *pstTask[2] = {NULL, NULL};
 	VB_BLK blk;
 	struct vb_s *vb_out[2];
+	struct cvi_buffer buf_in;
 	u32 buf_size;
 	s32 ret;
 	// void *_pcbParam;
@@ -249,17 +794,44 @@ static s32 mesh_gdc_do_ldc(struct cvi_dwa_vdev *wdev, const void *pUsageParam,
 	ROTATION_E enRotationOut[2];
 	u32 mesh_1st_size;
 
-	pstTask[0] = vmalloc(sizeof(struct gdc_task_attr));
-	pstTask[1] = vmalloc(sizeof(struct gdc_task_attr));
-	if (!pstTask[0] || !pstTask[1])
+	/*
+	 * vi and vpss hand over the ldc attr together with the mesh generated
+	 * from it, so an identity attr means an identity mesh, which the
+	 * rotation engine can skip. It has no 180, that stays on two passes.
+	 */
+	if (dwa_ldc_single_pass && enRotation != ROTATION_180 &&
+	    mesh_ldc_is_identity(pUsageParam)) {
+		gdc_est_record_ldc(true);
+		return mesh_gdc_do_rot(wdev, vb_in, enPixFormat,
+				       DEFAULT_MESH_PADDR, sync_io, pcbParam,
+				       cbParamSize, enModId, enRotation);
+	}
+	gdc_est_record_ldc(false);
+
+	pstTask[0] = kmalloc(sizeof(struct gdc_task_attr), GFP_KERNEL);
+	pstTask[1] = kmalloc(sizeof(struct gdc_task_attr), GFP_KERNEL);
+	if (!pstTask[0] || !pstTask[1]) {
+		ret = CVI_ERR_GDC_NOBUF;
+		goto LDC_FAIL_EXIT;
+	}
+
+	// start gdc job, a full queue turns the frame away before any work.
+	ret = gdc_begin_job(wdev, &data);
+	if (ret != CVI_SUCCESS)
+		goto LDC_FAIL_EXIT;
+	ret = gdc_client_admit(wdev, data.handle, enModId);
+	if (ret != CVI_SUCCESS) {
+		CVI_TRACE_DWA(CVI_DBG_WARN, "GDC mod(0x%x) queue full\n", enModId);
+		gdc_cancel_job(wdev, data.handle);
 		goto LDC_FAIL_EXIT;
+	}
 
 	// get buf for gdc output.
 	buf_size = vb_in->buf.length[0] + vb_in->buf.length[1] +
 		   vb_in->buf.length[2];
 	blk = vb_get_block_with_id(VB_INVALID_POOLID, buf_size, CVI_ID_GDC);
 	if (blk == VB_INVALID_HANDLE) {
-		vb_release_block((VB_BLK)vb_in);
+		gdc_cancel_job(wdev, data.handle);
 		ret = CVI_ERR_GDC_NOBUF;
 		goto LDC_FAIL_EXIT;
 	}
@@ -313,16 +885,19 @@ static s32 mesh_gdc_do_ldc(struct cvi_dwa_vdev *wdev, const void *pUsageParam,
 			     enRotationOut[0]);
 	if (ret) {
 		CVI_TRACE_DWA(CVI_DBG_ERR, "init ldc param failed\n");
-		goto LDC_FAIL_EXIT;
+		goto LDC_FAIL_JOB;
 	}
 
-	// start gdc job.
-	gdc_begin_job(wdev, &data);
 	pstTask[0]->handle = data.handle;
 	pstTask[0]->enRotation = enRotationOut[0];
-	gdc_add_ldc_task(wdev, pstTask[0]);
+	ret = gdc_add_ldc_task(wdev, pstTask[0]);
+	if (ret != CVI_SUCCESS) {
+		vfree((void *)(uintptr_t)pstTask[0]->au64privateData[2]);
+		goto LDC_FAIL_JOB;
+	}
 
 	// Reuse vb_in after 1st job assigned
+	buf_in = vb_in->buf;
 	base_get_frame_info(enPixFormat, size_out[1], &vb_out[1]->buf, vb_out[1]->phy_addr, DEFAULT_ALIGN);
 
 	mesh_gen_get_1st_size(size_out[0], &mesh_1st_size);
@@ -331,13 +906,16 @@ static s32 mesh_gdc_do_ldc(struct cvi_dwa_vdev *wdev, const void *pUsageParam,
 			     cbParamSize, enRotationOut[1]);
 	if (ret) {
 		CVI_TRACE_DWA(CVI_DBG_ERR, "init 2nd ldc param failed\n");
-		vfree((void *)(uintptr_t)pstTask[0]->au64privateData[2]);
-		goto LDC_FAIL_EXIT;
+		goto LDC_FAIL_BUF;
 	}
 
 	pstTask[1]->handle = data.handle;
 	pstTask[1]->enRotation = enRotationOut[1];
-	gdc_add_ldc_task(wdev, pstTask[1]);
+	ret = gdc_add_ldc_task(wdev, pstTask[1]);
+	if (ret != CVI_SUCCESS) {
+		vfree((void *)(uintptr_t)pstTask[1]->au64privateData[2]);
+		goto LDC_FAIL_BUF;
+	}
 
 	job = (struct cvi_dwa_job *)(uintptr_t)data.handle;
 	job->sync_io = sync_io;
@@ -346,21 +924,37 @@ static s32 mesh_gdc_do_ldc(struct cvi_dwa_vdev *wdev, const void *pUsageParam,
 	if (ret == CVI_SUCCESS && gdc_proc_ctx)
 		gdc_proc_ctx->stJobInfo[gdc_proc_ctx->u16JobInfoIdx].enModId =
 			enModId;
-
+	goto LDC_FAIL_EXIT;
+
+LDC_FAIL_BUF:
+	vb_in->buf = buf_in;
+LDC_FAIL_JOB:
+	// the cancel frees the cb param of the tasks already added
+	gdc_cancel_job(wdev, data.handle);
+	vb_in->mod_ids &= ~BIT(CVI_ID_GDC);
+	vb_in->mod_ids |= BIT(enModId);
+	vb_out[0]->mod_ids &= ~BIT(CVI_ID_GDC);
+	vb_release_block(blk);
 LDC_FAIL_EXIT:
-	vfree(pstTask[0]);
-	vfree(pstTask[1]);
+	kfree(pstTask[0]);
+	kfree(pstTask[1]);
 
 	return ret;
 }
 
+/* mesh_gdc_do_op: queue an ldc or rotation job of an internal module.
+ *
+ * On success gdc owns vb_in and hands the output to the module's callback.
+ * On any error vb_in is given back to the caller as it came, to pass on or
+ * release.
+ */
 s32 mesh_gdc_do_op(struct cvi_dwa_vdev *wdev, enum GDC_USAGE usage,
 		   const void *pUsageParam, struct vb_s *vb_in,
 		   PIXEL_FORMAT_E enPixFormat, u64 mesh_addr, CVI_BOOL sync_io,
 		   void *pcbParam, u32 cbParamSize, MOD_ID_E enModId,
 		   ROTATION_E enRotation)
 {
-	s32 ret = CVI_ERR_GDC_ILLEGAL_PARAM;
+	s32 ret;
 
 	CVI_TRACE_DWA(CVI_DBG_DEBUG, "GDC usage(%d) enRotation(%d), mesh-addr(0x%llx), cbParamSize(%d)\n",
 			usage, enRotation, (unsigned long long)mesh_addr, cbParamSize);
@@ -388,6 +982,7 @@ s32 mesh_gdc_do_op(struct cvi_dwa_vdev *wdev, enum GDC_USAGE usage,
 				      enModId, enRotation);
 		break;
 	default:
+		ret = CVI_ERR_GDC_ILLEGAL_PARAM;
 		break;
 	}
 
@@ -1,6 +1,7 @@
 #ifndef _LDC_COMMON_MESH_H
 #define _LDC_COMMON_MESH_H
 
+#include <linux/dwa_uapi.h>
 #include <dwa_cb.h>
 
 #define CVI_GDC_MAGIC 0xbabeface
@@ -9,6 +10,15 @@
 #define CVI_GDC_MESH_SIZE_AFFINE 0x20000
 #define CVI_GDC_MESH_SIZE_FISHEYE 0xB0000
 
+void mesh_gen_get_1st_size(SIZE_S in_size, u32 *mesh_1st_size);
+
+u64 mesh_cache_get(const void *owner, const struct gdc_task_attr *attr, u32 op);
+int mesh_cache_task_get(const void *owner, u64 paddr);
+bool mesh_cache_put(const struct gdc_task_attr *attr, bool is_ldc, u64 paddr);
+bool mesh_cache_task_cancel(u64 paddr);
+void mesh_cache_release(const void *owner);
+void mesh_cache_flush(void);
+
 s32 mesh_gdc_do_op(struct cvi_dwa_vdev *wdev, enum GDC_USAGE usage,
 		   const void *pUsageParam, struct vb_s *vb_in,
 		   PIXEL_FORMAT_E enPixFormat, u64 mesh_addr, CVI_BOOL sync_io,
@@ -131,6 +131,18 @@ static int gdc_proc_show(struct seq_file *m, void *v)
 				total_hwTime / GDC_PROC_JOB_INFO_NUM,
 				total_busyTime / GDC_PROC_JOB_INFO_NUM);
 
+	// GDC DDR traffic and latency estimate
+	seq_puts(m, "\n-------------------------------GDC DDR ESTIMATE---------------------------\n");
+	gdc_proc_show_est(m);
+
+	// GDC mesh cache status
+	seq_puts(m, "\n-------------------------------GDC MESH CACHE STATUS----------------------\n");
+	gdc_proc_show_mesh_cache(m);
+
+	// GDC per-client queue status
+	seq_puts(m, "\n-------------------------------GDC CLIENT STATUS--------------------------\n");
+	gdc_proc_show_client(m);
+
 	// GDC call correction status
 	seq_puts(m, "\n-------------------------------GDC CALL CORRECTION STATUS-----------------\n");
 	seq_printf(m, "%10s%10s%10s%10s%10s\n", "TaskSuc", "TaskFail", "EndSuc", "EndFail", "CbCnt");
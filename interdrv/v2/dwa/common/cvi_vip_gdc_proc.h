@@ -10,5 +10,8 @@
 
 int gdc_proc_init(void *shm);
 int gdc_proc_remove(void);
+void gdc_proc_show_est(struct seq_file *m);
+void gdc_proc_show_mesh_cache(struct seq_file *m);
+void gdc_proc_show_client(struct seq_file *m);
 
 #endif // _CVI_VIP_GDC_PROC_H_
@@ -145,7 +145,18 @@ static long dwa_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 
 		CVI_TRACE_DWA(CVI_DBG_DEBUG, "CVIDWA_ADD_ROT_TASK, handle=0x%llx\n",
 			      (unsigned long long)attr->handle);
+		// a cached mesh is held before the task can run on it
+		if (attr->au64privateData[0]) {
+			ret = mesh_cache_task_get(filp, attr->au64privateData[0]);
+			if (ret) {
+				CVI_TRACE_DWA(CVI_DBG_ERR, "mesh 0x%llx no longer cached\n",
+					      (unsigned long long)attr->au64privateData[0]);
+				break;
+			}
+		}
 		ret = gdc_add_rotation_task(wdev, attr);
+		if (ret != CVI_SUCCESS && attr->au64privateData[0])
+			mesh_cache_task_cancel(attr->au64privateData[0]);
 		break;
 	}
 
@@ -155,7 +166,28 @@ static long dwa_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 
 		CVI_TRACE_DWA(CVI_DBG_DEBUG, "CVIDWA_ADD_LDC_TASK, handle=0x%llx\n",
 			      (unsigned long long)attr->handle);
+		// a cached mesh is held before the task can run on it
+		if (attr->au64privateData[0]) {
+			ret = mesh_cache_task_get(filp, attr->au64privateData[0]);
+			if (ret) {
+				CVI_TRACE_DWA(CVI_DBG_ERR, "mesh 0x%llx no longer cached\n",
+					      (unsigned long long)attr->au64privateData[0]);
+				break;
+			}
+		}
 		ret = gdc_add_ldc_task(wdev, attr);
+		if (ret != CVI_SUCCESS && attr->au64privateData[0])
+			mesh_cache_task_cancel(attr->au64privateData[0]);
+		break;
+	}
+
+	case CVI_DWA_GET_MESH:
+	{
+		struct dwa_mesh_cache_cfg *cfg = (struct dwa_mesh_cache_cfg *)kdata;
+
+		cfg->mesh_addr = mesh_cache_get(filp, &cfg->stTask, cfg->op);
+		CVI_TRACE_DWA(CVI_DBG_DEBUG, "CVI_DWA_GET_MESH, mesh_addr=0x%llx\n",
+			      (unsigned long long)cfg->mesh_addr);
 		break;
 	}
 
@@ -198,6 +230,7 @@ err:
 
 static int dwa_release(struct inode *inode, struct file *filp)
 {
+	mesh_cache_release(filp);
 	return 0;
 }
 
@@ -300,6 +333,7 @@ int dwa_destroy_instance(struct platform_device *pdev)
 	misc_deregister(&wdev->miscdev);
 
 	gdc_proc_remove();
+	mesh_cache_flush();
 	kfree(wdev->shared_mem);
 
 	return 0;
@@ -476,7 +510,7 @@ static int cvi_dwa_probe(struct platform_device *pdev)
 	}
 
 	/* ldc self test */
-	ldc_test_proc_init();
+	ldc_test_proc_init(wdev);
 
 	/* dwa register cb */
 	if (dwa_register_cb(wdev)) {
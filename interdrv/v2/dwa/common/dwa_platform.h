@@ -30,6 +30,7 @@ struct cvi_dwa_vdev {
 	spinlock_t lock;
 	struct list_head jobq;
 	wait_queue_head_t cond_queue;
+	wait_queue_head_t client_wq;
 	bool job_done;
 };
 
@@ -91,11 +91,35 @@ struct dwa_buf_wrap_cfg {
 	struct _DWA_BUF_WRAP_S stBufWrap;
 };
 
+/*
+ * stTask: in/out frames, enRotation and stLDCAttr the mesh is generated for
+ * op: CVI_DWA_OP_* the mesh is generated for, a rotation op must match
+ *     stTask.enRotation
+ * mesh_addr: cached mesh to put in au64privateData[0], 0 if not cached.
+ *     A miss lets the cache keep the mesh generated next for the same key.
+ *     A hit stays pinned until a task of this fd uses it, the fd is closed
+ *     or dwa_mesh_pin_ms passes.
+ *
+ * The cache only helps a library that asks before it generates a mesh:
+ *   1. CVI_DWA_GET_MESH with the task attr and op
+ *   2. on a miss, generate and allocate the mesh as before
+ *   3. CVI_DWA_ADD_ROT_TASK/ADD_LDC_TASK with the mesh in au64privateData[0]
+ * and never frees a mesh it got from a hit. A hit whose pin expired may be
+ * freed by the cache, a task adding it then fails with -EINVAL and the
+ * library starts over from 1.
+ */
+struct dwa_mesh_cache_cfg {
+	struct gdc_task_attr stTask;
+	__u32 op;
+	__u64 mesh_addr;
+};
+
 #define CVI_DWA_BEGIN_JOB _IOWR('D', 0x00, struct gdc_handle_data)
 #define CVI_DWA_END_JOB _IOW('D', 0x01, struct gdc_handle_data)
 #define CVI_DWA_CANCEL_JOB _IOW('D', 0x02, unsigned long long)
 #define CVI_DWA_ADD_ROT_TASK _IOW('D', 0x03, struct gdc_task_attr)
 #define CVI_DWA_ADD_LDC_TASK _IOW('D', 0x04, struct gdc_task_attr)
+#define CVI_DWA_GET_MESH _IOWR('D', 0x05, struct dwa_mesh_cache_cfg)
 
 #define CVI_DWA_SET_BUF_WRAP _IOW('D', 0x10, struct dwa_buf_wrap_cfg)
 #define CVI_DWA_GET_BUF_WRAP _IOWR('D', 0x11, struct dwa_buf_wrap_cfg)
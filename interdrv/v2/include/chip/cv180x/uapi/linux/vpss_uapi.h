@@ -196,6 +196,27 @@ struct vpss_scene {
 	CVI_U8 scene;
 };
 
+/* grps of a lower class are always served first */
+enum vpss_sched_class {
+	VPSS_SCHED_CLASS_RT = 0,
+	VPSS_SCHED_CLASS_NORMAL,
+	VPSS_SCHED_CLASS_BATCH,
+	VPSS_SCHED_CLASS_MAX,
+};
+
+/*
+ * VpssGrp: grp to configure.
+ * sched_class: enum vpss_sched_class.
+ * target_latency_us: queueing delay the grp tolerates, 0 to derive it from weight.
+ * weight: share among grps of the same class which have no target_latency_us.
+ */
+struct vpss_grp_sched_cfg {
+	VPSS_GRP VpssGrp;
+	__u8 sched_class;
+	__u32 target_latency_us;
+	__u32 weight;
+};
+
 /* Public */
 #define CVI_VPSS_CREATE_GROUP _IOW('S', 0x00, struct vpss_crt_grp_cfg)
 #define CVI_VPSS_DESTROY_GROUP _IOW('S', 0x01, VPSS_GRP)
@@ -237,6 +258,8 @@ struct vpss_scene {
 #define CVI_VPSS_ATTACH_VB_POOL _IOW('S', 0x37, struct vpss_vb_pool_cfg)
 #define CVI_VPSS_DETACH_VB_POOL _IOW('S', 0x38, struct vpss_vb_pool_cfg)
 #define CVI_VPSS_TRIGGER_SNAP_FRAME _IOW('S', 0x39, struct vpss_snap_cfg)
+#define CVI_VPSS_SET_GRP_SCHED _IOW('S', 0x3a, struct vpss_grp_sched_cfg)
+#define CVI_VPSS_GET_GRP_SCHED _IOWR('S', 0x3b, struct vpss_grp_sched_cfg)
 
 /* Internal use */
 #define CVI_VPSS_SET_MODE _IOW('S', 0x75, __u32)
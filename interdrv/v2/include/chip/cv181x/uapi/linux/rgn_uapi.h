@@ -37,6 +37,9 @@ enum RGN_SDK_CTRL {
 	RGN_SDK_UPDATE_CANVAS,
 	RGN_SDK_INVERT_COLOR,
 	RGN_SDK_SET_CHN_PALETTE,
+	RGN_SDK_BATCH_BEGIN,
+	RGN_SDK_BATCH_COMMIT,
+	RGN_SDK_UNIT_TEST,
 	RGN_SDK_MAX,
 };
 
@@ -48,6 +51,19 @@ struct rgn_ext_control {
 	void *ptr2;
 } __attribute__ ((packed));
 
+/*
+ * Passed in ptr1 of RGN_SDK_UNIT_TEST, handle selects the case.
+ *
+ * @grp: first vpss grp to attach to, its chns must be enabled.
+ * @rgn_num: covers to update per frame, spread over the chns and then the next grps.
+ * @frm_num: frames to run.
+ */
+struct rgn_unit_test_cfg {
+	__u32 grp;
+	__u32 rgn_num;
+	__u32 frm_num;
+};
+
 struct rgn_plane {
 	__u64 addr;
 };
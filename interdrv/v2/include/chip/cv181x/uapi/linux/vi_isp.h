@@ -242,6 +242,40 @@ struct cvi_vip_isp_smooth_raw_param {
 	__u8 frm_num;
 };
 
+#define VI_RAW_RING_MAX		16
+/* mmap offset on the vi node of the ring of raw_num */
+#define VI_RAW_RING_MMAP_OFFSET(raw_num)	(0x100000 + (raw_num) * 0x1000)
+
+struct cvi_vip_isp_raw_ring_hdr {
+	__u64 phy_addr;
+	__u64 timestamp;	// ktime_get_ns() at pre_fe frame done
+	__u32 frm_num;
+	__u32 size;
+	__u16 width;
+	__u16 height;
+	__u8  raw_num;
+	__u8  rsv[3];
+};
+
+/*
+ * Continuous raw dump ring, one page per pipe.
+ *
+ * Started by VI_SDK_START_RAW_RING with the same cvi_vip_isp_smooth_raw_param
+ * as smooth raw dump and stopped by VI_SDK_STOP_SMOOTH_RAWDUMP. The kernel
+ * fills hdr[head % slot_num] and then advances head. The recorder advances
+ * tail once it is done with hdr[tail % slot_num]. If no buffer is left for
+ * the next frame, the finished one is reused and overrun is increased.
+ * The kernel only reads tail back, head, slot_num and overrun are copies of
+ * its own state.
+ */
+struct cvi_vip_isp_raw_ring {
+	__u32 head;
+	__u32 tail;
+	__u32 slot_num;
+	__u32 overrun;
+	struct cvi_vip_isp_raw_ring_hdr hdr[VI_RAW_RING_MAX];
+};
+
 struct cvi_isp_sts_mem {
 	__u8			raw_num;
 	struct cvi_vip_memblock af;
@@ -111,6 +111,7 @@ enum VI_SDK_CTRL {
 	VI_SDK_DETACH_VB_POOL,
 	VI_SDK_GET_PIPE_DUMP_ATTR,
 	VI_SDK_SET_PIPE_DUMP_ATTR,
+	VI_SDK_START_RAW_RING,
 };
 
 /*
@@ -3,6 +3,7 @@
 
 #include <linux/cvi_base_ctx.h>
 #include <linux/vb_uapi.h>
+#include <linux/rbtree.h>
 
 #include <queue.h>
 
@@ -133,6 +134,14 @@ struct cvi_buffer {
  * buf: the usage which define planes of buffer.
  * magic: magic number to avoid wrong reference.
  * mod_ids: the users of this blk. BIT(MOD_ID) will be set is MOD using.
+ * rsvd_node: unused, was the vb_hash node.
+ * size: size of the blk in bytes, 0 if unknown.
+ * node: node in the phy-addr index of all blks.
+ * motion_valid: buf.motion_table has been filled by producer. If not,
+ *               motion_table is all zero and needn't be copied/cleared.
+ *
+ * soph_vc_driver.ko is shipped prebuilt against this struct: fields up to
+ * rsvd_node must keep their layout, new ones are appended.
  */
 struct vb_s {
 	VB_POOL vb_pool;
@@ -143,7 +152,10 @@ struct vb_s {
 	uint32_t magic;
 	uint64_t mod_ids;
 	CVI_BOOL external;
-	struct hlist_node node;
+	struct hlist_node rsvd_node;
+	uint32_t size;
+	struct rb_node node;
+	CVI_BOOL motion_valid;
 };
 
 FIFO_HEAD(vbq, vb_s*);
@@ -171,11 +183,19 @@ struct vb_req {
 
 STAILQ_HEAD(vb_req_q, vb_req);
 
+/*
+ * blkArray: vb_s of all blks of the pool, allocated in one shot.
+ * lock: lock for pool lifetime and blk dump.
+ * freeList_lock: lock for freeList and free-blk accounting. Held only for
+ *                the push/pop on the blk acquire/release path.
+ * reqQ_lock: lock for reqQ.
+ */
 struct vb_pool {
 	VB_POOL poolID;
 	int16_t ownerID;
 	uint64_t memBase;
 	void *vmemBase;
+	struct vb_s *blkArray;
 	struct vbq freeList;
 	struct vb_req_q reqQ;
 	uint32_t blk_size;
@@ -187,6 +207,7 @@ struct vb_pool {
 	uint32_t u32MinFreeBlkCnt;
 	char acPoolName[VB_POOL_NAME_LEN];
 	struct mutex lock;
+	spinlock_t freeList_lock;
 	struct mutex reqQ_lock;
 };
 
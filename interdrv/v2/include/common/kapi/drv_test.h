@@ -0,0 +1,102 @@
+#ifndef __DRV_TEST_H__
+#define __DRV_TEST_H__
+
+#ifdef DRV_TEST
+
+#include <linux/types.h>
+#include <linux/atomic.h>
+#include <linux/string.h>
+#include <linux/fs.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
+#include <linux/uaccess.h>
+#include <linux/version.h>
+
+#define DRV_TEST_LOG_MAX 64
+
+/*
+ * Run log of a mock engine: each job run logs one tag char, so a test can
+ * check the run order. tag[] stays nul-terminated.
+ */
+struct drv_test_log {
+	char tag[DRV_TEST_LOG_MAX + 1];
+	atomic_t num;
+};
+
+static inline void drv_test_log_reset(struct drv_test_log *log)
+{
+	memset(log->tag, 0, sizeof(log->tag));
+	atomic_set(&log->num, 0);
+}
+
+static inline void drv_test_log_add(struct drv_test_log *log, char tag)
+{
+	int i = atomic_inc_return(&log->num) - 1;
+
+	if (i < DRV_TEST_LOG_MAX)
+		log->tag[i] = tag;
+}
+
+static inline int drv_test_log_num(struct drv_test_log *log)
+{
+	return atomic_read(&log->num);
+}
+
+/*
+ * DRV_TEST_PROC_DEFINE(prefix): proc ops of a module's test entry.
+ *
+ * Reading the entry prints prefix##_usage(m). Writing an op number calls
+ * prefix##_run(data, op), data as given to proc_create_data.
+ * Defines prefix##_proc_ops.
+ */
+#define __DRV_TEST_PROC_FUNCS(prefix)							\
+static int prefix##_proc_show(struct seq_file *m, void *v)				\
+{											\
+	prefix##_usage(m);								\
+	return 0;									\
+}											\
+											\
+static int prefix##_proc_open(struct inode *inode, struct file *file)			\
+{											\
+	return single_open(file, prefix##_proc_show, PDE_DATA(inode));			\
+}											\
+											\
+static ssize_t prefix##_proc_write(struct file *file, const char __user *user_buf,	\
+				   size_t count, loff_t *ppos)				\
+{											\
+	uint32_t input_param = 0;							\
+											\
+	if (kstrtouint_from_user(user_buf, count, 0, &input_param)) {			\
+		pr_err("input parameter incorrect\n");					\
+		return count;								\
+	}										\
+											\
+	pr_err("input_param=%d\n", input_param);					\
+	prefix##_run(PDE_DATA(file_inode(file)), input_param);				\
+	return count;									\
+}
+
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(5, 10, 0))
+#define DRV_TEST_PROC_DEFINE(prefix)							\
+__DRV_TEST_PROC_FUNCS(prefix)								\
+static const struct proc_ops prefix##_proc_ops = {					\
+	.proc_open = prefix##_proc_open,						\
+	.proc_read = seq_read,								\
+	.proc_write = prefix##_proc_write,						\
+	.proc_release = single_release,							\
+}
+#else
+#define DRV_TEST_PROC_DEFINE(prefix)							\
+__DRV_TEST_PROC_FUNCS(prefix)								\
+static const struct file_operations prefix##_proc_ops = {				\
+	.owner = THIS_MODULE,								\
+	.open = prefix##_proc_open,							\
+	.read = seq_read,								\
+	.write = prefix##_proc_write,							\
+	.release = single_release,							\
+}
+#endif
+
+#endif /* DRV_TEST */
+
+#endif /* __DRV_TEST_H__ */
@@ -26,12 +26,16 @@ extern "C" {
 
 int32_t vb_get_pool_info(struct vb_pool **pool_info);
 void vb_cleanup(void);
+int32_t vb_blk_cache_init(void);
+void vb_blk_cache_exit(void);
 int32_t vb_get_config(struct cvi_vb_cfg *pstVbConfig);
 
 int32_t vb_create_pool(struct cvi_vb_pool_cfg *config);
+int32_t vb_create_ex_pool(struct cvi_vb_pool_ex_cfg *config);
 int32_t vb_destroy_pool(uint32_t poolId);
 
 VB_BLK vb_physAddr2Handle(uint64_t u64PhyAddr);
+VB_BLK vb_physAddrWithin2Handle(uint64_t u64PhyAddr);
 uint64_t vb_handle2PhysAddr(VB_BLK blk);
 void *vb_handle2VirtAddr(VB_BLK blk);
 VB_POOL vb_handle2PoolId(VB_BLK blk);
@@ -45,6 +49,8 @@ int32_t vb_release_block(VB_BLK blk);
 void vb_acquire_block(vb_acquire_fp fp, MMF_CHN_S chn,
 	uint32_t u32BlkSize, VB_POOL VbPool);
 void vb_cancel_block(MMF_CHN_S chn, uint32_t u32BlkSize, VB_POOL VbPool);
+void vb_set_motion(struct vb_s *vb, uint8_t motion_lv, const uint8_t *motion_table);
+void vb_copy_motion(struct vb_s *dst, const struct vb_s *src);
 long vb_ctrl(struct vb_ext_control *p);
 int32_t vb_done_handler(MMF_CHN_S chn, enum CHN_TYPE_E chn_type, VB_BLK blk);
 int32_t vb_dqbuf(MMF_CHN_S chn, enum CHN_TYPE_E chn_type, VB_BLK *blk);
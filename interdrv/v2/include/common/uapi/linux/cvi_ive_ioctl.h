@@ -349,6 +349,32 @@ struct cvi_ive_ioctl_md {
 	CVI_BOOL bInstant;
 };
 
+/*
+ * Asynchronous job queue. A job is one of the CVI_IVE_IOC_* operator ioctls
+ * whose argument doesn't reference user memory by virtual address; it runs
+ * on the engine in submit order per fd, with fds served round robin.
+ *
+ * @cmd: the operator ioctl, e.g. CVI_IVE_IOC_Filter.
+ * @handle: [out] job handle, unique per fd and never 0.
+ * @arg: user pointer to the operator's argument, as passed to @cmd.
+ */
+struct cvi_ive_submit_arg {
+	__u32 cmd;
+	__u32 handle;
+	__u64 arg;
+};
+
+/*
+ * @handle: [in/out] job to wait for, 0 for any completed job of this fd.
+ * @timeout_ms: < 0 to wait forever, 0 to only check.
+ * @result: [out] return value of the operator, -ECANCELED if cancelled.
+ */
+struct cvi_ive_wait_arg {
+	__u32 handle;
+	__s32 timeout_ms;
+	__s32 result;
+};
+
 #define CVI_IVE_IOC_MAGIC 'v'
 #define CVI_IVE_IOC_TEST _IOW(CVI_IVE_IOC_MAGIC, 0x00, unsigned long long)
 #define CVI_IVE_IOC_DMA _IOW(CVI_IVE_IOC_MAGIC, 0x01, unsigned long long)
@@ -399,4 +425,7 @@ struct cvi_ive_ioctl_md {
 #define CVI_IVE_IOC_RESET _IOW(CVI_IVE_IOC_MAGIC, 0xF0, unsigned long long)
 #define CVI_IVE_IOC_DUMP _IO(CVI_IVE_IOC_MAGIC, 0xF1)
 #define CVI_IVE_IOC_QUERY _IOWR(CVI_IVE_IOC_MAGIC, 0xF2, unsigned long long)
+#define CVI_IVE_IOC_SUBMIT _IOWR(CVI_IVE_IOC_MAGIC, 0xF3, struct cvi_ive_submit_arg)
+#define CVI_IVE_IOC_WAIT _IOWR(CVI_IVE_IOC_MAGIC, 0xF4, struct cvi_ive_wait_arg)
+#define CVI_IVE_IOC_CANCEL _IOW(CVI_IVE_IOC_MAGIC, 0xF5, __u32)
 #endif /* __CVI_IVE_IOCTL_H__ */
@@ -74,6 +74,73 @@ struct cvi_tdma_wait_arg {
 	int ret;
 };
 
+/* priority of the jobs submitted through an fd, CVITPU_SET_PRIORITY */
+enum cvi_tpu_priority {
+	CVITPU_PRIO_HIGH = 0,
+	CVITPU_PRIO_NORMAL,
+	CVITPU_PRIO_LOW,
+	CVITPU_PRIO_MAX,
+};
+
+#define CVITPU_PMU_LAYER_MAX 32
+#define CVITPU_PMU_NAME_LEN 32
+
+/*
+ * PMU summary of one cpu sync descriptor of a dmabuf. Named after the
+ * descriptor string when the toolchain put a layer name there.
+ * cycles are TPU clock cycles, taken from the PMU record timestamps.
+ */
+struct cvi_tpu_pmu_layer {
+	char name[CVITPU_PMU_NAME_LEN];
+	unsigned int tiu_desc_cnt;
+	unsigned int tdma_desc_cnt;
+	unsigned int tiu_rec_cnt;
+	unsigned int tdma_rec_cnt;
+	unsigned long long tdma_bytes;
+	unsigned long long tdma_cycles;
+	unsigned long long tiu_cycles;
+	unsigned long long stall_cycles;
+	unsigned int start_cycle;
+	unsigned int end_cycle;
+	unsigned int max_desc_cycles;	// slowest descriptor of the layer
+	unsigned short max_desc_id;
+	unsigned short max_desc_type;
+	unsigned long long wall_ns;	// measured by the driver
+};
+
+/*
+ * PMU report of one dmabuf run. Layers past CVITPU_PMU_LAYER_MAX are
+ * folded into the last entry, layer_cnt keeps the real count.
+ */
+struct cvi_tpu_pmu_report {
+	unsigned int seq;		// report sequence, see CVITPU_GET_PMU_REPORT
+	unsigned int seq_no;		// seq_no of the submit
+	int pid;
+	unsigned int event;		// PMU event armed for this run
+	unsigned int rec_cnt;		// records decoded
+	unsigned int rec_bad;		// records not matching any layer
+	unsigned int layer_cnt;
+	unsigned int tpu_clk_rate;
+	unsigned long long tdma_bytes;
+	unsigned long long tdma_cycles;
+	unsigned long long tiu_cycles;
+	unsigned long long stall_cycles;
+	unsigned long long wall_ns;
+	struct cvi_tpu_pmu_layer layer[CVITPU_PMU_LAYER_MAX];
+};
+
+/*
+ * read reports from seq on into the reports array of count entries.
+ * count returns the number read, seq the one to ask next time and lost
+ * the number of reports overwritten before being read.
+ */
+struct cvi_tpu_pmu_read_arg {
+	unsigned long long reports;
+	unsigned int count;
+	unsigned int seq;
+	unsigned int lost;
+};
+
 #define IOCTL_TPU_BASE 'p'
 #define CVITPU_SUBMIT_DMABUF _IOW(IOCTL_TPU_BASE, 0x01, unsigned long long)
 #define CVITPU_DMABUF_FLUSH_FD _IOW(IOCTL_TPU_BASE, 0x02, unsigned long long)
@@ -88,5 +155,7 @@ struct cvi_tdma_wait_arg {
 #define CVITPU_UNLOAD_TEE _IOW(IOCTL_TPU_BASE, 0x0A, unsigned long long)
 #define CVITPU_SUBMIT_PIO _IOW(IOCTL_TPU_BASE, 0x0B, unsigned long long)
 #define CVITPU_WAIT_PIO _IOWR(IOCTL_TPU_BASE, 0x0C, unsigned long long)
+#define CVITPU_SET_PRIORITY _IOW(IOCTL_TPU_BASE, 0x0D, unsigned long long)
+#define CVITPU_GET_PMU_REPORT _IOWR(IOCTL_TPU_BASE, 0x0E, unsigned long long)
 
 #endif /* __CVI_TPU_IOCTL_H__ */
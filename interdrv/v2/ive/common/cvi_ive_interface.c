@@ -22,8 +22,10 @@
 #if (KERNEL_VERSION(5, 10, 0) <= LINUX_VERSION_CODE)
 #include <linux/sched/signal.h>
 #endif
+#include <linux/poll.h>
 #include <linux/proc_fs.h>
 #include <linux/seq_file.h>
+#include <linux/slab.h>
 
 #include "cvi_ive_interface.h"
 #include "cvi_ive_platform.h"
@@ -58,7 +60,6 @@ uint32_t get_duration_us(const struct timespec *start,
 	return event_duration_us;
 }
 
-static char *g_kdata;
 struct class *class_id;
 static dev_t cdev_id;
 static uint32_t g_enable_usage_profiling;
@@ -73,6 +74,7 @@ static int cvi_ive_open(struct inode *inode, struct file *filp);
 static int cvi_ive_close(struct inode *inode, struct file *filp);
 static long cvi_ive_ioctl(struct file *filp, unsigned int cmd,
 			  unsigned long arg);
+static unsigned int cvi_ive_poll(struct file *filp, struct poll_table_struct *wait);
 #ifdef CONFIG_COMPAT
 static long cvi_ive_compat_ioctl(struct file *filp, unsigned int cmd,
 				 unsigned long arg);
@@ -99,6 +101,7 @@ static const struct file_operations ive_fops = {
 	.open = cvi_ive_open,
 	.release = cvi_ive_close,
 	.unlocked_ioctl = cvi_ive_ioctl, //2.6.36
+	.poll = cvi_ive_poll,
 #ifdef CONFIG_COMPAT
 	.compat_ioctl = cvi_ive_compat_ioctl, //2.6.36
 #endif
@@ -115,6 +118,8 @@ static void start_ioctl_time(struct ive_profiling_info *pinfo, char *name)
 			pinfo->time_vld_diff_us[i] = 0;
 		}
 		pinfo->time_tile_diff_us = 0;
+		pinfo->time_spin_us = 0;
+		pinfo->time_sleep_us = 0;
 #if (KERNEL_VERSION(5, 10, 0) <= LINUX_VERSION_CODE)
 		ktime_get_real_ts64(&pinfo->time_ioctl_start);
 #else
@@ -169,6 +174,22 @@ void stop_vld_time(int optype, int tile_num)
 		g_time_infos[optype].time_vld_diff_us[tile_num];
 }
 
+/* add_wait_time: account cpu time of waiting for the h/w.
+ *
+ * @param optype: the op.
+ * @param spin_us: time busy waiting on the cpu.
+ * @param sleep_us: time sleeping on the irq.
+ */
+void add_wait_time(int optype, uint32_t spin_us, uint32_t sleep_us)
+{
+	if (g_enable_usage_profiling && optype < MOD_ALL &&
+		optype >= MOD_BYP &&
+		strlen(g_time_infos[optype].op_name) > 0) {
+		g_time_infos[optype].time_spin_us += spin_us;
+		g_time_infos[optype].time_sleep_us += sleep_us;
+	}
+}
+
 static irqreturn_t cvi_ive_irq_handler(int irq, void *data)
 {
 	struct cvi_ive_device *ndev = data;
@@ -190,29 +211,33 @@ static irqreturn_t cvi_ive_irq_handler(int irq, void *data)
 
 static int ive_proc_show(struct seq_file *m, void *v)
 {
+	struct cvi_ive_device *ndev = m->private;
 	int i = 0, tile = 0;
 
 	if (g_enable_usage_profiling) {
 		char const *row_name[] = {"op name", "start(s)", "ioctl(us)",
 							"tile0(us)", "tile1(us)", "tile2(us)", "tile3(us)",
-							"tile4(us)", "tile5(us)", "tileSum(us)"};
-		int row_space[] = { -15, 10, 10, 10, 10, 10, 10, 10, 10, 10};
+							"tile4(us)", "tile5(us)", "tileSum(us)",
+							"spin(us)", "sleep(us)"};
+		int row_space[] = { -15, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10, 10};
 		int table[] = { 20, 21, 22, 23, 24, 3, 2, 25, 26, 27,
 						28, 31, 33, 35, 1, 29, 30, 4, 6, 7,
 						8, 9, 10, 11, 15, 16, 17, 19, 18, 36,
 						12, 34, 13, 14, 32, 5};
 
 		seq_puts(m, "[IVE] ive time profiling\n");
-		seq_printf(m, "%*s| %*s| %*s| %*s| %*s| %*s| %*s| %*s| %*s| %*s\n",
+		seq_printf(m, "%*s| %*s| %*s| %*s| %*s| %*s| %*s| %*s| %*s| %*s| %*s| %*s\n",
 		row_space[0], row_name[0], row_space[1], row_name[1],
 		row_space[2], row_name[2], row_space[3], row_name[3],
 		row_space[4], row_name[4], row_space[5], row_name[5],
 		row_space[6], row_name[6], row_space[7], row_name[7],
-		row_space[8], row_name[8], row_space[9], row_name[9]);
+		row_space[8], row_name[8], row_space[9], row_name[9],
+		row_space[10], row_name[10], row_space[11], row_name[11]);
 
 		for (i = 0; i < 36; i++) {
 			uint32_t second_vld_time[6] = {0};
 			uint32_t second_tile_time = 0;
+			uint32_t second_spin_time = 0, second_sleep_time = 0;
 			uint32_t id = table[i];
 
 			if (strlen(g_time_infos[id].op_name) > 0) {
@@ -221,11 +246,13 @@ static int ive_proc_show(struct seq_file *m, void *v)
 						second_vld_time[tile] = g_time_infos[5].time_vld_diff_us[tile];
 					}
 					second_tile_time = g_time_infos[5].time_tile_diff_us;
+					second_spin_time = g_time_infos[5].time_spin_us;
+					second_sleep_time = g_time_infos[5].time_sleep_us;
 				} else if (id == 5) {
 					continue;
 				}
 				seq_printf(
-					m, "%*s| %*lld| %*u| %*d| %*d| %*d| %*d| %*d| %*d| %*d\n",
+					m, "%*s| %*lld| %*u| %*d| %*d| %*d| %*d| %*d| %*d| %*d| %*u| %*u\n",
 					row_space[0],
 					g_time_infos[id].op_name,
 					row_space[1],
@@ -245,12 +272,19 @@ static int ive_proc_show(struct seq_file *m, void *v)
 					row_space[8],
 					g_time_infos[id].time_vld_diff_us[5] + second_vld_time[5],
 					row_space[9],
-					g_time_infos[id].time_tile_diff_us + second_tile_time);
+					g_time_infos[id].time_tile_diff_us + second_tile_time,
+					row_space[10],
+					g_time_infos[id].time_spin_us + second_spin_time,
+					row_space[11],
+					g_time_infos[id].time_sleep_us + second_sleep_time);
 			}
 		}
 	} else {
 		seq_puts(m, "[IVE] ive time profiling is disabled\n");
 	}
+
+	seq_printf(m, "[IVE] job queue: submit(%u) done(%u) cancel(%u)\n",
+		   ndev->job_submit_cnt, ndev->job_done_cnt, ndev->job_cancel_cnt);
 	return 0;
 }
 
@@ -330,463 +364,873 @@ static long cvi_ive_compat_ioctl(struct file *file, unsigned int cmd,
 }
 #endif
 
-static long cvi_ive_ioctl(struct file *filp, unsigned int cmd,
-			  unsigned long arg)
+/* cvi_ive_run_op: run one operator ioctl on the engine.
+ *
+ * @param ndev: the ive device.
+ * @param cmd: the operator ioctl.
+ * @param kdata: the operator's argument, copied from user.
+ */
+static long cvi_ive_run_op(struct cvi_ive_device *ndev, unsigned int cmd,
+			   char *kdata)
 {
-	struct cvi_ive_device *ndev = filp->private_data;
 	CVI_S32 ret = -1;
 
-	if (!copy_from_user(g_kdata, (void __user *)arg, 512) ||
-		cmd == CVI_IVE_IOC_DUMP || cmd == CVI_IVE_IOC_CMDQ) {
-		switch (cmd) {
-		case CVI_IVE_IOC_QUERY: {
-			CVI_BOOL bFinish;
-			struct cvi_ive_query_arg *val =
-					(struct cvi_ive_query_arg *) g_kdata;
-
-			start_ioctl_time(&g_time_infos[MOD_QUERY], "QUERY");
-			ret = copy_from_user(&bFinish,
-							(void __user *)val->pbFinish,
-							sizeof(bool));
-			ret = cvi_ive_Query(ndev, &bFinish, val->bBlock);
-			ret = copy_to_user((void __user *)val->pbFinish,
-						&bFinish, sizeof(bool));
-			stop_ioctl_time(&g_time_infos[MOD_QUERY]);
-		} break;
-		case CVI_IVE_IOC_RESET: {
-			start_ioctl_time(&g_time_infos[MOD_RESET], "RESET");
-			ret = cvi_ive_reset(ndev, *((int *) g_kdata));
-			stop_ioctl_time(&g_time_infos[MOD_RESET]);
-		} break;
-		case CVI_IVE_IOC_DUMP: {
-			start_ioctl_time(&g_time_infos[MOD_DUMP], "DUMP");
-			ret = cvi_ive_dump_reg_state(true);
-			stop_ioctl_time(&g_time_infos[MOD_DUMP]);
-		} break;
-		case CVI_IVE_IOC_TEST: {
-			struct cvi_ive_test_arg *val =
-					(struct cvi_ive_test_arg *) g_kdata;
-
-			start_ioctl_time(&g_time_infos[MOD_TEST], "Test");
-			ret = cvi_ive_test(ndev, val->pAddr, &val->u16Width,
-						&val->u16Height);
-			stop_ioctl_time(&g_time_infos[MOD_TEST]);
-		} break;
-		case CVI_IVE_IOC_DMA: {
-			struct cvi_ive_ioctl_dma_arg *val =
-					(struct cvi_ive_ioctl_dma_arg *) g_kdata;
-
-			start_ioctl_time(&g_time_infos[MOD_DMA], "DMA");
-			ret = cvi_ive_DMA(ndev, &val->stSrc, &val->stDst,
+	switch (cmd) {
+	case CVI_IVE_IOC_QUERY: {
+		CVI_BOOL bFinish;
+		struct cvi_ive_query_arg *val =
+				(struct cvi_ive_query_arg *) kdata;
+
+		start_ioctl_time(&g_time_infos[MOD_QUERY], "QUERY");
+		ret = copy_from_user(&bFinish,
+						(void __user *)val->pbFinish,
+						sizeof(bool));
+		ret = cvi_ive_Query(ndev, &bFinish, val->bBlock);
+		ret = copy_to_user((void __user *)val->pbFinish,
+					&bFinish, sizeof(bool));
+		stop_ioctl_time(&g_time_infos[MOD_QUERY]);
+	} break;
+	case CVI_IVE_IOC_RESET: {
+		start_ioctl_time(&g_time_infos[MOD_RESET], "RESET");
+		ret = cvi_ive_reset(ndev, *((int *) kdata));
+		stop_ioctl_time(&g_time_infos[MOD_RESET]);
+	} break;
+	case CVI_IVE_IOC_DUMP: {
+		start_ioctl_time(&g_time_infos[MOD_DUMP], "DUMP");
+		ret = cvi_ive_dump_reg_state(true);
+		stop_ioctl_time(&g_time_infos[MOD_DUMP]);
+	} break;
+	case CVI_IVE_IOC_TEST: {
+		struct cvi_ive_test_arg *val =
+				(struct cvi_ive_test_arg *) kdata;
+
+		start_ioctl_time(&g_time_infos[MOD_TEST], "Test");
+		ret = cvi_ive_test(ndev, val->pAddr, &val->u16Width,
+					&val->u16Height);
+		stop_ioctl_time(&g_time_infos[MOD_TEST]);
+	} break;
+	case CVI_IVE_IOC_DMA: {
+		struct cvi_ive_ioctl_dma_arg *val =
+				(struct cvi_ive_ioctl_dma_arg *) kdata;
+
+		start_ioctl_time(&g_time_infos[MOD_DMA], "DMA");
+		ret = cvi_ive_DMA(ndev, &val->stSrc, &val->stDst,
+					&val->stCtrl, val->bInstant);
+		stop_ioctl_time(&g_time_infos[MOD_DMA]);
+	} break;
+	case CVI_IVE_IOC_And: {
+		struct cvi_ive_ioctl_and_arg *val =
+				(struct cvi_ive_ioctl_and_arg *) kdata;
+
+		start_ioctl_time(&g_time_infos[MOD_AND], "And");
+		ret = cvi_ive_And(ndev, &val->stSrc1, &val->stSrc2,
+					&val->stDst, val->bInstant);
+		stop_ioctl_time(&g_time_infos[MOD_AND]);
+	} break;
+	case CVI_IVE_IOC_Or: {
+		struct cvi_ive_ioctl_or_arg *val =
+				(struct cvi_ive_ioctl_or_arg *) kdata;
+
+		start_ioctl_time(&g_time_infos[MOD_OR], "Or");
+		ret = cvi_ive_Or(ndev, &val->stSrc1, &val->stSrc2,
+					&val->stDst, val->bInstant);
+		stop_ioctl_time(&g_time_infos[MOD_OR]);
+	} break;
+	case CVI_IVE_IOC_Xor: {
+		struct cvi_ive_ioctl_xor_arg *val =
+				(struct cvi_ive_ioctl_xor_arg *) kdata;
+
+		start_ioctl_time(&g_time_infos[MOD_XOR], "Xor");
+		ret = cvi_ive_Xor(ndev, &val->stSrc1, &val->stSrc2,
+					&val->stDst, val->bInstant);
+		stop_ioctl_time(&g_time_infos[MOD_XOR]);
+	} break;
+	case CVI_IVE_IOC_Add: {
+		struct cvi_ive_ioctl_add_arg *val =
+				(struct cvi_ive_ioctl_add_arg *) kdata;
+
+		start_ioctl_time(&g_time_infos[MOD_ADD], "Add");
+		ret = cvi_ive_Add(ndev, &val->stSrc1, &val->stSrc2,
+					&val->stDst, &val->pstCtrl,
+					val->bInstant);
+		stop_ioctl_time(&g_time_infos[MOD_ADD]);
+	} break;
+	case CVI_IVE_IOC_Sub: {
+		struct cvi_ive_ioctl_sub_arg *val =
+				(struct cvi_ive_ioctl_sub_arg *) kdata;
+
+		start_ioctl_time(&g_time_infos[MOD_SUB], "Sub");
+		ret = cvi_ive_Sub(ndev, &val->stSrc1, &val->stSrc2,
+					&val->stDst, &val->stCtrl,
+					val->bInstant);
+		stop_ioctl_time(&g_time_infos[MOD_SUB]);
+	} break;
+	case CVI_IVE_IOC_Thresh: {
+		struct cvi_ive_ioctl_thresh_arg *val =
+				(struct cvi_ive_ioctl_thresh_arg *) kdata;
+
+		start_ioctl_time(&g_time_infos[MOD_THRESH], "Thresh");
+		ret = cvi_ive_Thresh(ndev, &val->stSrc, &val->stDst,
 						&val->stCtrl, val->bInstant);
-			stop_ioctl_time(&g_time_infos[MOD_DMA]);
-		} break;
-		case CVI_IVE_IOC_And: {
-			struct cvi_ive_ioctl_and_arg *val =
-					(struct cvi_ive_ioctl_and_arg *) g_kdata;
-
-			start_ioctl_time(&g_time_infos[MOD_AND], "And");
-			ret = cvi_ive_And(ndev, &val->stSrc1, &val->stSrc2,
-						&val->stDst, val->bInstant);
-			stop_ioctl_time(&g_time_infos[MOD_AND]);
-		} break;
-		case CVI_IVE_IOC_Or: {
-			struct cvi_ive_ioctl_or_arg *val =
-					(struct cvi_ive_ioctl_or_arg *) g_kdata;
-
-			start_ioctl_time(&g_time_infos[MOD_OR], "Or");
-			ret = cvi_ive_Or(ndev, &val->stSrc1, &val->stSrc2,
-						&val->stDst, val->bInstant);
-			stop_ioctl_time(&g_time_infos[MOD_OR]);
-		} break;
-		case CVI_IVE_IOC_Xor: {
-			struct cvi_ive_ioctl_xor_arg *val =
-					(struct cvi_ive_ioctl_xor_arg *) g_kdata;
-
-			start_ioctl_time(&g_time_infos[MOD_XOR], "Xor");
-			ret = cvi_ive_Xor(ndev, &val->stSrc1, &val->stSrc2,
-						&val->stDst, val->bInstant);
-			stop_ioctl_time(&g_time_infos[MOD_XOR]);
-		} break;
-		case CVI_IVE_IOC_Add: {
-			struct cvi_ive_ioctl_add_arg *val =
-					(struct cvi_ive_ioctl_add_arg *) g_kdata;
-
-			start_ioctl_time(&g_time_infos[MOD_ADD], "Add");
-			ret = cvi_ive_Add(ndev, &val->stSrc1, &val->stSrc2,
-						&val->stDst, &val->pstCtrl,
-						val->bInstant);
-			stop_ioctl_time(&g_time_infos[MOD_ADD]);
-		} break;
-		case CVI_IVE_IOC_Sub: {
-			struct cvi_ive_ioctl_sub_arg *val =
-					(struct cvi_ive_ioctl_sub_arg *) g_kdata;
-
-			start_ioctl_time(&g_time_infos[MOD_SUB], "Sub");
-			ret = cvi_ive_Sub(ndev, &val->stSrc1, &val->stSrc2,
-						&val->stDst, &val->stCtrl,
-						val->bInstant);
-			stop_ioctl_time(&g_time_infos[MOD_SUB]);
-		} break;
-		case CVI_IVE_IOC_Thresh: {
-			struct cvi_ive_ioctl_thresh_arg *val =
-					(struct cvi_ive_ioctl_thresh_arg *) g_kdata;
-
-			start_ioctl_time(&g_time_infos[MOD_THRESH], "Thresh");
-			ret = cvi_ive_Thresh(ndev, &val->stSrc, &val->stDst,
-							&val->stCtrl, val->bInstant);
-			stop_ioctl_time(&g_time_infos[MOD_THRESH]);
-		} break;
-		case CVI_IVE_IOC_Dilate: {
-			struct cvi_ive_ioctl_dilate_arg *val =
-					(struct cvi_ive_ioctl_dilate_arg *) g_kdata;
-
-			start_ioctl_time(&g_time_infos[MOD_DILA], "Dilate");
-			ret = cvi_ive_Dilate(ndev, &val->stSrc, &val->stDst,
-							&val->stCtrl, val->bInstant);
-			stop_ioctl_time(&g_time_infos[MOD_DILA]);
-		} break;
-		case CVI_IVE_IOC_Erode: {
-			struct cvi_ive_ioctl_erode_arg *val =
-					(struct cvi_ive_ioctl_erode_arg *) g_kdata;
-
-			start_ioctl_time(&g_time_infos[MOD_ERO], "Erode");
-			ret = cvi_ive_Erode(ndev, &val->stSrc, &val->stDst,
+		stop_ioctl_time(&g_time_infos[MOD_THRESH]);
+	} break;
+	case CVI_IVE_IOC_Dilate: {
+		struct cvi_ive_ioctl_dilate_arg *val =
+				(struct cvi_ive_ioctl_dilate_arg *) kdata;
+
+		start_ioctl_time(&g_time_infos[MOD_DILA], "Dilate");
+		ret = cvi_ive_Dilate(ndev, &val->stSrc, &val->stDst,
 						&val->stCtrl, val->bInstant);
-			stop_ioctl_time(&g_time_infos[MOD_ERO]);
-		} break;
-		case CVI_IVE_IOC_MatchBgModel: {
-			struct cvi_ive_ioctl_match_bgmodel_arg *val =
-					(struct cvi_ive_ioctl_match_bgmodel_arg *) g_kdata;
-
-			start_ioctl_time(&g_time_infos[MOD_BGM], "MatchBgModel");
-			ret = cvi_ive_MatchBgModel(ndev, &val->stCurImg,
-							&val->stBgModel,
-							&val->stFgFlag, &val->stDiffFg,
-							&val->stStatData, &val->stCtrl,
-							val->bInstant);
-			stop_ioctl_time(&g_time_infos[MOD_BGM]);
-		} break;
-		case CVI_IVE_IOC_UpdateBgModel: {
-			struct cvi_ive_ioctl_update_bgmodel_arg *val =
-					(struct cvi_ive_ioctl_update_bgmodel_arg *) g_kdata;
-
-			start_ioctl_time(&g_time_infos[MOD_BGU], "UpdateBgModel");
-			ret = cvi_ive_UpdateBgModel(ndev, &val->stBgModel,
-							&val->stFgFlag, &val->stBgImg,
-							&val->stChgSta,
-							&val->stStatData,
-							&val->stCtrl, val->bInstant);
-			stop_ioctl_time(&g_time_infos[MOD_BGU]);
-		} break;
-		case CVI_IVE_IOC_GMM: {
-			struct cvi_ive_ioctl_gmm_arg *val =
-					(struct cvi_ive_ioctl_gmm_arg *) g_kdata;
-
-			start_ioctl_time(&g_time_infos[MOD_GMM], "GMM");
-			ret = cvi_ive_GMM(ndev, &val->stSrc, &val->stFg,
-						&val->stBg, &val->stModel, &val->stCtrl,
-						val->bInstant);
-			stop_ioctl_time(&g_time_infos[MOD_GMM]);
-		} break;
-		case CVI_IVE_IOC_GMM2: {
-			struct cvi_ive_ioctl_gmm2_arg *val =
-					(struct cvi_ive_ioctl_gmm2_arg *) g_kdata;
-
-			start_ioctl_time(&g_time_infos[MOD_GMM2], "GMM2");
-			ret = cvi_ive_GMM2(ndev, &val->stSrc, &val->stFactor,
-						&val->stFg, &val->stBg, &val->stInfo,
-						&val->stModel, &val->stCtrl,
+		stop_ioctl_time(&g_time_infos[MOD_DILA]);
+	} break;
+	case CVI_IVE_IOC_Erode: {
+		struct cvi_ive_ioctl_erode_arg *val =
+				(struct cvi_ive_ioctl_erode_arg *) kdata;
+
+		start_ioctl_time(&g_time_infos[MOD_ERO], "Erode");
+		ret = cvi_ive_Erode(ndev, &val->stSrc, &val->stDst,
+					&val->stCtrl, val->bInstant);
+		stop_ioctl_time(&g_time_infos[MOD_ERO]);
+	} break;
+	case CVI_IVE_IOC_MatchBgModel: {
+		struct cvi_ive_ioctl_match_bgmodel_arg *val =
+				(struct cvi_ive_ioctl_match_bgmodel_arg *) kdata;
+
+		start_ioctl_time(&g_time_infos[MOD_BGM], "MatchBgModel");
+		ret = cvi_ive_MatchBgModel(ndev, &val->stCurImg,
+						&val->stBgModel,
+						&val->stFgFlag, &val->stDiffFg,
+						&val->stStatData, &val->stCtrl,
 						val->bInstant);
-			stop_ioctl_time(&g_time_infos[MOD_GMM2]);
-		} break;
-
-		case CVI_IVE_IOC_Bernsen: {
-			struct cvi_ive_ioctl_bernsen_arg *val =
-					(struct cvi_ive_ioctl_bernsen_arg *) g_kdata;
-
-			start_ioctl_time(&g_time_infos[MOD_BERNSEN], "Bernsen");
-			ret = cvi_ive_Bernsen(ndev, &val->stSrc, &val->stDst,
-							&val->stCtrl, val->bInstant);
-			stop_ioctl_time(&g_time_infos[MOD_BERNSEN]);
-		} break;
-		case CVI_IVE_IOC_Filter: {
-			struct cvi_ive_ioctl_filter_arg *val =
-					(struct cvi_ive_ioctl_filter_arg *) g_kdata;
-
-			start_ioctl_time(&g_time_infos[MOD_FILTER3CH], "Filter");
-			ret = cvi_ive_Filter(ndev, &val->stSrc, &val->stDst,
-							&val->stCtrl, val->bInstant);
-			stop_ioctl_time(&g_time_infos[MOD_FILTER3CH]);
-		} break;
-		case CVI_IVE_IOC_Sobel: {
-			struct cvi_ive_ioctl_sobel_arg *val =
-					(struct cvi_ive_ioctl_sobel_arg *) g_kdata;
-
-			start_ioctl_time(&g_time_infos[MOD_SOBEL], "Sobel");
-			ret = cvi_ive_Sobel(ndev, &val->stSrc, &val->stDstH,
-						&val->stDstV, &val->stCtrl,
+		stop_ioctl_time(&g_time_infos[MOD_BGM]);
+	} break;
+	case CVI_IVE_IOC_UpdateBgModel: {
+		struct cvi_ive_ioctl_update_bgmodel_arg *val =
+				(struct cvi_ive_ioctl_update_bgmodel_arg *) kdata;
+
+		start_ioctl_time(&g_time_infos[MOD_BGU], "UpdateBgModel");
+		ret = cvi_ive_UpdateBgModel(ndev, &val->stBgModel,
+						&val->stFgFlag, &val->stBgImg,
+						&val->stChgSta,
+						&val->stStatData,
+						&val->stCtrl, val->bInstant);
+		stop_ioctl_time(&g_time_infos[MOD_BGU]);
+	} break;
+	case CVI_IVE_IOC_GMM: {
+		struct cvi_ive_ioctl_gmm_arg *val =
+				(struct cvi_ive_ioctl_gmm_arg *) kdata;
+
+		start_ioctl_time(&g_time_infos[MOD_GMM], "GMM");
+		ret = cvi_ive_GMM(ndev, &val->stSrc, &val->stFg,
+					&val->stBg, &val->stModel, &val->stCtrl,
+					val->bInstant);
+		stop_ioctl_time(&g_time_infos[MOD_GMM]);
+	} break;
+	case CVI_IVE_IOC_GMM2: {
+		struct cvi_ive_ioctl_gmm2_arg *val =
+				(struct cvi_ive_ioctl_gmm2_arg *) kdata;
+
+		start_ioctl_time(&g_time_infos[MOD_GMM2], "GMM2");
+		ret = cvi_ive_GMM2(ndev, &val->stSrc, &val->stFactor,
+					&val->stFg, &val->stBg, &val->stInfo,
+					&val->stModel, &val->stCtrl,
+					val->bInstant);
+		stop_ioctl_time(&g_time_infos[MOD_GMM2]);
+	} break;
+
+	case CVI_IVE_IOC_Bernsen: {
+		struct cvi_ive_ioctl_bernsen_arg *val =
+				(struct cvi_ive_ioctl_bernsen_arg *) kdata;
+
+		start_ioctl_time(&g_time_infos[MOD_BERNSEN], "Bernsen");
+		ret = cvi_ive_Bernsen(ndev, &val->stSrc, &val->stDst,
+						&val->stCtrl, val->bInstant);
+		stop_ioctl_time(&g_time_infos[MOD_BERNSEN]);
+	} break;
+	case CVI_IVE_IOC_Filter: {
+		struct cvi_ive_ioctl_filter_arg *val =
+				(struct cvi_ive_ioctl_filter_arg *) kdata;
+
+		start_ioctl_time(&g_time_infos[MOD_FILTER3CH], "Filter");
+		ret = cvi_ive_Filter(ndev, &val->stSrc, &val->stDst,
+						&val->stCtrl, val->bInstant);
+		stop_ioctl_time(&g_time_infos[MOD_FILTER3CH]);
+	} break;
+	case CVI_IVE_IOC_Sobel: {
+		struct cvi_ive_ioctl_sobel_arg *val =
+				(struct cvi_ive_ioctl_sobel_arg *) kdata;
+
+		start_ioctl_time(&g_time_infos[MOD_SOBEL], "Sobel");
+		ret = cvi_ive_Sobel(ndev, &val->stSrc, &val->stDstH,
+					&val->stDstV, &val->stCtrl,
+					val->bInstant);
+		stop_ioctl_time(&g_time_infos[MOD_SOBEL]);
+	} break;
+	case CVI_IVE_IOC_MagAndAng: {
+		struct cvi_ive_ioctl_maganang_arg *val =
+				(struct cvi_ive_ioctl_maganang_arg *) kdata;
+
+		start_ioctl_time(&g_time_infos[MOD_MAG], "MagAndAng");
+		ret = cvi_ive_MagAndAng(ndev, &val->stSrc, &val->stDstMag,
+					&val->stDstAng, &val->stCtrl,
+					val->bInstant);
+		stop_ioctl_time(&g_time_infos[MOD_MAG]);
+	} break;
+	case CVI_IVE_IOC_CSC: {
+		struct cvi_ive_ioctl_csc_arg *val =
+				(struct cvi_ive_ioctl_csc_arg *) kdata;
+
+		start_ioctl_time(&g_time_infos[MOD_CSC], "CSC");
+		ret = cvi_ive_CSC(ndev, &val->stSrc, &val->stDst,
+					&val->stCtrl, val->bInstant);
+		stop_ioctl_time(&g_time_infos[MOD_CSC]);
+	} break;
+	case CVI_IVE_IOC_Hist: {
+		struct cvi_ive_ioctl_hist_arg *val =
+				(struct cvi_ive_ioctl_hist_arg *) kdata;
+
+		start_ioctl_time(&g_time_infos[MOD_HIST], "Hist");
+		ret = cvi_ive_Hist(ndev, &val->stSrc, &val->stDst,
+					val->bInstant);
+		stop_ioctl_time(&g_time_infos[MOD_HIST]);
+	} break;
+	case CVI_IVE_IOC_FilterAndCSC: {
+		struct cvi_ive_ioctl_filter_and_csc_arg *val =
+				(struct cvi_ive_ioctl_filter_and_csc_arg *) kdata;
+
+		start_ioctl_time(&g_time_infos[MOD_FILTERCSC], "FilterAndCSC");
+		ret = cvi_ive_FilterAndCSC(ndev, &val->stSrc, &val->stDst,
+						&val->stCtrl, val->bInstant);
+		stop_ioctl_time(&g_time_infos[MOD_FILTERCSC]);
+	} break;
+	case CVI_IVE_IOC_Map: {
+		struct cvi_ive_ioctl_map_arg *val =
+				(struct cvi_ive_ioctl_map_arg *) kdata;
+
+		start_ioctl_time(&g_time_infos[MOD_MAP], "Map");
+		ret = cvi_ive_Map(ndev, &val->stSrc, &val->stMap,
+					&val->stDst, &val->stCtrl,
+					val->bInstant);
+		stop_ioctl_time(&g_time_infos[MOD_MAP]);
+	} break;
+	case CVI_IVE_IOC_NCC: {
+		struct cvi_ive_ioctl_ncc_arg *val =
+				(struct cvi_ive_ioctl_ncc_arg *) kdata;
+
+		start_ioctl_time(&g_time_infos[MOD_NCC], "NCC");
+		ret = cvi_ive_NCC(ndev, &val->stSrc1, &val->stSrc2,
+					&val->stDst, val->bInstant);
+		stop_ioctl_time(&g_time_infos[MOD_NCC]);
+	} break;
+	case CVI_IVE_IOC_Integ: {
+		struct cvi_ive_ioctl_integ_arg *val =
+				(struct cvi_ive_ioctl_integ_arg *) kdata;
+
+		start_ioctl_time(&g_time_infos[MOD_INTEG], "Integ");
+		ret = cvi_ive_Integ(ndev, &val->stSrc, &val->stDst,
+					&val->stCtrl, val->bInstant);
+		stop_ioctl_time(&g_time_infos[MOD_INTEG]);
+	} break;
+	case CVI_IVE_IOC_LBP: {
+		struct cvi_ive_ioctl_lbp_arg *val =
+				(struct cvi_ive_ioctl_lbp_arg *) kdata;
+
+		start_ioctl_time(&g_time_infos[MOD_LBP], "LBP");
+		ret = cvi_ive_LBP(ndev, &val->stSrc, &val->stDst,
+					&val->stCtrl, val->bInstant);
+		stop_ioctl_time(&g_time_infos[MOD_LBP]);
+	} break;
+	case CVI_IVE_IOC_Thresh_S16: {
+		struct cvi_ive_ioctl_thresh_s16_arg *val =
+				(struct cvi_ive_ioctl_thresh_s16_arg *) kdata;
+
+		start_ioctl_time(&g_time_infos[MOD_THRS16], "Thresh_S16");
+		ret = cvi_ive_Thresh_S16(ndev, &val->stSrc, &val->stDst,
+						&val->stCtrl, val->bInstant);
+		stop_ioctl_time(&g_time_infos[MOD_THRS16]);
+	} break;
+	case CVI_IVE_IOC_Thresh_U16: {
+		struct cvi_ive_ioctl_thres_su16_arg *val =
+				(struct cvi_ive_ioctl_thres_su16_arg *) kdata;
+
+		start_ioctl_time(&g_time_infos[MOD_THRU16], "Thresh_U16");
+		ret = cvi_ive_Thresh_U16(ndev, &val->stSrc, &val->stDst,
+						&val->stCtrl, val->bInstant);
+		stop_ioctl_time(&g_time_infos[MOD_THRU16]);
+	} break;
+	case CVI_IVE_IOC_16BitTo8Bit: {
+		struct cvi_ive_ioctl_16bit_to_8bit_arg *val =
+				(struct cvi_ive_ioctl_16bit_to_8bit_arg *) kdata;
+
+		start_ioctl_time(&g_time_infos[MOD_16To8], "16BitTo8Bit");
+		ret = cvi_ive_16BitTo8Bit(ndev, &val->stSrc, &val->stDst,
+						&val->stCtrl, val->bInstant);
+		stop_ioctl_time(&g_time_infos[MOD_16To8]);
+	} break;
+	case CVI_IVE_IOC_OrdStatFilter: {
+		struct cvi_ive_ioctl_ord_stat_filter_arg *val =
+				(struct cvi_ive_ioctl_ord_stat_filter_arg *) kdata;
+
+		start_ioctl_time(&g_time_infos[MOD_ORDSTAFTR], "OrdStatFilter");
+		ret = cvi_ive_OrdStatFilter(ndev, &val->stSrc,
+						&val->stDst, &val->stCtrl,
 						val->bInstant);
-			stop_ioctl_time(&g_time_infos[MOD_SOBEL]);
-		} break;
-		case CVI_IVE_IOC_MagAndAng: {
-			struct cvi_ive_ioctl_maganang_arg *val =
-					(struct cvi_ive_ioctl_maganang_arg *) g_kdata;
-
-			start_ioctl_time(&g_time_infos[MOD_MAG], "MagAndAng");
-			ret = cvi_ive_MagAndAng(ndev, &val->stSrc, &val->stDstMag,
-						&val->stDstAng, &val->stCtrl,
+		stop_ioctl_time(&g_time_infos[MOD_ORDSTAFTR]);
+	} break;
+	case CVI_IVE_IOC_CannyHysEdge: {
+		struct cvi_ive_ioctl_canny_hys_edge_arg *val =
+				(struct cvi_ive_ioctl_canny_hys_edge_arg *) kdata;
+
+		start_ioctl_time(&g_time_infos[MOD_CANNY], "CannyHysEdge");
+		ret = cvi_ive_CannyHysEdge(ndev, &val->stSrc, &val->stDst,
+						&val->stStack, &val->stCtrl,
 						val->bInstant);
-			stop_ioctl_time(&g_time_infos[MOD_MAG]);
-		} break;
-		case CVI_IVE_IOC_CSC: {
-			struct cvi_ive_ioctl_csc_arg *val =
-					(struct cvi_ive_ioctl_csc_arg *) g_kdata;
-
-			start_ioctl_time(&g_time_infos[MOD_CSC], "CSC");
-			ret = cvi_ive_CSC(ndev, &val->stSrc, &val->stDst,
+		stop_ioctl_time(&g_time_infos[MOD_CANNY]);
+	} break;
+	case CVI_IVE_IOC_NormGrad: {
+		struct cvi_ive_ioctl_norm_grad_arg *val =
+				(struct cvi_ive_ioctl_norm_grad_arg *) kdata;
+
+		start_ioctl_time(&g_time_infos[MOD_NORMG], "NormGrad");
+		ret = cvi_ive_NormGrad(ndev, &val->stSrc, &val->stDstH,
+						&val->stDstV, &val->stDstHV,
 						&val->stCtrl, val->bInstant);
-			stop_ioctl_time(&g_time_infos[MOD_CSC]);
-		} break;
-		case CVI_IVE_IOC_Hist: {
-			struct cvi_ive_ioctl_hist_arg *val =
-					(struct cvi_ive_ioctl_hist_arg *) g_kdata;
-
-			start_ioctl_time(&g_time_infos[MOD_HIST], "Hist");
-			ret = cvi_ive_Hist(ndev, &val->stSrc, &val->stDst,
+		stop_ioctl_time(&g_time_infos[MOD_NORMG]);
+	} break;
+	case CVI_IVE_IOC_GradFg: {
+		struct cvi_ive_ioctl_grad_fg_arg *val =
+				(struct cvi_ive_ioctl_grad_fg_arg *) kdata;
+
+		start_ioctl_time(&g_time_infos[MOD_GRADFG], "GradFg");
+		ret = cvi_ive_GradFg(ndev, &val->stBgDiffFg,
+						&val->stCurGrad, &val->stBgGrad,
+						&val->stGradFg, &val->stCtrl,
 						val->bInstant);
-			stop_ioctl_time(&g_time_infos[MOD_HIST]);
-		} break;
-		case CVI_IVE_IOC_FilterAndCSC: {
-			struct cvi_ive_ioctl_filter_and_csc_arg *val =
-					(struct cvi_ive_ioctl_filter_and_csc_arg *) g_kdata;
-
-			start_ioctl_time(&g_time_infos[MOD_FILTERCSC], "FilterAndCSC");
-			ret = cvi_ive_FilterAndCSC(ndev, &val->stSrc, &val->stDst,
-							&val->stCtrl, val->bInstant);
-			stop_ioctl_time(&g_time_infos[MOD_FILTERCSC]);
-		} break;
-		case CVI_IVE_IOC_Map: {
-			struct cvi_ive_ioctl_map_arg *val =
-					(struct cvi_ive_ioctl_map_arg *) g_kdata;
-
-			start_ioctl_time(&g_time_infos[MOD_MAP], "Map");
-			ret = cvi_ive_Map(ndev, &val->stSrc, &val->stMap,
-						&val->stDst, &val->stCtrl,
+		stop_ioctl_time(&g_time_infos[MOD_GRADFG]);
+	} break;
+	case CVI_IVE_IOC_SAD: {
+		struct cvi_ive_ioctl_sad_arg *val =
+				(struct cvi_ive_ioctl_sad_arg *) kdata;
+
+		start_ioctl_time(&g_time_infos[MOD_SAD], "SAD");
+		ret = cvi_ive_SAD(ndev, &val->stSrc1, &val->stSrc2,
+					&val->stSad, &val->stThr, &val->stCtrl,
+					val->bInstant);
+		stop_ioctl_time(&g_time_infos[MOD_SAD]);
+	} break;
+	case CVI_IVE_IOC_Resize: {
+		int i = 0;
+		struct cvi_ive_ioctl_resize_arg *val =
+				(struct cvi_ive_ioctl_resize_arg *) kdata;
+		IVE_SRC_IMAGE_S *Src;
+		IVE_DST_IMAGE_S *Dst;
+
+		start_ioctl_time(&g_time_infos[MOD_RESIZE], "Resize");
+		Src = vmalloc(sizeof(IVE_IMAGE_S) * val->stCtrl.u16Num);
+		Dst = vmalloc(sizeof(IVE_IMAGE_S) * val->stCtrl.u16Num);
+		for (i = 0; i < val->stCtrl.u16Num; i++) {
+			ret = copy_from_user(
+				&Src[i], (void __user *)&val->astSrc[i],
+				sizeof(Src[i]));
+			ret = copy_from_user(
+				&Dst[i], (void __user *)&val->astDst[i],
+				sizeof(Dst[i]));
+		}
+		ret = cvi_ive_Resize(ndev, Src, Dst, &val->stCtrl,
 						val->bInstant);
-			stop_ioctl_time(&g_time_infos[MOD_MAP]);
-		} break;
-		case CVI_IVE_IOC_NCC: {
-			struct cvi_ive_ioctl_ncc_arg *val =
-					(struct cvi_ive_ioctl_ncc_arg *) g_kdata;
-
-			start_ioctl_time(&g_time_infos[MOD_NCC], "NCC");
-			ret = cvi_ive_NCC(ndev, &val->stSrc1, &val->stSrc2,
-						&val->stDst, val->bInstant);
-			stop_ioctl_time(&g_time_infos[MOD_NCC]);
-		} break;
-		case CVI_IVE_IOC_Integ: {
-			struct cvi_ive_ioctl_integ_arg *val =
-					(struct cvi_ive_ioctl_integ_arg *) g_kdata;
-
-			start_ioctl_time(&g_time_infos[MOD_INTEG], "Integ");
-			ret = cvi_ive_Integ(ndev, &val->stSrc, &val->stDst,
+		vfree(Src);
+		vfree(Dst);
+		stop_ioctl_time(&g_time_infos[MOD_RESIZE]);
+	} break;
+	case CVI_IVE_IOC_imgInToOdma: {
+		struct cvi_ive_ioctl_filter_arg *val =
+				(struct cvi_ive_ioctl_filter_arg *) kdata;
+
+		start_ioctl_time(&g_time_infos[MOD_BYP], "imgInToOdma");
+		ret = cvi_ive_imgInToOdma(ndev, &val->stSrc, &val->stDst,
 						&val->stCtrl, val->bInstant);
-			stop_ioctl_time(&g_time_infos[MOD_INTEG]);
-		} break;
-		case CVI_IVE_IOC_LBP: {
-			struct cvi_ive_ioctl_lbp_arg *val =
-					(struct cvi_ive_ioctl_lbp_arg *) g_kdata;
-
-			start_ioctl_time(&g_time_infos[MOD_LBP], "LBP");
-			ret = cvi_ive_LBP(ndev, &val->stSrc, &val->stDst,
-						&val->stCtrl, val->bInstant);
-			stop_ioctl_time(&g_time_infos[MOD_LBP]);
-		} break;
-		case CVI_IVE_IOC_Thresh_S16: {
-			struct cvi_ive_ioctl_thresh_s16_arg *val =
-					(struct cvi_ive_ioctl_thresh_s16_arg *) g_kdata;
-
-			start_ioctl_time(&g_time_infos[MOD_THRS16], "Thresh_S16");
-			ret = cvi_ive_Thresh_S16(ndev, &val->stSrc, &val->stDst,
-							&val->stCtrl, val->bInstant);
-			stop_ioctl_time(&g_time_infos[MOD_THRS16]);
-		} break;
-		case CVI_IVE_IOC_Thresh_U16: {
-			struct cvi_ive_ioctl_thres_su16_arg *val =
-					(struct cvi_ive_ioctl_thres_su16_arg *) g_kdata;
-
-			start_ioctl_time(&g_time_infos[MOD_THRU16], "Thresh_U16");
-			ret = cvi_ive_Thresh_U16(ndev, &val->stSrc, &val->stDst,
-							&val->stCtrl, val->bInstant);
-			stop_ioctl_time(&g_time_infos[MOD_THRU16]);
-		} break;
-		case CVI_IVE_IOC_16BitTo8Bit: {
-			struct cvi_ive_ioctl_16bit_to_8bit_arg *val =
-					(struct cvi_ive_ioctl_16bit_to_8bit_arg *) g_kdata;
-
-			start_ioctl_time(&g_time_infos[MOD_16To8], "16BitTo8Bit");
-			ret = cvi_ive_16BitTo8Bit(ndev, &val->stSrc, &val->stDst,
-							&val->stCtrl, val->bInstant);
-			stop_ioctl_time(&g_time_infos[MOD_16To8]);
-		} break;
-		case CVI_IVE_IOC_OrdStatFilter: {
-			struct cvi_ive_ioctl_ord_stat_filter_arg *val =
-					(struct cvi_ive_ioctl_ord_stat_filter_arg *) g_kdata;
-
-			start_ioctl_time(&g_time_infos[MOD_ORDSTAFTR], "OrdStatFilter");
-			ret = cvi_ive_OrdStatFilter(ndev, &val->stSrc,
-							&val->stDst, &val->stCtrl,
-							val->bInstant);
-			stop_ioctl_time(&g_time_infos[MOD_ORDSTAFTR]);
-		} break;
-		case CVI_IVE_IOC_CannyHysEdge: {
-			struct cvi_ive_ioctl_canny_hys_edge_arg *val =
-					(struct cvi_ive_ioctl_canny_hys_edge_arg *) g_kdata;
-
-			start_ioctl_time(&g_time_infos[MOD_CANNY], "CannyHysEdge");
-			ret = cvi_ive_CannyHysEdge(ndev, &val->stSrc, &val->stDst,
-							&val->stStack, &val->stCtrl,
-							val->bInstant);
-			stop_ioctl_time(&g_time_infos[MOD_CANNY]);
-		} break;
-		case CVI_IVE_IOC_NormGrad: {
-			struct cvi_ive_ioctl_norm_grad_arg *val =
-					(struct cvi_ive_ioctl_norm_grad_arg *) g_kdata;
-
-			start_ioctl_time(&g_time_infos[MOD_NORMG], "NormGrad");
-			ret = cvi_ive_NormGrad(ndev, &val->stSrc, &val->stDstH,
-							&val->stDstV, &val->stDstHV,
-							&val->stCtrl, val->bInstant);
-			stop_ioctl_time(&g_time_infos[MOD_NORMG]);
-		} break;
-		case CVI_IVE_IOC_GradFg: {
-			struct cvi_ive_ioctl_grad_fg_arg *val =
-					(struct cvi_ive_ioctl_grad_fg_arg *) g_kdata;
-
-			start_ioctl_time(&g_time_infos[MOD_GRADFG], "GradFg");
-			ret = cvi_ive_GradFg(ndev, &val->stBgDiffFg,
-							&val->stCurGrad, &val->stBgGrad,
-							&val->stGradFg, &val->stCtrl,
-							val->bInstant);
-			stop_ioctl_time(&g_time_infos[MOD_GRADFG]);
-		} break;
-		case CVI_IVE_IOC_SAD: {
-			struct cvi_ive_ioctl_sad_arg *val =
-					(struct cvi_ive_ioctl_sad_arg *) g_kdata;
-
-			start_ioctl_time(&g_time_infos[MOD_SAD], "SAD");
-			ret = cvi_ive_SAD(ndev, &val->stSrc1, &val->stSrc2,
-						&val->stSad, &val->stThr, &val->stCtrl,
+		stop_ioctl_time(&g_time_infos[MOD_BYP]);
+	} break;
+	case CVI_IVE_IOC_rgbPToYuvToErodeToDilate: {
+		struct cvi_ive_ioctl_rgbPToYuvToErodeToDilate *val =
+				(struct cvi_ive_ioctl_rgbPToYuvToErodeToDilate *) kdata;
+
+		start_ioctl_time(&g_time_infos[MOD_ED],
+				"rgbPToYuvToErodeToDilate");
+		ret = cvi_ive_rgbPToYuvToErodeToDilate(
+			ndev, &val->stSrc, &val->stDst1, &val->stDst2,
+			&val->stCtrl, val->bInstant);
+		stop_ioctl_time(&g_time_infos[MOD_ED]);
+	} break;
+	case CVI_IVE_IOC_STCandiCorner: {
+		struct cvi_ive_ioctl_stcandicorner *val =
+				(struct cvi_ive_ioctl_stcandicorner *) kdata;
+
+		start_ioctl_time(&g_time_infos[MOD_STCANDI], "STCandiCorner");
+		start_ioctl_time(&g_time_infos[MOD_STBOX], "STBox");
+		ret = cvi_ive_STCandiCorner(ndev, &val->stSrc,
+						&val->stDst, &val->stCtrl,
 						val->bInstant);
-			stop_ioctl_time(&g_time_infos[MOD_SAD]);
-		} break;
-		case CVI_IVE_IOC_Resize: {
-			int i = 0;
-			struct cvi_ive_ioctl_resize_arg *val =
-					(struct cvi_ive_ioctl_resize_arg *) g_kdata;
-			IVE_SRC_IMAGE_S *Src;
-			IVE_DST_IMAGE_S *Dst;
-
-			start_ioctl_time(&g_time_infos[MOD_RESIZE], "Resize");
-			Src = vmalloc(sizeof(IVE_IMAGE_S) * val->stCtrl.u16Num);
-			Dst = vmalloc(sizeof(IVE_IMAGE_S) * val->stCtrl.u16Num);
-			for (i = 0; i < val->stCtrl.u16Num; i++) {
-				ret = copy_from_user(
-					&Src[i], (void __user *)&val->astSrc[i],
-					sizeof(Src[i]));
-				ret = copy_from_user(
-					&Dst[i], (void __user *)&val->astDst[i],
-					sizeof(Dst[i]));
-			}
-			ret = cvi_ive_Resize(ndev, Src, Dst, &val->stCtrl,
-							val->bInstant);
-			vfree(Src);
-			vfree(Dst);
-			stop_ioctl_time(&g_time_infos[MOD_RESIZE]);
-		} break;
-		case CVI_IVE_IOC_imgInToOdma: {
-			struct cvi_ive_ioctl_filter_arg *val =
-					(struct cvi_ive_ioctl_filter_arg *) g_kdata;
-
-			start_ioctl_time(&g_time_infos[MOD_BYP], "imgInToOdma");
-			ret = cvi_ive_imgInToOdma(ndev, &val->stSrc, &val->stDst,
-							&val->stCtrl, val->bInstant);
-			stop_ioctl_time(&g_time_infos[MOD_BYP]);
-		} break;
-		case CVI_IVE_IOC_rgbPToYuvToErodeToDilate: {
-			struct cvi_ive_ioctl_rgbPToYuvToErodeToDilate *val =
-					(struct cvi_ive_ioctl_rgbPToYuvToErodeToDilate *) g_kdata;
-
-			start_ioctl_time(&g_time_infos[MOD_ED],
-					"rgbPToYuvToErodeToDilate");
-			ret = cvi_ive_rgbPToYuvToErodeToDilate(
-				ndev, &val->stSrc, &val->stDst1, &val->stDst2,
-				&val->stCtrl, val->bInstant);
-			stop_ioctl_time(&g_time_infos[MOD_ED]);
-		} break;
-		case CVI_IVE_IOC_STCandiCorner: {
-			struct cvi_ive_ioctl_stcandicorner *val =
-					(struct cvi_ive_ioctl_stcandicorner *) g_kdata;
-
-			start_ioctl_time(&g_time_infos[MOD_STCANDI], "STCandiCorner");
-			start_ioctl_time(&g_time_infos[MOD_STBOX], "STBox");
-			ret = cvi_ive_STCandiCorner(ndev, &val->stSrc,
-							&val->stDst, &val->stCtrl,
+		stop_ioctl_time(&g_time_infos[MOD_STCANDI]);
+		stop_ioctl_time(&g_time_infos[MOD_STBOX]);
+	} break;
+	case CVI_IVE_IOC_MD: {
+		struct cvi_ive_ioctl_md *val = (struct cvi_ive_ioctl_md *) kdata;
+
+		start_ioctl_time(&g_time_infos[MOD_MD], "FrameDiffDetect");
+		ret = cvi_ive_FrameDiffMotion(ndev, &val->stSrc1,
+							&val->stSrc2, &val->stDst,
+							&val->stCtrl,
 							val->bInstant);
-			stop_ioctl_time(&g_time_infos[MOD_STCANDI]);
-			stop_ioctl_time(&g_time_infos[MOD_STBOX]);
-		} break;
-		case CVI_IVE_IOC_MD: {
-			struct cvi_ive_ioctl_md *val = (struct cvi_ive_ioctl_md *) g_kdata;
-
-			start_ioctl_time(&g_time_infos[MOD_MD], "FrameDiffDetect");
-			ret = cvi_ive_FrameDiffMotion(ndev, &val->stSrc1,
-								&val->stSrc2, &val->stDst,
-								&val->stCtrl,
-								val->bInstant);
-			stop_ioctl_time(&g_time_infos[MOD_MD]);
-		} break;
-		case CVI_IVE_IOC_CMDQ: {
-			start_ioctl_time(&g_time_infos[MOD_CMDQ], "CmdQ");
-			ret = cvi_ive_CmdQ(ndev);
-			stop_ioctl_time(&g_time_infos[MOD_CMDQ]);
-		} break;
-		default:
-			return -ENOTTY;
+		stop_ioctl_time(&g_time_infos[MOD_MD]);
+	} break;
+	case CVI_IVE_IOC_CMDQ: {
+		start_ioctl_time(&g_time_infos[MOD_CMDQ], "CmdQ");
+		ret = cvi_ive_CmdQ(ndev);
+		stop_ioctl_time(&g_time_infos[MOD_CMDQ]);
+	} break;
+	default:
+		return -ENOTTY;
+	}
+	if (ret) {
+		dev_err(ndev->dev,
+			"[IVE] ioctl _IOC_NR(%d) fail\n", _IOC_NR(cmd));
+		return ret;
+	}
+	return ret;
+}
+
+/* cvi_ive_job_async_capable: if the operator can run from the job worker.
+ *
+ * Operators which copy from/to user virtual addresses (Map, NCC, BgModel,
+ * STCandiCorner, Resize) and the control ioctls must stay synchronous.
+ *
+ * @param cmd: the operator ioctl.
+ */
+static bool cvi_ive_job_async_capable(unsigned int cmd)
+{
+	switch (cmd) {
+	case CVI_IVE_IOC_DMA:
+	case CVI_IVE_IOC_And:
+	case CVI_IVE_IOC_Or:
+	case CVI_IVE_IOC_Xor:
+	case CVI_IVE_IOC_Add:
+	case CVI_IVE_IOC_Sub:
+	case CVI_IVE_IOC_Thresh:
+	case CVI_IVE_IOC_Dilate:
+	case CVI_IVE_IOC_Erode:
+	case CVI_IVE_IOC_GMM:
+	case CVI_IVE_IOC_GMM2:
+	case CVI_IVE_IOC_Bernsen:
+	case CVI_IVE_IOC_Filter:
+	case CVI_IVE_IOC_Sobel:
+	case CVI_IVE_IOC_MagAndAng:
+	case CVI_IVE_IOC_CSC:
+	case CVI_IVE_IOC_Hist:
+	case CVI_IVE_IOC_FilterAndCSC:
+	case CVI_IVE_IOC_Integ:
+	case CVI_IVE_IOC_LBP:
+	case CVI_IVE_IOC_Thresh_S16:
+	case CVI_IVE_IOC_Thresh_U16:
+	case CVI_IVE_IOC_16BitTo8Bit:
+	case CVI_IVE_IOC_OrdStatFilter:
+	case CVI_IVE_IOC_CannyHysEdge:
+	case CVI_IVE_IOC_NormGrad:
+	case CVI_IVE_IOC_GradFg:
+	case CVI_IVE_IOC_SAD:
+	case CVI_IVE_IOC_imgInToOdma:
+	case CVI_IVE_IOC_rgbPToYuvToErodeToDilate:
+	case CVI_IVE_IOC_MD:
+		return true;
+	default:
+		return false;
+	}
+}
+
+static long cvi_ive_job_run(struct cvi_ive_device *ndev, struct cvi_ive_job *job)
+{
+#ifdef DRV_TEST
+	if (ndev->test_run_op)
+		return ndev->test_run_op(ndev, job->cmd, job->kdata);
+#endif
+	return cvi_ive_run_op(ndev, job->cmd, job->kdata);
+}
+
+static void cvi_ive_job_work(struct work_struct *work)
+{
+	struct cvi_ive_device *ndev =
+		container_of(work, struct cvi_ive_device, job_work);
+	struct cvi_ive_file *file;
+	struct cvi_ive_job *job;
+
+	for (;;) {
+		spin_lock(&ndev->job_lock);
+		if (list_empty(&ndev->job_files)) {
+			spin_unlock(&ndev->job_lock);
+			break;
 		}
-		if (ret) {
-			dev_err(ndev->dev,
-				"[IVE] ioctl _IOC_NR(%d) fail\n", _IOC_NR(cmd));
+		// take one job of the first file, then put it at the tail.
+		file = list_first_entry(&ndev->job_files, struct cvi_ive_file, node);
+		job = list_first_entry(&file->pending, struct cvi_ive_job, node);
+		list_del(&job->node);
+		if (list_empty(&file->pending))
+			list_del_init(&file->node);
+		else
+			list_move_tail(&file->node, &ndev->job_files);
+		file->running = job;
+		spin_unlock(&ndev->job_lock);
+
+		/* without bInstant cvi_ive_go gives up after 1ms, but the job is
+		 * only done once the engine is, so wait for its frame-done.
+		 */
+		mutex_lock(&ndev->op_lock);
+		ndev->job_instant = true;
+		job->ret = cvi_ive_job_run(ndev, job);
+		ndev->job_instant = false;
+		mutex_unlock(&ndev->op_lock);
+
+		spin_lock(&ndev->job_lock);
+		list_add_tail(&job->node, &file->done);
+		file->running = NULL;
+		ndev->job_done_cnt++;
+		// under job_lock, close may free the file once it sees it idle.
+		wake_up(&file->wq);
+		spin_unlock(&ndev->job_lock);
+	}
+}
+
+/* cvi_ive_job_queue: queue a job on the file and kick the worker.
+ *
+ * @param file: the owner.
+ * @param job: the job, freed here on failure.
+ * @return: the job's handle, or -EAGAIN if the file holds too many jobs.
+ */
+long cvi_ive_job_queue(struct cvi_ive_file *file, struct cvi_ive_job *job)
+{
+	struct cvi_ive_device *ndev = file->ndev;
+	u32 handle;
+
+	spin_lock(&ndev->job_lock);
+	if (file->job_num >= IVE_JOB_MAX_PER_FILE) {
+		spin_unlock(&ndev->job_lock);
+		kfree(job);
+		return -EAGAIN;
+	}
+	if (++file->next_handle == 0)
+		++file->next_handle;
+	handle = job->handle = file->next_handle;
+	file->job_num++;
+	list_add_tail(&job->node, &file->pending);
+	if (list_empty(&file->node))
+		list_add_tail(&file->node, &ndev->job_files);
+	ndev->job_submit_cnt++;
+	spin_unlock(&ndev->job_lock);
+
+	queue_work(ndev->job_wq, &ndev->job_work);
+
+	return handle;
+}
+
+static long cvi_ive_job_submit(struct cvi_ive_file *file, unsigned long arg)
+{
+	struct cvi_ive_submit_arg submit;
+	struct cvi_ive_job *job;
+	long ret;
+
+	if (copy_from_user(&submit, (void __user *)arg, sizeof(submit)))
+		return -EFAULT;
+	if (!cvi_ive_job_async_capable(submit.cmd))
+		return -EINVAL;
+
+	job = kzalloc(sizeof(*job), GFP_KERNEL);
+	if (!job)
+		return -ENOMEM;
+	job->cmd = submit.cmd;
+	if (copy_from_user(job->kdata, (void __user *)(uintptr_t)submit.arg,
+			   IVE_KDATA_SIZE)) {
+		kfree(job);
+		return -EFAULT;
+	}
+
+	ret = cvi_ive_job_queue(file, job);
+	if (ret < 0)
+		return ret;
+
+	submit.handle = ret;
+	if (copy_to_user((void __user *)arg, &submit, sizeof(submit)))
+		return -EFAULT;
+	return 0;
+}
+
+/* _cvi_ive_job_find: look up a job of the file. job_lock must be held.
+ *
+ * @param file: the owner.
+ * @param handle: job handle, 0 for the oldest completed job.
+ * @param done: [out] if the job is completed.
+ */
+static struct cvi_ive_job *_cvi_ive_job_find(struct cvi_ive_file *file,
+					     u32 handle, bool *done)
+{
+	struct cvi_ive_job *job;
+
+	if (handle == 0) {
+		job = list_first_entry_or_null(&file->done, struct cvi_ive_job, node);
+		*done = !!job;
+		return job;
+	}
+
+	*done = true;
+	list_for_each_entry(job, &file->done, node)
+		if (job->handle == handle)
+			return job;
+
+	*done = false;
+	if (file->running && file->running->handle == handle)
+		return file->running;
+	list_for_each_entry(job, &file->pending, node)
+		if (job->handle == handle)
+			return job;
+	return NULL;
+}
+
+static bool cvi_ive_job_ready(struct cvi_ive_file *file, u32 handle)
+{
+	struct cvi_ive_job *job;
+	bool done;
+
+	spin_lock(&file->ndev->job_lock);
+	job = _cvi_ive_job_find(file, handle, &done);
+	spin_unlock(&file->ndev->job_lock);
+
+	// a bad handle is ready too, so the waiter gets -ENOENT.
+	return done || (!job && handle);
+}
+
+/* cvi_ive_job_reap: wait for a job of the file and free it.
+ *
+ * @param file: the owner.
+ * @param handle: [in/out] job handle, 0 for the oldest completed job.
+ * @param timeout_ms: <0 wait forever, 0 just check, >0 wait at most this long.
+ * @param result: [out] the operator's result.
+ */
+long cvi_ive_job_reap(struct cvi_ive_file *file, u32 *handle, int timeout_ms,
+		      int *result)
+{
+	struct cvi_ive_device *ndev = file->ndev;
+	struct cvi_ive_job *job;
+	bool done;
+	long ret;
+
+	if (timeout_ms < 0) {
+		ret = wait_event_interruptible(file->wq,
+			cvi_ive_job_ready(file, *handle));
+		if (ret)
 			return ret;
-		}
+	} else if (timeout_ms > 0) {
+		ret = wait_event_interruptible_timeout(file->wq,
+			cvi_ive_job_ready(file, *handle),
+			msecs_to_jiffies(timeout_ms));
+		if (ret < 0)
+			return ret;
+	}
+
+	spin_lock(&ndev->job_lock);
+	job = _cvi_ive_job_find(file, *handle, &done);
+	if (!job && *handle) {
+		spin_unlock(&ndev->job_lock);
+		return -ENOENT;
 	}
+	if (!job || !done) {
+		spin_unlock(&ndev->job_lock);
+		return timeout_ms ? -ETIMEDOUT : -EAGAIN;
+	}
+	list_del(&job->node);
+	file->job_num--;
+	spin_unlock(&ndev->job_lock);
+
+	*handle = job->handle;
+	*result = job->ret;
+	kfree(job);
+
+	return 0;
+}
+
+static long cvi_ive_job_wait(struct cvi_ive_file *file, unsigned long arg)
+{
+	struct cvi_ive_wait_arg wait;
+	long ret;
+
+	if (copy_from_user(&wait, (void __user *)arg, sizeof(wait)))
+		return -EFAULT;
+
+	ret = cvi_ive_job_reap(file, &wait.handle, wait.timeout_ms, &wait.result);
+	if (ret)
+		return ret;
+
+	if (copy_to_user((void __user *)arg, &wait, sizeof(wait)))
+		return -EFAULT;
+	return 0;
+}
+
+/* cvi_ive_job_cancel: cancel queued job(s) not yet on the engine.
+ *
+ * Cancelled jobs complete with -ECANCELED and are reaped by wait as usual.
+ * A job already running or completed can't be cancelled.
+ */
+long cvi_ive_job_cancel(struct cvi_ive_file *file, u32 handle)
+{
+	struct cvi_ive_device *ndev = file->ndev;
+	struct cvi_ive_job *job, *tmp;
+	bool done;
+	long ret = -ENOENT;
+
+	spin_lock(&ndev->job_lock);
+	list_for_each_entry_safe(job, tmp, &file->pending, node) {
+		if (handle && job->handle != handle)
+			continue;
+		job->ret = -ECANCELED;
+		list_move_tail(&job->node, &file->done);
+		ndev->job_cancel_cnt++;
+		ret = 0;
+	}
+	if (list_empty(&file->pending))
+		list_del_init(&file->node);
+	if (!handle)
+		ret = 0;
+	else if (ret && _cvi_ive_job_find(file, handle, &done))
+		ret = -EBUSY;
+	spin_unlock(&ndev->job_lock);
+
+	wake_up(&file->wq);
 	return ret;
 }
 
+static unsigned int cvi_ive_poll(struct file *filp, struct poll_table_struct *wait)
+{
+	struct cvi_ive_file *file = filp->private_data;
+	unsigned int mask = 0;
+
+	poll_wait(filp, &file->wq, wait);
+
+	spin_lock(&file->ndev->job_lock);
+	if (!list_empty(&file->done))
+		mask |= POLLIN | POLLRDNORM;
+	spin_unlock(&file->ndev->job_lock);
+
+	return mask;
+}
+
+static long cvi_ive_ioctl(struct file *filp, unsigned int cmd,
+			  unsigned long arg)
+{
+	struct cvi_ive_file *file = filp->private_data;
+	struct cvi_ive_device *ndev = file->ndev;
+	long ret = -1;
+
+	switch (cmd) {
+	case CVI_IVE_IOC_SUBMIT:
+		return cvi_ive_job_submit(file, arg);
+	case CVI_IVE_IOC_WAIT:
+		return cvi_ive_job_wait(file, arg);
+	case CVI_IVE_IOC_CANCEL: {
+		u32 handle;
+
+		if (copy_from_user(&handle, (void __user *)arg, sizeof(handle)))
+			return -EFAULT;
+		return cvi_ive_job_cancel(file, handle);
+	}
+	default:
+		break;
+	}
+
+	if (copy_from_user(file->kdata, (void __user *)arg, IVE_KDATA_SIZE) &&
+	    cmd != CVI_IVE_IOC_DUMP && cmd != CVI_IVE_IOC_CMDQ)
+		return ret;
+
+	// QUERY only waits for the engine, DUMP only reads registers.
+	if (cmd == CVI_IVE_IOC_QUERY || cmd == CVI_IVE_IOC_DUMP)
+		return cvi_ive_run_op(ndev, cmd, file->kdata);
+
+	mutex_lock(&ndev->op_lock);
+	ret = cvi_ive_run_op(ndev, cmd, file->kdata);
+	mutex_unlock(&ndev->op_lock);
+
+	return ret;
+}
+
+struct cvi_ive_file *cvi_ive_file_alloc(struct cvi_ive_device *ndev)
+{
+	struct cvi_ive_file *file;
+	unsigned long flags = 0;
+
+	file = kzalloc(sizeof(*file), GFP_KERNEL);
+	if (!file)
+		return NULL;
+	file->ndev = ndev;
+	INIT_LIST_HEAD(&file->node);
+	INIT_LIST_HEAD(&file->pending);
+	INIT_LIST_HEAD(&file->done);
+	init_waitqueue_head(&file->wq);
+
+	spin_lock_irqsave(&ndev->close_lock, flags);
+	ndev->use_count++;
+	spin_unlock_irqrestore(&ndev->close_lock, flags);
+	return file;
+}
+
 static int cvi_ive_open(struct inode *inode, struct file *filp)
 {
 	//struct cvi_ive_device *ndev =
 	//	container_of(filp->private_data, struct cvi_ive_device, miscdev);
 	struct cvi_ive_device *ndev =
 		container_of(inode->i_cdev, struct cvi_ive_device, cdev);
-	unsigned long flags = 0;
+	struct cvi_ive_file *file;
 
-	spin_lock_irqsave(&ndev->close_lock, flags);
-	ndev->use_count++;
-	spin_unlock_irqrestore(&ndev->close_lock, flags);
-	filp->private_data = ndev;
+	file = cvi_ive_file_alloc(ndev);
+	if (!file)
+		return -ENOMEM;
+	filp->private_data = file;
 	return 0;
 }
 
-static int cvi_ive_close(struct inode *inode, struct file *filp)
+static bool cvi_ive_file_idle(struct cvi_ive_file *file)
+{
+	bool idle;
+
+	spin_lock(&file->ndev->job_lock);
+	idle = !file->running;
+	spin_unlock(&file->ndev->job_lock);
+
+	return idle;
+}
+
+void cvi_ive_file_free(struct cvi_ive_file *file)
 {
-	struct cvi_ive_device *ndev = filp->private_data;
+	struct cvi_ive_device *ndev = file->ndev;
+	struct cvi_ive_job *job, *tmp;
 	unsigned long flags = 0;
 
+	// drop queued jobs, then let the one on the engine finish.
+	spin_lock(&ndev->job_lock);
+	list_del_init(&file->node);
+	list_splice_tail_init(&file->pending, &file->done);
+	spin_unlock(&ndev->job_lock);
+	wait_event(file->wq, cvi_ive_file_idle(file));
+
+	list_for_each_entry_safe(job, tmp, &file->done, node) {
+		list_del(&job->node);
+		kfree(job);
+	}
+
 	spin_lock_irqsave(&ndev->close_lock, flags);
 	ndev->use_count--;
 	spin_unlock_irqrestore(&ndev->close_lock, flags);
+	kfree(file);
+}
+
+static int cvi_ive_close(struct inode *inode, struct file *filp)
+{
+	cvi_ive_file_free(filp->private_data);
 	filp->private_data = NULL;
 
 	return 0;
@@ -883,7 +1327,13 @@ static int cvi_ive_probe(struct platform_device *pdev)
 	//	pr_err("[IVE] register misc error\n");
 	//	return ret;
 	//}
-	g_kdata = vmalloc(512);
+	mutex_init(&ndev->op_lock);
+	spin_lock_init(&ndev->job_lock);
+	INIT_LIST_HEAD(&ndev->job_files);
+	INIT_WORK(&ndev->job_work, cvi_ive_job_work);
+	ndev->job_wq = alloc_ordered_workqueue("cvi_ive_job", 0);
+	if (!ndev->job_wq)
+		return -ENOMEM;
 	g_time_infos = devm_kzalloc(&pdev->dev,
 				  MOD_ALL * sizeof(struct ive_profiling_info),
 				  GFP_KERNEL);
@@ -902,6 +1352,9 @@ static int cvi_ive_probe(struct platform_device *pdev)
 			     &ive_proc_ops, ndev) == NULL)
 		pr_err("[IVE] ive hw_profiling proc creation failed\n");
 	g_enable_usage_profiling = 0;
+#ifdef DRV_TEST
+	ive_test_proc_init(ndev);
+#endif
 
 	stcandicorner_workaround(ndev);
 	return 0;
@@ -924,10 +1377,13 @@ static int cvi_ive_remove(struct platform_device *pdev)
 
 	platform_set_drvdata(pdev, NULL);
 
-	vfree(g_kdata);
+	destroy_workqueue(ndev->job_wq);
 	// clk_disable_unprepare(ndev->clk);
 
 	// remove ive proc
+#ifdef DRV_TEST
+	ive_test_proc_deinit(ndev);
+#endif
 	proc_remove(ndev->proc_dir);
 	return 0;
 }
@@ -10,6 +10,10 @@
 
 #include <linux/cdev.h>
 #include <linux/completion.h>
+#include <linux/ktime.h>
+#include <linux/list.h>
+#include <linux/mutex.h>
+#include <linux/workqueue.h>
 #include <linux/version.h>
 
 #ifdef DEBUG
@@ -27,12 +31,69 @@ struct cvi_ive_device {
 	struct clk *clk;
 	spinlock_t close_lock;
 	struct completion frame_done;
+	ktime_t irq_time; /* last ive irq, ends a bInstant op's measured time */
 	struct completion op_done;
 	int cur_optype;
 	int tile_num;
 	int total_tile;
 	int use_count;
 	uintptr_t *private_data;
+	struct mutex op_lock; /* one operator on the engine at a time */
+	spinlock_t job_lock; /* job_files & every file's job lists */
+	struct list_head job_files; /* files with queued jobs, round robin */
+	struct workqueue_struct *job_wq;
+	struct work_struct job_work;
+	u32 job_submit_cnt;
+	u32 job_done_cnt;
+	u32 job_cancel_cnt;
+	bool job_instant; /* a queued job is on the engine, wait as if bInstant */
+#ifdef DRV_TEST
+	/* runs queued jobs instead of the engine if set, see ive_test.c */
+	long (*test_run_op)(struct cvi_ive_device *ndev, unsigned int cmd, char *kdata);
+	/* replaces reading the frame-done bits if set, see ive_test.c */
+	bool (*test_frame_done)(struct cvi_ive_device *ndev, int done_mask);
+#endif
+};
+
+#define IVE_KDATA_SIZE 512
+#define IVE_JOB_MAX_PER_FILE 32
+
+/**
+ * @node: in the owner's pending/done list.
+ * @handle: returned to user on submit.
+ * @cmd: the operator ioctl.
+ * @ret: result of the operator once done.
+ * @kdata: the operator's argument.
+ */
+struct cvi_ive_job {
+	struct list_head node;
+	u32 handle;
+	unsigned int cmd;
+	int ret;
+	char kdata[IVE_KDATA_SIZE];
+};
+
+/**
+ * @ndev: the ive device.
+ * @node: in ndev->job_files while @pending isn't empty.
+ * @pending: jobs not yet on the engine, in submit order.
+ * @done: completed jobs not yet reaped by wait.
+ * @running: job on the engine now, if any.
+ * @job_num: jobs owned, pending/running/done.
+ * @next_handle: last handle given out.
+ * @wq: woken up when a job of this file completes.
+ * @kdata: argument of synchronous ioctls.
+ */
+struct cvi_ive_file {
+	struct cvi_ive_device *ndev;
+	struct list_head node;
+	struct list_head pending;
+	struct list_head done;
+	struct cvi_ive_job *running;
+	u32 job_num;
+	u32 next_handle;
+	wait_queue_head_t wq;
+	char kdata[IVE_KDATA_SIZE];
 };
 
 struct ive_profiling_info {
@@ -52,8 +113,23 @@ struct ive_profiling_info {
 	uint32_t time_ioctl_diff_us;
 	uint32_t time_vld_diff_us[6];
 	uint32_t time_tile_diff_us;
+	uint32_t time_spin_us;
+	uint32_t time_sleep_us;
 };
 
 void start_vld_time(int optype);
 void stop_vld_time(int optype, int tile_num);
+void add_wait_time(int optype, uint32_t spin_us, uint32_t sleep_us);
+
+struct cvi_ive_file *cvi_ive_file_alloc(struct cvi_ive_device *ndev);
+void cvi_ive_file_free(struct cvi_ive_file *file);
+long cvi_ive_job_queue(struct cvi_ive_file *file, struct cvi_ive_job *job);
+long cvi_ive_job_reap(struct cvi_ive_file *file, u32 *handle, int timeout_ms,
+		      int *result);
+long cvi_ive_job_cancel(struct cvi_ive_file *file, u32 handle);
+
+#ifdef DRV_TEST
+int ive_test_proc_init(struct cvi_ive_device *ndev);
+void ive_test_proc_deinit(struct cvi_ive_device *ndev);
+#endif
 #endif /* __CVI_IVE_INTERFACE_H__ */
@@ -0,0 +1,404 @@
+#ifdef DRV_TEST
+#include <linux/types.h>
+#include <linux/string.h>
+#include <linux/delay.h>
+#include <linux/fs.h>
+#include <linux/hrtimer.h>
+#include <linux/completion.h>
+#include <linux/slab.h>
+#include <linux/cvi_ive_ioctl.h>
+#include <drv_test.h>
+
+#include "cvi_ive_interface.h"
+#include "cvi_ive_platform.h"
+
+/*
+ * The mock engine: every job sleeps ~1ms instead of touching registers and
+ * logs the tag the test put in kdata[0], so the run order can be checked.
+ * With the gate armed a job holds the engine until the gate is opened.
+ */
+static struct drv_test_log ive_test_log;
+static atomic_t ive_test_not_instant;
+static bool ive_test_gate_armed;
+static struct completion ive_test_gate;
+static struct hrtimer ive_test_gate_timer;
+
+static long ive_test_run_op(struct cvi_ive_device *ndev, unsigned int cmd, char *kdata)
+{
+	drv_test_log_add(&ive_test_log, kdata[0]);
+	// a queued job must wait for the engine, not give up after 1ms
+	if (!ndev->job_instant)
+		atomic_inc(&ive_test_not_instant);
+	if (READ_ONCE(ive_test_gate_armed))
+		wait_for_completion(&ive_test_gate);
+	usleep_range(1000, 1200);
+	return 0;
+}
+
+static enum hrtimer_restart ive_test_gate_open(struct hrtimer *timer)
+{
+	complete_all(&ive_test_gate);
+	return HRTIMER_NORESTART;
+}
+
+static long ive_test_submit(struct cvi_ive_file *file, char tag)
+{
+	struct cvi_ive_job *job;
+
+	job = kzalloc(sizeof(*job), GFP_KERNEL);
+	if (!job)
+		return -ENOMEM;
+	job->cmd = CVI_IVE_IOC_DMA;
+	job->kdata[0] = tag;
+
+	return cvi_ive_job_queue(file, job);
+}
+
+static void ive_test_reset_log(void)
+{
+	drv_test_log_reset(&ive_test_log);
+	atomic_set(&ive_test_not_instant, 0);
+}
+
+/* submit then reap each job by handle, results in submit order. */
+static int ive_test_basic(struct cvi_ive_device *ndev)
+{
+	struct cvi_ive_file *a = cvi_ive_file_alloc(ndev);
+	u32 handle[4], h;
+	int i, result, ret = 0;
+	long rc;
+
+	if (!a)
+		return -ENOMEM;
+
+	ive_test_reset_log();
+	for (i = 0; i < 4; ++i) {
+		rc = ive_test_submit(a, '0' + i);
+		if (rc < 0) {
+			pr_err("submit %d fail %ld\n", i, rc);
+			ret = -1;
+			goto out;
+		}
+		handle[i] = rc;
+	}
+	for (i = 0; i < 4; ++i) {
+		h = handle[i];
+		rc = cvi_ive_job_reap(a, &h, 1000, &result);
+		if (rc || result || h != handle[i]) {
+			pr_err("reap %d rc(%ld) result(%d) handle(%d)\n", i, rc, result, h);
+			ret = -1;
+		}
+	}
+	for (i = 0; i < 4; ++i)
+		if (ive_test_log.tag[i] != '0' + i)
+			ret = -1;
+	if (atomic_read(&ive_test_not_instant)) {
+		pr_err("%d jobs ran without waiting for the engine\n", atomic_read(&ive_test_not_instant));
+		ret = -1;
+	}
+
+	// nothing left, a bad handle is reported as such
+	h = 0;
+	if (cvi_ive_job_reap(a, &h, 0, &result) != -EAGAIN)
+		ret = -1;
+	h = 0x1234;
+	if (cvi_ive_job_reap(a, &h, 0, &result) != -ENOENT)
+		ret = -1;
+out:
+	cvi_ive_file_free(a);
+	pr_err("ive queue basic %s\n", ret ? "FAIL" : "PASS");
+	return ret;
+}
+
+/* a busy fd doesn't starve another one: fds take turns, one job each. */
+static int ive_test_round_robin(struct cvi_ive_device *ndev)
+{
+	struct cvi_ive_file *a = cvi_ive_file_alloc(ndev);
+	struct cvi_ive_file *b = cvi_ive_file_alloc(ndev);
+	int i, n, last_b = -1, result, ret = 0;
+	u32 h;
+
+	if (!a || !b) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	ive_test_reset_log();
+	// stall the worker so both fds are queued before the first run
+	mutex_lock(&ndev->op_lock);
+	for (i = 0; i < 8; ++i)
+		ive_test_submit(a, 'a');
+	for (i = 0; i < 2; ++i)
+		ive_test_submit(b, 'b');
+	mutex_unlock(&ndev->op_lock);
+
+	for (i = 0; i < 8; ++i) {
+		h = 0;
+		cvi_ive_job_reap(a, &h, 1000, &result);
+	}
+	for (i = 0; i < 2; ++i) {
+		h = 0;
+		cvi_ive_job_reap(b, &h, 1000, &result);
+	}
+
+	n = min(drv_test_log_num(&ive_test_log), DRV_TEST_LOG_MAX);
+	for (i = 0; i < n; ++i)
+		if (ive_test_log.tag[i] == 'b')
+			last_b = i;
+	pr_err("run order: %s\n", ive_test_log.tag);
+	// a's first job may already be on the worker, then b, a, b.
+	if (n != 10 || last_b < 0 || last_b > 4)
+		ret = -1;
+out:
+	if (a)
+		cvi_ive_file_free(a);
+	if (b)
+		cvi_ive_file_free(b);
+	pr_err("ive queue round robin %s\n", ret ? "FAIL" : "PASS");
+	return ret;
+}
+
+/* per-fd limit, cancel of queued jobs and close with jobs still queued. */
+static int ive_test_limit_cancel(struct cvi_ive_device *ndev)
+{
+	struct cvi_ive_file *a = cvi_ive_file_alloc(ndev);
+	u32 h, done_cnt;
+	int i, result, cancelled = 0, reaped = 0, ret = 0;
+	long rc;
+
+	if (!a)
+		return -ENOMEM;
+
+	mutex_lock(&ndev->op_lock);
+	for (i = 0; i < 32; ++i) {
+		rc = ive_test_submit(a, 'c');
+		if (rc < 0) {
+			pr_err("submit %d fail %ld\n", i, rc);
+			ret = -1;
+		}
+	}
+	if (ive_test_submit(a, 'c') != -EAGAIN) {
+		pr_err("33rd submit not refused\n");
+		ret = -1;
+	}
+	if (cvi_ive_job_cancel(a, 0))
+		ret = -1;
+	mutex_unlock(&ndev->op_lock);
+
+	for (;;) {
+		h = 0;
+		if (cvi_ive_job_reap(a, &h, 1000, &result))
+			break;
+		reaped++;
+		if (result == -ECANCELED)
+			cancelled++;
+	}
+	// at most the job the worker took before the cancel ran
+	pr_err("reaped %d cancelled %d\n", reaped, cancelled);
+	if (reaped != 32 || cancelled < 31)
+		ret = -1;
+
+	// close must drop queued jobs and only wait for the running one:
+	// the first job holds the engine until well after the close started
+	init_completion(&ive_test_gate);
+	hrtimer_init(&ive_test_gate_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	ive_test_gate_timer.function = ive_test_gate_open;
+	WRITE_ONCE(ive_test_gate_armed, true);
+	ive_test_reset_log();
+	done_cnt = ndev->job_done_cnt;
+	for (i = 0; i < 16; ++i)
+		ive_test_submit(a, 'd');
+	hrtimer_start(&ive_test_gate_timer, ms_to_ktime(10), HRTIMER_MODE_REL);
+	cvi_ive_file_free(a);
+	hrtimer_cancel(&ive_test_gate_timer);
+	WRITE_ONCE(ive_test_gate_armed, false);
+	complete_all(&ive_test_gate);
+	pr_err("close ran %d of 16\n", drv_test_log_num(&ive_test_log));
+	if (drv_test_log_num(&ive_test_log) > 1 || ndev->job_done_cnt - done_cnt > 1)
+		ret = -1;
+
+	pr_err("ive queue limit/cancel/close %s\n", ret ? "FAIL" : "PASS");
+	return ret;
+}
+
+/*
+ * The mock irq source: an hrtimer raises the frame-done bits and runs the
+ * ive irq handler after the op's simulated h/w time. With early_us set it
+ * runs the handler once before that without the bits, as the irq of an
+ * earlier dma of the op would.
+ */
+static struct hrtimer ive_test_irq_timer;
+static struct cvi_ive_device *ive_test_irq_ndev;
+static u32 ive_test_irq_early_us;
+static u32 ive_test_irq_hw_us;
+static atomic_t ive_test_hw_done;
+static atomic_t ive_test_poll_cnt;
+
+static enum hrtimer_restart ive_test_irq_fire(struct hrtimer *timer)
+{
+	u32 early_us = ive_test_irq_early_us;
+
+	if (early_us) {
+		ive_test_irq_early_us = 0;
+		platform_ive_irq(ive_test_irq_ndev);
+		hrtimer_forward_now(timer, ns_to_ktime((u64)(ive_test_irq_hw_us - early_us) *
+						       NSEC_PER_USEC));
+		return HRTIMER_RESTART;
+	}
+	atomic_set(&ive_test_hw_done, 1);
+	platform_ive_irq(ive_test_irq_ndev);
+	return HRTIMER_NORESTART;
+}
+
+static bool ive_test_frame_done(struct cvi_ive_device *ndev, int done_mask)
+{
+	atomic_inc(&ive_test_poll_cnt);
+	return atomic_read(&ive_test_hw_done);
+}
+
+/* run one bInstant wait against an op taking hw_us, expected to take avg_us.
+ * Returns the op's measured time in *avg_us.
+ */
+static int ive_test_wait_one(struct cvi_ive_device *ndev, u32 *avg_us, u32 hw_us,
+			     u32 early_us, u32 *spin_us, u32 *sleep_us)
+{
+	u32 first_us = early_us ? early_us : hw_us;
+	u32 preset = *avg_us;
+	int ret;
+
+	cvi_ive_test_swap_hw_avg(MOD_DMA, preset);
+	atomic_set(&ive_test_hw_done, 0);
+	atomic_set(&ive_test_poll_cnt, 0);
+	ive_test_irq_early_us = early_us;
+	ive_test_irq_hw_us = hw_us;
+	reinit_completion(&ndev->frame_done);
+	hrtimer_start(&ive_test_irq_timer, ns_to_ktime((u64)first_us * NSEC_PER_USEC), HRTIMER_MODE_REL);
+	ret = cvi_ive_wait_instant(ndev, 1, MOD_DMA, spin_us, sleep_us);
+	hrtimer_cancel(&ive_test_irq_timer);
+	*avg_us = cvi_ive_test_swap_hw_avg(MOD_DMA, 0);
+
+	pr_err("avg(%5d) hw(%5d) early(%4d): ret(%d) spin(%5d us) sleep(%5d us) polls(%d) measured(%5d us)\n",
+		preset, hw_us, early_us, ret, *spin_us, *sleep_us, atomic_read(&ive_test_poll_cnt),
+		*avg_us);
+	return ret;
+}
+
+/* bInstant waits never busy wait beyond ive_spin_budget_us. */
+static int ive_test_wait_instant(struct cvi_ive_device *ndev)
+{
+	// time to notice the bits, wake up & be scheduled on a loaded system
+	const u32 slack_us = 30;
+	u32 budget = ive_spin_budget_us;
+	u32 old_avg, avg, spin_us, sleep_us;
+	int ret = 0;
+
+	ive_test_irq_ndev = ndev;
+	hrtimer_init(&ive_test_irq_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	ive_test_irq_timer.function = ive_test_irq_fire;
+
+	// the mock replaces the hw, keep real ops off the engine meanwhile
+	mutex_lock(&ndev->op_lock);
+	ndev->test_frame_done = ive_test_frame_done;
+	old_avg = cvi_ive_test_swap_hw_avg(MOD_DMA, 0);
+
+	pr_err("spin budget %d us\n", budget);
+
+	// not measured yet: sleep right away
+	avg = 0;
+	if (ive_test_wait_one(ndev, &avg, 5000, 0, &spin_us, &sleep_us) || spin_us > slack_us || !sleep_us)
+		ret = -1;
+
+	// measured long: sleep right away
+	avg = 5000;
+	if (ive_test_wait_one(ndev, &avg, 5000, 0, &spin_us, &sleep_us) || spin_us > slack_us || !sleep_us)
+		ret = -1;
+
+	// measured short and is short: spin only, no sleep
+	avg = budget / 2;
+	if (budget > 2 * 10 &&
+	    (ive_test_wait_one(ndev, &avg, 10, 0, &spin_us, &sleep_us) || sleep_us))
+		ret = -1;
+
+	// measured short but runs long: spin the budget, then sleep
+	avg = budget / 2 ? budget / 2 : 1;
+	if (ive_test_wait_one(ndev, &avg, 5000, 0, &spin_us, &sleep_us) ||
+	    spin_us > budget + slack_us || !sleep_us)
+		ret = -1;
+
+	// an earlier dma's irq wakes it first: it sleeps again instead of
+	// polling, and the measured time ends at the last irq, not the wakeup
+	avg = 0;
+	if (ive_test_wait_one(ndev, &avg, 2000, 200, &spin_us, &sleep_us) ||
+	    spin_us > slack_us || atomic_read(&ive_test_poll_cnt) > 4 ||
+	    avg + slack_us < 2000 || avg > 2000 + slack_us)
+		ret = -1;
+
+	// irq never comes: fails after the timeout, still without spinning
+	avg = 5000;
+	if (!ive_test_wait_one(ndev, &avg, 500000, 0, &spin_us, &sleep_us) || spin_us > slack_us)
+		ret = -1;
+
+	cvi_ive_test_swap_hw_avg(MOD_DMA, old_avg);
+	ndev->test_frame_done = NULL;
+	reinit_completion(&ndev->frame_done);
+	mutex_unlock(&ndev->op_lock);
+
+	pr_err("ive wait instant %s\n", ret ? "FAIL" : "PASS");
+	return ret;
+}
+
+static void ive_test_usage(struct seq_file *m)
+{
+	seq_puts(m, "  1: job queue, submit/reap in order\n");
+	seq_puts(m, "  2: job queue, round robin between fds\n");
+	seq_puts(m, "  3: job queue, per-fd limit, cancel and close\n");
+	seq_puts(m, "  4: bInstant wait on a mocked irq, spin budget, early irq\n");
+}
+
+static void ive_test_run(void *data, uint32_t op)
+{
+	struct cvi_ive_device *ndev = data;
+
+	// queued jobs run on the mock engine, sync ioctls still use the hw
+	mutex_lock(&ndev->op_lock);
+	ndev->test_run_op = ive_test_run_op;
+	mutex_unlock(&ndev->op_lock);
+
+	switch (op) {
+	case 1:
+		ive_test_basic(ndev);
+		break;
+	case 2:
+		ive_test_round_robin(ndev);
+		break;
+	case 3:
+		ive_test_limit_cancel(ndev);
+		break;
+	case 4:
+		ive_test_wait_instant(ndev);
+		break;
+	default:
+		break;
+	}
+
+	mutex_lock(&ndev->op_lock);
+	ndev->test_run_op = NULL;
+	mutex_unlock(&ndev->op_lock);
+}
+
+DRV_TEST_PROC_DEFINE(ive_test);
+
+int ive_test_proc_init(struct cvi_ive_device *ndev)
+{
+	if (proc_create_data("ive_test", 0644, ndev->proc_dir, &ive_test_proc_ops, ndev) == NULL)
+		pr_err("ive_test_proc_init() failed\n");
+
+	return 0;
+}
+
+void ive_test_proc_deinit(struct cvi_ive_device *ndev)
+{
+	remove_proc_entry("ive_test", ndev->proc_dir);
+}
+
+#endif
@@ -13,6 +13,8 @@
 
 #include <linux/delay.h>
 #include <linux/interrupt.h>
+#include <linux/ktime.h>
+#include <linux/module.h>
 #include <linux/string.h>
 #include <linux/timer.h>
 #include <linux/uaccess.h>
@@ -27,6 +29,18 @@
 #endif
 #define IVE_TOP_16_8_8(val, a, b, c) ((val) | (a << 16) | (b << 8) | (c))
 #define TIMEOUT_MS (1)
+#define INSTANT_TIMEOUT_MS (100)
+
+/*
+ * bInstant ops used to busy poll for up to INSTANT_TIMEOUT_MS. Now they only
+ * spin if the op measured to finish within this budget, else sleep on irq.
+ */
+uint ive_spin_budget_us = 50;
+module_param(ive_spin_budget_us, uint, 0644);
+MODULE_PARM_DESC(ive_spin_budget_us, "max busy wait (us) before sleeping on ive irq");
+
+// Running average of each op's h/w time (us), 0 if not measured yet.
+static u32 g_hw_avg_us[MOD_ALL];
 
 char IMG_FMT[16][32] = {
 	"YUV420 planar",
@@ -1787,12 +1801,104 @@ CVI_S32 clearInterruptStatus(CVI_S32 status, CVI_BOOL enlog)
 	return status;
 }
 
+static inline bool _ive_frame_done(struct cvi_ive_device *ndev, CVI_S32 done_mask)
+{
+#ifdef DRV_TEST
+	if (ndev->test_frame_done)
+		return ndev->test_frame_done(ndev, done_mask);
+#endif
+	return readl(IVE_BLK_BA.IVE_TOP + IVE_TOP_REG_90) & done_mask;
+}
+
+#ifdef DRV_TEST
+/* cvi_ive_test_swap_hw_avg: set the op's measured h/w time, return the old one. */
+u32 cvi_ive_test_swap_hw_avg(CVI_S32 optype, u32 avg_us)
+{
+	u32 old = g_hw_avg_us[optype];
+
+	g_hw_avg_us[optype] = avg_us;
+	return old;
+}
+#endif
+
+/* cvi_ive_wait_instant: wait for a bInstant op to set its frame-done bits.
+ *
+ * Spin on the done bits only if the op is expected to finish within
+ * ive_spin_budget_us, else sleep on the irq. The irq may come from an
+ * earlier dma of the op, so a wakeup without the bits sleeps again.
+ *
+ * The op's measured time runs up to the irq that finished it, or up to the
+ * poll that saw the bits when spinning, so wakeup latency does not make
+ * short ops look long.
+ *
+ * @param ndev: the ive device.
+ * @param done_mask: frame-done bits of REG_90 to wait for.
+ * @param optype: the op, to look up/update its measured h/w time.
+ * @param spin_us: [out] time busy waiting on the cpu.
+ * @param sleep_us: [out] time sleeping on the irq.
+ */
+CVI_S32 cvi_ive_wait_instant(struct cvi_ive_device *ndev, CVI_S32 done_mask,
+			     CVI_S32 optype, u32 *spin_us, u32 *sleep_us)
+{
+	bool valid_op = (optype >= 0 && optype < MOD_ALL);
+	u32 expect_us = valid_op ? g_hw_avg_us[optype] : 0;
+	ktime_t start = ktime_get();
+	ktime_t deadline = ktime_add_ms(start, INSTANT_TIMEOUT_MS);
+	ktime_t t_sleep, t_done, t_irq;
+	s64 remain_us;
+	u32 total_us, hw_us;
+	bool done = false, slept = false;
+
+	*sleep_us = 0;
+
+	if (expect_us && expect_us <= ive_spin_budget_us) {
+		ktime_t spin_end = ktime_add_us(start, ive_spin_budget_us);
+
+		while (!(done = _ive_frame_done(ndev, done_mask)) &&
+		       ktime_before(ktime_get(), spin_end))
+			udelay(1);
+	}
+	t_done = ktime_get();
+
+	while (!done) {
+		// rearm before looking, an irq from here on wakes us up
+		reinit_completion(&ndev->frame_done);
+		done = _ive_frame_done(ndev, done_mask);
+		if (done)
+			break;
+		remain_us = ktime_us_delta(deadline, ktime_get());
+		if (remain_us <= 0)
+			break;
+		t_sleep = ktime_get();
+		wait_for_completion_timeout(&ndev->frame_done,
+			usecs_to_jiffies(remain_us));
+		*sleep_us += (u32)ktime_us_delta(ktime_get(), t_sleep);
+		slept = true;
+	}
+	reinit_completion(&ndev->frame_done);
+
+	total_us = (u32)ktime_us_delta(ktime_get(), start);
+	*spin_us = total_us - *sleep_us;
+	if (!done)
+		return CVI_FAILURE;
+
+	if (slept) {
+		t_irq = READ_ONCE(ndev->irq_time);
+		t_done = ktime_after(t_irq, start) ? t_irq : ktime_get();
+	}
+	hw_us = (u32)ktime_us_delta(t_done, start);
+	if (valid_op)
+		g_hw_avg_us[optype] = g_hw_avg_us[optype] ?
+			(g_hw_avg_us[optype] * 7 + hw_us) / 8 : hw_us;
+	return CVI_SUCCESS;
+}
+
 inline CVI_S32 cvi_ive_go(struct cvi_ive_device *ndev, IVE_TOP_C *ive_top_c,
 			  CVI_BOOL bInstant, CVI_S32 done_mask, CVI_S32 optype)
 {
-	CVI_S32 cnt = 0;
 	CVI_S32 ret = CVI_SUCCESS;
 	CVI_S32 int_mask = 0;
+	u32 spin_us, sleep_us;
 	IVE_FILTEROP_REG_h10_C REG_h10;
 	IVE_FILTEROP_REG_h14_C REG_h14;
 	IVE_FILTEROP_REG_28_C  REG_28;
@@ -1803,29 +1909,29 @@ inline CVI_S32 cvi_ive_go(struct cvi_ive_device *ndev, IVE_TOP_C *ive_top_c,
 
 	if (optype == MOD_HIST) {
 		int_mask = IVE_TOP_REG_INTR_STATUS_HIST_MASK;
-		ive_top_c->REG_94.reg_intr_en_hist = !bInstant;
+		ive_top_c->REG_94.reg_intr_en_hist = 1;
 	} else if (optype == MOD_NCC) {
 		int_mask = IVE_TOP_REG_INTR_STATUS_NCC_MASK;
-		ive_top_c->REG_94.reg_intr_en_ncc = !bInstant;
+		ive_top_c->REG_94.reg_intr_en_ncc = 1;
 	} else if (optype == MOD_INTEG) {
 		int_mask = IVE_TOP_REG_INTR_STATUS_INTG_MASK;
-		ive_top_c->REG_94.reg_intr_en_intg = !bInstant;
+		ive_top_c->REG_94.reg_intr_en_intg = 1;
 	} else if (optype == MOD_DMA) {
 		int_mask = IVE_TOP_REG_INTR_STATUS_DMAF_MASK;
-		ive_top_c->REG_94.reg_intr_en_dmaf = !bInstant;
+		ive_top_c->REG_94.reg_intr_en_dmaf = 1;
 	} else if (optype == MOD_GRADFG) {
 		int_mask = IVE_TOP_REG_INTR_STATUS_FILTEROP_WDMA_Y_MASK;
-		ive_top_c->REG_94.reg_intr_en_filterop_wdma_y = !bInstant;
+		ive_top_c->REG_94.reg_intr_en_filterop_wdma_y = 1;
 	} else if (optype == MOD_SAD) {
 		int_mask = IVE_TOP_REG_INTR_STATUS_SAD_MASK;
-		ive_top_c->REG_94.reg_intr_en_sad = !bInstant;
+		ive_top_c->REG_94.reg_intr_en_sad = 1;
 	} else {
 		int_mask = IVE_TOP_REG_INTR_STATUS_FILTEROP_ODMA_MASK |
 			   IVE_TOP_REG_INTR_STATUS_FILTEROP_WDMA_Y_MASK |
 			   IVE_TOP_REG_INTR_STATUS_FILTEROP_WDMA_C_MASK;
-		ive_top_c->REG_94.reg_intr_en_filterop_odma = !bInstant;
-		ive_top_c->REG_94.reg_intr_en_filterop_wdma_y = !bInstant;
-		ive_top_c->REG_94.reg_intr_en_filterop_wdma_c = !bInstant;
+		ive_top_c->REG_94.reg_intr_en_filterop_odma = 1;
+		ive_top_c->REG_94.reg_intr_en_filterop_wdma_y = 1;
+		ive_top_c->REG_94.reg_intr_en_filterop_wdma_c = 1;
 	}
 	writel(ive_top_c->REG_94.val, (IVE_BLK_BA.IVE_TOP + IVE_TOP_REG_94));
 
@@ -1851,18 +1957,12 @@ inline CVI_S32 cvi_ive_go(struct cvi_ive_device *ndev, IVE_TOP_C *ive_top_c,
 		ive_top_c->REG_1.reg_fmt_vld_fg = 1;
 	}
 
+	reinit_completion(&ndev->frame_done);
 	writel(ive_top_c->REG_1.val, (IVE_BLK_BA.IVE_TOP + IVE_TOP_REG_1));
 	start_vld_time(optype);
-	if (bInstant) {
-		while (!(readl(IVE_BLK_BA.IVE_TOP + IVE_TOP_REG_90) &
-			done_mask) && cnt < 10000) {
-			udelay(10);
-			cnt++;
-		}
-		stop_vld_time(optype, ndev->tile_num);
-		complete(&ndev->frame_done);
-		if (cnt >= 10000)
-			ret = CVI_FAILURE;
+	if (bInstant || ndev->job_instant) {
+		ret = cvi_ive_wait_instant(ndev, done_mask, optype, &spin_us, &sleep_us);
+		add_wait_time(optype, spin_us, sleep_us);
 	} else {
 		long leavetime = wait_for_completion_timeout(
 			&ndev->frame_done, msecs_to_jiffies(1 * TIMEOUT_MS));
@@ -9554,6 +9654,7 @@ void stcandicorner_workaround(struct cvi_ive_device *ndev)
 irqreturn_t platform_ive_irq(struct cvi_ive_device *ndev)
 {
 	//pr_err("[IVE] got %s callback\n", __func__);
+	WRITE_ONCE(ndev->irq_time, ktime_get());
 	complete(&ndev->frame_done);
 	stop_vld_time(ndev->cur_optype, ndev->tile_num);
 	return IRQ_HANDLED;
@@ -291,6 +291,12 @@ union cmdq_set {
 
 CVI_S32 cvi_ive_go(struct cvi_ive_device *ndev, IVE_TOP_C *ive_top_c,
 		   CVI_BOOL bInstant, int done_mask, int optype);
+extern uint ive_spin_budget_us;
+CVI_S32 cvi_ive_wait_instant(struct cvi_ive_device *ndev, CVI_S32 done_mask,
+			     CVI_S32 optype, u32 *spin_us, u32 *sleep_us);
+#ifdef DRV_TEST
+u32 cvi_ive_test_swap_hw_avg(CVI_S32 optype, u32 avg_us);
+#endif
 
 CVI_S32 assign_ive_block_addr(void __iomem *ive_phy_base);
 
@@ -212,6 +212,8 @@ static int rgn_proc_show(struct seq_file *m, void *v)
 		}
 	}
 
+	rgn_batch_proc_show(m);
+
 	return 0;
 }
 
@@ -16,5 +16,6 @@
 
 int rgn_proc_init(void);
 int rgn_proc_remove(void);
+void rgn_batch_proc_show(struct seq_file *m);
 
 #endif // _CVI_VIP_RGN_PROC_H_
@@ -6,10 +6,12 @@
 #include <linux/cvi_base_ctx.h>
 #include <linux/cvi_errno.h>
 #include <linux/delay.h>
+#include <linux/ktime.h>
 #include <linux/random.h>
 
 #include <rgn.h>
 #include "proc/rgn_proc.h"
+#include "rgn_test.h"
 #include <cif_cb.h>
 #include <vpss_cb.h>
 #include <vo_cb.h>
@@ -26,15 +28,55 @@ struct rgn_mem_info {
 	__u32 buf_len;
 };
 
+/* struct rgn_batch_entry: a display attr change deferred to rgn_batch_commit.
+ *
+ * @stChnAttr: attr to apply, swapped with the one in ctx while its hdls list is programmed.
+ */
+struct rgn_batch_entry {
+	RGN_HANDLE hdl;
+	RGN_CHN_ATTR_S stChnAttr;
+};
+
+/* struct rgn_chn_state: rgn state of one chn, hdls of the chn are only changed under @lock.
+ *
+ * @bBatch: set between rgn_batch_begin and rgn_batch_commit.
+ * @owner: file that began the batch, the batch is dropped when it is closed.
+ * @pending: rgns whose display attr changed in the batch, ctx keeps the attr in use till commit.
+ * @u32CommitCnt/@u32RgnCnt: hw updates done and the rgn changes they carried.
+ * @u64CommitNs/@u64CommitMaxNs: time spent in hw updates, mostly in vpss/vo callbacks.
+ * @u32LockCnt/@u64LockWaitNs/@u64LockWaitMaxNs: time waited for @lock.
+ */
+struct rgn_chn_state {
+	struct mutex lock;
+	CVI_BOOL bBatch;
+	struct file *owner;
+	CVI_U32 nr_pending;
+	struct rgn_batch_entry *pending;
+	CVI_U32 u32CommitCnt;
+	CVI_U32 u32RgnCnt;
+	CVI_U64 u64CommitNs;
+	CVI_U64 u64CommitMaxNs;
+	CVI_U32 u32LockCnt;
+	CVI_U64 u64LockWaitNs;
+	CVI_U64 u64LockWaitMaxNs;
+};
+
 /*******************************************************
  *  Global variables
  ******************************************************/
+static atomic_t	dev_open_cnt = ATOMIC_INIT(0);
+
+u32 rgn_log_lv = RGN_WARN;
+module_param(rgn_log_lv, int, 0644);
+
 //Keep every ctx include rgn_ctx and rgn_proc_ctx
 struct cvi_rgn_ctx rgn_prc_ctx[RGN_MAX_NUM];
 static struct rgn_mem_info s_astMosaicBuf[VPSS_MAX_GRP_NUM][VPSS_MAX_CHN_NUM];
 
 static CVI_U32 u32RgnNum;
-static struct mutex hdlslock, g_rgnlock, g_rgnhashlock;
+static struct mutex g_rgnlock, g_rgnhashlock;
+static struct rgn_chn_state vpss_chn_state[VPSS_MAX_GRP_NUM][VPSS_MAX_CHN_NUM];
+static struct rgn_chn_state vo_chn_state;
 
 DECLARE_HASHTABLE(rgn_hash, 6);
 
@@ -86,6 +128,55 @@ static CVI_S32 CHECK_RGN_HANDLE(struct cvi_rgn_ctx **ctx, RGN_HANDLE Handle)
 	return CVI_SUCCESS;
 }
 
+static struct rgn_chn_state *_rgn_get_chn_state(const MMF_CHN_S *pstChn)
+{
+	if (pstChn->enModId == CVI_ID_VO)
+		return &vo_chn_state;
+
+	if (pstChn->enModId == CVI_ID_VPSS
+		&& pstChn->s32DevId >= 0 && pstChn->s32DevId < VPSS_MAX_GRP_NUM
+		&& pstChn->s32ChnId >= 0 && pstChn->s32ChnId < VPSS_MAX_CHN_NUM)
+		return &vpss_chn_state[pstChn->s32DevId][pstChn->s32ChnId];
+
+	return NULL;
+}
+
+static void _rgn_chn_lock(struct rgn_chn_state *state)
+{
+	CVI_U64 t = ktime_get_ns();
+
+	mutex_lock(&state->lock);
+
+	t = ktime_get_ns() - t;
+	state->u32LockCnt++;
+	state->u64LockWaitNs += t;
+	if (t > state->u64LockWaitMaxNs)
+		state->u64LockWaitMaxNs = t;
+}
+
+static void _rgn_commit_stat(struct rgn_chn_state *state, CVI_U32 rgn_cnt, CVI_U64 t)
+{
+	state->u32CommitCnt++;
+	state->u32RgnCnt += rgn_cnt;
+	state->u64CommitNs += t;
+	if (t > state->u64CommitMaxNs)
+		state->u64CommitMaxNs = t;
+}
+
+static void _rgn_chn_state_init(struct rgn_chn_state *state)
+{
+	memset(state, 0, sizeof(*state));
+	mutex_init(&state->lock);
+}
+
+static void _rgn_chn_state_exit(struct rgn_chn_state *state)
+{
+	kfree(state->pending);
+	state->pending = NULL;
+	state->bBatch = CVI_FALSE;
+	mutex_destroy(&state->lock);
+}
+
 static int _rgn_call_cb(u32 m_id, u32 cmd_id, void *data)
 {
 	struct base_exe_m_cb exe_cb;
@@ -100,13 +191,18 @@ static int _rgn_call_cb(u32 m_id, u32 cmd_id, void *data)
 
 int32_t _rgn_init(void)
 {
+	int i, j;
+
 	// Only init once until exit.
 	// It is guarantueed in rgn_open
 
 	hash_init(rgn_hash);
 	memset(rgn_prc_ctx, 0, sizeof(rgn_prc_ctx));
 	u32RgnNum = 0;
-	mutex_init(&hdlslock);
+	for (i = 0; i < VPSS_MAX_GRP_NUM; ++i)
+		for (j = 0; j < VPSS_MAX_CHN_NUM; ++j)
+			_rgn_chn_state_init(&vpss_chn_state[i][j]);
+	_rgn_chn_state_init(&vo_chn_state);
 	mutex_init(&g_rgnlock);
 	mutex_init(&g_rgnhashlock);
 	CVI_TRACE_RGN(RGN_INFO, "-\n");
@@ -118,6 +214,7 @@ int32_t _rgn_exit(void)
 	unsigned int bkt;
 	struct cvi_rgn_ctx *obj;
 	struct hlist_node *tmp;
+	int i, j;
 
 	// Only exit once.
 	// It is guarantueed in rgn_release
@@ -128,7 +225,10 @@ int32_t _rgn_exit(void)
 	}
 	memset(rgn_prc_ctx, 0, sizeof(rgn_prc_ctx));
 	u32RgnNum = 0;
-	mutex_destroy(&hdlslock);
+	for (i = 0; i < VPSS_MAX_GRP_NUM; ++i)
+		for (j = 0; j < VPSS_MAX_CHN_NUM; ++j)
+			_rgn_chn_state_exit(&vpss_chn_state[i][j]);
+	_rgn_chn_state_exit(&vo_chn_state);
 	mutex_destroy(&g_rgnlock);
 	mutex_destroy(&g_rgnhashlock);
 
@@ -983,99 +1083,351 @@ static CVI_S32 _rgn_get_chn_info(struct cvi_rgn_ctx *ctx,
 	return CVI_SUCCESS;
 }
 
+/* _rgn_commit_hw_cfg: update cfg of the list @hdls belongs to.
+ *
+ * @ctx: any rgn in @hdls, gives the chn and the type.
+ * @hdls: rgn handles on chn.
+ * @size: size of gop acceptable.
+ */
+static CVI_S32 _rgn_commit_hw_cfg(struct cvi_rgn_ctx *ctx, RGN_HANDLE hdls[], CVI_U8 size)
+{
+	CVI_S32 ret;
+
+	if (ctx->stRegion.enType == OVERLAY_RGN || ctx->stRegion.enType == COVER_RGN) {
+		ret = _rgn_set_hw_cfg(hdls, size, &ctx->stChn, ctx->stRegion.enType,
+					ctx->stCanvasInfo[ctx->canvas_idx].bCompressed);
+		if (ret != CVI_SUCCESS)
+			CVI_TRACE_RGN(RGN_ERR, "_rgn_set_hw_cfg failed\n");
+	} else if (ctx->stRegion.enType == COVEREX_RGN) {
+		ret = _rgn_coverex_set_hw_cfg(hdls, size, &ctx->stChn, ctx->stRegion.enType);
+		if (ret != CVI_SUCCESS)
+			CVI_TRACE_RGN(RGN_ERR, "_rgn_coverex_set_hw_cfg failed\n");
+	} else if (ctx->stRegion.enType == OVERLAYEX_RGN) {
+		ret = _rgn_ex_set_hw_cfg(hdls, size, &ctx->stChn, ctx->stRegion.enType);
+		if (ret != CVI_SUCCESS)
+			CVI_TRACE_RGN(RGN_ERR, "_rgn_ex_set_hw_cfg failed\n");
+	} else if (ctx->stRegion.enType == MOSAIC_RGN) {
+		ret = _rgn_mosaic_set_hw_cfg(hdls, size, &ctx->stChn, ctx->stRegion.enType);
+		if (ret != CVI_SUCCESS)
+			CVI_TRACE_RGN(RGN_ERR, "_rgn_mosaic_set_hw_cfg failed\n");
+	} else {
+		ret = CVI_ERR_RGN_NOT_SUPPORT;
+	}
+
+	#if 0
+	sys_cache_flush(ctx->stCanvasInfo[ctx->canvas_idx].u64PhyAddr,
+		ctx->stCanvasInfo[ctx->canvas_idx].pu8VirtAddr, ctx->ion_len);
+	#endif
+
+	return ret;
+}
+
+/* _rgn_batch_drop: forget the deferred update of @hdl, called with @state->lock held. */
+static void _rgn_batch_drop(struct rgn_chn_state *state, RGN_HANDLE hdl)
+{
+	CVI_U32 i;
+
+	if (!state->bBatch)
+		return;
+
+	for (i = 0; i < state->nr_pending; ++i) {
+		if (state->pending[i].hdl != hdl)
+			continue;
+		state->pending[i] = state->pending[--state->nr_pending];
+		break;
+	}
+}
+
 static CVI_S32 _rgn_update_hw(struct cvi_rgn_ctx *ctx, enum RGN_OP op)
 {
+	struct rgn_chn_state *state;
 	CVI_U8 size;
 	CVI_S32 ret;
+	CVI_U64 t;
 	RGN_HANDLE hdls[RGN_EX_MAX_NUM_VPSS];
 
-	mutex_lock(&hdlslock);
+	state = _rgn_get_chn_state(&ctx->stChn);
+	if (!state)
+		return CVI_ERR_RGN_INVALID_DEVID;
+
+	_rgn_chn_lock(state);
+	// a detached rgn must not be moved by a commit
+	if (op == RGN_OP_REMOVE)
+		_rgn_batch_drop(state, ctx->Handle);
+
+	t = ktime_get_ns();
 	ret = _rgn_get_chn_info(ctx, hdls, &size);
-	if (ret != CVI_SUCCESS) {
-		mutex_unlock(&hdlslock);
-		return ret;
-	}
+	if (ret != CVI_SUCCESS)
+		goto out;
 
 	if (op == RGN_OP_INSERT) {
-		if (ctx->stRegion.enType == OVERLAY_RGN || ctx->stRegion.enType == COVER_RGN) {
+		if (ctx->stRegion.enType == OVERLAY_RGN || ctx->stRegion.enType == COVER_RGN)
 			ret = _rgn_insert(hdls, size, ctx->Handle);
-			if (ret != CVI_SUCCESS) {
-				mutex_unlock(&hdlslock);
-				return ret;
-			}
-		} else {
+		else
 			ret = _rgn_ex_insert(hdls, size, ctx->Handle);
-			if (ret != CVI_SUCCESS) {
-				mutex_unlock(&hdlslock);
-				return ret;
-			}
-		}
+		if (ret != CVI_SUCCESS)
+			goto out;
 	} else if (op == RGN_OP_REMOVE) {
 		ret = _rgn_remove(hdls, size, ctx->Handle);
 		if (ret != CVI_SUCCESS) {
-			mutex_unlock(&hdlslock);
 			CVI_TRACE_RGN(RGN_ERR, "RGN_HANDLE(%d) not at CHN(%s-%d-%d).\n", ctx->Handle
 			, sys_get_modname(ctx->stChn.enModId), ctx->stChn.s32DevId, ctx->stChn.s32ChnId);
-			return ret;
+			goto out;
 		}
 	} else if (op == RGN_OP_UPDATE) {
 		_rgn_remove(hdls, size, ctx->Handle);
-		if (ctx->stRegion.enType == OVERLAY_RGN || ctx->stRegion.enType == COVER_RGN) {
+		if (ctx->stRegion.enType == OVERLAY_RGN || ctx->stRegion.enType == COVER_RGN)
 			ret = _rgn_insert(hdls, size, ctx->Handle);
-			if (ret != CVI_SUCCESS) {
-				mutex_unlock(&hdlslock);
-				return ret;
-			}
-		} else {
+		else
 			ret = _rgn_ex_insert(hdls, size, ctx->Handle);
-			if (ret != CVI_SUCCESS) {
-				mutex_unlock(&hdlslock);
-				return ret;
+		if (ret != CVI_SUCCESS)
+			goto out;
+	}
+
+	ret = _rgn_commit_hw_cfg(ctx, hdls, size);
+	if (ret == CVI_SUCCESS)
+		_rgn_commit_stat(state, 1, ktime_get_ns() - t);
+out:
+	mutex_unlock(&state->lock);
+
+	return ret;
+}
+
+struct rgn_sort_key {
+	RGN_HANDLE hdl;
+	RECT_S rect;
+	CVI_U32 layer;
+};
+
+static CVI_S32 _rgn_get_sort_key(RGN_HANDLE hdl, struct rgn_sort_key *key)
+{
+	struct cvi_rgn_ctx *ctx = NULL;
+	CVI_S32 s32Ret;
+
+	s32Ret = CHECK_RGN_HANDLE(&ctx, hdl);
+	if (s32Ret != CVI_SUCCESS)
+		return s32Ret;
+
+	key->hdl = hdl;
+	if (_rgn_get_rect(ctx, &key->rect) != CVI_SUCCESS
+		|| _rgn_get_layer(ctx, &key->layer) != CVI_SUCCESS) {
+		CVI_TRACE_RGN(RGN_ERR, "RGN_HANDLE(%d) can't get rect/layer.\n", hdl);
+		return CVI_FAILURE;
+	}
+
+	return CVI_SUCCESS;
+}
+
+/* _rgn_key_before: check if @k1 should be placed before @k0, same order as _rgn_insert/_rgn_ex_insert. */
+static CVI_BOOL _rgn_key_before(struct rgn_sort_key *k0, struct rgn_sort_key *k1, CVI_BOOL by_rect)
+{
+	return by_rect ? _rgn_check_order(&k0->rect, &k1->rect) : (k1->layer < k0->layer);
+}
+
+/* _rgn_merge: put @upd back into the sorted @hdls in one pass.
+ *
+ * @hdls: rgn handles on chn, none of @upd in it.
+ * @size: size of gop acceptable.
+ * @upd: rgn handles to place.
+ * @n: number of @upd.
+ * @by_rect: sort by position and reject overlap as overlay/cover; o/w sort by layer.
+ * @bCmpr: the list is the odec layer, which takes only one ow.
+ */
+static CVI_S32 _rgn_merge(RGN_HANDLE hdls[], CVI_U8 size, const RGN_HANDLE upd[], CVI_U8 n,
+			CVI_BOOL by_rect, CVI_BOOL bCmpr)
+{
+	struct rgn_sort_key old_key[RGN_EX_MAX_NUM_VPSS], upd_key[RGN_EX_MAX_NUM_VPSS], tmp;
+	CVI_U8 m, i, j, k;
+	CVI_S32 s32Ret;
+
+	m = 0;
+	while (m < size && hdls[m] != RGN_INVALID_HANDLE)
+		++m;
+
+	if (m + n > size || (bCmpr && m + n > 1)) {
+		CVI_TRACE_RGN(RGN_ERR, "rgn's count is full, %d attached, %d to place.\n", m, n);
+		return CVI_FAILURE;
+	}
+
+	for (i = 0; i < m; ++i) {
+		s32Ret = _rgn_get_sort_key(hdls[i], &old_key[i]);
+		if (s32Ret != CVI_SUCCESS)
+			return s32Ret;
+	}
+
+	// insertion sort, n is no more than a gop
+	for (i = 0; i < n; ++i) {
+		s32Ret = _rgn_get_sort_key(upd[i], &tmp);
+		if (s32Ret != CVI_SUCCESS)
+			return s32Ret;
+
+		for (j = i; j > 0 && _rgn_key_before(&upd_key[j - 1], &tmp, by_rect); --j)
+			upd_key[j] = upd_key[j - 1];
+		upd_key[j] = tmp;
+	}
+
+	if (by_rect) {
+		for (i = 0; i < n; ++i) {
+			for (j = 0; j < m + n; ++j) {
+				struct rgn_sort_key *o = (j < m) ? &old_key[j] : &upd_key[j - m];
+
+				if (o == &upd_key[i] || !is_rect_overlap(&o->rect, &upd_key[i].rect))
+					continue;
+				CVI_TRACE_RGN(RGN_ERR, "RGN_HANDLE(%d) is overlapped on another RGN_HANDLE(%d).\n"
+					, upd_key[i].hdl, o->hdl);
+				return CVI_ERR_RGN_NOT_PERM;
 			}
 		}
 	}
 
-	if (ctx->stRegion.enType == OVERLAY_RGN || ctx->stRegion.enType == COVER_RGN) {
-		ret = _rgn_set_hw_cfg(hdls, size, &ctx->stChn, ctx->stRegion.enType,
-					ctx->stCanvasInfo[ctx->canvas_idx].bCompressed);
-		if (ret != CVI_SUCCESS) {
-			CVI_TRACE_RGN(RGN_ERR, "_rgn_set_hw_cfg failed\n");
-			mutex_unlock(&hdlslock);
-			return ret;
-		}
-	} else if (ctx->stRegion.enType == COVEREX_RGN) {
-		ret = _rgn_coverex_set_hw_cfg(hdls, size, &ctx->stChn, ctx->stRegion.enType);
-		if (ret != CVI_SUCCESS) {
-			CVI_TRACE_RGN(RGN_ERR, "_rgn_coverex_set_hw_cfg failed\n");
-			mutex_unlock(&hdlslock);
-			return ret;
+	for (i = 0, j = 0, k = 0; k < m + n; ++k) {
+		if (j < n && (i == m || _rgn_key_before(&old_key[i], &upd_key[j], by_rect)))
+			hdls[k] = upd_key[j++].hdl;
+		else
+			hdls[k] = old_key[i++].hdl;
+	}
+	for (; k < size; ++k)
+		hdls[k] = RGN_INVALID_HANDLE;
+
+	return CVI_SUCCESS;
+}
+
+/* _rgn_batch_defer: record a display attr change of @ctx if its chn is in a batch.
+ *
+ * @ctx: rgn to update, left untouched if deferred.
+ * @pstChnAttr: attr to apply at commit.
+ * @return: CVI_TRUE if the update is left to rgn_batch_commit.
+ */
+static CVI_BOOL _rgn_batch_defer(struct cvi_rgn_ctx *ctx, const RGN_CHN_ATTR_S *pstChnAttr)
+{
+	struct rgn_chn_state *state = _rgn_get_chn_state(&ctx->stChn);
+	CVI_BOOL bDefer = CVI_FALSE;
+	CVI_U32 i;
+
+	if (!state)
+		return CVI_FALSE;
+
+	_rgn_chn_lock(state);
+	if (state->bBatch) {
+		for (i = 0; i < state->nr_pending; ++i)
+			if (state->pending[i].hdl == ctx->Handle)
+				break;
+
+		// the last update of a rgn in the batch wins
+		if (i == state->nr_pending && i < RGN_MAX_NUM) {
+			state->pending[i].hdl = ctx->Handle;
+			state->nr_pending++;
 		}
-	} else if (ctx->stRegion.enType == OVERLAYEX_RGN) {
-		ret = _rgn_ex_set_hw_cfg(hdls, size, &ctx->stChn, ctx->stRegion.enType);
-		if (ret != CVI_SUCCESS) {
-			CVI_TRACE_RGN(RGN_ERR, "_rgn_ex_set_hw_cfg failed\n");
-			mutex_unlock(&hdlslock);
-			return ret;
+		if (i < state->nr_pending) {
+			state->pending[i].stChnAttr = *pstChnAttr;
+			bDefer = CVI_TRUE;
 		}
-	} else if (ctx->stRegion.enType == MOSAIC_RGN) {
-		ret = _rgn_mosaic_set_hw_cfg(hdls, size, &ctx->stChn, ctx->stRegion.enType);
-		if (ret != CVI_SUCCESS) {
-			CVI_TRACE_RGN(RGN_ERR, "_rgn_mosaic_set_hw_cfg failed\n");
-			mutex_unlock(&hdlslock);
-			return ret;
+	}
+	mutex_unlock(&state->lock);
+
+	return bDefer;
+}
+
+/* _rgn_batch_list_id: rgns of the same id share one hdls list on a chn. */
+static CVI_U32 _rgn_batch_list_id(struct cvi_rgn_ctx *ctx)
+{
+	if (ctx->stRegion.enType == OVERLAY_RGN || ctx->stRegion.enType == COVER_RGN)
+		return ctx->stCanvasInfo[ctx->canvas_idx].bCompressed ? 1 : 0;
+
+	return 2 + ctx->stRegion.enType;
+}
+
+/* _rgn_batch_swap: exchange the deferred attr with the one in ctx, a second call undoes the first. */
+static void _rgn_batch_swap(struct cvi_rgn_ctx *ctx, struct rgn_batch_entry *entry)
+{
+	RGN_CHN_ATTR_S stChnAttr = ctx->stChnAttr;
+	CVI_U32 proc_idx = _rgn_proc_get_idx(ctx->Handle);
+
+	ctx->stChnAttr = rgn_prc_ctx[proc_idx].stChnAttr = entry->stChnAttr;
+	entry->stChnAttr = stChnAttr;
+}
+
+/* _rgn_batch_fit_cover: fit the canvas of a cover to the attr in use.
+ *
+ * @pstPrevAttr: attr the canvas was fitted to, the canvas is refilled if the color differs.
+ */
+static CVI_S32 _rgn_batch_fit_cover(struct cvi_rgn_ctx *ctx, const RGN_CHN_ATTR_S *pstPrevAttr)
+{
+	RGN_CHN_ATTR_S stChnAttr = ctx->stChnAttr;
+	CVI_S32 ret;
+
+	if (stChnAttr.enType != COVER_RGN)
+		return CVI_SUCCESS;
+
+	// _rgn_update_cover_canvas compares the color with the one in ctx
+	ctx->stChnAttr = *pstPrevAttr;
+	ret = _rgn_update_cover_canvas(ctx, &stChnAttr);
+	ctx->stChnAttr = stChnAttr;
+
+	return ret;
+}
+
+/* _rgn_batch_apply: apply the deferred attrs of rgns sharing one hdls list.
+ *
+ * @objs: the rgns, all on the chn of @state.
+ * @idx: index of each rgn in @state->pending.
+ * @n: number of @objs.
+ * @return: on failure the attrs, the cover canvases and the hw cfg are put back as before.
+ */
+static CVI_S32 _rgn_batch_apply(struct rgn_chn_state *state, struct cvi_rgn_ctx *objs[],
+			const CVI_U32 idx[], CVI_U8 n)
+{
+	struct cvi_rgn_ctx *ctx = objs[0];
+	RGN_HANDLE hdls[RGN_EX_MAX_NUM_VPSS], old_hdls[RGN_EX_MAX_NUM_VPSS], upd[RGN_EX_MAX_NUM_VPSS];
+	CVI_BOOL bHwDirty = CVI_FALSE;
+	CVI_U8 size, k, filled;
+	CVI_S32 s32Ret;
+
+	s32Ret = _rgn_get_chn_info(ctx, hdls, &size);
+	if (s32Ret != CVI_SUCCESS)
+		return s32Ret;
+	memcpy(old_hdls, hdls, sizeof(hdls));
+
+	// the canvas, the merge and the hw cfg all read the attrs from ctx
+	for (k = 0; k < n; ++k) {
+		_rgn_batch_swap(objs[k], &state->pending[idx[k]]);
+		upd[k] = objs[k]->Handle;
+	}
+
+	for (filled = 0; filled < n; ++filled) {
+		s32Ret = _rgn_batch_fit_cover(objs[filled], &state->pending[idx[filled]].stChnAttr);
+		if (s32Ret != CVI_SUCCESS) {
+			CVI_TRACE_RGN(RGN_ERR, "RGN_HANDLE(%d) fill cover failed.\n", objs[filled]->Handle);
+			goto rollback;
 		}
-	} else {
-		mutex_unlock(&hdlslock);
-		return CVI_ERR_RGN_NOT_SUPPORT;
 	}
 
-	#if 0
-	sys_cache_flush(ctx->stCanvasInfo[ctx->canvas_idx].u64PhyAddr,
-		ctx->stCanvasInfo[ctx->canvas_idx].pu8VirtAddr, ctx->ion_len);
-	#endif
-	mutex_unlock(&hdlslock);
+	for (k = 0; k < n; ++k)
+		_rgn_remove(hdls, size, upd[k]);
+	s32Ret = _rgn_merge(hdls, size, upd, n,
+		(ctx->stRegion.enType == OVERLAY_RGN || ctx->stRegion.enType == COVER_RGN),
+		ctx->stCanvasInfo[ctx->canvas_idx].bCompressed);
+	if (s32Ret != CVI_SUCCESS)
+		goto rollback;
+
+	s32Ret = _rgn_commit_hw_cfg(ctx, hdls, size);
+	if (s32Ret != CVI_SUCCESS) {
+		bHwDirty = CVI_TRUE;
+		goto rollback;
+	}
 
 	return CVI_SUCCESS;
+
+rollback:
+	for (k = 0; k < n; ++k)
+		_rgn_batch_swap(objs[k], &state->pending[idx[k]]);
+	for (k = 0; k < filled; ++k)
+		_rgn_batch_fit_cover(objs[k], &state->pending[idx[k]].stChnAttr);
+	// vpss/vo may have taken part of the new cfg
+	if (bHwDirty)
+		_rgn_commit_hw_cfg(ctx, old_hdls, size);
+
+	return s32Ret;
 }
 
 CVI_S32 _rgn_check_chn_attr(RGN_HANDLE Handle, const MMF_CHN_S *pstChn, const RGN_CHN_ATTR_S *pstChnAttr)
@@ -1755,6 +2107,9 @@ CVI_S32 rgn_set_display_attr(RGN_HANDLE Handle, const MMF_CHN_S *pstChn, const R
 	if (_rgn_check_chn_attr(Handle, pstChn, pstChnAttr) != CVI_SUCCESS)
 		return CVI_ERR_RGN_ILLEGAL_PARAM;
 
+	if (_rgn_batch_defer(ctx, pstChnAttr))
+		return CVI_SUCCESS;
+
 	if (ctx->stChnAttr.enType == COVER_RGN) {
 		ret = _rgn_update_cover_canvas(ctx, pstChnAttr);
 
@@ -1775,6 +2130,170 @@ CVI_S32 rgn_set_display_attr(RGN_HANDLE Handle, const MMF_CHN_S *pstChn, const R
 	return ret;
 }
 
+/* rgn_batch_begin: defer the display attr updates of rgns on @pstChn until rgn_batch_commit.
+ *
+ * Attach/detach still take effect at once, and detach drops the deferred update of the rgn.
+ * Until commit, rgn_get_display_attr and the hw updates of other rgns see the attrs in use.
+ *
+ * @owner: file the batch belongs to, only it can commit.
+ */
+CVI_S32 rgn_batch_begin(const MMF_CHN_S *pstChn, struct file *owner)
+{
+	struct rgn_chn_state *state = _rgn_get_chn_state(pstChn);
+	CVI_S32 ret = CVI_SUCCESS;
+
+	if (!state) {
+		CVI_TRACE_RGN(RGN_ERR, "Unsupported chn(%s-%d-%d)\n",
+			sys_get_modname(pstChn->enModId), pstChn->s32DevId, pstChn->s32ChnId);
+		return CVI_ERR_RGN_INVALID_CHNID;
+	}
+
+	_rgn_chn_lock(state);
+	if (state->bBatch) {
+		CVI_TRACE_RGN(RGN_ERR, "chn(%s-%d-%d) batch already begun.\n",
+			sys_get_modname(pstChn->enModId), pstChn->s32DevId, pstChn->s32ChnId);
+		ret = CVI_ERR_RGN_BUSY;
+		goto out;
+	}
+
+	if (!state->pending) {
+		state->pending = kcalloc(RGN_MAX_NUM, sizeof(*state->pending), GFP_KERNEL);
+		if (!state->pending) {
+			ret = CVI_ERR_RGN_NOMEM;
+			goto out;
+		}
+	}
+	state->nr_pending = 0;
+	state->owner = owner;
+	state->bBatch = CVI_TRUE;
+out:
+	mutex_unlock(&state->lock);
+
+	return ret;
+}
+
+/* rgn_batch_commit: apply the updates deferred since rgn_batch_begin.
+ *
+ * Each hdls list of the chn is merged and programmed once. If a list fails, its
+ * rgns keep the attrs and cover canvases they had before the batch and the first
+ * error is returned.
+ */
+CVI_S32 rgn_batch_commit(const MMF_CHN_S *pstChn, struct file *owner)
+{
+	struct rgn_chn_state *state = _rgn_get_chn_state(pstChn);
+	struct cvi_rgn_ctx *ctx = NULL, *obj = NULL, *objs[RGN_EX_MAX_NUM_VPSS];
+	CVI_BOOL done[RGN_MAX_NUM] = {0};
+	CVI_U32 i, j, list_id, idx[RGN_EX_MAX_NUM_VPSS];
+	CVI_U8 n;
+	CVI_S32 ret = CVI_SUCCESS, s32Ret;
+	CVI_U64 t;
+
+	if (!state)
+		return CVI_ERR_RGN_INVALID_CHNID;
+
+	_rgn_chn_lock(state);
+	if (!state->bBatch) {
+		CVI_TRACE_RGN(RGN_ERR, "chn(%s-%d-%d) batch not begun.\n",
+			sys_get_modname(pstChn->enModId), pstChn->s32DevId, pstChn->s32ChnId);
+		mutex_unlock(&state->lock);
+		return CVI_ERR_RGN_NOT_CONFIG;
+	}
+	if (state->owner != owner) {
+		CVI_TRACE_RGN(RGN_ERR, "chn(%s-%d-%d) batch begun by another file.\n",
+			sys_get_modname(pstChn->enModId), pstChn->s32DevId, pstChn->s32ChnId);
+		mutex_unlock(&state->lock);
+		return CVI_ERR_RGN_NOT_PERM;
+	}
+	state->bBatch = CVI_FALSE;
+	state->owner = NULL;
+
+	t = ktime_get_ns();
+	for (i = 0; i < state->nr_pending; ++i) {
+		if (done[i])
+			continue;
+		done[i] = CVI_TRUE;
+
+		// detached or destroyed within the batch
+		if (CHECK_RGN_HANDLE(&ctx, state->pending[i].hdl) != CVI_SUCCESS
+			|| _rgn_get_chn_state(&ctx->stChn) != state)
+			continue;
+
+		// gather the other rgns sharing the hdls list
+		list_id = _rgn_batch_list_id(ctx);
+		objs[0] = ctx;
+		idx[0] = i;
+		for (n = 1, j = i + 1; j < state->nr_pending && n < RGN_EX_MAX_NUM_VPSS; ++j) {
+			if (done[j] || CHECK_RGN_HANDLE(&obj, state->pending[j].hdl) != CVI_SUCCESS
+				|| _rgn_get_chn_state(&obj->stChn) != state || _rgn_batch_list_id(obj) != list_id)
+				continue;
+			done[j] = CVI_TRUE;
+			objs[n] = obj;
+			idx[n++] = j;
+		}
+
+		s32Ret = _rgn_batch_apply(state, objs, idx, n);
+		if (s32Ret != CVI_SUCCESS) {
+			if (ret == CVI_SUCCESS)
+				ret = s32Ret;
+			continue;
+		}
+		_rgn_commit_stat(state, n, ktime_get_ns() - t);
+		t = ktime_get_ns();
+	}
+	state->nr_pending = 0;
+	mutex_unlock(&state->lock);
+
+	return ret;
+}
+
+/* rgn_batch_release: drop the batches @owner left open, their rgns keep the attrs in use. */
+void rgn_batch_release(struct file *owner)
+{
+	struct rgn_chn_state *state;
+	CVI_U32 i;
+
+	for (i = 0; i <= VPSS_MAX_GRP_NUM * VPSS_MAX_CHN_NUM; ++i) {
+		state = (i < VPSS_MAX_GRP_NUM * VPSS_MAX_CHN_NUM)
+		      ? &vpss_chn_state[i / VPSS_MAX_CHN_NUM][i % VPSS_MAX_CHN_NUM] : &vo_chn_state;
+
+		mutex_lock(&state->lock);
+		if (state->bBatch && state->owner == owner) {
+			state->bBatch = CVI_FALSE;
+			state->owner = NULL;
+			state->nr_pending = 0;
+		}
+		mutex_unlock(&state->lock);
+	}
+}
+
+void rgn_batch_proc_show(struct seq_file *m)
+{
+	struct rgn_chn_state *state;
+	CVI_U32 i;
+
+	seq_puts(m, "\n------REGION CHN COMMIT STATUS--------------------------------------------\n");
+	seq_printf(m, "%10s%10s%10s%10s%10s%12s%12s%12s%12s\n",
+		"Mod", "Dev", "Chn", "Commit", "Rgn", "AvgNs", "MaxNs", "WaitAvgNs", "WaitMaxNs");
+
+	for (i = 0; i <= VPSS_MAX_GRP_NUM * VPSS_MAX_CHN_NUM; ++i) {
+		state = (i < VPSS_MAX_GRP_NUM * VPSS_MAX_CHN_NUM)
+		      ? &vpss_chn_state[i / VPSS_MAX_CHN_NUM][i % VPSS_MAX_CHN_NUM] : &vo_chn_state;
+		if (!state->u32CommitCnt)
+			continue;
+
+		seq_printf(m, "%10s%10d%10d%10d%10d%12llu%12llu%12llu%12llu\n",
+			(state == &vo_chn_state) ? "VO" : "VPSS",
+			(state == &vo_chn_state) ? 0 : i / VPSS_MAX_CHN_NUM,
+			(state == &vo_chn_state) ? 0 : i % VPSS_MAX_CHN_NUM,
+			state->u32CommitCnt,
+			state->u32RgnCnt,
+			div_u64(state->u64CommitNs, state->u32CommitCnt),
+			state->u64CommitMaxNs,
+			state->u32LockCnt ? div_u64(state->u64LockWaitNs, state->u32LockCnt) : 0,
+			state->u64LockWaitMaxNs);
+	}
+}
+
 CVI_S32 rgn_get_display_attr(RGN_HANDLE Handle, const MMF_CHN_S *pstChn, RGN_CHN_ATTR_S *pstChnAttr)
 {
 	struct cvi_rgn_ctx *ctx = NULL;
@@ -2381,7 +2900,7 @@ static void _rgn_destroy_proc(struct cvi_rgn_dev *rdev)
 /*******************************************************
  *  File operations for core
  ******************************************************/
-static long _rgn_s_ctrl(struct cvi_rgn_dev *rdev, struct rgn_ext_control *p)
+static long _rgn_s_ctrl(struct cvi_rgn_dev *rdev, struct file *file, struct rgn_ext_control *p)
 {
 	int ret = -EINVAL;
 	RGN_ATTR_S stRegion;
@@ -2490,6 +3009,34 @@ static long _rgn_s_ctrl(struct cvi_rgn_dev *rdev, struct rgn_ext_control *p)
 		}
 		break;
 
+		case RGN_SDK_BATCH_BEGIN: {
+			if (copy_from_user(&stChn, p->ptr1, sizeof(MMF_CHN_S)) != 0)
+				break;
+
+			ret = rgn_batch_begin(&stChn, file);
+		}
+		break;
+
+		case RGN_SDK_BATCH_COMMIT: {
+			if (copy_from_user(&stChn, p->ptr1, sizeof(MMF_CHN_S)) != 0)
+				break;
+
+			ret = rgn_batch_commit(&stChn, file);
+		}
+		break;
+
+#ifdef DRV_TEST
+		case RGN_SDK_UNIT_TEST: {
+			struct rgn_unit_test_cfg stCfg;
+
+			if (copy_from_user(&stCfg, p->ptr1, sizeof(stCfg)) != 0)
+				break;
+
+			ret = rgn_unit_test(Handle, &stCfg);
+		}
+		break;
+#endif
+
 		case RGN_SDK_INVERT_COLOR: {
 			if ((copy_from_user(&stChn, p->ptr1, sizeof(MMF_CHN_S)) != 0) ||
 				(copy_from_user(&u32Color, p->ptr2, sizeof(CVI_U32)) != 0))
@@ -2607,7 +3154,7 @@ long rgn_ioctl(struct file *file, u_int cmd, u_long arg)
 
 	switch (cmd) {
 	case RGN_IOC_S_CTRL:
-		ret = _rgn_s_ctrl(rdev, &p);
+		ret = _rgn_s_ctrl(rdev, file, &p);
 		break;
 	case RGN_IOC_G_CTRL:
 		ret = _rgn_g_ctrl(rdev, &p);
@@ -2649,6 +3196,8 @@ int rgn_release(struct inode *inode, struct file *file)
 {
 	int ret = 0;
 
+	rgn_batch_release(file);
+
 	// only exit once
 	if (atomic_dec_and_test(&dev_open_cnt)) {
 		struct cvi_rgn_dev *rdev =
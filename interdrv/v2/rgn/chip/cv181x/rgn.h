@@ -27,11 +27,6 @@
 #include <vip/rgn_drv.h>
 #include <rgn_defines.h>
 
-static atomic_t	dev_open_cnt = ATOMIC_INIT(0);
-
-u32 rgn_log_lv = RGN_WARN;
-module_param(rgn_log_lv, int, 0644);
-
 /*********************************************************************************************/
 /* Configured from user, IOCTL */
 CVI_S32 rgn_create(RGN_HANDLE Handle, const RGN_ATTR_S *pstRegion);
@@ -48,6 +43,9 @@ CVI_S32 rgn_update_canvas(RGN_HANDLE Handle);
 CVI_S32 rgn_invert_color(RGN_HANDLE Handle, MMF_CHN_S *pstChn, CVI_U32 *pu32Color);
 CVI_S32 rgn_set_chn_palette(RGN_HANDLE Handle, const MMF_CHN_S *pstChn, RGN_PALETTE_S *pstPalette,
 			RGN_RGBQUARD_S *pstInputPixelTable);
+CVI_S32 rgn_batch_begin(const MMF_CHN_S *pstChn, struct file *owner);
+CVI_S32 rgn_batch_commit(const MMF_CHN_S *pstChn, struct file *owner);
+void rgn_batch_release(struct file *owner);
 
 /* INTERNAL */
 int32_t _rgn_init(void);
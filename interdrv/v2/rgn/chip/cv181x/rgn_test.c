@@ -0,0 +1,368 @@
+#include "rgn_test.h"
+
+#ifdef DRV_TEST
+
+#include <vpss_cb.h>
+#include <rgn_cb.h>
+
+// handles past RGN_MAX_NUM are outside the range given to clients, rgn_create
+// refuses one that exists anyway and the test leaves it alone.
+// covers of a chn sit in one row, far enough apart to move without overlapping
+#define RGN_TEST_HDL(k)		(RGN_MAX_NUM + (k))
+#define RGN_TEST_SIZE		32
+#define RGN_TEST_COLOR		0xff0000
+#define RGN_TEST_PITCH		64
+#define RGN_TEST_SHIFT		16
+#define RGN_TEST_Y		16
+
+// only the addresses are used, as the files owning a batch
+static struct file owner_a, owner_b;
+
+extern struct cvi_rgn_ctx rgn_prc_ctx[RGN_MAX_NUM];
+
+/* struct rgn_test_waiter: stands for a vpss chn commit, which takes the vpss grp lock
+ * that rgn takes to program its hdls and cfg.
+ */
+struct rgn_test_waiter {
+	struct task_struct *thread;
+	MMF_CHN_S stChn;
+	CVI_U32 u32Cnt;
+	CVI_U64 u64WaitNs;
+	CVI_U64 u64WaitMaxNs;
+};
+
+static int _rgn_test_call_cb(u32 m_id, u32 cmd_id, void *data)
+{
+	struct base_exe_m_cb exe_cb;
+
+	exe_cb.callee = m_id;
+	exe_cb.caller = E_MODULE_RGN;
+	exe_cb.cmd_id = cmd_id;
+	exe_cb.data   = (void *)data;
+
+	return base_exe_module_cb(&exe_cb);
+}
+
+static void _rgn_test_cover_attr_ex(RGN_CHN_ATTR_S *pstChnAttr, CVI_S32 s32X, CVI_U32 u32Size, CVI_U32 u32Color)
+{
+	memset(pstChnAttr, 0, sizeof(*pstChnAttr));
+	pstChnAttr->bShow = CVI_TRUE;
+	pstChnAttr->enType = COVER_RGN;
+	pstChnAttr->unChnAttr.stCoverChn.enCoverType = AREA_RECT;
+	pstChnAttr->unChnAttr.stCoverChn.stRect.s32X = s32X;
+	pstChnAttr->unChnAttr.stCoverChn.stRect.s32Y = RGN_TEST_Y;
+	pstChnAttr->unChnAttr.stCoverChn.stRect.u32Width = u32Size;
+	pstChnAttr->unChnAttr.stCoverChn.stRect.u32Height = u32Size;
+	pstChnAttr->unChnAttr.stCoverChn.u32Color = u32Color;
+	pstChnAttr->unChnAttr.stCoverChn.enCoordinate = RGN_ABS_COOR;
+}
+
+static void _rgn_test_cover_attr(RGN_CHN_ATTR_S *pstChnAttr, CVI_S32 s32X)
+{
+	_rgn_test_cover_attr_ex(pstChnAttr, s32X, RGN_TEST_SIZE, RGN_TEST_COLOR);
+}
+
+static CVI_S32 _rgn_test_attach(RGN_HANDLE hdl, const MMF_CHN_S *pstChn, CVI_S32 s32X)
+{
+	RGN_ATTR_S stRegion;
+	RGN_CHN_ATTR_S stChnAttr;
+	CVI_S32 ret;
+
+	memset(&stRegion, 0, sizeof(stRegion));
+	stRegion.enType = COVER_RGN;
+	ret = rgn_create(hdl, &stRegion);
+	if (ret != CVI_SUCCESS)
+		return ret;
+
+	_rgn_test_cover_attr(&stChnAttr, s32X);
+	ret = rgn_attach_to_chn(hdl, pstChn, &stChnAttr);
+	if (ret != CVI_SUCCESS)
+		rgn_destory(hdl);
+
+	return ret;
+}
+
+static CVI_S32 _rgn_test_move(RGN_HANDLE hdl, const MMF_CHN_S *pstChn, CVI_S32 s32X)
+{
+	RGN_CHN_ATTR_S stChnAttr;
+
+	_rgn_test_cover_attr(&stChnAttr, s32X);
+	return rgn_set_display_attr(hdl, pstChn, &stChnAttr);
+}
+
+static CVI_S32 _rgn_test_get_x(RGN_HANDLE hdl, const MMF_CHN_S *pstChn)
+{
+	RGN_CHN_ATTR_S stChnAttr;
+
+	if (rgn_get_display_attr(hdl, pstChn, &stChnAttr) != CVI_SUCCESS)
+		return -1;
+
+	return stChnAttr.unChnAttr.stCoverChn.stRect.s32X;
+}
+
+static void _rgn_test_chn(const struct rgn_unit_test_cfg *cfg, CVI_U32 idx, MMF_CHN_S *pstChn)
+{
+	pstChn->enModId = CVI_ID_VPSS;
+	pstChn->s32DevId = cfg->grp + idx / VPSS_MAX_CHN_NUM;
+	pstChn->s32ChnId = idx % VPSS_MAX_CHN_NUM;
+}
+
+static int _rgn_test_waiter_fn(void *data)
+{
+	struct rgn_test_waiter *w = data;
+	RGN_HANDLE hdls[RGN_EX_MAX_NUM_VPSS];
+	struct _rgn_hdls_cb_param rgn_hdls_arg;
+	CVI_U64 t;
+
+	rgn_hdls_arg.stChn = w->stChn;
+	rgn_hdls_arg.hdls = hdls;
+	rgn_hdls_arg.enType = COVER_RGN;
+	rgn_hdls_arg.layer = 0;
+
+	while (!kthread_should_stop()) {
+		// the callback only copies the hdls, the rest is waiting for the grp lock
+		t = ktime_get_ns();
+		_rgn_test_call_cb(E_MODULE_VPSS, VPSS_CB_GET_RGN_HDLS, &rgn_hdls_arg);
+		t = ktime_get_ns() - t;
+
+		w->u32Cnt++;
+		w->u64WaitNs += t;
+		if (t > w->u64WaitMaxNs)
+			w->u64WaitMaxNs = t;
+		usleep_range(50, 100);
+	}
+
+	return 0;
+}
+
+/* _rgn_batch_test: deferred attrs stay out of ctx until commit, detach drops them,
+ * a closed owner drops its batch and a failed list keeps the attrs from before.
+ */
+static int32_t _rgn_batch_test(const struct rgn_unit_test_cfg *cfg)
+{
+	RGN_HANDLE a = RGN_TEST_HDL(0), b = RGN_TEST_HDL(1), c = RGN_TEST_HDL(2);
+	RGN_CHN_ATTR_S stChnAttr;
+	MMF_CHN_S stChn;
+	CVI_BOOL bHasC = CVI_TRUE;
+	CVI_S32 ret;
+	int32_t fail = 0;
+
+	_rgn_test_chn(cfg, 0, &stChn);
+	if (_rgn_test_attach(a, &stChn, 0) != CVI_SUCCESS) {
+		CVI_TRACE_RGN(RGN_ERR, "attach to vpss grp(%d) chn0 failed\n", cfg->grp);
+		return -1;
+	}
+	if (_rgn_test_attach(b, &stChn, RGN_TEST_PITCH) != CVI_SUCCESS) {
+		CVI_TRACE_RGN(RGN_ERR, "attach to vpss grp(%d) chn0 failed\n", cfg->grp);
+		rgn_destory(a);
+		return -1;
+	}
+
+	// a deferred update is not seen by readers or by the hw update of another rgn
+	rgn_batch_begin(&stChn, &owner_a);
+	_rgn_test_move(a, &stChn, 2 * RGN_TEST_PITCH);
+	if (_rgn_test_get_x(a, &stChn) != 0) {
+		CVI_TRACE_RGN(RGN_ERR, "deferred attr applied before commit\n");
+		fail++;
+	}
+	if (_rgn_test_attach(c, &stChn, 3 * RGN_TEST_PITCH) != CVI_SUCCESS) {
+		CVI_TRACE_RGN(RGN_ERR, "attach within a batch failed\n");
+		bHasC = CVI_FALSE;
+		fail++;
+	}
+	if (_rgn_test_get_x(a, &stChn) != 0) {
+		CVI_TRACE_RGN(RGN_ERR, "attach within a batch applied the deferred attr\n");
+		fail++;
+	}
+	ret = rgn_batch_commit(&stChn, &owner_b);
+	if (ret != CVI_ERR_RGN_NOT_PERM) {
+		CVI_TRACE_RGN(RGN_ERR, "commit by another file returned %#x\n", ret);
+		fail++;
+	}
+	ret = rgn_batch_commit(&stChn, &owner_a);
+	if (ret != CVI_SUCCESS || _rgn_test_get_x(a, &stChn) != 2 * RGN_TEST_PITCH) {
+		CVI_TRACE_RGN(RGN_ERR, "commit returned %#x, x(%d)\n", ret, _rgn_test_get_x(a, &stChn));
+		fail++;
+	}
+
+	// detach drops the deferred update, the rgn keeps where it is attached again
+	rgn_batch_begin(&stChn, &owner_a);
+	_rgn_test_move(a, &stChn, 4 * RGN_TEST_PITCH);
+	rgn_detach_from_chn(a, &stChn);
+	_rgn_test_cover_attr(&stChnAttr, 5 * RGN_TEST_PITCH);
+	rgn_attach_to_chn(a, &stChn, &stChnAttr);
+	ret = rgn_batch_commit(&stChn, &owner_a);
+	if (ret != CVI_SUCCESS || _rgn_test_get_x(a, &stChn) != 5 * RGN_TEST_PITCH) {
+		CVI_TRACE_RGN(RGN_ERR, "commit after reattach returned %#x, x(%d)\n",
+			ret, _rgn_test_get_x(a, &stChn));
+		fail++;
+	}
+
+	// a closed owner leaves no batch behind
+	rgn_batch_begin(&stChn, &owner_a);
+	_rgn_test_move(b, &stChn, 0);
+	rgn_batch_release(&owner_a);
+	ret = rgn_batch_begin(&stChn, &owner_b);
+	if (ret != CVI_SUCCESS) {
+		CVI_TRACE_RGN(RGN_ERR, "begin after the owner closed returned %#x\n", ret);
+		fail++;
+	}
+	ret = rgn_batch_commit(&stChn, &owner_b);
+	if (ret != CVI_SUCCESS || _rgn_test_get_x(b, &stChn) != RGN_TEST_PITCH) {
+		CVI_TRACE_RGN(RGN_ERR, "dropped batch applied, ret %#x x(%d)\n", ret, _rgn_test_get_x(b, &stChn));
+		fail++;
+	}
+
+	// an overlap fails the list, none of its rgns move and c keeps its canvas
+	rgn_batch_begin(&stChn, &owner_a);
+	_rgn_test_move(a, &stChn, RGN_TEST_PITCH);
+	_rgn_test_cover_attr_ex(&stChnAttr, 7 * RGN_TEST_PITCH, 2 * RGN_TEST_SIZE, 0x00ff00);
+	rgn_set_display_attr(c, &stChn, &stChnAttr);
+	ret = rgn_batch_commit(&stChn, &owner_a);
+	if (ret == CVI_SUCCESS || _rgn_test_get_x(a, &stChn) != 5 * RGN_TEST_PITCH
+		|| _rgn_test_get_x(c, &stChn) != 3 * RGN_TEST_PITCH) {
+		CVI_TRACE_RGN(RGN_ERR, "failed commit returned %#x, x(%d %d)\n", ret,
+			_rgn_test_get_x(a, &stChn), _rgn_test_get_x(c, &stChn));
+		fail++;
+	}
+	if (bHasC) {
+		RGN_CANVAS_INFO_S *pstCanvas = &rgn_prc_ctx[_rgn_proc_get_idx(c)].stCanvasInfo[0];
+
+		if (pstCanvas->stSize.u32Width != RGN_TEST_SIZE
+			|| *(CVI_U16 *)pstCanvas->pu8VirtAddr != RGB888_2_ARGB1555(RGN_TEST_COLOR)) {
+			CVI_TRACE_RGN(RGN_ERR, "failed commit left canvas width(%d) color(%#x)\n",
+				pstCanvas->stSize.u32Width, *(CVI_U16 *)pstCanvas->pu8VirtAddr);
+			fail++;
+		}
+		rgn_destory(c);
+	}
+
+	rgn_destory(b);
+	rgn_destory(a);
+
+	pr_err("rgn batch test %s\n", fail ? "FAIL" : "PASS");
+	return fail;
+}
+
+/* _rgn_batch_bench_run: move every rgn each frame, one set_display_attr per rgn or
+ * one batch per chn. Frames are back to back so the waiter sees the worst case.
+ */
+static int32_t _rgn_batch_bench_run(const struct rgn_unit_test_cfg *cfg, CVI_U32 chn_num, CVI_BOOL bBatch)
+{
+	struct rgn_test_waiter w;
+	MMF_CHN_S stChn;
+	CVI_U32 f, k, shift;
+	CVI_U64 t, frm_ns = 0, frm_max_ns = 0;
+	CVI_S32 ret;
+	int32_t fail = 0;
+
+	memset(&w, 0, sizeof(w));
+	_rgn_test_chn(cfg, 0, &w.stChn);
+	w.thread = kthread_run(_rgn_test_waiter_fn, &w, "rgn_test_waiter");
+	if (IS_ERR(w.thread)) {
+		CVI_TRACE_RGN(RGN_ERR, "waiter thread create failed\n");
+		return -1;
+	}
+
+	for (f = 0; f < cfg->frm_num; ++f) {
+		shift = (f & 1) ? RGN_TEST_SHIFT : 0;
+
+		t = ktime_get_ns();
+		for (k = 0; bBatch && k < chn_num; ++k) {
+			_rgn_test_chn(cfg, k, &stChn);
+			rgn_batch_begin(&stChn, &owner_a);
+		}
+		for (k = 0; k < cfg->rgn_num; ++k) {
+			_rgn_test_chn(cfg, k / RGN_MAX_NUM_VPSS, &stChn);
+			ret = _rgn_test_move(RGN_TEST_HDL(k), &stChn, (k % RGN_MAX_NUM_VPSS) * RGN_TEST_PITCH + shift);
+			if (ret != CVI_SUCCESS)
+				fail++;
+		}
+		for (k = 0; bBatch && k < chn_num; ++k) {
+			_rgn_test_chn(cfg, k, &stChn);
+			if (rgn_batch_commit(&stChn, &owner_a) != CVI_SUCCESS)
+				fail++;
+		}
+		t = ktime_get_ns() - t;
+
+		frm_ns += t;
+		if (t > frm_max_ns)
+			frm_max_ns = t;
+	}
+
+	kthread_stop(w.thread);
+
+	pr_err("%s: %d rgns on %d chns, %d frms, frame avg %llu ns max %llu ns\n",
+		bBatch ? "batch" : "single", cfg->rgn_num, chn_num, cfg->frm_num,
+		div_u64(frm_ns, cfg->frm_num), frm_max_ns);
+	pr_err("%s: vpss grp(%d) lock wait avg %llu ns max %llu ns, %d samples\n",
+		bBatch ? "batch" : "single", cfg->grp,
+		w.u32Cnt ? div_u64(w.u64WaitNs, w.u32Cnt) : 0, w.u64WaitMaxNs, w.u32Cnt);
+	if (fail)
+		CVI_TRACE_RGN(RGN_ERR, "%d updates failed\n", fail);
+
+	return fail;
+}
+
+/* _rgn_batch_bench: @rgn_num covers, RGN_MAX_NUM_VPSS per chn, updated per frame
+ * without and with batching. A chn takes RGN_MAX_NUM_VPSS * RGN_TEST_PITCH in width.
+ */
+static int32_t _rgn_batch_bench(const struct rgn_unit_test_cfg *cfg)
+{
+	MMF_CHN_S stChn;
+	CVI_U32 k, chn_num, attached = 0;
+	int32_t fail = 0;
+
+	chn_num = DIV_ROUND_UP(cfg->rgn_num, RGN_MAX_NUM_VPSS);
+	if (!cfg->rgn_num || !cfg->frm_num || cfg->grp >= VPSS_MAX_GRP_NUM
+		|| cfg->grp + DIV_ROUND_UP(chn_num, VPSS_MAX_CHN_NUM) > VPSS_MAX_GRP_NUM) {
+		CVI_TRACE_RGN(RGN_ERR, "invalid cfg grp(%d) rgn_num(%d) frm_num(%d)\n",
+			cfg->grp, cfg->rgn_num, cfg->frm_num);
+		return -1;
+	}
+
+	for (k = 0; k < cfg->rgn_num; ++k, ++attached) {
+		_rgn_test_chn(cfg, k / RGN_MAX_NUM_VPSS, &stChn);
+		if (_rgn_test_attach(RGN_TEST_HDL(k), &stChn, (k % RGN_MAX_NUM_VPSS) * RGN_TEST_PITCH)) {
+			CVI_TRACE_RGN(RGN_ERR, "attach rgn(%d) to vpss grp(%d) chn(%d) failed\n",
+				k, stChn.s32DevId, stChn.s32ChnId);
+			fail++;
+			break;
+		}
+	}
+
+	if (!fail) {
+		fail += _rgn_batch_bench_run(cfg, chn_num, CVI_FALSE);
+		fail += _rgn_batch_bench_run(cfg, chn_num, CVI_TRUE);
+	}
+
+	for (k = 0; k < attached; ++k)
+		rgn_destory(RGN_TEST_HDL(k));
+
+	pr_err("rgn batch bench %s\n", fail ? "FAIL" : "PASS");
+	return fail;
+}
+
+int32_t rgn_unit_test(int32_t op, const struct rgn_unit_test_cfg *cfg)
+{
+	int32_t ret = 0;
+
+	switch (op) {
+	case 1: {
+		CVI_TRACE_RGN(RGN_INFO, "rgn batch test\n");
+		ret = _rgn_batch_test(cfg);
+		break;
+	}
+	case 2: {
+		CVI_TRACE_RGN(RGN_INFO, "rgn batch bench\n");
+		ret = _rgn_batch_bench(cfg);
+		break;
+	}
+	default:
+		break;
+	}
+
+	return ret;
+}
+
+#endif
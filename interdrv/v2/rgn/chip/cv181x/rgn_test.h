@@ -0,0 +1,43 @@
+#ifndef __RGN_TEST_H__
+#define __RGN_TEST_H__
+
+#ifdef DRV_TEST
+
+#ifdef __cplusplus
+#if __cplusplus
+extern "C" {
+#endif
+#endif /* End of #ifdef __cplusplus */
+
+#include <linux/types.h>
+#include <linux/fs.h>
+#include <linux/kthread.h>
+#include <linux/delay.h>
+#include <linux/ktime.h>
+
+#include <linux/cvi_common.h>
+#include <linux/cvi_defines.h>
+#include <linux/cvi_comm_vpss.h>
+#include <linux/cvi_comm_region.h>
+#include <linux/cvi_errno.h>
+#include <linux/cvi_vip.h>
+#include <linux/rgn_uapi.h>
+#include <linux/cvi_rgn_ctx.h>
+
+#include <base_cb.h>
+#include <base_ctx.h>
+#include <rgn_common.h>
+#include <rgn.h>
+
+int32_t rgn_unit_test(int32_t op, const struct rgn_unit_test_cfg *cfg);
+
+
+#ifdef __cplusplus
+#if __cplusplus
+}
+#endif
+#endif /* __cplusplus */
+
+#endif
+
+#endif /* __RGN_TEST_H__ */
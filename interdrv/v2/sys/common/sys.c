@@ -4,6 +4,9 @@
 #include <linux/mod_devicetable.h>
 #include <linux/uaccess.h>
 #include <linux/version.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/sort.h>
 #include <asm/cacheflush.h>
 #if (LINUX_VERSION_CODE >= KERNEL_VERSION(5, 10, 0))
 #include <linux/dma-map-ops.h>
@@ -45,6 +48,75 @@ extern int32_t sys_test_proc_deinit(void);
 static int ion_debug_alloc_free;
 module_param(ion_debug_alloc_free, int, 0644);
 
+static atomic_t ion_alloc_fail = ATOMIC_INIT(0);
+
+static int _sys_ion_mem_cmp(const void *a, const void *b)
+{
+	const struct mem_mapping *ma = a, *mb = b;
+
+	if (ma->phy_addr == mb->phy_addr)
+		return 0;
+	return ma->phy_addr < mb->phy_addr ? -1 : 1;
+}
+
+/*
+ * _sys_ion_frag_collect: the live buffers sorted by address, and the gaps
+ * between them. The caller frees *p_list.
+ */
+static int32_t _sys_ion_frag_collect(struct sys_ion_frag_info *info,
+	struct mem_mapping **p_list, int32_t *p_num)
+{
+	struct mem_mapping *list;
+	uint64_t end, gap;
+	int32_t i, num;
+
+	list = kcalloc(MEM_MAPPING_MAX, sizeof(*list), GFP_KERNEL);
+	if (!list)
+		return -ENOMEM;
+
+	num = sys_ctx_mem_snapshot(list, MEM_MAPPING_MAX);
+	sort(list, num, sizeof(*list), _sys_ion_mem_cmp, NULL);
+
+	memset(info, 0, sizeof(*info));
+	info->buf_num = num;
+	info->alloc_fail = atomic_read(&ion_alloc_fail);
+	for (i = 0; i < num; i++) {
+		end = list[i].phy_addr + PAGE_ALIGN(list[i].size);
+		info->buf_bytes += PAGE_ALIGN(list[i].size);
+		if (i == 0)
+			info->span_start = list[i].phy_addr;
+		if (end > info->span_end)
+			info->span_end = end;
+		if (i + 1 < num && list[i + 1].phy_addr > end) {
+			gap = list[i + 1].phy_addr - end;
+			info->holes++;
+			info->hole_bytes += gap;
+			if (gap > info->largest_hole)
+				info->largest_hole = gap;
+		}
+	}
+
+	if (p_list)
+		*p_list = list;
+	else
+		kfree(list);
+	if (p_num)
+		*p_num = num;
+	return 0;
+}
+
+// a failed allocation says whether the carveout is short or only split up
+static void _sys_ion_alloc_failed(uint32_t u32Len)
+{
+	struct sys_ion_frag_info info;
+
+	atomic_inc(&ion_alloc_fail);
+	if (_sys_ion_frag_collect(&info, NULL, NULL))
+		return;
+	pr_err("ion len=0x%x failed, %u buffers 0x%llx bytes, %u holes largest 0x%llx\n",
+		u32Len, info.buf_num, info.buf_bytes, info.holes, info.largest_hole);
+}
+
 static int32_t _sys_ion_alloc_nofd(uint64_t *addr_p, void **addr_v, uint32_t u32Len,
 	uint32_t is_cached, uint8_t *name)
 {
@@ -57,6 +129,7 @@ static int32_t _sys_ion_alloc_nofd(uint64_t *addr_p, void **addr_v, uint32_t u32
 	ionbuf = cvi_ion_alloc_nofd(ION_HEAP_TYPE_CARVEOUT, u32Len, is_cached);
 	if (IS_ERR(ionbuf)) {
 		pr_err("ion allocated len=0x%x failed\n", u32Len);
+		_sys_ion_alloc_failed(u32Len);
 		return -ENOMEM;
 	}
 
@@ -90,6 +163,7 @@ static int32_t _sys_ion_alloc_nofd(uint64_t *addr_p, void **addr_v, uint32_t u32
 	mem_info.vir_addr = vmap_addr;
 	mem_info.phy_addr = ionbuf->paddr;
 	mem_info.fd_pid = current->pid;
+	mem_info.size = u32Len;
 	mem_info.ionbuf = ionbuf;
 	if (sys_ctx_mem_put(&mem_info)) {
 		pr_err("allocate mm put failed\n");
@@ -126,6 +200,7 @@ static int32_t _sys_ion_alloc(int32_t *p_fd, uint64_t *addr_p, void **addr_v, ui
 	dmabuf_fd = cvi_ion_alloc(ION_HEAP_TYPE_CARVEOUT, u32Len, is_cached);
 	if (dmabuf_fd < 0) {
 		pr_err("ion allocated len=0x%x failed\n", u32Len);
+		_sys_ion_alloc_failed(u32Len);
 		return -ENOMEM;
 	}
 
@@ -169,6 +244,7 @@ static int32_t _sys_ion_alloc(int32_t *p_fd, uint64_t *addr_p, void **addr_v, ui
 	mem_info.vir_addr = vmap_addr;
 	mem_info.phy_addr = ionbuf->paddr;
 	mem_info.fd_pid = current->pid;
+	mem_info.size = u32Len;
 	if (sys_ctx_mem_put(&mem_info)) {
 		pr_err("allocate mm put failed\n");
 		dma_buf_end_cpu_access(dmabuf, DMA_TO_DEVICE);
@@ -278,6 +354,40 @@ static int32_t sys_exit_user(struct cvi_sys_device *ndev, unsigned long arg)
 	return 0;
 }
 
+int32_t sys_ion_get_frag_info(struct sys_ion_frag_info *info)
+{
+	return _sys_ion_frag_collect(info, NULL, NULL);
+}
+EXPORT_SYMBOL_GPL(sys_ion_get_frag_info);
+
+/* Lists the live ion buffers for /proc/cvitek/sys_ion, which base owns */
+int32_t sys_ion_show(struct seq_file *m)
+{
+	struct sys_ion_frag_info info;
+	struct mem_mapping *list;
+	uint64_t end;
+	int32_t i, num;
+
+	if (_sys_ion_frag_collect(&info, &list, &num))
+		return -ENOMEM;
+
+	seq_printf(m, "buffers %u, 0x%llx bytes in [0x%llx, 0x%llx), alloc fail %u\n",
+		info.buf_num, info.buf_bytes, info.span_start, info.span_end, info.alloc_fail);
+	seq_printf(m, "holes %u, 0x%llx bytes, largest 0x%llx\n",
+		info.holes, info.hole_bytes, info.largest_hole);
+	seq_printf(m, "%-12s %-10s %-8s %s\n", "paddr", "size", "pid", "hole after");
+	for (i = 0; i < num; i++) {
+		end = list[i].phy_addr + PAGE_ALIGN(list[i].size);
+		seq_printf(m, "0x%-10llx 0x%-8x %-8d 0x%llx\n", list[i].phy_addr, list[i].size,
+			list[i].fd_pid,
+			(i + 1 < num && list[i + 1].phy_addr > end) ? list[i + 1].phy_addr - end : 0);
+	}
+
+	kfree(list);
+	return 0;
+}
+EXPORT_SYMBOL_GPL(sys_ion_show);
+
 int32_t sys_init()
 {
 	sys_ctx_init();
@@ -8,7 +8,6 @@
 #include <queue.h>
 #include <linux/cvi_errno.h>
 
-#define MEM_MAPPING_MAX 100
 #define BIND_NODE_MAXNUM 64
 
 #ifndef TAILQ_FOREACH_SAFE
@@ -138,6 +137,21 @@ int32_t sys_ctx_mem_dump(void)
 	return cnt;
 }
 
+// copy the live mappings out, at most max of them; returns the number copied
+int32_t sys_ctx_mem_snapshot(struct mem_mapping *mem_list, int32_t max)
+{
+	int32_t i = 0, cnt = 0;
+
+	spin_lock(&mem_lock);
+	for (i = 0; i < MEM_MAPPING_MAX && cnt < max; i++) {
+		if (ctx_mem_mgr[i].phy_addr)
+			memcpy(&mem_list[cnt++], &ctx_mem_mgr[i], sizeof(struct mem_mapping));
+	}
+	spin_unlock(&mem_lock);
+
+	return cnt;
+}
+
 VPSS_MODE_E sys_ctx_get_vpssmode(void)
 {
 	return ctx_info.mode_cfg.vpss_mode.enMode;
@@ -5,6 +5,8 @@
 #include <linux/cvi_comm_sys.h>
 #include "base.h"
 
+#define MEM_MAPPING_MAX 100
+
 struct sys_info {
 	char version[VERSION_NAME_MAXLEN];
 	uint32_t chip_id;
@@ -28,6 +30,7 @@ struct mem_mapping {
 	void *dmabuf;
 	pid_t fd_pid;
 	void *ionbuf;
+	uint32_t size;
 };
 
 int32_t sys_ctx_init(void);
@@ -35,6 +38,7 @@ struct sys_ctx_info *sys_get_ctx(void);
 int32_t sys_ctx_mem_put(struct mem_mapping *mem_config);
 int32_t sys_ctx_mem_get(struct mem_mapping *mem_config);
 int32_t sys_ctx_mem_dump(void);
+int32_t sys_ctx_mem_snapshot(struct mem_mapping *mem_list, int32_t max);
 
 uint32_t sys_ctx_get_chipid(void);
 uint8_t *sys_ctx_get_version(void);
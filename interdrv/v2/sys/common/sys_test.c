@@ -5,6 +5,7 @@
 #include <linux/proc_fs.h>
 #include <linux/seq_file.h>
 #include <linux/version.h>
+#include <linux/ktime.h>
 #include "sys.h"
 #include "sys_context.h"
 
@@ -76,8 +77,100 @@ static uint32_t sys_test_ion(void)
 	return 0;
 }
 
+/*
+ * An alloc/free trace of the codec buffers, replayed through
+ * sys_ion_alloc_nofd() like the vc driver does. len 0 frees the slot.
+ */
+struct sys_test_ion_op {
+	int32_t slot;
+	uint32_t len;
+	const char *mark;	// report the fragmentation after this op
+};
+
+#define SYS_TEST_ION_SLOT 12
+
+static const struct sys_test_ion_op sys_test_ion_trace[] = {
+	// venc 720p: work, bitstream, 3 frame buffers, a temp one
+	{0, 0x40000, NULL}, {1, 0x100000, NULL}, {2, 0x160000, NULL}, {3, 0x160000, NULL},
+	{4, 0x160000, NULL}, {5, 0x8000, NULL}, {5, 0, "venc open"},
+	// vdec 480p next to it
+	{6, 0x40000, NULL}, {7, 0x80000, NULL}, {8, 0x80000, NULL}, {9, 0x80000, NULL},
+	{10, 0x8000, "vdec open"},
+	// venc closes while a small buffer is taken
+	{0, 0}, {1, 0}, {11, 0x8000, NULL}, {2, 0}, {3, 0}, {4, 0}, {10, 0, "venc close"},
+	// venc reopens at 1080p, frame buffers larger than the freed ones
+	{0, 0x40000, NULL}, {1, 0x200000, NULL}, {2, 0x300000, NULL}, {3, 0x300000, NULL},
+	{4, 0x300000, "venc 1080p open"},
+	{0, 0}, {1, 0}, {2, 0}, {3, 0}, {4, 0}, {6, 0}, {7, 0}, {8, 0}, {9, 0}, {11, 0, "close all"},
+};
+
+static void sys_test_ion_frag_show(const char *mark, struct sys_ion_frag_info *info)
+{
+	pr_err("%-16s buffers %2u 0x%08llx, holes %u 0x%llx largest 0x%llx\n", mark,
+		info->buf_num, info->buf_bytes, info->holes, info->hole_bytes, info->largest_hole);
+}
+
+static uint32_t sys_test_ion_replay(void)
+{
+	uint64_t paddr[SYS_TEST_ION_SLOT] = { 0 };
+	void *vaddr = NULL;
+	struct sys_ion_frag_info base, info;
+	uint64_t largest_hole = 0;
+	uint64_t t, lat_sum = 0, lat_max = 0;
+	uint32_t i, alloc = 0, fail = 0;
+	int32_t ret;
+	const struct sys_test_ion_op *op;
+
+	sys_ion_get_frag_info(&base);
+	sys_test_ion_frag_show("before", &base);
+
+	for (i = 0; i < ARRAY_SIZE(sys_test_ion_trace); i++) {
+		op = &sys_test_ion_trace[i];
+		if (op->len) {
+			t = ktime_get_ns();
+			ret = sys_ion_alloc_nofd(&paddr[op->slot], &vaddr, "sys_test_replay", op->len, false);
+			t = ktime_get_ns() - t;
+			alloc++;
+			lat_sum += t;
+			if (t > lat_max)
+				lat_max = t;
+			if (ret) {
+				pr_err("op %u slot %d len 0x%x failed\n", i, op->slot, op->len);
+				paddr[op->slot] = 0;
+				fail++;
+			}
+		} else if (paddr[op->slot]) {
+			sys_ion_free_nofd(paddr[op->slot]);
+			paddr[op->slot] = 0;
+		}
+
+		if (op->mark) {
+			sys_ion_get_frag_info(&info);
+			sys_test_ion_frag_show(op->mark, &info);
+			if (info.largest_hole > largest_hole)
+				largest_hole = info.largest_hole;
+		}
+	}
+
+	for (i = 0; i < SYS_TEST_ION_SLOT; i++)
+		if (paddr[i])
+			sys_ion_free_nofd(paddr[i]);
+
+	sys_ion_get_frag_info(&info);
+	if (info.buf_num != base.buf_num)
+		fail++;
+	pr_err("largest hole 0x%llx, alloc fail %u/%u, alloc avg %llu ns max %llu ns\n",
+		largest_hole, info.alloc_fail - base.alloc_fail, alloc,
+		alloc ? div_u64(lat_sum, alloc) : 0, lat_max);
+	pr_err("sys_test_ion_replay %s\n", fail ? "FAIL" : "PASS");
+
+	return fail;
+}
+
 static int sys_test_proc_show(struct seq_file *m, void *v)
 {
+	seq_puts(m, "  100: ion alloc and cache ops\n");
+	seq_puts(m, "  101: replay a codec ion alloc/free trace, report fragmentation\n");
 	return 0;
 }
 
@@ -102,6 +195,9 @@ static ssize_t sys_test_proc_write(struct file *file, const char __user *user_bu
 	case 100:
 		sys_test_ion();
 		break;
+	case 101:
+		sys_test_ion_replay();
+		break;
 	}
 
 	return count;
@@ -18,6 +18,25 @@ int32_t sys_ion_alloc_nofd(uint64_t *p_paddr, void **pp_vaddr, uint8_t *buf_name
 int32_t sys_ion_free(uint64_t u64PhyAddr);
 int32_t sys_ion_free_nofd(uint64_t u64PhyAddr);
 
+/*
+ * The live sys ion buffers seen as extents of the carveout: the gaps
+ * between them are what a larger allocation can not use.
+ */
+struct sys_ion_frag_info {
+	uint32_t buf_num;
+	uint64_t buf_bytes;
+	uint64_t span_start;	// lowest buffer
+	uint64_t span_end;	// end of the highest buffer
+	uint32_t holes;		// gaps between live buffers
+	uint64_t hole_bytes;
+	uint64_t largest_hole;
+	uint32_t alloc_fail;
+};
+
+int32_t sys_ion_get_frag_info(struct sys_ion_frag_info *info);
+struct seq_file;
+int32_t sys_ion_show(struct seq_file *m);
+
 int32_t sys_cache_invalidate(uint64_t addr_p, void *addr_v, uint32_t u32Len);
 int32_t sys_cache_flush(uint64_t addr_p, void *addr_v, uint32_t u32Len);
 
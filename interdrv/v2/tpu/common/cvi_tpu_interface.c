@@ -33,6 +33,7 @@
 #include <linux/kthread.h>
 #include <linux/slab.h>
 #include <linux/clk.h>
+#include <linux/capability.h>
 #include <asm/cacheflush.h>
 #include <linux/of.h>
 #include <linux/version.h>
@@ -64,6 +65,11 @@ enum tpu_submit_path {
 struct cvi_list_node {
 	struct device *dev;
 	struct list_head list;
+	struct hlist_node hnode;
+	u8 prio;
+	bool pooled;
+	ktime_t submit_time;
+	struct cvi_tpu_file *file;
 	pid_t pid;
 	uint32_t seq_no;
 	uint32_t pio_seq_no;
@@ -93,6 +99,23 @@ struct tpu_profiling_info {
 	uint32_t usage;
 };
 
+/* a dmabuf kept got & begun cpu access between submits of a client */
+struct tpu_dmabuf_entry {
+	struct dma_buf *dma_buf;
+	void *vaddr;
+	uint64_t paddr;
+	u64 last_use;
+};
+
+struct cvi_tpu_file {
+	struct cvi_tpu_device *ndev;
+	u8 prio;
+	struct mutex cache_lock;
+	atomic_t inflight;
+	u64 cache_tick;
+	struct tpu_dmabuf_entry cache[TPU_DMABUF_CACHE_NUM];
+};
+
 struct tpu_suspend_info {
 	spinlock_t spin_lock;
 	uint8_t running_cnt;
@@ -109,6 +132,10 @@ static struct tpu_suspend_info tpu_suspend;
 
 #define TASK_LIST_MAX 100
 #define DONE_LIST_MAX 1000
+// nodes preallocated, enough for a full task list plus the usual done ones
+#define TPU_NODE_POOL_NUM (TASK_LIST_MAX + 28)
+// max jobs taken from higher priorities in a row while a lower one waits
+#define TPU_PRIO_STARVE_MAX 8
 
 #if (KERNEL_VERSION(4, 15, 0) <= LINUX_VERSION_CODE)
 typedef struct legacy_timer_emu {
@@ -217,15 +244,112 @@ static int __init tpu_profile_timer_init(void)
 
 static int tpu_proc_show(struct seq_file *m, void *v)
 {
+	struct cvi_tpu_device *ndev = m->private;
+	struct cvi_kernel_work *kernel_work = &ndev->kernel_work;
+	struct tpu_prio_stat *stat;
+	struct tpu_seg_stat *seg;
+	int i;
+
 	if (info.enable_usage_profiling) {
 		seq_puts(m, "profiling is running\n");
 		seq_printf(m, "interval=%dms usage=%d%%\n", PROFILING_INTERVAL_MS, info.usage);
 	} else {
 		seq_puts(m, "profiling is disabled\n");
 	}
+
+	seq_printf(m, "queued=%u done=%u\n", kernel_work->task_count, kernel_work->done_count);
+	seq_printf(m, "dmabuf cache hit=%u miss=%u\n",
+		   atomic_read(&kernel_work->cache_hit), atomic_read(&kernel_work->cache_miss));
+	seq_printf(m, "submit=%u cpu(ns) last=%u avg=%llu max=%u\n",
+		   kernel_work->submit_cnt, kernel_work->submit_last_ns,
+		   kernel_work->submit_cnt ?
+			div_u64(kernel_work->submit_sum_ns, kernel_work->submit_cnt) : 0,
+		   kernel_work->submit_max_ns);
+	seg = &ndev->seg_stat;
+	seq_printf(m, "segment=%u spin=%u sleep=%u gap(ns) avg=%llu max=%u\n",
+		   seg->seg_cnt, seg->spin_cnt, seg->sleep_cnt,
+		   seg->gap_cnt ? div_u64(seg->gap_sum_ns, seg->gap_cnt) : 0,
+		   seg->gap_max_ns);
+	for (i = 0; i < TPU_PRIO_NUM; i++) {
+		stat = &kernel_work->prio_stat[i];
+		seq_printf(m, "prio%d: done=%u turnaround(us) last=%u avg=%llu max=%u\n",
+			   i, stat->done_cnt, stat->last_us,
+			   stat->done_cnt ? div_u64(stat->sum_us, stat->done_cnt) : 0,
+			   stat->max_us);
+	}
+	return 0;
+}
+
+static int tpu_pmu_proc_show(struct seq_file *m, void *v)
+{
+	struct cvi_tpu_device *ndev = m->private;
+	struct tpu_pmu_ring *ring = &ndev->pmu;
+	struct cvi_tpu_pmu_report *report;
+	struct cvi_tpu_pmu_layer *layer;
+	int i, num;
+
+	if (!ring->report) {
+		seq_puts(m, "pmu decode is not available\n");
+		return 0;
+	}
+
+	report = kmalloc(sizeof(*report), GFP_KERNEL);
+	if (!report)
+		return -ENOMEM;
+
+	spin_lock(&ring->lock);
+	if (!ring->head) {
+		spin_unlock(&ring->lock);
+		kfree(report);
+		seq_puts(m, "no pmu report, run a dmabuf with a pmu buffer\n");
+		return 0;
+	}
+	memcpy(report, &ring->report[(ring->head - 1) % TPU_PMU_RING_NUM], sizeof(*report));
+	spin_unlock(&ring->lock);
+
+	seq_printf(m, "report=%u pid=%d seq_no=%u event=%u clk=%u records=%u bad=%u layers=%u\n",
+		   report->seq, report->pid, report->seq_no, report->event, report->tpu_clk_rate,
+		   report->rec_cnt, report->rec_bad, report->layer_cnt);
+	seq_printf(m, "total: wall(ns)=%llu tiu(cycles)=%llu tdma(cycles)=%llu tdma(bytes)=%llu stall(cycles)=%llu\n",
+		   report->wall_ns, report->tiu_cycles, report->tdma_cycles,
+		   report->tdma_bytes, report->stall_cycles);
+
+	num = min_t(u32, report->layer_cnt, CVITPU_PMU_LAYER_MAX);
+	seq_printf(m, "%-4s %-20s %6s %6s %10s %10s %10s %10s %10s %10s\n", "id", "name", "bd", "gdma",
+		   "wall(ns)", "span(cyc)", "tiu(cyc)", "tdma(cyc)", "tdma(B)", "stall(cyc)");
+	for (i = 0; i < num; i++) {
+		layer = &report->layer[i];
+		seq_printf(m, "%-4d %-20.20s %6u %6u %10llu %10u %10llu %10llu %10llu %10llu\n",
+			   i, layer->name, layer->tiu_desc_cnt, layer->tdma_desc_cnt,
+			   layer->wall_ns, layer->end_cycle - layer->start_cycle,
+			   layer->tiu_cycles, layer->tdma_cycles, layer->tdma_bytes,
+			   layer->stall_cycles);
+	}
+
+	kfree(report);
 	return 0;
 }
 
+static int tpu_pmu_proc_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, tpu_pmu_proc_show, PDE_DATA(inode));
+}
+
+#if (KERNEL_VERSION(5, 10, 0) <= LINUX_VERSION_CODE)
+static const struct proc_ops tpu_pmu_proc_ops = {
+	.proc_open = tpu_pmu_proc_open,
+	.proc_read = seq_read,
+	.proc_release = single_release,
+};
+#else
+static const struct file_operations tpu_pmu_proc_ops = {
+	.owner = THIS_MODULE,
+	.open = tpu_pmu_proc_open,
+	.read = seq_read,
+	.release = single_release,
+};
+#endif
+
 static ssize_t tpu_proc_write(struct file *file, const char __user *user_buf, size_t count, loff_t *ppos)
 {
 	uint32_t input_param = 0;
@@ -296,12 +420,26 @@ static irqreturn_t cvi_tpu_tdma_irq(int irq, void *data)
 	return ret;
 }
 
+static void cvi_tpu_check_buffer(struct cvi_list_node *node)
+{
+	struct dma_hdr_t *header;
+
+	// Check parameters
+	header = (struct dma_hdr_t *)node->dmabuf_vaddr;
+	if ((header->pmubuf_offset & 0xF) && (header->pmubuf_size & 0xF)) {
+		pr_err("error: pmubuf_offset=0x%x, pmubuf_size=0x%x\n", header->pmubuf_offset, header->pmubuf_size);
+	}
+
+	if (node->dmabuf_paddr & 0xFFF) {
+		pr_err("error: dmabuf_paddr=0x%p\n", node->dmabuf_paddr);
+	}
+}
+
 static int cvi_tpu_prepare_buffer(struct cvi_list_node *node)
 {
 	int ret = 0;
 	struct ion_buffer *buffer;
 	struct file *fp;
-	struct dma_hdr_t *header;
 
 	node->dma_buf = dma_buf_get(node->dmabuf_fd);
 	pr_debug("dma_buf=0x%llx, dmabuf_fd=%d\n", (uint64_t)node->dma_buf, node->dmabuf_fd);
@@ -332,25 +470,127 @@ static int cvi_tpu_prepare_buffer(struct cvi_list_node *node)
 	fp = (struct file *)(node->dma_buf->file);
 	pr_debug("p=0x%llx, ref_count=%lld\n", (uint64_t)node->dmabuf_paddr, file_count(fp));
 
-	// Check parameters
-	header = (struct dma_hdr_t *)node->dmabuf_vaddr;
-	if ((header->pmubuf_offset & 0xF) && (header->pmubuf_size & 0xF)) {
-		pr_err("error: pmubuf_offset=0x%x, pmubuf_size=0x%x\n", header->pmubuf_offset, header->pmubuf_size);
+	cvi_tpu_check_buffer(node);
+	return 0;
+}
+
+static void tpu_dmabuf_entry_release(struct tpu_dmabuf_entry *entry)
+{
+	dma_buf_end_cpu_access(entry->dma_buf, DMA_TO_DEVICE);
+	dma_buf_put(entry->dma_buf);
+	memset(entry, 0, sizeof(*entry));
+}
+
+// buffers only the cache still holds go first, then the least recently used
+static bool tpu_dmabuf_evict_before(struct tpu_dmabuf_entry *a, struct tpu_dmabuf_entry *b)
+{
+	bool a_released = file_count(a->dma_buf->file) == 1;
+	bool b_released = file_count(b->dma_buf->file) == 1;
+
+	if (a_released != b_released)
+		return a_released;
+	return a->last_use < b->last_use;
+}
+
+/*
+ * Map the job's dmabuf through the client's cache. A hit only costs the
+ * dma_buf_get() to resolve the fd; a miss takes a free entry or evicts the
+ * least recently used one, preferring buffers the client already released.
+ * Nothing is evicted while the client has jobs in flight; -ENOSPC then, and
+ * the caller maps the buffer uncached.
+ */
+static int cvi_tpu_map_cached(struct cvi_tpu_file *file, struct cvi_list_node *node)
+{
+	struct cvi_kernel_work *kernel_work = &file->ndev->kernel_work;
+	struct tpu_dmabuf_entry *entry = NULL, *victim = NULL;
+	struct ion_buffer *buffer;
+	struct dma_buf *dma_buf;
+	bool busy;
+	int i, ret;
+
+	dma_buf = dma_buf_get(node->dmabuf_fd);
+	if (IS_ERR(dma_buf))
+		return -EINVAL;
+
+	mutex_lock(&file->cache_lock);
+	busy = atomic_read(&file->inflight);
+	for (i = 0; i < TPU_DMABUF_CACHE_NUM; i++) {
+		struct tpu_dmabuf_entry *e = &file->cache[i];
+
+		if (e->dma_buf == dma_buf) {
+			entry = e;
+			break;
+		}
+		if (!e->dma_buf) {
+			if (!victim || victim->dma_buf)
+				victim = e;
+		} else if (!busy && (!victim || (victim->dma_buf &&
+			   tpu_dmabuf_evict_before(e, victim)))) {
+			victim = e;
+		}
 	}
 
-	if (node->dmabuf_paddr & 0xFFF) {
-		pr_err("error: dmabuf_paddr=0x%p\n", node->dmabuf_paddr);
+	if (entry) {
+		// the cache holds its own reference.
+		dma_buf_put(dma_buf);
+		atomic_inc(&kernel_work->cache_hit);
+	} else {
+		atomic_inc(&kernel_work->cache_miss);
+		if (!victim) {
+			mutex_unlock(&file->cache_lock);
+			dma_buf_put(dma_buf);
+			return -ENOSPC;
+		}
+		if (victim->dma_buf)
+			tpu_dmabuf_entry_release(victim);
+
+		ret = dma_buf_begin_cpu_access(dma_buf, DMA_TO_DEVICE);
+		if (ret) {
+			mutex_unlock(&file->cache_lock);
+			dma_buf_put(dma_buf);
+			return ret;
+		}
+		buffer = dma_buf->priv;
+		victim->dma_buf = dma_buf;
+		victim->vaddr = buffer->vaddr;
+		victim->paddr = buffer->paddr;
+		entry = victim;
 	}
 
+	entry->last_use = ++file->cache_tick;
+	node->dma_buf = entry->dma_buf;
+	node->dmabuf_vaddr = entry->vaddr;
+	node->dmabuf_paddr = entry->paddr;
+	node->file = file;
+	atomic_inc(&file->inflight);
+	mutex_unlock(&file->cache_lock);
+
+	cvi_tpu_check_buffer(node);
 	return 0;
 }
 
+static void cvi_tpu_cache_flush_all(struct cvi_tpu_file *file)
+{
+	int i;
+
+	mutex_lock(&file->cache_lock);
+	for (i = 0; i < TPU_DMABUF_CACHE_NUM; i++)
+		if (file->cache[i].dma_buf)
+			tpu_dmabuf_entry_release(&file->cache[i]);
+	mutex_unlock(&file->cache_lock);
+}
+
 static void cvi_tpu_cleanup_buffer(struct cvi_list_node *node)
 {
 	struct file *fp;
 
 	//do nothing while security path
 	if (node->tpu_path == TPU_PATH_DESNORMAL) {
+		// the client's cache keeps it mapped
+		if (node->file) {
+			atomic_dec(&node->file->inflight);
+			return;
+		}
 
 		dma_buf_end_cpu_access(node->dma_buf, DMA_TO_DEVICE);
 		dma_buf_put(node->dma_buf);
@@ -360,27 +600,63 @@ static void cvi_tpu_cleanup_buffer(struct cvi_list_node *node)
 	}
 }
 
+static struct cvi_list_node *tpu_node_alloc(struct cvi_kernel_work *kernel_work)
+{
+	struct cvi_list_node *node = NULL;
+	bool pooled = false;
+
+	spin_lock(&kernel_work->node_lock);
+	if (!list_empty(&kernel_work->node_free)) {
+		node = list_first_entry(&kernel_work->node_free, struct cvi_list_node, list);
+		list_del(&node->list);
+		pooled = true;
+	}
+	spin_unlock(&kernel_work->node_lock);
+
+	if (!node)
+		node = vmalloc(sizeof(struct cvi_list_node));
+	if (!node)
+		return NULL;
+
+	memset(node, 0, sizeof(struct cvi_list_node));
+	node->pooled = pooled;
+	return node;
+}
+
+static void tpu_node_free(struct cvi_kernel_work *kernel_work, struct cvi_list_node *node)
+{
+	if (!node->pooled) {
+		vfree(node);
+		return;
+	}
+
+	spin_lock(&kernel_work->node_lock);
+	list_add(&node->list, &kernel_work->node_free);
+	spin_unlock(&kernel_work->node_lock);
+}
+
+static inline u64 tpu_done_key(pid_t pid, u32 seq_no, bool pio)
+{
+	return ((u64)pid << 32) ^ ((u64)seq_no << 1) ^ pio;
+}
+
 static struct cvi_list_node *
 get_from_done_list(struct cvi_kernel_work *kernel_work, u32 seq_no, enum tpu_submit_path path)
 {
 	struct cvi_list_node *node = NULL;
 	struct cvi_list_node *pos;
+	bool pio = (path == TPU_PATH_PIOTDMA);
 
 	spin_lock(&kernel_work->done_list_lock);
 
-	if (path == TPU_PATH_PIOTDMA) {
-		list_for_each_entry(pos, &kernel_work->done_list, list) {
-			if ((pos->pid == current->pid) && (pos->pio_seq_no == seq_no)) {
-				node = pos;
-				break;
-			}
-		}
-	} else {
-		list_for_each_entry(pos, &kernel_work->done_list, list) {
-			if ((pos->pid == current->pid) && (pos->seq_no == seq_no)) {
-				node = pos;
-				break;
-			}
+	hash_for_each_possible(kernel_work->done_hash, pos, hnode,
+			       tpu_done_key(current->pid, seq_no, pio)) {
+		if (pos->pid != current->pid)
+			continue;
+		if ((pio && pos->tpu_path == TPU_PATH_PIOTDMA && pos->pio_seq_no == seq_no) ||
+		    (!pio && pos->tpu_path != TPU_PATH_PIOTDMA && pos->seq_no == seq_no)) {
+			node = pos;
+			break;
 		}
 	}
 	spin_unlock(&kernel_work->done_list_lock);
@@ -388,22 +664,90 @@ get_from_done_list(struct cvi_kernel_work *kernel_work, u32 seq_no, enum tpu_sub
 	return node;
 }
 
+static void add_to_done_list(struct cvi_kernel_work *kernel_work,
+			     struct cvi_list_node *node)
+{
+	bool pio = (node->tpu_path == TPU_PATH_PIOTDMA);
+
+	spin_lock(&kernel_work->done_list_lock);
+	hash_add(kernel_work->done_hash, &node->hnode,
+		 tpu_done_key(node->pid, pio ? node->pio_seq_no : node->seq_no, pio));
+	kernel_work->done_count++;
+	spin_unlock(&kernel_work->done_list_lock);
+}
+
 static void remove_from_done_list(struct cvi_kernel_work *kernel_work,
 				  struct cvi_list_node *node)
 {
 	spin_lock(&kernel_work->done_list_lock);
-	list_del(&node->list);
+	hash_del(&node->hnode);
+	kernel_work->done_count--;
 	spin_unlock(&kernel_work->done_list_lock);
-	vfree(node);
+	tpu_node_free(kernel_work, node);
 }
 
-static int cvi_tpu_submit(struct cvi_tpu_device *ndev, unsigned long arg)
+/*
+ * Take a slot in the run queues, sleeping until the worker frees one if
+ * TASK_LIST_MAX jobs are already queued.
+ */
+static int cvi_tpu_reserve_task(struct cvi_kernel_work *kernel_work)
 {
+	int ret;
+
+	while (1) {
+		spin_lock(&kernel_work->task_list_lock);
+		if (kernel_work->task_count < TASK_LIST_MAX) {
+			kernel_work->task_count++;
+			spin_unlock(&kernel_work->task_list_lock);
+			return 0;
+		}
+		spin_unlock(&kernel_work->task_list_lock);
+
+		ret = wait_event_interruptible(kernel_work->task_space_queue,
+			READ_ONCE(kernel_work->task_count) < TASK_LIST_MAX);
+		if (ret)
+			return -EINTR;
+	}
+}
+
+static void cvi_tpu_unreserve_task(struct cvi_kernel_work *kernel_work)
+{
+	spin_lock(&kernel_work->task_list_lock);
+	kernel_work->task_count--;
+	spin_unlock(&kernel_work->task_list_lock);
+	wake_up_interruptible(&kernel_work->task_space_queue);
+}
+
+/*
+ * @start: when the submit ioctl began, to account its cpu overhead.
+ */
+static void cvi_tpu_queue_task(struct cvi_kernel_work *kernel_work,
+			       struct cvi_list_node *node, u8 prio, ktime_t start)
+{
+	u32 ns;
+
+	node->prio = prio;
+	node->submit_time = ktime_get();
+	ns = (u32)ktime_to_ns(ktime_sub(node->submit_time, start));
+
+	spin_lock(&kernel_work->task_list_lock);
+	list_add_tail(&node->list, &kernel_work->task_list[prio]);
+	wake_up_interruptible(&kernel_work->task_wait_queue);
+	kernel_work->submit_cnt++;
+	kernel_work->submit_last_ns = ns;
+	kernel_work->submit_sum_ns += ns;
+	if (ns > kernel_work->submit_max_ns)
+		kernel_work->submit_max_ns = ns;
+	spin_unlock(&kernel_work->task_list_lock);
+}
+
+static int cvi_tpu_submit(struct cvi_tpu_file *file, unsigned long arg)
+{
+	struct cvi_tpu_device *ndev = file->ndev;
+	ktime_t start = ktime_get();
 	int ret = 0;
-	u32 task_list_count = 0;
 	struct cvi_submit_dma_arg run_dmabuf_arg;
 	struct cvi_list_node *node;
-	struct cvi_list_node *pos;
 	struct cvi_kernel_work *kernel_work;
 
 	ret = copy_from_user(&run_dmabuf_arg,
@@ -415,48 +759,37 @@ static int cvi_tpu_submit(struct cvi_tpu_device *ndev, unsigned long arg)
 	}
 
 	kernel_work = &ndev->kernel_work;
-	while (1) {
-		spin_lock(&ndev->kernel_work.task_list_lock);
-		list_for_each_entry(pos, &kernel_work->task_list, list) {
-			task_list_count++;
-		}
-		spin_unlock(&ndev->kernel_work.task_list_lock);
-		if (task_list_count > TASK_LIST_MAX) {
-			dev_info(ndev->dev, "too much task in task list\n");
-			msleep(20);
-		} else {
-			break;
-		}
-	}
+	ret = cvi_tpu_reserve_task(kernel_work);
+	if (ret)
+		return ret;
 
 	pr_debug("cvi_tpu_submit path()\n");
-	node = vmalloc(sizeof(struct cvi_list_node));
-	if (!node)
+	node = tpu_node_alloc(kernel_work);
+	if (!node) {
+		cvi_tpu_unreserve_task(kernel_work);
 		return -ENOMEM;
-	memset(node, 0, sizeof(struct cvi_list_node));
+	}
 
 	node->pid = current->pid;
 	node->seq_no = run_dmabuf_arg.seq_no;
 	node->dmabuf_fd = run_dmabuf_arg.fd;
 	node->dev = ndev->dev;
 	node->tpu_path = TPU_PATH_DESNORMAL;
-	cvi_tpu_prepare_buffer(node);
+	if (cvi_tpu_map_cached(file, node))
+		cvi_tpu_prepare_buffer(node);
 
-	spin_lock(&ndev->kernel_work.task_list_lock);
-	list_add_tail(&node->list, &ndev->kernel_work.task_list);
-	wake_up_interruptible(&ndev->kernel_work.task_wait_queue);
-	spin_unlock(&ndev->kernel_work.task_list_lock);
+	cvi_tpu_queue_task(kernel_work, node, file->prio, start);
 
 	return 0;
 }
 
-static int cvi_tpu_submit_tee(struct cvi_tpu_device *ndev, unsigned long arg)
+static int cvi_tpu_submit_tee(struct cvi_tpu_file *file, unsigned long arg)
 {
+	struct cvi_tpu_device *ndev = file->ndev;
+	ktime_t start = ktime_get();
 	int ret = 0;
-	u32 task_list_count = 0;
 	struct cvi_submit_tee_arg ioctl_arg;
 	struct cvi_list_node *node;
-	struct cvi_list_node *pos;
 	struct cvi_kernel_work *kernel_work;
 
 	ret = copy_from_user(&ioctl_arg,
@@ -468,25 +801,16 @@ static int cvi_tpu_submit_tee(struct cvi_tpu_device *ndev, unsigned long arg)
 	}
 
 	kernel_work = &ndev->kernel_work;
-	while (1) {
-		spin_lock(&ndev->kernel_work.task_list_lock);
-		list_for_each_entry(pos, &kernel_work->task_list, list) {
-			task_list_count++;
-		}
-		spin_unlock(&ndev->kernel_work.task_list_lock);
-		if (task_list_count > TASK_LIST_MAX) {
-			dev_info(ndev->dev, "too much task in task list\n");
-			msleep(20);
-		} else {
-			break;
-		}
-	}
+	ret = cvi_tpu_reserve_task(kernel_work);
+	if (ret)
+		return ret;
 
 	pr_debug("cvi_tpu_submit_tee path()\n");
-	node = vmalloc(sizeof(struct cvi_list_node));
-	if (!node)
+	node = tpu_node_alloc(kernel_work);
+	if (!node) {
+		cvi_tpu_unreserve_task(kernel_work);
 		return -ENOMEM;
-	memset(node, 0, sizeof(struct cvi_list_node));
+	}
 
 	node->pid = current->pid;
 	node->seq_no = ioctl_arg.seq_no;
@@ -501,10 +825,7 @@ static int cvi_tpu_submit_tee(struct cvi_tpu_device *ndev, unsigned long arg)
 	node->dev = ndev->dev;
 	node->tpu_path = TPU_PATH_DESSEC;
 
-	spin_lock(&ndev->kernel_work.task_list_lock);
-	list_add_tail(&node->list, &ndev->kernel_work.task_list);
-	wake_up_interruptible(&ndev->kernel_work.task_wait_queue);
-	spin_unlock(&ndev->kernel_work.task_list_lock);
+	cvi_tpu_queue_task(kernel_work, node, file->prio, start);
 
 	return 0;
 }
@@ -549,6 +870,79 @@ static int cvi_tpu_load_tee(struct cvi_tpu_device *ndev, unsigned long arg)
 	return ret;
 }
 
+// move the report the platform code decoded into the ring, under dev_lock.
+static void tpu_pmu_commit(struct cvi_tpu_device *ndev, struct cvi_list_node *node)
+{
+	struct tpu_pmu_ring *ring = &ndev->pmu;
+	struct cvi_tpu_pmu_report *report;
+
+	spin_lock(&ring->lock);
+	report = &ring->report[ring->head % TPU_PMU_RING_NUM];
+	memcpy(report, ring->scratch, sizeof(*report));
+	report->seq = ring->head++;
+	report->pid = node->pid;
+	report->seq_no = node->seq_no;
+	spin_unlock(&ring->lock);
+}
+
+static int cvi_tpu_get_pmu_report(struct cvi_tpu_device *ndev, unsigned long arg)
+{
+	struct tpu_pmu_ring *ring = &ndev->pmu;
+	struct cvi_tpu_pmu_read_arg read_arg;
+	struct cvi_tpu_pmu_report __user *dst;
+	struct cvi_tpu_pmu_report *report;
+	u32 seq, oldest, n = 0;
+	int ret = 0;
+
+	if (copy_from_user(&read_arg, (void __user *)arg, sizeof(read_arg)))
+		return -EFAULT;
+
+	if (!ring->report)
+		return -ENODEV;
+
+	report = kmalloc(sizeof(*report), GFP_KERNEL);
+	if (!report)
+		return -ENOMEM;
+
+	dst = (struct cvi_tpu_pmu_report __user *)(uintptr_t)read_arg.reports;
+	seq = read_arg.seq;
+	read_arg.lost = 0;
+
+	while (n < read_arg.count) {
+		spin_lock(&ring->lock);
+		// catch up with the oldest report still in the ring
+		oldest = ring->head - min_t(u32, ring->head, TPU_PMU_RING_NUM);
+		if ((s32)(seq - oldest) < 0) {
+			read_arg.lost += oldest - seq;
+			seq = oldest;
+		}
+		if ((s32)(ring->head - seq) <= 0) {
+			spin_unlock(&ring->lock);
+			break;
+		}
+		memcpy(report, &ring->report[seq % TPU_PMU_RING_NUM], sizeof(*report));
+		spin_unlock(&ring->lock);
+
+		if (copy_to_user(&dst[n], report, sizeof(*report))) {
+			ret = -EFAULT;
+			break;
+		}
+		seq++;
+		n++;
+	}
+
+	kfree(report);
+	if (ret)
+		return ret;
+
+	read_arg.count = n;
+	read_arg.seq = seq;
+	if (copy_to_user((void __user *)arg, &read_arg, sizeof(read_arg)))
+		return -EFAULT;
+
+	return 0;
+}
+
 static int cvi_tpu_run_dmabuf(struct cvi_tpu_device *ndev, struct cvi_list_node *node)
 {
 	int ret = 0;
@@ -559,6 +953,13 @@ static int cvi_tpu_run_dmabuf(struct cvi_tpu_device *ndev, struct cvi_list_node
 #endif
 
 	mutex_lock(&ndev->dev_lock);
+#ifdef DRV_TEST
+	if (ndev->test_run) {
+		ret = ndev->test_run(ndev, node->seq_no, node->prio);
+		mutex_unlock(&ndev->dev_lock);
+		return ret;
+	}
+#endif
 	platform_tpu_init(ndev);
 
 	if (info.enable_usage_profiling) {
@@ -573,7 +974,11 @@ static int cvi_tpu_run_dmabuf(struct cvi_tpu_device *ndev, struct cvi_list_node
 	//two different ways of normal and security submit
 	switch (node->tpu_path) {
 	case TPU_PATH_DESNORMAL:
+		ndev->pmu.scratch_ready = false;
+		ndev->pmu.buf_size = node->dma_buf->size;
 		ret = platform_run_dmabuf(ndev, node->dmabuf_vaddr, node->dmabuf_paddr);
+		if (ndev->pmu.scratch_ready)
+			tpu_pmu_commit(ndev, node);
 		break;
 	case TPU_PATH_DESSEC:
 		ret = platform_run_dmabuf_tee(ndev, &node->tee_info);
@@ -648,13 +1053,13 @@ static int cvi_tpu_wait_pio(struct cvi_tpu_device *ndev, unsigned long arg)
 	return ret;
 }
 
-static int cvi_tpu_submit_pio(struct cvi_tpu_device *ndev, unsigned long arg)
+static int cvi_tpu_submit_pio(struct cvi_tpu_file *file, unsigned long arg)
 {
+	struct cvi_tpu_device *ndev = file->ndev;
+	ktime_t start = ktime_get();
 	int ret = 0;
 	struct cvi_tdma_copy_arg ioctl_arg;
-	u32 task_list_count = 0;
 	struct cvi_list_node *node;
-	struct cvi_list_node *pos;
 	struct cvi_kernel_work *kernel_work;
 
 	ret = copy_from_user(&ioctl_arg,
@@ -666,25 +1071,16 @@ static int cvi_tpu_submit_pio(struct cvi_tpu_device *ndev, unsigned long arg)
 	}
 
 	kernel_work = &ndev->kernel_work;
-	while (1) {
-		spin_lock(&ndev->kernel_work.task_list_lock);
-		list_for_each_entry(pos, &kernel_work->task_list, list) {
-			task_list_count++;
-		}
-		spin_unlock(&ndev->kernel_work.task_list_lock);
-		if (task_list_count > TASK_LIST_MAX) {
-			dev_info(ndev->dev, "too much task in task list\n");
-			msleep(20);
-		} else {
-			break;
-		}
-	}
+	ret = cvi_tpu_reserve_task(kernel_work);
+	if (ret)
+		return ret;
 
 	pr_debug("cvi_tpu_submit_pio path()\n");
-	node = vmalloc(sizeof(struct cvi_list_node));
-	if (!node)
+	node = tpu_node_alloc(kernel_work);
+	if (!node) {
+		cvi_tpu_unreserve_task(kernel_work);
 		return -ENOMEM;
-	memset(node, 0, sizeof(struct cvi_list_node));
+	}
 
 	node->pid = current->pid;
 	node->pio_seq_no = ioctl_arg.seq_no;
@@ -703,10 +1099,7 @@ static int cvi_tpu_submit_pio(struct cvi_tpu_device *ndev, unsigned long arg)
 		node->pio_info.leng_bytes = ioctl_arg.leng_bytes;
 	}
 
-	spin_lock(&ndev->kernel_work.task_list_lock);
-	list_add_tail(&node->list, &ndev->kernel_work.task_list);
-	wake_up_interruptible(&ndev->kernel_work.task_wait_queue);
-	spin_unlock(&ndev->kernel_work.task_list_lock);
+	cvi_tpu_queue_task(kernel_work, node, file->prio, start);
 	return 0;
 }
 
@@ -733,25 +1126,22 @@ static int cvi_tpu_unload_tee(struct cvi_tpu_device *ndev, unsigned long arg)
 static void cvi_tpu_cleanup_done_list(struct cvi_tpu_device *ndev,
 				     struct cvi_kernel_work *kernel_work)
 {
-	u32 done_list_count = 0;
-	struct cvi_list_node *pos, *tmp;
+	struct cvi_list_node *pos;
+	struct hlist_node *tmp;
 	struct task_struct *task;
 	bool alive;
+	int bkt;
 
 	spin_lock(&kernel_work->done_list_lock);
 
-	list_for_each_entry(pos, &kernel_work->done_list, list) {
-		done_list_count++;
-	}
-
-	if (done_list_count < DONE_LIST_MAX) {
+	if (kernel_work->done_count < DONE_LIST_MAX) {
 		spin_unlock(&kernel_work->done_list_lock);
 		return;
 	}
 
 	dev_info(ndev->dev, "done list too much node, clean up\n");
 
-	list_for_each_entry_safe(pos, tmp, &kernel_work->done_list, list) {
+	hash_for_each_safe(kernel_work->done_hash, bkt, tmp, pos, hnode) {
 		alive = false;
 		for_each_process(task) {
 			if (pos->pid == task->pid) {
@@ -760,14 +1150,62 @@ static void cvi_tpu_cleanup_done_list(struct cvi_tpu_device *ndev,
 			}
 		}
 		if (!alive) {
-			list_del(&pos->list);
-			vfree(pos);
+			hash_del(&pos->hnode);
+			kernel_work->done_count--;
+			tpu_node_free(kernel_work, pos);
 		}
 	}
 
 	spin_unlock(&kernel_work->done_list_lock);
 }
 
+/*
+ * Pick the next job: highest priority first, but once TPU_PRIO_STARVE_MAX
+ * jobs in a row went ahead of a waiting lower priority, serve the lowest
+ * waiting one. task_list_lock must be held and a queue must be non-empty.
+ */
+static struct cvi_list_node *cvi_tpu_pick_task(struct cvi_kernel_work *kernel_work)
+{
+	int prio, high = -1, low = -1;
+	struct cvi_list_node *node;
+
+	for (prio = 0; prio < TPU_PRIO_NUM; prio++) {
+		if (list_empty(&kernel_work->task_list[prio]))
+			continue;
+		if (high < 0)
+			high = prio;
+		low = prio;
+	}
+
+	if (high != low && kernel_work->starve_cnt >= TPU_PRIO_STARVE_MAX) {
+		prio = low;
+		kernel_work->starve_cnt = 0;
+	} else {
+		prio = high;
+		kernel_work->starve_cnt = (high != low) ? kernel_work->starve_cnt + 1 : 0;
+	}
+
+	node = list_first_entry(&kernel_work->task_list[prio],
+				struct cvi_list_node, list);
+	list_del(&node->list);
+	kernel_work->task_count--;
+
+	return node;
+}
+
+static void tpu_prio_stat_update(struct cvi_kernel_work *kernel_work,
+				 struct cvi_list_node *node)
+{
+	struct tpu_prio_stat *stat = &kernel_work->prio_stat[node->prio];
+	u32 us = (u32)ktime_us_delta(ktime_get(), node->submit_time);
+
+	stat->done_cnt++;
+	stat->last_us = us;
+	stat->sum_us += us;
+	if (us > stat->max_us)
+		stat->max_us = us;
+}
+
 static void work_thread_run(struct cvi_tpu_device *ndev)
 {
 	struct cvi_kernel_work *kernel_work = &ndev->kernel_work;
@@ -775,10 +1213,9 @@ static void work_thread_run(struct cvi_tpu_device *ndev)
 	int ret = 0;
 
 	spin_lock(&kernel_work->task_list_lock);
-	first_node = list_first_entry(&kernel_work->task_list,
-				      struct cvi_list_node, list);
-	list_del(&first_node->list);
+	first_node = cvi_tpu_pick_task(kernel_work);
 	spin_unlock(&kernel_work->task_list_lock);
+	wake_up_interruptible(&kernel_work->task_space_queue);
 
 	//before tpu inference
 	tpu_suspend.running_cnt = 1;
@@ -791,9 +1228,8 @@ static void work_thread_run(struct cvi_tpu_device *ndev)
 	//after tpu inference
 	tpu_suspend.running_cnt = 0;
 
-	spin_lock(&kernel_work->done_list_lock);
-	list_add_tail(&first_node->list, &kernel_work->done_list);
-	spin_unlock(&kernel_work->done_list_lock);
+	tpu_prio_stat_update(kernel_work, first_node);
+	add_to_done_list(kernel_work, first_node);
 
 	wake_up_all(&kernel_work->done_wait_queue);
 
@@ -802,10 +1238,15 @@ static void work_thread_run(struct cvi_tpu_device *ndev)
 
 static int task_list_empty(struct cvi_kernel_work *kernel_work)
 {
-	int ret;
+	int ret = 1, prio;
 
 	spin_lock(&kernel_work->task_list_lock);
-	ret = list_empty(&kernel_work->task_list);
+	for (prio = 0; prio < TPU_PRIO_NUM; prio++) {
+		if (!list_empty(&kernel_work->task_list[prio])) {
+			ret = 0;
+			break;
+		}
+	}
 	spin_unlock(&kernel_work->task_list_lock);
 
 	return ret;
@@ -815,19 +1256,25 @@ static void work_thread_exit(struct cvi_tpu_device *ndev)
 {
 	struct cvi_kernel_work *kernel_work = &ndev->kernel_work;
 	struct cvi_list_node *pos, *tmp;
+	struct hlist_node *htmp;
+	int prio, bkt;
 
 	spin_lock(&kernel_work->task_list_lock);
-	list_for_each_entry_safe(pos, tmp, &kernel_work->task_list, list) {
-		list_del(&pos->list);
-		vfree(pos);
+	for (prio = 0; prio < TPU_PRIO_NUM; prio++) {
+		list_for_each_entry_safe(pos, tmp, &kernel_work->task_list[prio], list) {
+			list_del(&pos->list);
+			tpu_node_free(kernel_work, pos);
+		}
 	}
+	kernel_work->task_count = 0;
 	spin_unlock(&kernel_work->task_list_lock);
 
 	spin_lock(&kernel_work->done_list_lock);
-	list_for_each_entry_safe(pos, tmp, &kernel_work->done_list, list) {
-		list_del(&pos->list);
-		vfree(pos);
+	hash_for_each_safe(kernel_work->done_hash, bkt, htmp, pos, hnode) {
+		hash_del(&pos->hnode);
+		tpu_node_free(kernel_work, pos);
 	}
+	kernel_work->done_count = 0;
 	spin_unlock(&kernel_work->done_list_lock);
 }
 
@@ -857,18 +1304,33 @@ static int work_thread_main(void *data)
 static int work_thread_init(struct cvi_tpu_device *ndev)
 {
 	struct cvi_kernel_work *kernel_work = &ndev->kernel_work;
+	int prio, i;
 
 	init_waitqueue_head(&kernel_work->task_wait_queue);
 	init_waitqueue_head(&kernel_work->done_wait_queue);
-	INIT_LIST_HEAD(&kernel_work->task_list);
+	init_waitqueue_head(&kernel_work->task_space_queue);
+	for (prio = 0; prio < TPU_PRIO_NUM; prio++)
+		INIT_LIST_HEAD(&kernel_work->task_list[prio]);
+	kernel_work->task_count = 0;
+	kernel_work->starve_cnt = 0;
 	spin_lock_init(&kernel_work->task_list_lock);
-	INIT_LIST_HEAD(&kernel_work->done_list);
+	hash_init(kernel_work->done_hash);
+	kernel_work->done_count = 0;
 	spin_lock_init(&kernel_work->done_list_lock);
 
+	INIT_LIST_HEAD(&kernel_work->node_free);
+	spin_lock_init(&kernel_work->node_lock);
+	kernel_work->node_pool = vmalloc(TPU_NODE_POOL_NUM * sizeof(struct cvi_list_node));
+	if (!kernel_work->node_pool)
+		return -ENOMEM;
+	for (i = 0; i < TPU_NODE_POOL_NUM; i++)
+		list_add_tail(&kernel_work->node_pool[i].list, &kernel_work->node_free);
+
 	kernel_work->work_thread =
 		kthread_run(work_thread_main, ndev, "cvitask_tpu_wor");
 	if (IS_ERR(kernel_work->work_thread)) {
 		dev_err(ndev->dev, "kthread run fail\n");
+		vfree(kernel_work->node_pool);
 		return PTR_ERR(kernel_work->work_thread);
 	}
 
@@ -997,14 +1459,138 @@ static int cvi_tpu_cache_invalidate(struct cvi_tpu_device *ndev,
 	return 0;
 }
 
+int cvi_tpu_check_priority(int prio)
+{
+	if (prio < CVITPU_PRIO_HIGH || prio >= CVITPU_PRIO_MAX)
+		return -EINVAL;
+	// jumping ahead of every other client is a scheduling privilege
+	if (prio == CVITPU_PRIO_HIGH && !capable(CAP_SYS_NICE))
+		return -EPERM;
+	return 0;
+}
+
+static int cvi_tpu_set_priority(struct cvi_tpu_file *file, unsigned long arg)
+{
+	int ret;
+	int prio;
+
+	ret = get_user(prio, (int __user *)arg);
+	if (ret)
+		return ret;
+	ret = cvi_tpu_check_priority(prio);
+	if (ret)
+		return ret;
+
+	file->prio = prio;
+	return 0;
+}
+
+#ifdef DRV_TEST
+/* queue a job with no buffer, for the mock backend of tpu_test.c */
+int cvi_tpu_test_submit(struct cvi_tpu_device *ndev, u32 seq_no, u8 prio)
+{
+	struct cvi_kernel_work *kernel_work = &ndev->kernel_work;
+	struct cvi_list_node *node;
+	int ret;
+
+	ret = cvi_tpu_reserve_task(kernel_work);
+	if (ret)
+		return ret;
+
+	node = tpu_node_alloc(kernel_work);
+	if (!node) {
+		cvi_tpu_unreserve_task(kernel_work);
+		return -ENOMEM;
+	}
+
+	node->pid = current->pid;
+	node->seq_no = seq_no;
+	node->dev = ndev->dev;
+	// no dmabuf to map or release
+	node->tpu_path = TPU_PATH_DESSEC;
+
+	cvi_tpu_queue_task(kernel_work, node, prio, ktime_get());
+	return 0;
+}
+
+struct cvi_tpu_file *cvi_tpu_test_file_alloc(struct cvi_tpu_device *ndev)
+{
+	struct cvi_tpu_file *file = kzalloc(sizeof(*file), GFP_KERNEL);
+
+	if (!file)
+		return NULL;
+	file->ndev = ndev;
+	file->prio = CVITPU_PRIO_NORMAL;
+	mutex_init(&file->cache_lock);
+	atomic_set(&file->inflight, 0);
+	return file;
+}
+
+void cvi_tpu_test_file_free(struct cvi_tpu_file *file)
+{
+	cvi_tpu_cache_flush_all(file);
+	kfree(file);
+}
+
+/*
+ * Map a dmabuf as a submit does, the node stays in flight until
+ * cvi_tpu_test_unmap(). Returns what the cache lookup returned.
+ */
+int cvi_tpu_test_map(struct cvi_tpu_file *file, int fd, struct cvi_list_node **pnode)
+{
+	struct cvi_kernel_work *kernel_work = &file->ndev->kernel_work;
+	struct cvi_list_node *node;
+	int ret;
+
+	node = tpu_node_alloc(kernel_work);
+	if (!node)
+		return -ENOMEM;
+	node->dmabuf_fd = fd;
+	node->dev = file->ndev->dev;
+	node->tpu_path = TPU_PATH_DESNORMAL;
+
+	ret = cvi_tpu_map_cached(file, node);
+	if (ret && cvi_tpu_prepare_buffer(node)) {
+		tpu_node_free(kernel_work, node);
+		return -EINVAL;
+	}
+	*pnode = node;
+	return ret;
+}
+
+void cvi_tpu_test_unmap(struct cvi_tpu_file *file, struct cvi_list_node *node)
+{
+	cvi_tpu_cleanup_buffer(node);
+	tpu_node_free(&file->ndev->kernel_work, node);
+}
+
+int cvi_tpu_test_wait(struct cvi_tpu_device *ndev, u32 seq_no, int timeout_ms)
+{
+	struct cvi_kernel_work *kernel_work = &ndev->kernel_work;
+	struct cvi_list_node *node;
+	int ret;
+
+	if (!wait_event_timeout(kernel_work->done_wait_queue,
+				get_from_done_list(kernel_work, seq_no, TPU_PATH_DESSEC),
+				msecs_to_jiffies(timeout_ms)))
+		return -ETIMEDOUT;
+
+	node = get_from_done_list(kernel_work, seq_no, TPU_PATH_DESSEC);
+	ret = node->ret;
+	remove_from_done_list(kernel_work, node);
+	return ret;
+}
+#endif
+
 static long cvi_tpu_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 {
-	struct cvi_tpu_device *ndev = filp->private_data;
+	struct cvi_tpu_file *file = filp->private_data;
+	struct cvi_tpu_device *ndev = file->ndev;
 	long ret = 0;
 
 	switch (cmd) {
 	case CVITPU_SUBMIT_DMABUF:
-		ret = cvi_tpu_submit(ndev, arg);
+		ret = cvi_tpu_submit(file, arg);
 		break;
 	case CVITPU_DMABUF_FLUSH_FD:
 		ret = cvi_tpu_map_dmabuf(ndev, arg, DMA_TO_DEVICE);
@@ -1026,18 +1612,25 @@ static long cvi_tpu_ioctl(struct file *filp, unsigned int cmd, unsigned long arg
 		ret = cvi_tpu_load_tee(ndev, arg);
 		break;
 	case CVITPU_SUBMIT_TEE:
-		ret = cvi_tpu_submit_tee(ndev, arg);
+		ret = cvi_tpu_submit_tee(file, arg);
 		break;
 	case CVITPU_UNLOAD_TEE:
 		ret = cvi_tpu_unload_tee(ndev, arg);
 		break;
 
 	case CVITPU_SUBMIT_PIO:
-		ret = cvi_tpu_submit_pio(ndev, arg);
+		ret = cvi_tpu_submit_pio(file, arg);
 		break;
 	case CVITPU_WAIT_PIO:
 		ret = cvi_tpu_wait_pio(ndev, arg);
 		break;
+	case CVITPU_GET_PMU_REPORT:
+		ret = cvi_tpu_get_pmu_report(ndev, arg);
+		break;
+
+	case CVITPU_SET_PRIORITY:
+		ret = cvi_tpu_set_priority(file, arg);
+		break;
 
 	default:
 		return -ENOTTY;
@@ -1050,15 +1643,26 @@ static int cvi_tpu_open(struct inode *inode, struct file *filp)
 {
 	struct cvi_tpu_device *ndev =
 		container_of(inode->i_cdev, struct cvi_tpu_device, cdev);
+	struct cvi_tpu_file *file;
 	unsigned long flags = 0;
 	int ret;
 
+	file = kzalloc(sizeof(*file), GFP_KERNEL);
+	if (!file)
+		return -ENOMEM;
+	file->ndev = ndev;
+	file->prio = CVITPU_PRIO_NORMAL;
+	mutex_init(&file->cache_lock);
+	atomic_set(&file->inflight, 0);
+
 	spin_lock_irqsave(&ndev->close_lock, flags);
 
 	if (ndev->use_count == 0) {
 
 		ret = platform_tpu_open(ndev);
 		if (ret < 0) {
+			spin_unlock_irqrestore(&ndev->close_lock, flags);
+			kfree(file);
 			pr_err("npu open failed\n");
 			return ret;
 		}
@@ -1067,7 +1671,7 @@ static int cvi_tpu_open(struct inode *inode, struct file *filp)
 
 	spin_unlock_irqrestore(&ndev->close_lock, flags);
 
-	filp->private_data = ndev;
+	filp->private_data = file;
 
 	return 0;
 }
@@ -1077,6 +1681,11 @@ static int cvi_tpu_close(struct inode *inode, struct file *filp)
 	unsigned long flags = 0;
 	struct cvi_tpu_device *ndev =
 		container_of(inode->i_cdev, struct cvi_tpu_device, cdev);
+	struct cvi_tpu_file *file = filp->private_data;
+
+	// jobs in flight still use the cached mappings.
+	wait_event(ndev->kernel_work.done_wait_queue, !atomic_read(&file->inflight));
+	cvi_tpu_cache_flush_all(file);
 
 	spin_lock_irqsave(&ndev->close_lock, flags);
 
@@ -1084,6 +1693,7 @@ static int cvi_tpu_close(struct inode *inode, struct file *filp)
 
 	spin_unlock_irqrestore(&ndev->close_lock, flags);
 
+	kfree(file);
 	filp->private_data = NULL;
 
 	return 0;
@@ -1208,15 +1818,25 @@ static int cvi_tpu_probe(struct platform_device *pdev)
 	spin_lock_init(&ndev->close_lock);
 	ndev->use_count = 0;
 
+	//pmu reports, the last slot is the scratch of the running job
+	spin_lock_init(&ndev->pmu.lock);
+	ndev->pmu.report = vzalloc(sizeof(struct cvi_tpu_pmu_report) * (TPU_PMU_RING_NUM + 1));
+	if (ndev->pmu.report)
+		ndev->pmu.scratch = &ndev->pmu.report[TPU_PMU_RING_NUM];
+	else
+		dev_warn(dev, "no memory for pmu reports, pmu decode disabled\n");
+
 	ret = cvi_tpu_register_cdev(ndev);
 	if (ret < 0) {
 		pr_err("register chrdev error\n");
+		vfree(ndev->pmu.report);
 		return ret;
 	}
 
 	ret = work_thread_init(ndev);
 	if (ret < 0) {
 		pr_err("work thread init error\n");
+		vfree(ndev->pmu.report);
 		return ret;
 	}
 
@@ -1226,6 +1846,12 @@ static int cvi_tpu_probe(struct platform_device *pdev)
 	tpu_proc_dir = proc_mkdir("tpu", NULL);
 	if (proc_create_data("usage_profiling", 0644, tpu_proc_dir, &tpu_proc_ops, ndev) == NULL)
 		pr_err("tpu usage_profiling proc creation failed\n");
+	if (proc_create_data("pmu_report", 0444, tpu_proc_dir, &tpu_pmu_proc_ops, ndev) == NULL)
+		pr_err("tpu pmu_report proc creation failed\n");
+
+#ifdef DRV_TEST
+	tpu_test_proc_init(ndev, tpu_proc_dir);
+#endif
 
 	pr_debug("===cvi_tpu_probe end\n");
 	return 0;
@@ -1237,6 +1863,8 @@ static int cvi_tpu_remove(struct platform_device *pdev)
 	struct cvi_kernel_work *kernel_work = &ndev->kernel_work;
 
 	kthread_stop(kernel_work->work_thread);
+	vfree(kernel_work->node_pool);
+	vfree(ndev->pmu.report);
 
 	//put clock related
 	if (ndev->clk_tpu_axi)
@@ -1256,6 +1884,9 @@ static int cvi_tpu_remove(struct platform_device *pdev)
 	pr_debug("===cvi_tpu_remove\n");
 
 	//remove tpu proc
+#ifdef DRV_TEST
+	tpu_test_proc_deinit(tpu_proc_dir);
+#endif
 	proc_remove(tpu_proc_dir);
 	return 0;
 }
@@ -12,18 +12,82 @@
 #include <linux/completion.h>
 #include <linux/wait.h>
 #include <linux/list.h>
+#include <linux/hashtable.h>
 #include <linux/dma-direction.h>
 
 #include "cvi_regcpu.h"
 
+#define TPU_PRIO_NUM 3
+#define TPU_DONE_HASH_BITS 6
+#define TPU_DMABUF_CACHE_NUM 8
+
+struct cvi_list_node;
+struct cvi_tpu_file;
+struct cvi_tpu_pmu_report;
+struct proc_dir_entry;
+
+#define TPU_PMU_RING_NUM 16
+
+struct tpu_prio_stat {
+	u32 done_cnt;
+	u32 last_us;
+	u32 max_us;
+	u64 sum_us;
+};
+
 struct cvi_kernel_work {
 	struct task_struct *work_thread;
 	wait_queue_head_t task_wait_queue;
 	wait_queue_head_t done_wait_queue;
-	struct list_head task_list;
+	wait_queue_head_t task_space_queue;
+	struct list_head task_list[TPU_PRIO_NUM];
+	u32 task_count;
+	u32 starve_cnt;
 	spinlock_t task_list_lock;
-	struct list_head done_list;
+	DECLARE_HASHTABLE(done_hash, TPU_DONE_HASH_BITS);
+	u32 done_count;
 	spinlock_t done_list_lock;
+	struct tpu_prio_stat prio_stat[TPU_PRIO_NUM];
+	struct cvi_list_node *node_pool;
+	struct list_head node_free;
+	spinlock_t node_lock;
+	atomic_t cache_hit;
+	atomic_t cache_miss;
+	u32 submit_cnt;
+	u32 submit_last_ns;
+	u32 submit_max_ns;
+	u64 submit_sum_ns;
+};
+
+/* decoded PMU reports of the last TPU_PMU_RING_NUM runs with PMU armed.
+ *
+ * @scratch: filled by the platform code for the running job, under dev_lock.
+ * @scratch_ready: set by the platform code once scratch holds a report.
+ * @buf_size: size of the running dmabuf, the pmu buffer must fit in.
+ * @head: seq of the next report, report[seq % TPU_PMU_RING_NUM].
+ */
+struct tpu_pmu_ring {
+	struct cvi_tpu_pmu_report *report;
+	struct cvi_tpu_pmu_report *scratch;
+	bool scratch_ready;
+	u64 buf_size;
+	u32 head;
+	spinlock_t lock;
+};
+
+/* dmabuf segments run by the platform code.
+ *
+ * @spin_cnt: tdma done caught by spinning.
+ * @sleep_cnt: tdma done after sleeping on the irq.
+ * @gap_*: host time between the end of a segment and the fire of the next.
+ */
+struct tpu_seg_stat {
+	u32 seg_cnt;
+	u32 spin_cnt;
+	u32 sleep_cnt;
+	u32 gap_cnt;
+	u32 gap_max_ns;
+	u64 gap_sum_ns;
 };
 
 struct cvi_tpu_device {
@@ -47,6 +111,12 @@ struct cvi_tpu_device {
 	int resume_count;
 	void *private_data;
 	struct cvi_kernel_work kernel_work;
+	struct tpu_pmu_ring pmu;
+	struct tpu_seg_stat seg_stat;
+#ifdef DRV_TEST
+	/* runs queued jobs instead of the tpu if set, see tpu_test.c */
+	int (*test_run)(struct cvi_tpu_device *ndev, u32 seq_no, u8 prio);
+#endif
 };
 
 struct CMD_ID_NODE {
@@ -65,4 +135,17 @@ struct tpu_tdma_pio_info {
 	uint32_t leng_bytes;
 };
 
+int cvi_tpu_check_priority(int prio);
+
+#ifdef DRV_TEST
+int cvi_tpu_test_submit(struct cvi_tpu_device *ndev, u32 seq_no, u8 prio);
+int cvi_tpu_test_wait(struct cvi_tpu_device *ndev, u32 seq_no, int timeout_ms);
+struct cvi_tpu_file *cvi_tpu_test_file_alloc(struct cvi_tpu_device *ndev);
+void cvi_tpu_test_file_free(struct cvi_tpu_file *file);
+int cvi_tpu_test_map(struct cvi_tpu_file *file, int fd, struct cvi_list_node **pnode);
+void cvi_tpu_test_unmap(struct cvi_tpu_file *file, struct cvi_list_node *node);
+int tpu_test_proc_init(struct cvi_tpu_device *ndev, struct proc_dir_entry *dir);
+void tpu_test_proc_deinit(struct proc_dir_entry *dir);
+#endif
+
 #endif /* __CVI_TPU_INTERFACE_H__ */
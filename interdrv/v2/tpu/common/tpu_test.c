@@ -0,0 +1,615 @@
+#ifdef DRV_TEST
+#include <linux/types.h>
+#include <linux/string.h>
+#include <linux/delay.h>
+#include <linux/fs.h>
+#include <linux/cred.h>
+#include <linux/capability.h>
+#include <linux/dma-buf.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/hrtimer.h>
+
+#include "ion.h"
+#include "cvitek/cvitek_ion_alloc.h"
+
+#include <drv_test.h>
+
+#include "cvi_tpu_interface.h"
+#include "cvi_tpu_ioctl.h"
+#include "tpu_pmu.h"
+
+#define TPU_TEST_SEQ_BASE 0x7e570000
+
+/*
+ * The mock backend: every job sleeps ~0.5ms instead of touching the tpu and
+ * logs its priority, so the run order can be checked.
+ */
+static struct drv_test_log tpu_test_log;
+static u32 tpu_test_seq;
+
+static int tpu_test_mock_run(struct cvi_tpu_device *ndev, u32 seq_no, u8 prio)
+{
+	drv_test_log_add(&tpu_test_log, "HNL"[prio]);
+	usleep_range(500, 600);
+	return 0;
+}
+
+static void tpu_test_reset_log(void)
+{
+	drv_test_log_reset(&tpu_test_log);
+	tpu_test_seq = TPU_TEST_SEQ_BASE;
+}
+
+/*
+ * Hold the tpu with a job the worker already took, so the next ones queue
+ * up and the worker picks among all of them once dev_lock is released.
+ */
+static int tpu_test_stall(struct cvi_tpu_device *ndev)
+{
+	int i;
+
+	mutex_lock(&ndev->dev_lock);
+	if (cvi_tpu_test_submit(ndev, tpu_test_seq++, CVITPU_PRIO_NORMAL))
+		return -1;
+	for (i = 0; i < 100 && READ_ONCE(ndev->kernel_work.task_count); ++i)
+		usleep_range(1000, 1100);
+	return READ_ONCE(ndev->kernel_work.task_count) ? -1 : 0;
+}
+
+static int tpu_test_submit_n(struct cvi_tpu_device *ndev, int num, u8 prio)
+{
+	int i;
+
+	for (i = 0; i < num; ++i)
+		if (cvi_tpu_test_submit(ndev, tpu_test_seq++, prio))
+			return -1;
+	return 0;
+}
+
+static int tpu_test_reap_all(struct cvi_tpu_device *ndev)
+{
+	u32 seq;
+	int ret = 0;
+
+	for (seq = TPU_TEST_SEQ_BASE; seq != tpu_test_seq; ++seq)
+		if (cvi_tpu_test_wait(ndev, seq, 1000)) {
+			pr_err("seq %#x not done\n", seq);
+			ret = -1;
+		}
+	return ret;
+}
+
+/* higher priority first, fifo within one priority. */
+static int tpu_test_prio_order(struct cvi_tpu_device *ndev)
+{
+	int ret = 0;
+
+	tpu_test_reset_log();
+	if (tpu_test_stall(ndev))
+		ret = -1;
+	if (tpu_test_submit_n(ndev, 4, CVITPU_PRIO_LOW) ||
+	    tpu_test_submit_n(ndev, 4, CVITPU_PRIO_NORMAL) ||
+	    tpu_test_submit_n(ndev, 4, CVITPU_PRIO_HIGH))
+		ret = -1;
+	mutex_unlock(&ndev->dev_lock);
+
+	if (tpu_test_reap_all(ndev))
+		ret = -1;
+
+	pr_err("run order: %s\n", tpu_test_log.tag);
+	// the stalling job, then by priority
+	if (strcmp(tpu_test_log.tag, "NHHHHNNNNLLLL"))
+		ret = -1;
+
+	pr_err("tpu prio order %s\n", ret ? "FAIL" : "PASS");
+	return ret;
+}
+
+/* a waiting low job is served after TPU_PRIO_STARVE_MAX higher ones. */
+static int tpu_test_starve(struct cvi_tpu_device *ndev)
+{
+	char *low;
+	int ret = 0;
+
+	tpu_test_reset_log();
+	if (tpu_test_stall(ndev))
+		ret = -1;
+	if (tpu_test_submit_n(ndev, 1, CVITPU_PRIO_LOW) ||
+	    tpu_test_submit_n(ndev, 20, CVITPU_PRIO_HIGH))
+		ret = -1;
+	mutex_unlock(&ndev->dev_lock);
+
+	if (tpu_test_reap_all(ndev))
+		ret = -1;
+
+	pr_err("run order: %s\n", tpu_test_log.tag);
+	low = strchr(tpu_test_log.tag, 'L');
+	if (!low || low - tpu_test_log.tag != 1 + 8 ||
+	    drv_test_log_num(&tpu_test_log) != 22)
+		ret = -1;
+
+	pr_err("tpu prio anti-starvation %s\n", ret ? "FAIL" : "PASS");
+	return ret;
+}
+
+/* HIGH needs CAP_SYS_NICE, the other priorities don't. */
+static int tpu_test_prio_gate(struct cvi_tpu_device *ndev)
+{
+	const struct cred *old;
+	struct cred *cred;
+	int ret = 0;
+
+	if (cvi_tpu_check_priority(CVITPU_PRIO_MAX) != -EINVAL ||
+	    cvi_tpu_check_priority(-1) != -EINVAL)
+		ret = -1;
+	if (cvi_tpu_check_priority(CVITPU_PRIO_HIGH) != (capable(CAP_SYS_NICE) ? 0 : -EPERM))
+		ret = -1;
+
+	cred = prepare_creds();
+	if (!cred)
+		return -ENOMEM;
+	cap_lower(cred->cap_effective, CAP_SYS_NICE);
+	old = override_creds(cred);
+	if (cvi_tpu_check_priority(CVITPU_PRIO_HIGH) != -EPERM ||
+	    cvi_tpu_check_priority(CVITPU_PRIO_NORMAL) ||
+	    cvi_tpu_check_priority(CVITPU_PRIO_LOW))
+		ret = -1;
+	revert_creds(old);
+	put_cred(cred);
+
+	pr_err("tpu prio gate %s\n", ret ? "FAIL" : "PASS");
+	return ret;
+}
+
+#define TPU_TEST_BUF_NUM (TPU_DMABUF_CACHE_NUM + 2)
+
+static int tpu_test_map_hold(struct cvi_tpu_file *file, int fd, struct cvi_list_node **node)
+{
+	*node = NULL;
+	return cvi_tpu_test_map(file, fd, node);
+}
+
+static int tpu_test_map_once(struct cvi_tpu_file *file, int fd)
+{
+	struct cvi_list_node *node;
+	int ret;
+
+	ret = tpu_test_map_hold(file, fd, &node);
+	if (node)
+		cvi_tpu_test_unmap(file, node);
+	return ret;
+}
+
+/* references held on the dmabuf of fd, besides the one taken to count. */
+static long tpu_test_buf_refs(int fd)
+{
+	struct dma_buf *dma_buf = dma_buf_get(fd);
+	long refs;
+
+	if (IS_ERR(dma_buf))
+		return -1;
+	refs = file_count(dma_buf->file) - 1;
+	dma_buf_put(dma_buf);
+	return refs;
+}
+
+/*
+ * The per-client dmabuf cache on real ion buffers: hit/miss, lru eviction,
+ * released buffers evicted first, no eviction while jobs are in flight and
+ * every reference dropped when the client goes away.
+ */
+static int tpu_test_dmabuf_cache(struct cvi_tpu_device *ndev)
+{
+	struct cvi_kernel_work *kernel_work = &ndev->kernel_work;
+	struct cvi_tpu_file *file;
+	struct cvi_list_node *held;
+	int fd[TPU_TEST_BUF_NUM];
+	u32 hit, miss;
+	int i, ret = 0;
+
+	for (i = 0; i < TPU_TEST_BUF_NUM; ++i)
+		fd[i] = cvi_ion_alloc(ION_HEAP_TYPE_CARVEOUT, PAGE_SIZE, 1);
+	file = cvi_tpu_test_file_alloc(ndev);
+	for (i = 0; i < TPU_TEST_BUF_NUM; ++i)
+		if (fd[i] < 0)
+			ret = -ENOMEM;
+	if (!file || ret) {
+		pr_err("no ion buffer\n");
+		ret = -1;
+		goto out;
+	}
+
+	hit = atomic_read(&kernel_work->cache_hit);
+	miss = atomic_read(&kernel_work->cache_miss);
+
+	// first use misses, the next one hits and the cache holds one ref
+	if (tpu_test_map_once(file, fd[0]) || tpu_test_map_once(file, fd[0]))
+		ret = -1;
+	if (atomic_read(&kernel_work->cache_hit) - hit != 1 ||
+	    atomic_read(&kernel_work->cache_miss) - miss != 1 ||
+	    tpu_test_buf_refs(fd[0]) != 2)
+		ret = -1;
+	pr_err("hit/miss: %s\n", ret ? "FAIL" : "ok");
+
+	// one more buffer than entries: the least recently used one goes
+	for (i = 1; i <= TPU_DMABUF_CACHE_NUM; ++i)
+		if (tpu_test_map_once(file, fd[i]))
+			ret = -1;
+	if (tpu_test_buf_refs(fd[0]) != 1 || tpu_test_buf_refs(fd[1]) != 2)
+		ret = -1;
+	pr_err("lru eviction: %s\n", ret ? "FAIL" : "ok");
+
+	// a buffer the client closed is evicted before the lru ones
+	cvi_ion_free(current->pid, fd[5]);
+	fd[5] = -1;
+	if (tpu_test_map_once(file, fd[0]))
+		ret = -1;
+	for (i = 1; i <= TPU_DMABUF_CACHE_NUM; ++i)
+		if (i != 5 && tpu_test_buf_refs(fd[i]) != 2)
+			ret = -1;
+	pr_err("released first: %s\n", ret ? "FAIL" : "ok");
+
+	// nothing is evicted with a job in flight, the new buffer maps uncached
+	if (tpu_test_map_hold(file, fd[2], &held))
+		ret = -1;
+	if (tpu_test_map_once(file, fd[TPU_TEST_BUF_NUM - 1]) != -ENOSPC ||
+	    tpu_test_buf_refs(fd[TPU_TEST_BUF_NUM - 1]) != 1)
+		ret = -1;
+	if (held)
+		cvi_tpu_test_unmap(file, held);
+	pr_err("busy no eviction: %s\n", ret ? "FAIL" : "ok");
+
+	// the client going away drops every cached ref
+	cvi_tpu_test_file_free(file);
+	file = NULL;
+	for (i = 0; i < TPU_TEST_BUF_NUM; ++i)
+		if (fd[i] >= 0 && tpu_test_buf_refs(fd[i]) != 1)
+			ret = -1;
+out:
+	if (file)
+		cvi_tpu_test_file_free(file);
+	for (i = 0; i < TPU_TEST_BUF_NUM; ++i)
+		if (fd[i] >= 0)
+			cvi_ion_free(current->pid, fd[i]);
+	pr_err("tpu dmabuf cache %s\n", ret ? "FAIL" : "PASS");
+	return ret;
+}
+
+#define TPU_TEST_REC_MAX 16
+
+static struct TPU_PMU_DOUBLEEVENT tpu_test_rec[TPU_TEST_REC_MAX];
+static int tpu_test_rec_num;
+
+static void tpu_test_rec_add(u32 type, u32 id, u32 cnt0, u32 cnt1, u32 start, u32 end)
+{
+	struct TPU_PMU_DOUBLEEVENT *rec = &tpu_test_rec[tpu_test_rec_num++];
+
+	rec->type = type;
+	rec->desID = id;
+	rec->eventCnt0 = cnt0;
+	rec->eventCnt1 = cnt1;
+	rec->startTime = start;
+	rec->endTime = end;
+}
+
+/* a fresh report of layer_cnt layers and the records added after it. */
+static void tpu_test_pmu_reset(struct cvi_tpu_pmu_report *report, u32 layer_cnt, u32 event)
+{
+	memset(report, 0, sizeof(*report));
+	report->layer_cnt = layer_cnt;
+	report->event = event;
+	memset(tpu_test_rec, 0, sizeof(tpu_test_rec));
+	tpu_test_rec_num = 0;
+}
+
+static u32 tpu_test_pmu_decode(struct cvi_tpu_pmu_report *report)
+{
+	return TPUPMU_Decode((const u8 *)tpu_test_rec, sizeof(tpu_test_rec), report);
+}
+
+#define TPU_TEST_CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			pr_err("%s:%d %s\n", __func__, __LINE__, #cond); \
+			ret = -1; \
+		} \
+	} while (0)
+
+/* records split into layers on descriptor id restarts, per engine. */
+static int tpu_test_pmu_layers(struct cvi_tpu_pmu_report *report)
+{
+	struct cvi_tpu_pmu_layer *l = report->layer;
+	int ret = 0;
+
+	tpu_test_pmu_reset(report, 2, TPU_PMUEVENT_TDMABW);
+	l[0].tiu_desc_cnt = 2;
+	l[0].tdma_desc_cnt = 1;
+	l[1].tiu_desc_cnt = 1;
+	l[1].tdma_desc_cnt = 2;
+	tpu_test_rec_add(TPU_PMUTYPE_TDMALOAD, 1, 100, 28, 10, 20);
+	tpu_test_rec_add(TPU_PMUTYPE_TIU, 1, 0, 0, 15, 40);
+	tpu_test_rec_add(TPU_PMUTYPE_TIU, 2, 0, 0, 40, 45);
+	tpu_test_rec_add(TPU_PMUTYPE_TIU, 1, 0, 0, 50, 60);
+	tpu_test_rec_add(TPU_PMUTYPE_TDMASTORE, 1, 64, 0, 45, 55);
+	tpu_test_rec_add(TPU_PMUTYPE_TDMAMOVE, 2, 32, 32, 55, 90);
+
+	TPU_TEST_CHECK(tpu_test_pmu_decode(report) == 6);
+	TPU_TEST_CHECK(!report->rec_bad);
+	TPU_TEST_CHECK(l[0].tdma_rec_cnt == 1 && l[0].tiu_rec_cnt == 2);
+	TPU_TEST_CHECK(l[1].tdma_rec_cnt == 2 && l[1].tiu_rec_cnt == 1);
+	TPU_TEST_CHECK(l[0].tdma_cycles == 10 && l[0].tiu_cycles == 30);
+	TPU_TEST_CHECK(l[1].tdma_cycles == 45 && l[1].tiu_cycles == 10);
+	TPU_TEST_CHECK(l[0].start_cycle == 10 && l[0].end_cycle == 45);
+	TPU_TEST_CHECK(l[1].start_cycle == 45 && l[1].end_cycle == 90);
+	TPU_TEST_CHECK(l[0].tdma_bytes == 128 && l[1].tdma_bytes == 128);
+	TPU_TEST_CHECK(l[1].max_desc_cycles == 35 && l[1].max_desc_id == 2 &&
+		       l[1].max_desc_type == TPU_PMUTYPE_TDMAMOVE);
+	TPU_TEST_CHECK(report->tdma_bytes == 256 && report->tdma_cycles == 55 &&
+		       report->tiu_cycles == 40 && !report->stall_cycles);
+
+	// layers without descriptors of an engine are skipped for it
+	tpu_test_pmu_reset(report, 3, TPU_PMUEVENT_STALLCNT);
+	l[0].tiu_desc_cnt = 1;
+	l[1].tdma_desc_cnt = 1;
+	l[2].tiu_desc_cnt = 1;
+	l[2].tdma_desc_cnt = 1;
+	tpu_test_rec_add(TPU_PMUTYPE_TDMALOAD, 1, 3, 4, 0, 10);
+	tpu_test_rec_add(TPU_PMUTYPE_TIU, 1, 5, 0, 0, 10);
+	tpu_test_rec_add(TPU_PMUTYPE_TDMALOAD, 1, 0, 0, 10, 20);
+	tpu_test_rec_add(TPU_PMUTYPE_TIU, 1, 0, 1, 10, 20);
+
+	TPU_TEST_CHECK(tpu_test_pmu_decode(report) == 4);
+	TPU_TEST_CHECK(l[0].tiu_rec_cnt == 1 && !l[0].tdma_rec_cnt);
+	TPU_TEST_CHECK(l[1].tdma_rec_cnt == 1 && !l[1].tiu_rec_cnt);
+	TPU_TEST_CHECK(l[2].tdma_rec_cnt == 1 && l[2].tiu_rec_cnt == 1);
+	TPU_TEST_CHECK(l[1].stall_cycles == 7 && l[0].stall_cycles == 5 &&
+		       l[2].stall_cycles == 1 && report->stall_cycles == 13);
+	TPU_TEST_CHECK(!report->tdma_bytes);
+
+	pr_err("pmu decode layers %s\n", ret ? "FAIL" : "PASS");
+	return ret;
+}
+
+/* end of buffer, partial records, orphans, folding and counter wrap. */
+static int tpu_test_pmu_edges(struct cvi_tpu_pmu_report *report)
+{
+	struct cvi_tpu_pmu_layer *l = report->layer;
+	int ret = 0;
+
+	// nothing written: the first record has no type
+	tpu_test_pmu_reset(report, 1, TPU_PMUEVENT_TDMABW);
+	l[0].tiu_desc_cnt = 1;
+	TPU_TEST_CHECK(tpu_test_pmu_decode(report) == 0 && !l[0].tiu_rec_cnt);
+
+	// decoding stops at the first unknown type
+	tpu_test_pmu_reset(report, 1, TPU_PMUEVENT_TDMABW);
+	l[0].tiu_desc_cnt = 2;
+	tpu_test_rec_add(TPU_PMUTYPE_TIU, 1, 0, 0, 0, 1);
+	tpu_test_rec_add(0xf, 2, 0, 0, 0, 1);
+	tpu_test_rec_add(TPU_PMUTYPE_TIU, 2, 0, 0, 0, 1);
+	TPU_TEST_CHECK(tpu_test_pmu_decode(report) == 1);
+
+	// a trailing partial record is not read
+	tpu_test_pmu_reset(report, 1, TPU_PMUEVENT_TDMABW);
+	l[0].tiu_desc_cnt = 2;
+	tpu_test_rec_add(TPU_PMUTYPE_TIU, 1, 0, 0, 0, 1);
+	tpu_test_rec_add(TPU_PMUTYPE_TIU, 2, 0, 0, 0, 1);
+	TPU_TEST_CHECK(TPUPMU_Decode((const u8 *)tpu_test_rec,
+				     sizeof(tpu_test_rec[0]) * 2 - 1, report) == 1);
+
+	// an engine without any layer to go to counts as bad
+	tpu_test_pmu_reset(report, 1, TPU_PMUEVENT_TDMABW);
+	l[0].tiu_desc_cnt = 1;
+	tpu_test_rec_add(TPU_PMUTYPE_TDMALOAD, 1, 0, 0, 0, 1);
+	tpu_test_rec_add(TPU_PMUTYPE_TIU, 1, 0, 0, 0, 1);
+	TPU_TEST_CHECK(tpu_test_pmu_decode(report) == 1 && report->rec_bad == 1);
+
+	// past CVITPU_PMU_LAYER_MAX, restarts stay in the last entry
+	tpu_test_pmu_reset(report, CVITPU_PMU_LAYER_MAX + 8, TPU_PMUEVENT_TDMABW);
+	l[CVITPU_PMU_LAYER_MAX - 1].tiu_desc_cnt = 3;
+	tpu_test_rec_add(TPU_PMUTYPE_TIU, 1, 0, 0, 0, 1);
+	tpu_test_rec_add(TPU_PMUTYPE_TIU, 1, 0, 0, 1, 2);
+	tpu_test_rec_add(TPU_PMUTYPE_TIU, 1, 0, 0, 2, 3);
+	TPU_TEST_CHECK(tpu_test_pmu_decode(report) == 3 && !report->rec_bad);
+	TPU_TEST_CHECK(l[CVITPU_PMU_LAYER_MAX - 1].tiu_rec_cnt == 3);
+
+	// the 32 bit cycle counter wraps within a layer
+	tpu_test_pmu_reset(report, 1, TPU_PMUEVENT_TDMABW);
+	l[0].tdma_desc_cnt = 2;
+	tpu_test_rec_add(TPU_PMUTYPE_TDMALOAD, 1, 0, 0, 0xffffff00, 0xfffffff0);
+	tpu_test_rec_add(TPU_PMUTYPE_TDMALOAD, 2, 0, 0, 0xfffffff0, 0x100);
+	TPU_TEST_CHECK(tpu_test_pmu_decode(report) == 2);
+	TPU_TEST_CHECK(l[0].tdma_cycles == 0xf0 + 0x110);
+	TPU_TEST_CHECK(l[0].start_cycle == 0xffffff00 && l[0].end_cycle == 0x100);
+
+	pr_err("pmu decode edges %s\n", ret ? "FAIL" : "PASS");
+	return ret;
+}
+
+static int tpu_test_pmu_decode_all(void)
+{
+	struct cvi_tpu_pmu_report *report = kmalloc(sizeof(*report), GFP_KERNEL);
+	int ret;
+
+	if (!report)
+		return -ENOMEM;
+
+	ret = tpu_test_pmu_layers(report);
+	ret |= tpu_test_pmu_edges(report);
+	kfree(report);
+
+	pr_err("tpu pmu decode %s\n", ret ? "FAIL" : "PASS");
+	return ret;
+}
+
+/*
+ * The segment simulator: an hrtimer plays the tdma, raising the irq
+ * tdma_num * desc_ns after the fire as platform_tdma_irq() would.
+ */
+static struct hrtimer tpu_test_tdma_timer;
+static struct cvi_tpu_device *tpu_test_tdma_ndev;
+static ktime_t tpu_test_tdma_irq;
+
+static enum hrtimer_restart tpu_test_tdma_fire(struct hrtimer *timer)
+{
+	tpu_test_tdma_irq = ktime_get();
+	platform_test_tdma_done(tpu_test_tdma_ndev);
+	return HRTIMER_NORESTART;
+}
+
+struct tpu_test_seg_result {
+	u32 seg;
+	u32 spin;
+	u32 sleep;
+	u64 wake_sum_ns;	// from the irq to wait_tdma_done() returning
+	u32 wake_max_ns;
+};
+
+static int tpu_test_run_segs(struct cvi_tpu_device *ndev, int num, int tdma_num, u32 desc_ns,
+			     struct tpu_test_seg_result *res)
+{
+	struct tpu_seg_stat *stat = &ndev->seg_stat;
+	u32 spin = stat->spin_cnt, sleep = stat->sleep_cnt;
+	ktime_t fire;
+	u32 wake_ns;
+	long ret;
+	int i;
+
+	memset(res, 0, sizeof(*res));
+	for (i = 0; i < num; ++i) {
+		reinit_completion(&ndev->tdma_done);
+		fire = ktime_get();
+		hrtimer_start(&tpu_test_tdma_timer, ns_to_ktime((u64)tdma_num * desc_ns), HRTIMER_MODE_REL);
+		ret = platform_test_wait_tdma_done(ndev, tdma_num, fire);
+		wake_ns = ktime_to_ns(ktime_sub(ktime_get(), tpu_test_tdma_irq));
+		hrtimer_cancel(&tpu_test_tdma_timer);
+		if (ret <= 0)
+			return -1;
+
+		res->seg++;
+		res->wake_sum_ns += wake_ns;
+		if (wake_ns > res->wake_max_ns)
+			res->wake_max_ns = wake_ns;
+	}
+	res->spin = stat->spin_cnt - spin;
+	res->sleep = stat->sleep_cnt - sleep;
+
+	pr_err("%4d x %3d desc x %5d ns: spin(%4d) sleep(%4d) wake(ns) avg(%6llu) max(%6d)\n",
+	       num, tdma_num, desc_ns, res->spin, res->sleep,
+	       div_u64(res->wake_sum_ns, res->seg), res->wake_max_ns);
+	return 0;
+}
+
+/* wait_tdma_done() spins on short segments only and learns what short is. */
+static int tpu_test_seg_wait(struct cvi_tpu_device *ndev)
+{
+	struct tpu_test_seg_result res;
+	int old_budget, budget = 30;
+	u32 old_avg;
+	int ret = 0;
+
+	tpu_test_tdma_ndev = ndev;
+	hrtimer_init(&tpu_test_tdma_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	tpu_test_tdma_timer.function = tpu_test_tdma_fire;
+
+	// the simulator replaces the tdma, keep real jobs off it meanwhile
+	mutex_lock(&ndev->dev_lock);
+	old_budget = platform_test_swap_spin_budget(budget);
+	old_avg = platform_test_swap_desc_avg(0);
+
+	// short segments are spun on from the start, a hiccup may sleep one
+	TPU_TEST_CHECK(!tpu_test_run_segs(ndev, 256, 2, 1000, &res));
+	TPU_TEST_CHECK(res.spin >= res.seg * 9 / 10);
+
+	// long ones: the first may spin out the budget, the rest sleep right away
+	TPU_TEST_CHECK(!tpu_test_run_segs(ndev, 32, 50, 10000, &res));
+	TPU_TEST_CHECK(!res.spin && res.sleep == res.seg);
+
+	// back to short: the average comes down and spinning resumes
+	TPU_TEST_CHECK(!tpu_test_run_segs(ndev, 256, 2, 1000, &res));
+	TPU_TEST_CHECK(res.spin >= res.seg * 3 / 4);
+
+	// expected short but running long: spin the budget, then sleep
+	platform_test_swap_desc_avg(100);
+	TPU_TEST_CHECK(!tpu_test_run_segs(ndev, 1, 4, 500000, &res));
+	TPU_TEST_CHECK(!res.spin && res.sleep == 1);
+
+	// budget 0 always sleeps, the old behaviour
+	platform_test_swap_spin_budget(0);
+	platform_test_swap_desc_avg(0);
+	TPU_TEST_CHECK(!tpu_test_run_segs(ndev, 64, 2, 1000, &res));
+	TPU_TEST_CHECK(!res.spin && res.sleep == res.seg);
+
+	platform_test_swap_spin_budget(old_budget);
+	platform_test_swap_desc_avg(old_avg);
+	reinit_completion(&ndev->tdma_done);
+	mutex_unlock(&ndev->dev_lock);
+
+	pr_err("tpu segment wait %s\n", ret ? "FAIL" : "PASS");
+	return ret;
+}
+
+static void tpu_test_usage(struct seq_file *m)
+{
+	seq_puts(m, "  1: run queue, priority order on a mock backend\n");
+	seq_puts(m, "  2: run queue, anti-starvation of a low job\n");
+	seq_puts(m, "  3: priority, HIGH needs CAP_SYS_NICE\n");
+	seq_puts(m, "  4: dmabuf cache on ion buffers\n");
+	seq_puts(m, "  5: pmu buffer decode on crafted records\n");
+	seq_puts(m, "  6: tdma segment wait on a simulated tdma, spin or sleep\n");
+}
+
+static void tpu_test_run(void *data, uint32_t op)
+{
+	struct cvi_tpu_device *ndev = data;
+
+	// queued jobs run on the mock backend meanwhile
+	mutex_lock(&ndev->dev_lock);
+	ndev->test_run = tpu_test_mock_run;
+	mutex_unlock(&ndev->dev_lock);
+
+	switch (op) {
+	case 1:
+		tpu_test_prio_order(ndev);
+		break;
+	case 2:
+		tpu_test_starve(ndev);
+		break;
+	case 3:
+		tpu_test_prio_gate(ndev);
+		break;
+	case 4:
+		tpu_test_dmabuf_cache(ndev);
+		break;
+	case 5:
+		tpu_test_pmu_decode_all();
+		break;
+	case 6:
+		tpu_test_seg_wait(ndev);
+		break;
+	default:
+		break;
+	}
+
+	mutex_lock(&ndev->dev_lock);
+	ndev->test_run = NULL;
+	mutex_unlock(&ndev->dev_lock);
+}
+
+DRV_TEST_PROC_DEFINE(tpu_test);
+
+int tpu_test_proc_init(struct cvi_tpu_device *ndev, struct proc_dir_entry *dir)
+{
+	if (proc_create_data("tpu_test", 0644, dir, &tpu_test_proc_ops, ndev) == NULL)
+		pr_err("tpu_test_proc_init() failed\n");
+
+	return 0;
+}
+
+void tpu_test_proc_deinit(struct proc_dir_entry *dir)
+{
+	remove_proc_entry("tpu_test", dir);
+}
+
+#endif
@@ -6,6 +6,8 @@
  */
 
 #include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/version.h>
 #include <linux/io.h>
 #include <linux/dma-mapping.h>
 #include <linux/delay.h>
@@ -14,6 +16,9 @@
 #include <linux/streamline_annotate.h>
 #include <linux/clk.h>
 #include <asm/cacheflush.h>
+#if (KERNEL_VERSION(5, 10, 0) <= LINUX_VERSION_CODE)
+#include <linux/dma-map-ops.h>
+#endif
 
 #include "cvi_tpu_interface.h"
 #include "reg_tiu.h"
@@ -123,6 +128,21 @@ static spinlock_t tpu_int_got_spinlock;
 static uint8_t tpu_sync_backup;
 static uint8_t tpu_suspend_handle_int;
 static struct tpu_reg_backup_info tpu_reg_backup;
+static ktime_t tpu_int_time;
+static u32 tdma_desc_avg_ns;
+
+static int tpu_spin_budget_us = 30;
+module_param(tpu_spin_budget_us, int, 0644);
+MODULE_PARM_DESC(tpu_spin_budget_us, "spin instead of sleep on tdma segments expected within this, 0 to always sleep");
+
+static int tpu_pmu_event = TPU_PMUEVENT_TDMABW;
+module_param(tpu_pmu_event, int, 0644);
+MODULE_PARM_DESC(tpu_pmu_event, "pmu event armed for dmabufs with a pmu buffer, 0~3");
+
+static bool tpu_pmu_decode = true;
+module_param(tpu_pmu_decode, bool, 0644);
+MODULE_PARM_DESC(tpu_pmu_decode, "decode pmu buffers into /proc/tpu/pmu_report");
+
 void platform_clear_int(struct cvi_tpu_device *ndev)
 {
 	u32 reg_value, int_status;
@@ -145,6 +165,7 @@ void platform_clear_int(struct cvi_tpu_device *ndev)
 
 	spin_lock(&tpu_int_got_spinlock);
 	tpu_sync_backup = 1;
+	tpu_int_time = ktime_get();
 	spin_unlock(&tpu_int_got_spinlock);
 	pr_debug("platform_clear_int() done\n");
 }
@@ -325,6 +346,99 @@ static void platform_run_dmabuf_setArrayBase(struct TPU_PLATFORM_CFG *pCfg, stru
 	RAW_WRITE32(iomem_tdmaBase + TDMA_ARRAYBASE1_H, 0);
 }
 
+static void pmu_report_layer(struct cvi_tpu_pmu_report *report, int i,
+			     struct cvi_cpu_sync_desc_t *desc, u64 wall_ns)
+{
+	struct cvi_tpu_pmu_layer *layer = &report->layer[min(i, CVITPU_PMU_LAYER_MAX - 1)];
+
+	if (i < CVITPU_PMU_LAYER_MAX)
+		strscpy(layer->name, desc->str, sizeof(layer->name));
+	layer->tiu_desc_cnt += desc->num_bd & 0xFFFF;
+	layer->tdma_desc_cnt += desc->num_gdma & 0xFFFF;
+	layer->wall_ns += wall_ns;
+	report->wall_ns += wall_ns;
+}
+
+static void pmu_buf_invalidate(uint64_t paddr, uint32_t size)
+{
+#if (KERNEL_VERSION(5, 10, 0) <= LINUX_VERSION_CODE) && defined(__riscv)
+	arch_sync_dma_for_device(paddr, size, DMA_FROM_DEVICE);
+#else
+	__dma_map_area(phys_to_virt(paddr), size, DMA_FROM_DEVICE);
+#endif
+}
+
+/*
+ * wait_tdma_done: wait for the tdma interrupt of the segment fired at @fire.
+ *
+ * A sleep and wake-up costs more than a short segment takes, so a segment
+ * expected to end within tpu_spin_budget_us, going by the average time per
+ * tdma descriptor, is spun on; the irq still completes tdma_done. A segment
+ * late past the budget falls back to sleeping.
+ */
+static long wait_tdma_done(struct cvi_tpu_device *ndev, int tdma_num, ktime_t fire)
+{
+	u64 est_ns = (u64)tdma_desc_avg_ns * tdma_num;
+	u64 seg_ns;
+	ktime_t deadline;
+	long ret = 1;
+
+	if (tpu_spin_budget_us > 0 && est_ns <= (u64)tpu_spin_budget_us * NSEC_PER_USEC) {
+		deadline = ktime_add_us(fire, tpu_spin_budget_us);
+		while (!try_wait_for_completion(&ndev->tdma_done)) {
+			if (ktime_after(ktime_get(), deadline))
+				goto sleep;
+			cpu_relax();
+		}
+		ndev->seg_stat.spin_cnt++;
+		goto done;
+	}
+
+sleep:
+	ret = wait_for_completion_interruptible_timeout(
+		&ndev->tdma_done, msecs_to_jiffies(TIMEOUT_MS));
+	if (ret <= 0)
+		return ret;
+	ndev->seg_stat.sleep_cnt++;
+
+done:
+	seg_ns = ktime_to_ns(ktime_sub(tpu_int_time, fire));
+	tdma_desc_avg_ns = (tdma_desc_avg_ns * 7 + (u32)div_u64(seg_ns, tdma_num)) / 8;
+	return ret;
+}
+
+#ifdef DRV_TEST
+/* what the tdma irq does at the end of a segment, for the tpu_test.c simulator */
+void platform_test_tdma_done(struct cvi_tpu_device *ndev)
+{
+	spin_lock(&tpu_int_got_spinlock);
+	tpu_int_time = ktime_get();
+	spin_unlock(&tpu_int_got_spinlock);
+	complete(&ndev->tdma_done);
+}
+
+long platform_test_wait_tdma_done(struct cvi_tpu_device *ndev, int tdma_num, ktime_t fire)
+{
+	return wait_tdma_done(ndev, tdma_num, fire);
+}
+
+u32 platform_test_swap_desc_avg(u32 avg_ns)
+{
+	u32 old = tdma_desc_avg_ns;
+
+	tdma_desc_avg_ns = avg_ns;
+	return old;
+}
+
+int platform_test_swap_spin_budget(int budget_us)
+{
+	int old = tpu_spin_budget_us;
+
+	tpu_spin_budget_us = budget_us;
+	return old;
+}
+#endif
+
 int platform_run_dmabuf(struct cvi_tpu_device *ndev, void *dmabuf_v, uint64_t dmabuf_p)
 {
 	int i = 0, ret = -1;
@@ -335,6 +449,10 @@ int platform_run_dmabuf(struct cvi_tpu_device *ndev, void *dmabuf_v, uint64_t dm
 
 	struct TPU_PLATFORM_CFG cfg;
 	struct CMD_ID_NODE id_node = {0};
+	struct cvi_tpu_pmu_report *report = NULL;
+	enum TPU_PMUEVENT pmu_event = tpu_pmu_event & 0x3;
+	ktime_t seg_start = 0, seg_done = 0;
+	u32 gap_ns;
 
 	pr_debug("dmabuf_v=0x%p, dmabuf_p=0x%llx\n", dmabuf_v, dmabuf_p);
 
@@ -366,8 +484,17 @@ int platform_run_dmabuf(struct cvi_tpu_device *ndev, void *dmabuf_v, uint64_t dm
 	if ((header->pmubuf_offset) && (header->pmubuf_size))
 		u8pmu_enable = 1;
 
+	//decode only a pmu buffer inside the dmabuf
+	if (u8pmu_enable && tpu_pmu_decode && ndev->pmu.scratch &&
+	    (u64)header->pmubuf_offset + header->pmubuf_size <= ndev->pmu.buf_size) {
+		report = ndev->pmu.scratch;
+		memset(report, 0, sizeof(*report));
+		report->event = pmu_event;
+		report->layer_cnt = header->cpu_desc_count;
+	}
+
 	if (u8pmu_enable)
-		TPUPMU_Enable(&cfg, 1, TPU_PMUEVENT_TDMABW);
+		TPUPMU_Enable(&cfg, 1, pmu_event);
 
 	for (i = 0; i < header->cpu_desc_count; i++, desc++) {
 		int bd_num = desc->num_bd & 0xFFFF;
@@ -378,6 +505,17 @@ int platform_run_dmabuf(struct cvi_tpu_device *ndev, void *dmabuf_v, uint64_t dm
 		reinit_completion(&ndev->tdma_done);
 		resync_cmd_id(&cfg);
 
+		//host time between the end of a segment and the fire of the next
+		seg_start = ktime_get();
+		if (seg_done) {
+			gap_ns = ktime_to_ns(ktime_sub(seg_start, seg_done));
+			ndev->seg_stat.gap_cnt++;
+			ndev->seg_stat.gap_sum_ns += gap_ns;
+			if (gap_ns > ndev->seg_stat.gap_max_ns)
+				ndev->seg_stat.gap_max_ns = gap_ns;
+		}
+		ndev->seg_stat.seg_cnt++;
+
 		id_node.bd_cmd_id = bd_num;
 		id_node.tdma_cmd_id = tdma_num;
 
@@ -395,8 +533,7 @@ int platform_run_dmabuf(struct cvi_tpu_device *ndev, void *dmabuf_v, uint64_t dm
 
 		/////////////////wait
 		if (tdma_num > 0) {
-			ret = wait_for_completion_interruptible_timeout(
-				&ndev->tdma_done, msecs_to_jiffies(TIMEOUT_MS));
+			ret = wait_tdma_done(ndev, tdma_num, seg_start);
 
 			//clear int, tdma int must be edge_triiger, for security compatible support
 			//platform_clear_int(ndev);
@@ -424,13 +561,17 @@ int platform_run_dmabuf(struct cvi_tpu_device *ndev, void *dmabuf_v, uint64_t dm
 				return -ETIMEDOUT;
 			}
 		}
+
+		seg_done = tdma_num > 0 ? tpu_int_time : ktime_get();
+		if (report)
+			pmu_report_layer(report, i, desc, ktime_to_ns(ktime_sub(ktime_get(), seg_start)));
 	}
 
 	//disable PMU
 	if (u8pmu_enable) {
 		reinit_completion(&ndev->tdma_done);
 
-		TPUPMU_Enable(&cfg, 0, TPU_PMUEVENT_TDMABW);
+		TPUPMU_Enable(&cfg, 0, pmu_event);
 
 		if (!tpu_suspend_handle_int) {
 			ret = wait_for_completion_interruptible_timeout(&ndev->tdma_done, msecs_to_jiffies(TIMEOUT_MS));
@@ -451,8 +592,11 @@ int platform_run_dmabuf(struct cvi_tpu_device *ndev, void *dmabuf_v, uint64_t dm
 		//cv180x project not support tpu TEE
 		//platform_clear_int(ndev);
 
-		//parsing pmubuf content, depracated way, move to user space
-		//TPUPMU_ParsingResult((u8 *)((u64)dmabuf_v + (u64)(header->pmubuf_offset)));
+		//the raw pmubuf stays for user space, only a summary is kept here
+		if (report) {
+			pmu_buf_invalidate(cfg.pmubuf_addr_p, header->pmubuf_size);
+			TPUPMU_Decode((u8 *)dmabuf_v + header->pmubuf_offset, header->pmubuf_size, report);
+		}
 	}
 
 	if (ndev->clk_tpu_axi) {
@@ -461,6 +605,11 @@ int platform_run_dmabuf(struct cvi_tpu_device *ndev, void *dmabuf_v, uint64_t dm
 		//__dma_map_area(phys_to_virt((uint64_t)dmabuf_p), sizeof(struct dma_hdr_t), DMA_TO_DEVICE);
 	}
 
+	if (report) {
+		report->tpu_clk_rate = header->tpu_clk_rate;
+		ndev->pmu.scratch_ready = true;
+	}
+
 	PLATTAG_CHANNEL_END(1);
 	PLATTAG_NAME_CHANNEL(1, 1, "tpu_SW");
 	PLATTAG_NAME_CHANNEL(2, 1, "tpu_HW");
@@ -97,6 +97,13 @@ void platform_tpu_spll_divide(struct cvi_tpu_device *ndev, u32 div);
 int platform_tpu_probe_setting(void);
 int platform_run_pio(struct cvi_tpu_device *ndev, struct tpu_tdma_pio_info *info);
 
+#ifdef DRV_TEST
+void platform_test_tdma_done(struct cvi_tpu_device *ndev);
+long platform_test_wait_tdma_done(struct cvi_tpu_device *ndev, int tdma_num, ktime_t fire);
+u32 platform_test_swap_desc_avg(u32 avg_ns);
+int platform_test_swap_spin_budget(int budget_us);
+#endif
+
 #define RAW_READ32(addr) readl(addr)
 #define RAW_WRITE32(addr, value) writel(value, addr)
 
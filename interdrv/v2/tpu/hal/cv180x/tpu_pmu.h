@@ -9,6 +9,7 @@
 #define __TPU_PMU_H__
 
 #include "tpu_platform.h"
+#include "cvi_tpu_ioctl.h"
 
 enum TPU_PMUEVENT {
 	TPU_PMUEVENT_BANKCONFLICT	= 0x0,
@@ -34,7 +35,7 @@ struct TPU_PMU_DOUBLEEVENT {
 };
 
 int TPUPMU_Enable(struct TPU_PLATFORM_CFG *pCfg, u8 enable, enum TPU_PMUEVENT event);
-int TPUPMU_ParsingResult(u8 *pbuf_start);
+u32 TPUPMU_Decode(const u8 *pbuf, u32 size, struct cvi_tpu_pmu_report *report);
 
 
 #endif
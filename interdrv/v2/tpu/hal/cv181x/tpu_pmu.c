@@ -127,3 +127,109 @@ int TPUPMU_Enable(struct TPU_PLATFORM_CFG *pCfg, u8 enable, enum TPU_PMUEVENT ev
 	return 0;
 }
 
+
+static int TPUPMU_NextLayer(const struct cvi_tpu_pmu_report *report, int from, bool tiu)
+{
+	int i, num = min_t(u32, report->layer_cnt, CVITPU_PMU_LAYER_MAX);
+
+	for (i = from; i < num; i++) {
+		if (tiu ? report->layer[i].tiu_desc_cnt : report->layer[i].tdma_desc_cnt)
+			return i;
+	}
+
+	return -1;
+}
+
+/*
+ * TPUPMU_Decode: sum up the records of a pmu buffer into the report layers.
+ *
+ * The caller fills layer_cnt, event and the per layer descriptor counts.
+ * Records come in execution order per engine, and the descriptor ids restart
+ * at every cpu sync descriptor, so a non increasing id moves that engine to
+ * its next layer with descriptors. Decoding stops at the first record with
+ * an unknown type, i.e. the end of what the PMU wrote.
+ *
+ * @pbuf: pmu buffer, already invalidated from the cpu cache.
+ * @size: pmu buffer size in bytes.
+ * @report: report to fill.
+ *
+ * Return the number of records decoded.
+ */
+u32 TPUPMU_Decode(const u8 *pbuf, u32 size, struct cvi_tpu_pmu_report *report)
+{
+	const struct TPU_PMU_DOUBLEEVENT *rec = (const struct TPU_PMU_DOUBLEEVENT *)pbuf;
+	u32 i, num = size / sizeof(*rec);
+	int layer_num = min_t(u32, report->layer_cnt, CVITPU_PMU_LAYER_MAX);
+	int cur[2], last_id[2] = {-1, -1};	// [0] tdma, [1] tiu
+
+	cur[0] = TPUPMU_NextLayer(report, 0, false);
+	cur[1] = TPUPMU_NextLayer(report, 0, true);
+
+	for (i = 0; i < num; i++, rec++) {
+		struct cvi_tpu_pmu_layer *layer;
+		u32 type = rec->type;
+		int id = rec->desID;
+		u32 cycles, cnt;
+		int eng, next;
+
+		if (type < TPU_PMUTYPE_TDMALOAD || type > TPU_PMUTYPE_TIU)
+			break;
+
+		eng = (type == TPU_PMUTYPE_TIU);
+		if (last_id[eng] >= 0 && id <= last_id[eng] && cur[eng] >= 0) {
+			// layers folded into the last entry keep restarting there
+			next = TPUPMU_NextLayer(report, cur[eng] + 1, eng);
+			if (next >= 0)
+				cur[eng] = next;
+		}
+		last_id[eng] = id;
+
+		if (cur[eng] < 0 || cur[eng] >= layer_num) {
+			report->rec_bad++;
+			continue;
+		}
+
+		layer = &report->layer[cur[eng]];
+		cycles = rec->endTime - rec->startTime;
+		cnt = rec->eventCnt0 + rec->eventCnt1;
+
+		if (!layer->tiu_rec_cnt && !layer->tdma_rec_cnt) {
+			layer->start_cycle = rec->startTime;
+			layer->end_cycle = rec->endTime;
+		} else {
+			if ((s32)(rec->startTime - layer->start_cycle) < 0)
+				layer->start_cycle = rec->startTime;
+			if ((s32)(rec->endTime - layer->end_cycle) > 0)
+				layer->end_cycle = rec->endTime;
+		}
+
+		if (eng) {
+			layer->tiu_rec_cnt++;
+			layer->tiu_cycles += cycles;
+		} else {
+			layer->tdma_rec_cnt++;
+			layer->tdma_cycles += cycles;
+			if (report->event == TPU_PMUEVENT_TDMABW)
+				layer->tdma_bytes += cnt;
+		}
+
+		if (report->event == TPU_PMUEVENT_STALLCNT)
+			layer->stall_cycles += cnt;
+
+		if (cycles > layer->max_desc_cycles) {
+			layer->max_desc_cycles = cycles;
+			layer->max_desc_id = id;
+			layer->max_desc_type = type;
+		}
+		report->rec_cnt++;
+	}
+
+	for (i = 0; i < layer_num; i++) {
+		report->tdma_bytes += report->layer[i].tdma_bytes;
+		report->tdma_cycles += report->layer[i].tdma_cycles;
+		report->tiu_cycles += report->layer[i].tiu_cycles;
+		report->stall_cycles += report->layer[i].stall_cycles;
+	}
+
+	return report->rec_cnt;
+}
@@ -22,9 +22,11 @@
 #include <linux/of_device.h>
 #include <linux/platform_device.h>
 #include <linux/poll.h>
+#include <linux/proc_fs.h>
 #include <linux/reset.h>
 #include <linux/slab.h>
 #include <linux/sched.h>
+#include <linux/seq_file.h>
 #include <linux/uaccess.h>
 #include <linux/version.h>
 #include <linux/wait.h>
@@ -113,6 +115,8 @@ static vpudrv_buffer_t s_video_memory = { 0 };
 static void *pCviVpuDevice;
 #endif
 
+static struct proc_dir_entry *vcodec_proc_dir;
+
 static int vpu_hw_reset(void);
 
 static int s_vpu_open_ref_count;
@@ -304,7 +308,7 @@ static int vpu_alloc_dma_buffer(vpudrv_buffer_t *vb)
 
 	VCODEC_DBG_TRACE("size = 0x%X\n", vb->size);
 #ifdef VPU_SUPPORT_RESERVED_VIDEO_MEMORY
-	vb->phys_addr = (unsigned long)vmem_alloc(&s_vmem, vb->size, 0);
+	vb->phys_addr = (unsigned long)vmem_alloc(&s_vmem, vb->size, current->tgid);
 	if ((unsigned long)vb->phys_addr == (unsigned long)-1) {
 		VCODEC_DBG_ERR("Physical memory allocation error size=%d\n",
 		       vb->size);
@@ -363,11 +367,122 @@ static int vpu_free_buffers(struct file *filp)
 }
 #endif
 
+/*
+ * vpu_irq_event_push: record an interrupt of the core, irq handler only.
+ *
+ * The slot is invalidated before being rewritten, so a waiter copying it
+ * concurrently fails its claim instead of returning a torn event.
+ */
+static void vpu_irq_event_push(struct cvi_vcodec_context *pvctx,
+			       unsigned long reason, int inst_idx)
+{
+	struct vpu_irq_event_ring *ring = &pvctx->irq_events;
+	u32 seq = ring->head + 1;
+	struct vpu_irq_event *ev = &ring->ev[seq % VPU_IRQ_EVENT_NUM];
+	int old;
+
+	old = atomic_xchg(&ev->state, 0);
+	if (old && !(old & 1)) {
+		atomic_inc(&ring->overflow);
+		VCODEC_DBG_WARN("irq event ring overflow, lost reason 0x%lx\n", ev->reason);
+	}
+
+	ev->reason = reason;
+	ev->inst_idx = inst_idx;
+	ev->timestamp = pvctx->irq_timestamp;
+	atomic_set_release(&ev->state, seq << 1);
+	smp_store_release(&ring->head, seq);
+}
+
+/*
+ * vpu_irq_event_pop: claim the oldest event of the core for inst_idx.
+ *
+ * @inst_idx: instance waited for, -1 for any. Events whose instance is not
+ *            known match every waiter.
+ * @out: the claimed event.
+ *
+ * Return true if an event was claimed.
+ */
+static bool vpu_irq_event_pop(struct cvi_vcodec_context *pvctx, int inst_idx,
+			      struct vpu_irq_event *out)
+{
+	struct vpu_irq_event_ring *ring = &pvctx->irq_events;
+	u32 head = smp_load_acquire(&ring->head);
+	u32 seq = head >= VPU_IRQ_EVENT_NUM ? head - VPU_IRQ_EVENT_NUM + 1 : 1;
+	struct vpu_irq_event *ev;
+	int state;
+
+	for (; (s32)(head - seq) >= 0; seq++) {
+		ev = &ring->ev[seq % VPU_IRQ_EVENT_NUM];
+		state = atomic_read_acquire(&ev->state);
+
+		// taken, being rewritten or already replaced by a newer one
+		if (state != (int)(seq << 1))
+			continue;
+		if (inst_idx >= 0 && ev->inst_idx >= 0 && ev->inst_idx != inst_idx)
+			continue;
+
+		out->reason = ev->reason;
+		out->inst_idx = ev->inst_idx;
+		out->timestamp = ev->timestamp;
+		if (atomic_cmpxchg(&ev->state, state, state | 1) == state)
+			return true;
+	}
+
+	return false;
+}
+
+// keep an interrupt we could not clear from firing again until the next wait
+static void vpu_irq_mask(struct cvi_vcodec_context *pvctx)
+{
+#if (KERNEL_VERSION(5, 10, 0) <= LINUX_VERSION_CODE) && defined(__riscv)
+#else
+	if (!atomic_xchg(&pvctx->irq_events.irq_masked, 1))
+		disable_irq_nosync(pvctx->s_vcodec_irq);
+#endif
+}
+
+/*
+ * vpu_irq_event_reset: drop the events left in the ring of the core, so a
+ * session never gets one from the instances closed before it.
+ *
+ * The irq is held off while the slots are cleared, the handler being their
+ * only writer. The sequence keeps going for waiters still scanning.
+ */
+static void vpu_irq_event_reset(struct cvi_vcodec_context *pvctx)
+{
+	struct vpu_irq_event_ring *ring = &pvctx->irq_events;
+	int i;
+
+	if (pvctx->s_vcodec_irq > 0)
+		disable_irq(pvctx->s_vcodec_irq);
+	for (i = 0; i < VPU_IRQ_EVENT_NUM; i++)
+		atomic_set(&ring->ev[i].state, 0);
+	if (pvctx->s_vcodec_irq > 0)
+		enable_irq(pvctx->s_vcodec_irq);
+}
+
+// events of the ring still waiting to be claimed
+static u32 vpu_irq_event_pending(struct cvi_vcodec_context *pvctx)
+{
+	struct vpu_irq_event_ring *ring = &pvctx->irq_events;
+	u32 i, num = 0;
+	int state;
+
+	for (i = 0; i < VPU_IRQ_EVENT_NUM; i++) {
+		state = atomic_read(&ring->ev[i].state);
+		if (state && !(state & 1))
+			num++;
+	}
+	return num;
+}
+
 static irqreturn_t vpu_irq_handler(int irq, void *dev_id)
 {
-	vpu_drv_context_t *dev = &vcodec_dev.s_vpu_drv_context;
 	struct cvi_vcodec_context *pvctx = (struct cvi_vcodec_context *) dev_id;
 	int coreIdx = -1;
+	int inst_idx = -1;
+	unsigned long reason = 0;
 	// (INT_BIT_PIC_RUN | INT_BIT_BIT_BUF_FULL)
 	unsigned long bsMask = (1 << W4_INT_ENC_PIC) | (1 << W4_INT_BSBUF_EMPTY);
 
@@ -376,16 +491,12 @@ static irqreturn_t vpu_irq_handler(int irq, void *dev_id)
 
 	VCODEC_DBG_INTR("[+]%s\n", __func__);
 
-#if (KERNEL_VERSION(5, 10, 0) <= LINUX_VERSION_CODE) && defined(__riscv)
-#else
-	disable_irq_nosync(pvctx->s_vcodec_irq);
-#endif
-
 	if (pvctx->s_bit_firmware_info.size ==
 			0) {
 		/* it means that we didn't get an information		  */
 		/* the current core from API layer. No core activated.*/
 		VCODEC_DBG_ERR("s_bit_firmware_info.size is zero\n");
+		vpu_irq_mask(pvctx);
 		return IRQ_HANDLED;
 	}
 
@@ -399,40 +510,39 @@ static irqreturn_t vpu_irq_handler(int irq, void *dev_id)
 
 	VCODEC_DBG_TRACE("product_code = 0x%X\n", product_code);
 
+	// the instance index is the one of the command the core last took
 	if (PRODUCT_CODE_W_SERIES(product_code)) {
 		if (ReadVpuRegister(W4_VPU_VPU_INT_STS)) {
-			pvctx->interrupt_reason =
-				ReadVpuRegister(W4_VPU_INT_REASON);
-			WriteVpuRegister(W4_VPU_INT_REASON_CLEAR,
-					pvctx->interrupt_reason);
+			reason = ReadVpuRegister(W4_VPU_INT_REASON);
+			inst_idx = ReadVpuRegister(W4_INST_INDEX) & 0xFFFF;
+			WriteVpuRegister(W4_VPU_INT_REASON_CLEAR, reason);
 			WriteVpuRegister(W4_VPU_VINT_CLEAR, 0x1);
 		}
 		coreIdx = 0;
 	} else if (PRODUCT_CODE_NOT_W_SERIES(product_code)) {
 		if (ReadVpuRegister(BIT_INT_STS)) {
-			pvctx->interrupt_reason =
-				ReadVpuRegister(BIT_INT_REASON);
+			reason = ReadVpuRegister(BIT_INT_REASON);
+			inst_idx = ReadVpuRegister(BIT_RUN_INDEX);
 			WriteVpuRegister(BIT_INT_CLEAR, 0x1);
 		}
 		coreIdx = 1;
 	} else {
 		VCODEC_DBG_ERR("Unknown product id : %08x\n",
 				product_code);
+		vpu_irq_mask(pvctx);
 		return IRQ_HANDLED;
 	}
 
-	VCODEC_DBG_INTR("product: 0x%08x intr_reason: 0x%08lx\n",
-			product_code, pvctx->interrupt_reason);
-	VCODEC_DBG_INTR("intr_reason: 0x%lX\n",
-			pvctx->interrupt_reason);
+	VCODEC_DBG_INTR("product: 0x%08x intr_reason: 0x%08lx inst: %d\n",
+			product_code, reason, inst_idx);
 
-	if (dev->async_queue)
-		kill_fasync(&dev->async_queue, SIGIO,
-				POLL_IN); /* notify the interrupt to user space */
+	if (!reason)
+		return IRQ_HANDLED;
 
-	pvctx->s_interrupt_flag = 1;
+	pvctx->interrupt_reason = reason;
+	vpu_irq_event_push(pvctx, reason, inst_idx);
 
-	if ((pvctx->interrupt_reason & bsMask)) {
+	if ((reason & bsMask)) {
 		if (chnIdxMapping[coreIdx] != -1) {
 			//wake_up(&tWaitQueue[chnIdxMapping[coreIdx]]);
 		}
@@ -515,12 +625,13 @@ int sbm_wait_interrupt(int timeout)
 }
 EXPORT_SYMBOL(sbm_wait_interrupt);
 
-// VDI_IOCTL_WAIT_INTERRUPT
-int vpu_wait_interrupt(vpudrv_intr_info_t *p_intr_info)
+// VDI_IOCTL_WAIT_INTERRUPT, for the instance inst_idx or any with -1
+int vpu_wait_interrupt_inst(vpudrv_intr_info_t *p_intr_info, int inst_idx)
 {
 	int ret = 0;
 	vpudrv_intr_info_t info;
 	struct cvi_vcodec_context *pvctx = NULL;
+	struct vpu_irq_event ev;
 
 	memcpy(&info, p_intr_info, sizeof(vpudrv_intr_info_t));
 
@@ -529,11 +640,18 @@ int vpu_wait_interrupt(vpudrv_intr_info_t *p_intr_info)
 
 	pvctx = &vcodec_dev.vcodec_ctx[info.coreIdx];
 
-	VCODEC_DBG_TRACE("coreIdx = %d, s_interrupt_flag = 0x%X\n",
-			info.coreIdx, pvctx->s_interrupt_flag);
+	VCODEC_DBG_TRACE("coreIdx = %d, inst = %d, head = %u\n",
+			info.coreIdx, inst_idx, pvctx->irq_events.head);
+
+#if (KERNEL_VERSION(5, 10, 0) <= LINUX_VERSION_CODE) && defined(__riscv)
+#else
+	if (atomic_xchg(&pvctx->irq_events.irq_masked, 0))
+		enable_irq(pvctx->s_vcodec_irq);
+#endif
 
+	// a claimed event is always returned, nothing is dropped on the way out
 	ret = wait_event_timeout(
-		pvctx->s_interrupt_wait_q, pvctx->s_interrupt_flag != 0,
+		pvctx->s_interrupt_wait_q, vpu_irq_event_pop(pvctx, inst_idx, &ev),
 		msecs_to_jiffies(info.timeout));
 	if (!ret) {
 		ret = -ETIME;
@@ -541,35 +659,140 @@ int vpu_wait_interrupt(vpudrv_intr_info_t *p_intr_info)
 	}
 
 	ANNOTATE_CHANNEL_COLOR(1, ANNOTATE_GREEN, "vcodec end");
-	if (signal_pending(current)) {
-		ret = -ERESTARTSYS;
-		return ret;
-	}
 
-	VCODEC_DBG_INTR("s_interrupt_flag(%d), reason(0x%08lx)\n",
-		pvctx->s_interrupt_flag, pvctx->interrupt_reason);
+	VCODEC_DBG_INTR("inst(%d), reason(0x%08lx)\n", ev.inst_idx, ev.reason);
 
-	info.intr_reason = pvctx->interrupt_reason;
-	info.intr_tv_sec = pvctx->irq_timestamp.tv_sec;
-	info.intr_tv_nsec = pvctx->irq_timestamp.tv_nsec;
-	pvctx->s_interrupt_flag = 0;
+	info.intr_reason = ev.reason;
+	info.intr_tv_sec = ev.timestamp.tv_sec;
+	info.intr_tv_nsec = ev.timestamp.tv_nsec;
 	pvctx->interrupt_reason = 0;
 
 	memcpy(p_intr_info, &info, sizeof(vpudrv_intr_info_t));
 	ret = 0;
 
-#if (KERNEL_VERSION(5, 10, 0) <= LINUX_VERSION_CODE) && defined(__riscv)
-#else
-	enable_irq(pvctx->s_vcodec_irq);
-#endif
-
 	ANNOTATE_CHANNEL_END(1);
 	ANNOTATE_NAME_CHANNEL(1, 1, "vcodec end");
 
 	return ret;
 }
+EXPORT_SYMBOL(vpu_wait_interrupt_inst);
+
+int vpu_wait_interrupt(vpudrv_intr_info_t *p_intr_info)
+{
+	return vpu_wait_interrupt_inst(p_intr_info, -1);
+}
 EXPORT_SYMBOL(vpu_wait_interrupt);
 
+#ifdef DRV_TEST
+/* what vpu_irq_handler() does with a decoded interrupt, for vcodec_test.c */
+void vpu_test_irq_event(int coreIdx, unsigned long reason, int inst_idx)
+{
+	struct cvi_vcodec_context *pvctx = &vcodec_dev.vcodec_ctx[coreIdx];
+
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(5, 10, 0))
+	ktime_get_ts64(&pvctx->irq_timestamp);
+#else
+	ktime_get_ts(&pvctx->irq_timestamp);
+#endif
+	vpu_irq_event_push(pvctx, reason, inst_idx);
+	wake_up(&pvctx->s_interrupt_wait_q);
+}
+
+void vpu_test_irq_event_reset(int coreIdx)
+{
+	vpu_irq_event_reset(&vcodec_dev.vcodec_ctx[coreIdx]);
+}
+
+int vpu_test_open_count(void)
+{
+	return s_vpu_open_ref_count;
+}
+#endif
+
+static int vcodec_irq_proc_show(struct seq_file *m, void *v)
+{
+	struct cvi_vcodec_context *pvctx;
+	struct vpu_irq_event_ring *ring;
+	int core;
+
+	seq_printf(m, "%-4s %10s %8s %8s %6s\n", "core", "irq", "pending", "overflow", "masked");
+	for (core = 0; core < MAX_NUM_VPU_CORE; core++) {
+		pvctx = &vcodec_dev.vcodec_ctx[core];
+		ring = &pvctx->irq_events;
+		seq_printf(m, "%-4d %10u %8u %8d %6d\n", core, READ_ONCE(ring->head),
+			   vpu_irq_event_pending(pvctx), atomic_read(&ring->overflow),
+			   atomic_read(&ring->irq_masked));
+	}
+	return 0;
+}
+
+static int vcodec_irq_proc_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, vcodec_irq_proc_show, PDE_DATA(inode));
+}
+
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(5, 10, 0))
+static const struct proc_ops vcodec_irq_proc_ops = {
+	.proc_open = vcodec_irq_proc_open,
+	.proc_read = seq_read,
+	.proc_release = single_release,
+};
+#else
+static const struct file_operations vcodec_irq_proc_ops = {
+	.owner = THIS_MODULE,
+	.open = vcodec_irq_proc_open,
+	.read = seq_read,
+	.release = single_release,
+};
+#endif
+
+#ifndef CVI_H26X_USE_ION_FW_BUFFER
+#ifdef VPU_SUPPORT_RESERVED_VIDEO_MEMORY
+static int vcodec_vmem_proc_show(struct seq_file *m, void *v)
+{
+	vmem_info_t info;
+	vmem_frag_info_t frag;
+	int i;
+
+	if (down_interruptible(&s_vpu_sem))
+		return -ERESTARTSYS;
+	vmem_get_info(&s_vmem, &info);
+	vmem_get_frag_info(&s_vmem, &frag);
+	up(&s_vpu_sem);
+
+	seq_printf(m, "page 0x%lx total %lu alloc %lu free %lu alloc fail %lu\n",
+		   info.page_size, info.total_pages, info.alloc_pages, info.free_pages,
+		   frag.alloc_fail);
+	seq_printf(m, "free extents %lu largest %lu pages\n",
+		   frag.free_extents, frag.largest_free_pages);
+	for (i = 0; i < VMEM_FRAG_HIST_NUM; i++)
+		seq_printf(m, "  %s%4lu pages: %lu\n", i == VMEM_FRAG_HIST_NUM - 1 ? ">=" : "  ",
+			   1UL << i, frag.hist[i]);
+	return 0;
+}
+
+static int vcodec_vmem_proc_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, vcodec_vmem_proc_show, PDE_DATA(inode));
+}
+
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(5, 10, 0))
+static const struct proc_ops vcodec_vmem_proc_ops = {
+	.proc_open = vcodec_vmem_proc_open,
+	.proc_read = seq_read,
+	.proc_release = single_release,
+};
+#else
+static const struct file_operations vcodec_vmem_proc_ops = {
+	.owner = THIS_MODULE,
+	.open = vcodec_vmem_proc_open,
+	.read = seq_read,
+	.release = single_release,
+};
+#endif
+#endif /*VPU_SUPPORT_RESERVED_VIDEO_MEMORY*/
+#endif /*CVI_H26X_USE_ION_FW_BUFFER*/
+
 // VDI_IOCTL_SET_CLOCK_GATE_EXT
 int vpu_set_clock_gate_ext(struct clk_ctrl_info *p_info)
 {
@@ -652,6 +875,10 @@ int vpu_open_instance(vpudrv_inst_info_t *p_inst_info)
 	}
 	spin_unlock(&s_vpu_lock);
 
+	// the first instance on the core starts from an empty event ring
+	if (inst_info.inst_open_count == 1 && inst_info.core_idx < MAX_NUM_VPU_CORE)
+		vpu_irq_event_reset(&vcodec_dev.vcodec_ctx[inst_info.core_idx]);
+
 	s_vpu_open_ref_count++; /* flag just for that vpu is in opened or closed */
 
 	memcpy(p_inst_info, &inst_info, sizeof(vpudrv_inst_info_t));
@@ -690,6 +917,10 @@ int vpu_close_instance(vpudrv_inst_info_t *p_inst_info)
 	}
 	spin_unlock(&s_vpu_lock);
 
+	// nobody left to claim what the last instance did not
+	if (inst_info.inst_open_count == 0 && inst_info.core_idx < MAX_NUM_VPU_CORE)
+		vpu_irq_event_reset(&vcodec_dev.vcodec_ctx[inst_info.core_idx]);
+
 	s_vpu_open_ref_count--; /* flag just for that vpu is in opened or closed */
 
 	memcpy(p_inst_info, &inst_info, sizeof(vpudrv_inst_info_t));
@@ -1073,13 +1304,6 @@ static int vpu_release(struct inode *inode, struct file *filp)
 	return 0;
 }
 
-static int vpu_fasync(int fd, struct file *filp, int mode)
-{
-	struct vpu_drv_context_t *dev =
-		(struct vpu_drv_context_t *)&vcodec_dev.s_vpu_drv_context;
-	return fasync_helper(fd, filp, mode, &dev->async_queue);
-}
-
 static int vpu_map_to_register(struct file *filp, struct vm_area_struct *vm)
 {
 	#ifdef VPU_SUPPORT_GLOBAL_DEVICE_CONTEXT
@@ -1192,7 +1416,6 @@ const struct file_operations vpu_fops = {
 	.compat_ioctl = vpu_ioctl,
 #endif
 	.release = vpu_release,
-	.fasync = vpu_fasync,
 	.mmap = vpu_mmap,
 };
 #endif
@@ -1273,6 +1496,19 @@ static int vpu_probe(struct platform_device *pdev)
 
 	platform_set_drvdata(pdev, vdev);
 
+	vcodec_proc_dir = proc_mkdir("vcodec", NULL);
+	if (proc_create_data("irq_events", 0444, vcodec_proc_dir, &vcodec_irq_proc_ops, NULL) == NULL)
+		VCODEC_DBG_ERR("vcodec irq_events proc creation failed\n");
+#ifndef CVI_H26X_USE_ION_FW_BUFFER
+#ifdef VPU_SUPPORT_RESERVED_VIDEO_MEMORY
+	if (proc_create_data("vmem", 0444, vcodec_proc_dir, &vcodec_vmem_proc_ops, NULL) == NULL)
+		VCODEC_DBG_ERR("vcodec vmem proc creation failed\n");
+#endif
+#endif
+#ifdef DRV_TEST
+	vcodec_test_proc_init(vcodec_proc_dir);
+#endif
+
 	return 0;
 
 ERROR_PROBE_DEVICE:
@@ -1597,6 +1833,11 @@ static int vpu_remove(struct platform_device *pdev)
 
 	cviReleaseRegResource(vdev);
 
+#ifdef DRV_TEST
+	vcodec_test_proc_deinit(vcodec_proc_dir);
+#endif
+	proc_remove(vcodec_proc_dir);
+
 	return 0;
 }
 
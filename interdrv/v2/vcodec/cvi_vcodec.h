@@ -65,6 +65,14 @@ typedef struct vpudrv_intr_info_t {
 	__u64 intr_tv_nsec;
 } vpudrv_intr_info_t;
 
+/*
+ * VDI_IOCTL_WAIT_INTERRUPT of the kernel mode. Returns the oldest interrupt
+ * of p_intr_info->coreIdx not yet taken. The _inst flavor only takes the
+ * ones of instance inst_idx, or of an unknown instance; -1 takes any.
+ */
+int vpu_wait_interrupt(vpudrv_intr_info_t *p_intr_info);
+int vpu_wait_interrupt_inst(vpudrv_intr_info_t *p_intr_info, int inst_idx);
+
 struct vpu_pltfm_data {
 	const struct vpu_ops *ops;
 	unsigned int quirks;
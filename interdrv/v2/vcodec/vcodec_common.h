@@ -17,16 +17,45 @@ extern "C" {
 #include "cvi_vcodec.h"
 #include "vpuconfig.h"
 
+struct proc_dir_entry;
+
 typedef struct vpu_drv_context_t {
-	struct fasync_struct *async_queue;
 	u32 open_count; /*!<< device reference count. Not instance count */
 } vpu_drv_context_t;
 
+#define VPU_IRQ_EVENT_NUM 32
+
+/*
+ * one interrupt of a core. state is seq << 1, with bit 0 set once a waiter
+ * claimed the event; the irq handler zeroes it while rewriting the slot.
+ */
+struct vpu_irq_event {
+	atomic_t state;
+	unsigned long reason;
+	int inst_idx;
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(5, 10, 0))
+	struct timespec64 timestamp;
+#else
+	struct timespec timestamp;
+#endif
+};
+
+/*
+ * interrupts of a core not yet taken by vpu_wait_interrupt(). Written by the
+ * irq handler only, waiters claim events lock-free, see vpu_irq_event_pop().
+ */
+struct vpu_irq_event_ring {
+	struct vpu_irq_event ev[VPU_IRQ_EVENT_NUM];
+	u32 head;		// seq of the last event pushed
+	atomic_t overflow;	// events overwritten before being taken
+	atomic_t irq_masked;	// irq line disabled on an unhandled interrupt
+};
+
 struct cvi_vcodec_context {
 	vpudrv_buffer_t s_vpu_register;
 	int s_vcodec_irq;
 	int s_sbm_irq;
-	int s_interrupt_flag;
+	struct vpu_irq_event_ring irq_events;
 	wait_queue_head_t s_interrupt_wait_q;
 	int s_sbm_interrupt_flag;
 	wait_queue_head_t s_sbm_interrupt_wait_q;
@@ -62,6 +91,14 @@ void vpu_clk_disable(struct cvi_vpu_device *vdev, int mask);
 unsigned long vpu_clk_get_rate(struct cvi_vpu_device *vdev);
 void cviConfigDDR(struct cvi_vpu_device *vdev);
 
+#ifdef DRV_TEST
+void vpu_test_irq_event(int coreIdx, unsigned long reason, int inst_idx);
+void vpu_test_irq_event_reset(int coreIdx);
+int vpu_test_open_count(void);
+int vcodec_test_proc_init(struct proc_dir_entry *dir);
+void vcodec_test_proc_deinit(struct proc_dir_entry *dir);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
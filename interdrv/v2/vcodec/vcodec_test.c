@@ -0,0 +1,380 @@
+#ifdef DRV_TEST
+#include <linux/types.h>
+#include <linux/string.h>
+#include <linux/delay.h>
+#include <linux/fs.h>
+#include <linux/hrtimer.h>
+#include <linux/kthread.h>
+#include <linux/interrupt.h>
+#include <linux/slab.h>
+#include <linux/ktime.h>
+#include <linux/vmalloc.h>
+#include <drv_test.h>
+
+#include "cvi_vcodec.h"
+#include "vcodec_common.h"
+#ifdef CVI_H26X_USE_ION_FW_BUFFER
+/* cvi_vcodec.c leaves vmm.h out then, the placement replay has its own */
+#include "vmm.h"
+#define VCODEC_TEST_VMEM
+#endif
+
+#define VCODEC_TEST_CORE 0
+#define VCODEC_TEST_WAITER 2
+
+/*
+ * The interrupt storm: an hrtimer plays the core, pushing events the way
+ * vpu_irq_handler() does. The reason carries the event's sequence and
+ * instance, (seq << 2) | (inst + 1), with inst -1 for an unknown instance.
+ */
+struct vcodec_test_storm {
+	struct hrtimer timer;
+	u32 period_ns;
+	u32 burst;		// events pushed per timer tick
+	u32 total;
+	u32 pushed;
+	bool done;
+	unsigned long *seen;	// a bit per seq, set when claimed
+	atomic_t dup;
+	atomic_t mismatch;
+	atomic_t claimed[VCODEC_TEST_WAITER];
+	atomic64_t lat_sum_ns;
+	atomic_t lat_max_ns;
+};
+
+static struct vcodec_test_storm vcodec_storm;
+
+static int vcodec_test_inst_of(u32 seq)
+{
+	// 10% of the events come with an unknown instance
+	return (seq % 10 == 9) ? -1 : (int)(seq & 1);
+}
+
+static enum hrtimer_restart vcodec_test_storm_fire(struct hrtimer *timer)
+{
+	struct vcodec_test_storm *st = &vcodec_storm;
+	u32 i, seq;
+
+	for (i = 0; i < st->burst && st->pushed < st->total; i++) {
+		seq = ++st->pushed;
+		vpu_test_irq_event(VCODEC_TEST_CORE, ((unsigned long)seq << 2) |
+				   (vcodec_test_inst_of(seq) + 1), vcodec_test_inst_of(seq));
+	}
+	if (st->pushed >= st->total) {
+		WRITE_ONCE(st->done, true);
+		return HRTIMER_NORESTART;
+	}
+	hrtimer_forward_now(timer, ns_to_ktime(st->period_ns));
+	return HRTIMER_RESTART;
+}
+
+// account an event a waiter claimed for inst, -1 for any
+static void vcodec_test_claim(vpudrv_intr_info_t *info, int inst)
+{
+	struct vcodec_test_storm *st = &vcodec_storm;
+	u32 seq = (u32)info->intr_reason >> 2;
+	int ev_inst = (int)(info->intr_reason & 3) - 1;
+	struct timespec64 now;
+	u32 lat_ns;
+
+	if (!seq || seq > st->total || test_and_set_bit(seq, st->seen))
+		atomic_inc(&st->dup);
+	if (inst >= 0 && ev_inst >= 0 && ev_inst != inst)
+		atomic_inc(&st->mismatch);
+
+	ktime_get_ts64(&now);
+	lat_ns = (u32)((now.tv_sec - info->intr_tv_sec) * NSEC_PER_SEC +
+		       now.tv_nsec - info->intr_tv_nsec);
+	atomic64_add(lat_ns, &st->lat_sum_ns);
+	if (lat_ns > atomic_read(&st->lat_max_ns))
+		atomic_set(&st->lat_max_ns, lat_ns);
+}
+
+static int vcodec_test_waiter(void *data)
+{
+	struct vcodec_test_storm *st = &vcodec_storm;
+	int inst = (int)(uintptr_t)data;
+	vpudrv_intr_info_t info;
+
+	while (!kthread_should_stop()) {
+		memset(&info, 0, sizeof(info));
+		info.coreIdx = VCODEC_TEST_CORE;
+		info.timeout = 20;
+		if (vpu_wait_interrupt_inst(&info, inst))
+			continue;
+		vcodec_test_claim(&info, inst);
+		atomic_inc(&st->claimed[inst]);
+	}
+	return 0;
+}
+
+/*
+ * One storm: two waiters, one per instance, claim events while the timer
+ * pushes them. Every event must be claimed once, by a waiter of its
+ * instance, or be counted as overflow; what is left is drained after.
+ */
+static int vcodec_test_storm_run(u32 total, u32 period_ns, u32 burst)
+{
+	struct vcodec_test_storm *st = &vcodec_storm;
+	struct vpu_irq_event_ring *ring = &vcodec_dev.vcodec_ctx[VCODEC_TEST_CORE].irq_events;
+	struct task_struct *waiter[VCODEC_TEST_WAITER] = { NULL };
+	vpudrv_intr_info_t info;
+	u32 claimed = 0, drained = 0, overflow;
+	int i, overflow0, ret = 0;
+
+	memset(st, 0, sizeof(*st));
+	st->seen = kcalloc(BITS_TO_LONGS(total + 1), sizeof(long), GFP_KERNEL);
+	if (!st->seen)
+		return -ENOMEM;
+	st->total = total;
+	st->period_ns = period_ns;
+	st->burst = burst;
+
+	vpu_test_irq_event_reset(VCODEC_TEST_CORE);
+	overflow0 = atomic_read(&ring->overflow);
+
+	for (i = 0; i < VCODEC_TEST_WAITER; i++) {
+		waiter[i] = kthread_run(vcodec_test_waiter, (void *)(uintptr_t)i, "vcodec_test%d", i);
+		if (IS_ERR(waiter[i])) {
+			waiter[i] = NULL;
+			ret = -1;
+		}
+	}
+
+	hrtimer_init(&st->timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	st->timer.function = vcodec_test_storm_fire;
+	hrtimer_start(&st->timer, ns_to_ktime(period_ns), HRTIMER_MODE_REL);
+	while (!READ_ONCE(st->done))
+		msleep(10);
+	hrtimer_cancel(&st->timer);
+
+	// let the waiters catch up, then take what they left
+	msleep(100);
+	for (i = 0; i < VCODEC_TEST_WAITER; i++)
+		if (waiter[i])
+			kthread_stop(waiter[i]);
+	for (;;) {
+		memset(&info, 0, sizeof(info));
+		info.coreIdx = VCODEC_TEST_CORE;
+		info.timeout = 0;
+		if (vpu_wait_interrupt_inst(&info, -1))
+			break;
+		vcodec_test_claim(&info, -1);
+		drained++;
+	}
+
+	for (i = 0; i < VCODEC_TEST_WAITER; i++)
+		claimed += atomic_read(&st->claimed[i]);
+	overflow = atomic_read(&ring->overflow) - overflow0;
+
+	pr_err("storm %u events, %u ns x %u: claimed %u (%u/%u) drained %u overflow %u\n",
+	       total, period_ns, burst, claimed, atomic_read(&st->claimed[0]),
+	       atomic_read(&st->claimed[1]), drained, overflow);
+	pr_err("  dup %d mismatch %d, irq to claim(ns) avg %llu max %d\n",
+	       atomic_read(&st->dup), atomic_read(&st->mismatch),
+	       (claimed + drained) ? div_u64(atomic64_read(&st->lat_sum_ns), claimed + drained) : 0,
+	       atomic_read(&st->lat_max_ns));
+
+	if (claimed + drained + overflow != total || atomic_read(&st->dup) ||
+	    atomic_read(&st->mismatch))
+		ret = -1;
+
+	kfree(st->seen);
+	return ret;
+}
+
+static int vcodec_test_storm_all(void)
+{
+	struct cvi_vcodec_context *pvctx = &vcodec_dev.vcodec_ctx[VCODEC_TEST_CORE];
+	int ret = 0;
+
+	// the core must be idle, the storm stands in for its irq meanwhile
+	if (vpu_test_open_count()) {
+		pr_err("vcodec in use, close all instances first\n");
+		return -EBUSY;
+	}
+	if (pvctx->s_vcodec_irq > 0)
+		disable_irq(pvctx->s_vcodec_irq);
+
+	// steady storm, the waiters keep up
+	if (vcodec_test_storm_run(20000, 20000, 1))
+		ret = -1;
+	// bursts past the ring size: the excess is counted as overflow
+	if (vcodec_test_storm_run(20000, 200000, VPU_IRQ_EVENT_NUM * 2))
+		ret = -1;
+
+	vpu_test_irq_event_reset(VCODEC_TEST_CORE);
+	if (pvctx->s_vcodec_irq > 0)
+		enable_irq(pvctx->s_vcodec_irq);
+
+	pr_err("vcodec irq storm %s\n", ret ? "FAIL" : "PASS");
+	return ret;
+}
+
+#ifdef VCODEC_TEST_VMEM
+/*
+ * vmem placement replay: codec instances open and close at random over a
+ * reserved memory of VCODEC_TEST_VMEM_SIZE, once with best-fit for every
+ * buffer and once with the frame buffers taken top-down. Both runs get
+ * the same random sequence. Reports the failed allocations and the alloc
+ * latency of each, and fails if top-down fails more often.
+ */
+#define VCODEC_TEST_VMEM_BASE	0x80000000UL	// bookkeeping only, never touched
+#define VCODEC_TEST_VMEM_SIZE	(24 << 20)
+#define VCODEC_TEST_VMEM_INST	4
+#define VCODEC_TEST_VMEM_FB	3
+#define VCODEC_TEST_VMEM_BUF	(VCODEC_TEST_VMEM_FB + 3)
+#define VCODEC_TEST_VMEM_ROUND	4000
+
+// work, bitstream and frame buffer sizes at 480p, 720p and 1080p
+static const u32 vcodec_test_vmem_size[][3] = {
+	{0x40000, 0x80000, 0x80000},
+	{0x40000, 0x100000, 0x160000},
+	{0x40000, 0x200000, 0x300000},
+};
+
+struct vcodec_test_vmem_stat {
+	u32 alloc;
+	u32 fail;
+	u64 lat_sum_ns;
+	u64 lat_max_ns;
+};
+
+static u32 vcodec_test_rand(u32 *seed)
+{
+	*seed = *seed * 1103515245 + 12345;
+	return *seed >> 16;
+}
+
+static unsigned long vcodec_test_vmem_alloc(video_mm_t *mm, u32 size,
+					    struct vcodec_test_vmem_stat *st)
+{
+	unsigned long ptr;
+	u64 t = ktime_get_ns();
+
+	ptr = vmem_alloc(mm, size, 0);
+	t = ktime_get_ns() - t;
+	st->alloc++;
+	st->lat_sum_ns += t;
+	if (t > st->lat_max_ns)
+		st->lat_max_ns = t;
+	if (ptr == (unsigned long)-1) {
+		st->fail++;
+		return 0;
+	}
+	return ptr;
+}
+
+static int vcodec_test_vmem_run(int top_down_pages, struct vcodec_test_vmem_stat *st)
+{
+	unsigned long buf[VCODEC_TEST_VMEM_INST][VCODEC_TEST_VMEM_BUF];
+	const u32 *size;
+	video_mm_t mm;
+	u32 seed = 1, round, inst, i;
+
+	memset(buf, 0, sizeof(buf));
+	memset(st, 0, sizeof(*st));
+	if (vmem_init(&mm, VCODEC_TEST_VMEM_BASE, VCODEC_TEST_VMEM_SIZE) < 0)
+		return -1;
+	mm.top_down_pages = top_down_pages;
+
+	for (round = 0; round < VCODEC_TEST_VMEM_ROUND; round++) {
+		inst = vcodec_test_rand(&seed) % VCODEC_TEST_VMEM_INST;
+		size = vcodec_test_vmem_size[vcodec_test_rand(&seed) %
+					     ARRAY_SIZE(vcodec_test_vmem_size)];
+		if (buf[inst][0]) {
+			// close
+			for (i = 0; i < VCODEC_TEST_VMEM_BUF; i++)
+				if (buf[inst][i])
+					vmem_free(&mm, buf[inst][i], 0);
+			memset(buf[inst], 0, sizeof(buf[inst]));
+			continue;
+		}
+
+		// open: work, bitstream, frame buffers, then a small report one
+		buf[inst][0] = vcodec_test_vmem_alloc(&mm, size[0], st);
+		buf[inst][1] = vcodec_test_vmem_alloc(&mm, size[1], st);
+		for (i = 0; i < VCODEC_TEST_VMEM_FB; i++)
+			buf[inst][2 + i] = vcodec_test_vmem_alloc(&mm, size[2], st);
+		buf[inst][VCODEC_TEST_VMEM_BUF - 1] = vcodec_test_vmem_alloc(&mm, 0x8000, st);
+
+		for (i = 0; i < VCODEC_TEST_VMEM_BUF; i++)
+			if (!buf[inst][i])
+				break;
+		if (i < VCODEC_TEST_VMEM_BUF) {
+			// an open that fails gives back what it got
+			for (i = 0; i < VCODEC_TEST_VMEM_BUF; i++)
+				if (buf[inst][i])
+					vmem_free(&mm, buf[inst][i], 0);
+			memset(buf[inst], 0, sizeof(buf[inst]));
+		}
+	}
+
+	vmem_exit(&mm);
+	return 0;
+}
+
+static int vcodec_test_vmem_replay(void)
+{
+	struct vcodec_test_vmem_stat best_fit, top_down;
+	int ret = 0;
+
+	if (vcodec_test_vmem_run(0, &best_fit) ||
+	    vcodec_test_vmem_run(VMEM_TOP_DOWN_PAGES, &top_down))
+		return -ENOMEM;
+
+	pr_err("best-fit: %u/%u alloc failed, alloc avg %llu ns max %llu ns\n",
+	       best_fit.fail, best_fit.alloc, div_u64(best_fit.lat_sum_ns, best_fit.alloc),
+	       best_fit.lat_max_ns);
+	pr_err("top-down: %u/%u alloc failed, alloc avg %llu ns max %llu ns\n",
+	       top_down.fail, top_down.alloc, div_u64(top_down.lat_sum_ns, top_down.alloc),
+	       top_down.lat_max_ns);
+	// compare the rates, the runs may try different numbers of opens
+	if ((u64)top_down.fail * best_fit.alloc > (u64)best_fit.fail * top_down.alloc)
+		ret = -1;
+
+	pr_err("vcodec vmem replay %s\n", ret ? "FAIL" : "PASS");
+	return ret;
+}
+#endif
+
+static void vcodec_test_usage(struct seq_file *m)
+{
+	seq_puts(m, "  1: irq event ring under an interrupt storm, per instance waiters\n");
+#ifdef VCODEC_TEST_VMEM
+	seq_puts(m, "  2: vmem alloc/free replay, best-fit vs top-down placement\n");
+#endif
+}
+
+static void vcodec_test_run(void *data, uint32_t op)
+{
+	switch (op) {
+	case 1:
+		vcodec_test_storm_all();
+		break;
+#ifdef VCODEC_TEST_VMEM
+	case 2:
+		vcodec_test_vmem_replay();
+		break;
+#endif
+	default:
+		break;
+	}
+}
+
+DRV_TEST_PROC_DEFINE(vcodec_test);
+
+int vcodec_test_proc_init(struct proc_dir_entry *dir)
+{
+	if (proc_create_data("vcodec_test", 0644, dir, &vcodec_test_proc_ops, NULL) == NULL)
+		pr_err("vcodec_test_proc_init() failed\n");
+
+	return 0;
+}
+
+void vcodec_test_proc_deinit(struct proc_dir_entry *dir)
+{
+	remove_proc_entry("vcodec_test", dir);
+}
+
+#endif
@@ -19,9 +19,24 @@ typedef struct _video_mm_info_struct {
 	unsigned long page_size;
 } vmem_info_t;
 
+#define VMEM_FRAG_HIST_NUM 8
+
+typedef struct _video_mm_frag_struct {
+	unsigned long free_extents;
+	unsigned long largest_free_pages;
+	/* free extents of [2^i, 2^(i+1)) pages, the last bucket takes the rest */
+	unsigned long hist[VMEM_FRAG_HIST_NUM];
+	unsigned long alloc_fail;
+} vmem_frag_info_t;
+
 typedef unsigned long long vmem_key_t;
 
 #define VMEM_PAGE_SIZE (16 * 1024)
+/* allocations of at least this many pages (frame buffers) are taken from the
+ * top of the memory, the smaller ones (bitstream, work buffers) from the
+ * bottom, so short lived small buffers do not split the large extents.
+ */
+#define VMEM_TOP_DOWN_PAGES 128
 #define MAKE_KEY(_a, _b) (((vmem_key_t)_a) << 32 | _b)
 #define KEY_TO_VALUE(_key) (_key >> 32)
 
@@ -50,6 +65,8 @@ typedef struct _video_mm_struct {
 	unsigned long mem_size;
 	int free_page_count;
 	int alloc_page_count;
+	int alloc_fail_count;
+	int top_down_pages;	/* 0 places every request best-fit */
 } video_mm_t;
 
 #define VMEM_P_ALLOC(_x) vmalloc(_x)
@@ -371,6 +388,47 @@ static avl_node_t *remove_approx_value(avl_node_t *tree, avl_node_t **found,
 	return tree;
 }
 
+/*
+ * find_top_free_block: the free block at the highest address holding at
+ * least npages. The free tree is keyed by size first, so a subtree is
+ * skipped only when all its blocks are too small.
+ */
+static avl_node_t *find_top_free_block(avl_node_t *tree, int npages,
+				       avl_node_t *best)
+{
+	if (tree == NULL)
+		return best;
+
+	if ((int)KEY_TO_VALUE(tree->key) >= npages) {
+		if (best == NULL || tree->page->pageno > best->page->pageno)
+			best = tree;
+		best = find_top_free_block(tree->left, npages, best);
+	}
+
+	return find_top_free_block(tree->right, npages, best);
+}
+
+static void collect_frag_info(avl_node_t *tree, vmem_frag_info_t *info)
+{
+	unsigned long npages;
+	int bucket = 0;
+
+	if (tree == NULL)
+		return;
+
+	npages = KEY_TO_VALUE(tree->key);
+	while (bucket < VMEM_FRAG_HIST_NUM - 1 && (npages >> (bucket + 1)))
+		bucket++;
+
+	info->free_extents++;
+	info->hist[bucket]++;
+	if (npages > info->largest_free_pages)
+		info->largest_free_pages = npages;
+
+	collect_frag_info(tree->left, info);
+	collect_frag_info(tree->right, info);
+}
+
 static void set_blocks_free(video_mm_t *mm, int pageno, int npages)
 {
 	int last_pageno = pageno + npages - 1;
@@ -440,12 +498,16 @@ int vmem_init(video_mm_t *mm, unsigned long addr, unsigned long size)
 		return -1;
 
 	mm->base_addr = (addr + (VMEM_PAGE_SIZE - 1)) & ~(VMEM_PAGE_SIZE - 1);
-	mm->mem_size = size & ~VMEM_PAGE_SIZE;
+	if (size < mm->base_addr - addr)
+		return -1;
+	mm->mem_size = (size - (mm->base_addr - addr)) & ~(VMEM_PAGE_SIZE - 1);
 	mm->num_pages = mm->mem_size / VMEM_PAGE_SIZE;
 	mm->free_tree = NULL;
 	mm->alloc_tree = NULL;
 	mm->free_page_count = mm->num_pages;
 	mm->alloc_page_count = 0;
+	mm->alloc_fail_count = 0;
+	mm->top_down_pages = VMEM_TOP_DOWN_PAGES;
 	mm->page_list = (page_t *)VMEM_P_ALLOC(mm->num_pages * sizeof(page_t));
 	if (mm->page_list == NULL) {
 		pr_err("%s:%d failed to kmalloc(%d)\n", __func__, __LINE__,
@@ -496,13 +558,31 @@ int vmem_exit(video_mm_t *mm)
 	return 0;
 }
 
+/*
+ * vmem_get_frag_info: free extent statistics, to tell fragmentation from
+ * a real shortage when an allocation fails.
+ */
+int vmem_get_frag_info(video_mm_t *mm, vmem_frag_info_t *info)
+{
+	if (mm == NULL || info == NULL)
+		return -1;
+
+	memset(info, 0, sizeof(*info));
+	collect_frag_info(mm->free_tree, info);
+	info->alloc_fail = mm->alloc_fail_count;
+
+	return 0;
+}
+
 unsigned long vmem_alloc(video_mm_t *mm, int size, unsigned long pid)
 {
 	avl_node_t *node;
 	page_t *free_page;
 	int npages, free_size;
-	int alloc_pageno;
+	int alloc_pageno, free_pageno;
+	int top_down;
 	unsigned long ptr;
+	vmem_frag_info_t frag;
 
 	if (mm == NULL) {
 		pr_info("vmem_alloc: invalid handle\n");
@@ -515,20 +595,37 @@ unsigned long vmem_alloc(video_mm_t *mm, int size, unsigned long pid)
 	npages = (size + VMEM_PAGE_SIZE - 1) / VMEM_PAGE_SIZE;
 	VCODEC_DBG_MEM("size = 0x%X\n", npages * VMEM_PAGE_SIZE);
 
-	mm->free_tree =
-		remove_approx_value(mm->free_tree, &node, MAKE_KEY(npages, 0));
+	top_down = mm->top_down_pages && npages >= mm->top_down_pages;
+	if (top_down) {
+		node = find_top_free_block(mm->free_tree, npages, NULL);
+		if (node)
+			mm->free_tree = avltree_remove(mm->free_tree, &node, node->key);
+	} else {
+		mm->free_tree =
+			remove_approx_value(mm->free_tree, &node, MAKE_KEY(npages, 0));
+	}
 	if (node == NULL) {
+		mm->alloc_fail_count++;
+		vmem_get_frag_info(mm, &frag);
+		VCODEC_DBG_ERR("no extent of %d pages, free %d largest %lu extents %lu\n",
+			       npages, mm->free_page_count, frag.largest_free_pages,
+			       frag.free_extents);
 		return -1;
 	}
 	free_page = node->page;
 	free_size = KEY_TO_VALUE(node->key);
 
-	alloc_pageno = free_page->pageno;
+	// large ones take the tail of the extent, small ones the head
+	if (top_down) {
+		free_pageno = free_page->pageno;
+		alloc_pageno = free_pageno + free_size - npages;
+	} else {
+		alloc_pageno = free_page->pageno;
+		free_pageno = alloc_pageno + npages;
+	}
 	set_blocks_alloc(mm, alloc_pageno, npages);
-	if (npages != free_size) {
-		int free_pageno = alloc_pageno + npages;
+	if (npages != free_size)
 		set_blocks_free(mm, free_pageno, (free_size - npages));
-	}
 
 	VMEM_P_FREE(node);
 
@@ -3,6 +3,7 @@ soph_vi-objs += chip/$(CHIP_CODE)/vi.o \
 				chip/$(CHIP_CODE)/vi_sdk_layer.o \
 				chip/$(CHIP_CODE)/vi_isp_buf_ctrl.o \
 				chip/$(CHIP_CODE)/vi_raw_dump.o \
+				chip/$(CHIP_CODE)/vi_mempool.o \
 				chip/$(CHIP_CODE)/vip/vi_drv.o \
 				chip/$(CHIP_CODE)/vip/vi_subsys_ctrl.o \
 				chip/$(CHIP_CODE)/vip/vi_fe_ip_ctrl.o \
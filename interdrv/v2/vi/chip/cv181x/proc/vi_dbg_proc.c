@@ -1,5 +1,8 @@
 #include <linux/version.h>
+#include <linux/uaccess.h>
 #include <proc/vi_dbg_proc.h>
+#include <vip/vi_perf_chk.h>
+#include <vi_mempool.h>
 
 #define VI_DBG_PROC_NAME	"cvitek/vi_dbg"
 
@@ -9,6 +12,8 @@
  * 1: preraw0 reg-dump
  * 2: preraw1 reg-dump
  * 3: postraw reg-dump
+ *
+ * Writing "lat_reset" clears the latency histograms instead.
  */
 int proc_isp_mode;
 
@@ -144,6 +149,9 @@ static inline void _vi_dbg_proc_show(struct seq_file *m, void *v)
 							ctx->isp_pipe_cfg[raw_num].dg_info.bdg_h_ls_cnt[ISP_FE_CH1]);
 		}
 	}
+
+	vi_lat_hist_show(m);
+	vi_mempool_proc_show(m);
 }
 
 static int vi_dbg_proc_show(struct seq_file *m, void *v)
@@ -161,7 +169,19 @@ static int vi_dbg_proc_show(struct seq_file *m, void *v)
 
 static ssize_t vi_dbg_proc_write(struct file *file, const char __user *user_buf, size_t count, loff_t *ppos)
 {
-	if (kstrtoint(user_buf, 10, &proc_isp_mode))
+	char cmd[16] = {0};
+
+	if (count >= sizeof(cmd))
+		return -EINVAL;
+	if (copy_from_user(cmd, user_buf, count))
+		return -EFAULT;
+
+	if (!strncmp(cmd, "lat_reset", strlen("lat_reset"))) {
+		vi_lat_hist_reset();
+		return count;
+	}
+
+	if (kstrtoint(cmd, 10, &proc_isp_mode))
 		proc_isp_mode = 0;
 	return count;
 }
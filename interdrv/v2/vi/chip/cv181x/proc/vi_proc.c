@@ -5,6 +5,10 @@
 #define VI_PRC_NAME	"cvitek/vi"
 
 static void *vi_shared_mem;
+
+static const char * const drop_cause_name[VI_DROP_CAUSE_MAX] = {
+	"NoVb", "GdcBusy", "QFull", "IspErr", "Timeout",
+};
 /*************************************************************************
  *	VI proc functions
  *************************************************************************/
@@ -16,6 +20,7 @@ static int _vi_proc_show(struct seq_file *m, void *v)
 	u8 i = 0, j = 0, chn = 0;
 	char o[8], p[8];
 	u8 isRGB = 0;
+	u64 now;
 
 	pviProcCtx = (struct cvi_vi_ctx *)(vi_shared_mem);
 
@@ -334,6 +339,38 @@ static int _vi_proc_show(struct seq_file *m, void *v)
 		}
 	}
 
+	seq_puts(m, "\n-------------------------------VI EVENT STATUS----------------------------------\n");
+	seq_puts(m, "\tWakeup\t\tFrame\t\tCoalesced\tDeferred\tMaxBatch\n");
+	seq_printf(m, "\t%6u\t\t%6u\t\t%6u\t\t%6u\t\t%4u\n",
+		vdev->evt_stat.wakeup, vdev->evt_stat.frame,
+		vdev->evt_stat.coalesced, vdev->evt_stat.deferred,
+		vdev->evt_stat.max_batch);
+
+	seq_puts(m, "\n-------------------------------VI DROP STATUS-----------------------------------\n");
+	seq_puts(m, "\tPipe\tNoVb\tGdcBusy\tQFull\tIspErr\tTimeout\tRetry\tLastCause\tLastDrop(ms ago)\n");
+	now = ktime_get_ns();
+	for (i = 0; i < ISP_PRERAW_VIRT_MAX; i++) {
+		struct vi_drop_stat *stat = &vdev->drop_stat[i];
+		u8 last = VI_DROP_CAUSE_MAX;
+
+		for (j = 0; j < VI_DROP_CAUSE_MAX; j++) {
+			if (stat->cnt[j] && (last == VI_DROP_CAUSE_MAX || stat->last_ns[j] > stat->last_ns[last]))
+				last = j;
+		}
+		if (last == VI_DROP_CAUSE_MAX && !stat->retry)
+			continue;
+
+		seq_printf(m, "\t%3d\t%5d\t%5d\t%5d\t%5d\t%5d\t%5d\t", i,
+			stat->cnt[VI_DROP_NO_VB], stat->cnt[VI_DROP_GDC_BUSY],
+			stat->cnt[VI_DROP_QUEUE_FULL], stat->cnt[VI_DROP_ISP_ERR],
+			stat->cnt[VI_DROP_TIMEOUT], stat->retry);
+		if (last == VI_DROP_CAUSE_MAX)
+			seq_puts(m, "-\n");
+		else
+			seq_printf(m, "%-8s\t%llu\n", drop_cause_name[last],
+				div_u64(now - stat->last_ns[last], NSEC_PER_MSEC));
+	}
+
 	return 0;
 }
 
@@ -1,5 +1,6 @@
 #include <vi.h>
 #include <linux/cvi_base_ctx.h>
+#include <linux/cvi_errno.h>
 #include <linux/of_gpio.h>
 #include <proc/vi_dbg_proc.h>
 #include <proc/vi_proc.h>
@@ -16,6 +17,9 @@
 #include <vcodec_cb.h>
 #include <vi_raw_dump.h>
 
+#define CREATE_TRACE_POINTS
+#include <vi_trace.h>
+
 /*******************************************************
  *  MACRO defines
  ******************************************************/
@@ -63,10 +67,15 @@ module_param(ctrl_flow, bool, 0644);
 struct cvi_vi_ctx *gViCtx;
 struct cvi_overflow_info *gOverflowInfo;
 struct _vi_gdc_cb_param {
+	struct cvi_vi_dev *vdev;
 	MMF_CHN_S chn;
 	enum GDC_USAGE usage;
 };
 struct cvi_gdc_mesh g_vi_mesh[VI_MAX_CHN_NUM];
+/* frames of each chn handed to gdc and not yet returned */
+static atomic_t vi_gdc_inflight[VI_MAX_CHN_NUM];
+static atomic_t vi_gdc_held[VI_MAX_CHN_NUM];
+static DECLARE_WAIT_QUEUE_HEAD(vi_gdc_idle_wq);
 
 /*******************************************************
  *  Internal APIs
@@ -89,7 +98,7 @@ static void _vi_mempool_reset(void)
 {
 	u8 i = 0;
 
-	isp_mempool.byteused = 0;
+	vi_mempool_init(&isp_mempool, isp_mempool.base, isp_mempool.size);
 
 	memset(isp_bufpool, 0x0, (sizeof(struct _membuf) * ISP_PRERAW_VIRT_MAX));
 
@@ -100,6 +109,38 @@ static void _vi_mempool_reset(void)
 	}
 }
 
+/**
+ * _vi_mempool_free_pipe - release the buffers of one pipe only.
+ *
+ * Only the buffer addresses are cleared, the sts locks and fswdr_rpt stay as
+ * they are.
+ *
+ * @param owner: the pipe, or VI_MEM_OWNER_SHARED for the stage-shared buffers.
+ */
+static void _vi_mempool_free_pipe(u8 owner)
+{
+	struct _membuf *pool;
+
+	BUILD_BUG_ON(VI_MEM_PIPE_MAX != ISP_PRERAW_VIRT_MAX);
+
+	vi_mempool_free_owner(&isp_mempool, owner);
+
+	if (owner >= ISP_PRERAW_VIRT_MAX)
+		return;
+
+	pool = &isp_bufpool[owner];
+	memset(pool, 0x0, offsetof(struct _membuf, fswdr_rpt));
+	memset(pool->sts_mem, 0x0, sizeof(pool->sts_mem));
+}
+
+/**
+ * _mempool_tag - account the following buffers to @owner and @type.
+ */
+static void _mempool_tag(u8 owner, enum vi_mem_type type)
+{
+	vi_mempool_tag(&isp_mempool, owner, type);
+}
+
 /**
  * _mempool_get_addr - get mempool's latest address.
  *
@@ -107,7 +148,7 @@ static void _vi_mempool_reset(void)
  */
 static uint64_t _mempool_get_addr(void)
 {
-	return isp_mempool.base + isp_mempool.byteused;
+	return vi_mempool_cursor(&isp_mempool);
 }
 
 /**
@@ -122,18 +163,148 @@ static int64_t _mempool_pop(uint32_t size)
 
 	size = VI_ALIGN(size);
 
-	if ((isp_mempool.byteused + size) > isp_mempool.size) {
+	addr = vi_mempool_alloc(&isp_mempool, size);
+	if (addr < 0) {
 		vi_pr(VI_ERR, "reserved_memory(0x%x) is not enough. byteused(0x%x) alloc_size(0x%x)\n",
 				isp_mempool.size, isp_mempool.byteused, size);
 		return -EINVAL;
 	}
 
-	addr = isp_mempool.base + isp_mempool.byteused;
-	isp_mempool.byteused += size;
-
 	return addr;
 }
 
+void vi_mempool_proc_show(struct seq_file *m)
+{
+	static const char * const type_name[VI_MEM_TYPE_MAX] = {
+		"fe", "be", "rawtop", "rgbtop", "yuvtop",
+	};
+	struct _mempool *pool = &isp_mempool;
+	u8 i;
+
+	seq_puts(m, "[VI Mempool]\n");
+	seq_printf(m, "Size\t\t\t:0x%x\tUsed\t\t\t:0x%x\n", pool->size, pool->byteused);
+	seq_printf(m, "Peak\t\t\t:0x%x\tNoReuse\t\t\t:0x%x\n", pool->peak, pool->bump_used);
+	seq_printf(m, "Saved\t\t\t:0x%x\tExtents\t\t\t:%4d\n",
+			(pool->bump_used > pool->peak) ? pool->bump_used - pool->peak : 0, pool->nr_blk);
+
+	for (i = 0; i < VI_MEM_OWNER_MAX; i++) {
+		if (!pool->owner_used[i])
+			continue;
+		if (i == VI_MEM_OWNER_SHARED)
+			seq_printf(m, "Shared\t\t\t:0x%x\n", pool->owner_used[i]);
+		else
+			seq_printf(m, "Pipe%c\t\t\t:0x%x\n", 'A' + i, pool->owner_used[i]);
+	}
+
+	for (i = 0; i < VI_MEM_TYPE_MAX; i++)
+		seq_printf(m, "%-8s\t\t:0x%x\tpeak:0x%x\n", type_name[i], pool->type_used[i], pool->type_peak[i]);
+}
+
+static s32 _vi_frm_dqbuf(MMF_CHN_S chn, VB_BLK *blk)
+{
+	return vb_dqbuf(chn, CHN_TYPE_OUT, blk);
+}
+
+static s32 _vi_frm_gdc_op(struct mesh_gdc_cfg *cfg)
+{
+	struct base_exe_m_cb exe_cb;
+
+	exe_cb.callee = E_MODULE_DWA;
+	exe_cb.caller = E_MODULE_VI;
+	exe_cb.cmd_id = DWA_CB_MESH_GDC_OP;
+	exe_cb.data   = cfg;
+	return base_exe_module_cb(&exe_cb);
+}
+
+static s32 _vi_frm_done(MMF_CHN_S chn, VB_BLK blk)
+{
+	return vb_done_handler(chn, CHN_TYPE_OUT, blk);
+}
+
+static void _vi_frm_qbuf(MMF_CHN_S chn)
+{
+	if (vi_sdk_qbuf(chn) != CVI_SUCCESS)
+		vb_acquire_block(vi_sdk_qbuf, chn, gViCtx->blk_size[chn.s32ChnId],
+					gViCtx->chnAttr[chn.s32ChnId].u32BindVbPool);
+}
+
+static const struct vi_frm_ops vi_frm_ops_hw = {
+	.next		= vi_dqbuf,
+	.dqbuf		= _vi_frm_dqbuf,
+	.gdc_op		= _vi_frm_gdc_op,
+	.done		= _vi_frm_done,
+	.release	= vb_release_block,
+	.qbuf		= _vi_frm_qbuf,
+};
+
+/* vi_frm_ops_set: @vdev hands done frames to @ops instead of vb and dwa,
+ * NULL restores them. Only the ip test cases set ops, on a vdev of their own.
+ */
+void vi_frm_ops_set(struct cvi_vi_dev *vdev, const struct vi_frm_ops *ops)
+{
+	vdev->frm_ops = ops ? ops : &vi_frm_ops_hw;
+}
+
+/* _vi_chn_to_raw: the raw pipe a vi chn comes from.
+ *
+ * Chns are numbered pipe after pipe, devAttr[].chn_num of them each.
+ * Returns ISP_PRERAW_VIRT_MAX for a chn past the last dev.
+ */
+static enum cvi_isp_raw _vi_chn_to_raw(struct cvi_vi_ctx *vi_ctx, s32 chn_id)
+{
+	enum cvi_isp_raw raw_num;
+
+	for (raw_num = ISP_PRERAW_A; raw_num < vi_ctx->total_dev_num; raw_num++) {
+		if (chn_id < vi_ctx->devAttr[raw_num].chn_num)
+			return raw_num;
+		chn_id -= vi_ctx->devAttr[raw_num].chn_num;
+	}
+
+	return ISP_PRERAW_VIRT_MAX;
+}
+
+/* _vi_record_drop: account a frame lost by @raw_num to @cause, @chn_id is -1
+ * if the frame didn't reach a vi chn.
+ */
+static void _vi_record_drop(struct cvi_vi_dev *vdev, const u8 raw_num, const s32 chn_id,
+			const enum vi_drop_cause cause)
+{
+	struct vi_drop_stat *stat;
+
+	if (raw_num >= ISP_PRERAW_VIRT_MAX)
+		return;
+
+	stat = &vdev->drop_stat[raw_num];
+	stat->cnt[cause]++;
+	stat->last_ns[cause] = ktime_get_ns();
+	trace_vi_drop(raw_num, chn_id, cause, stat->cnt[cause]);
+
+	vi_pr(VI_DBG, "raw_%d drop frame, cause(%d) cnt(%d)\n", raw_num, cause, stat->cnt[cause]);
+}
+
+/* _vi_record_chn_drop: account a frame of vi chn @chn_id lost to @cause.
+ *
+ * Counts in the chn's u32LostFrame and in the drops of the pipe it comes
+ * from.
+ */
+static void _vi_record_chn_drop(struct cvi_vi_dev *vdev, const s32 chn_id, const enum vi_drop_cause cause)
+{
+	if (chn_id < 0 || chn_id >= VI_MAX_CHN_NUM)
+		return;
+
+	vdev->vi_ctx->chnStatus[chn_id].u32LostFrame++;
+	_vi_record_drop(vdev, _vi_chn_to_raw(vdev->vi_ctx, chn_id), chn_id, cause);
+}
+
+/* _vi_record_retry: @raw_num couldn't start its next frame yet and tries
+ * again on a later trigger. Nothing is lost, so this isn't a drop.
+ */
+static void _vi_record_retry(struct cvi_vi_dev *vdev, const u8 raw_num)
+{
+	if (raw_num < ISP_PRERAW_VIRT_MAX)
+		vdev->drop_stat[raw_num].retry++;
+}
+
 static CVI_VOID vi_gdc_callback(CVI_VOID *pParam, VB_BLK blk)
 {
 	struct _vi_gdc_cb_param *_pParam = pParam;
@@ -142,19 +313,52 @@ static CVI_VOID vi_gdc_callback(CVI_VOID *pParam, VB_BLK blk)
 		return;
 
 	vi_pr(VI_DBG, "ViChn(%d) usage(%d)\n", _pParam->chn.s32ChnId, _pParam->usage);
-	mutex_unlock(&g_vi_mesh[_pParam->chn.s32ChnId].lock);
-	if (blk != VB_INVALID_HANDLE)
-		vb_done_handler(_pParam->chn, CHN_TYPE_OUT, blk);
+	if (atomic_dec_and_test(&vi_gdc_inflight[_pParam->chn.s32ChnId]))
+		wake_up(&vi_gdc_idle_wq);
+	// dwa completes a timed out job without output
+	if (blk == VB_INVALID_HANDLE)
+		_vi_record_chn_drop(_pParam->vdev, _pParam->chn.s32ChnId, VI_DROP_TIMEOUT);
+	else if (_pParam->vdev->frm_ops->done(_pParam->chn, blk) == -ENOBUFS)
+		_vi_record_chn_drop(_pParam->vdev, _pParam->chn.s32ChnId, VI_DROP_QUEUE_FULL);
 	vfree(pParam);
 }
 
-static CVI_S32 _mesh_gdc_do_op_cb(enum GDC_USAGE usage, const CVI_VOID *pUsageParam,
+/* vi_gdc_hold: stop new frames of the chn going to gdc and wait until gdc
+ * returned the queued ones, which still refer to the current mesh.
+ *
+ * The mesh lock only orders the hold against the event thread's submit, the
+ * wait runs without it. Pair every call with vi_gdc_unhold(), also on error.
+ */
+CVI_S32 vi_gdc_hold(VI_CHN ViChn)
+{
+	struct cvi_gdc_mesh *pmesh = &g_vi_mesh[ViChn];
+
+	mutex_lock(&pmesh->lock);
+	atomic_inc(&vi_gdc_held[ViChn]);
+	mutex_unlock(&pmesh->lock);
+
+	// gdc completes a timed out frame too, only a stuck engine ends here
+	if (!wait_event_timeout(vi_gdc_idle_wq, !atomic_read(&vi_gdc_inflight[ViChn]),
+				msecs_to_jiffies(1000))) {
+		vi_pr(VI_ERR, "chn(%d) %d frames not back from gdc\n",
+			ViChn, atomic_read(&vi_gdc_inflight[ViChn]));
+		return CVI_ERR_VI_BUSY;
+	}
+
+	return CVI_SUCCESS;
+}
+
+void vi_gdc_unhold(VI_CHN ViChn)
+{
+	atomic_dec(&vi_gdc_held[ViChn]);
+}
+
+static CVI_S32 _mesh_gdc_do_op_cb(struct cvi_vi_dev *vdev, enum GDC_USAGE usage, const CVI_VOID *pUsageParam,
 				struct vb_s *vb_in, PIXEL_FORMAT_E enPixFormat, CVI_U64 mesh_addr,
 				CVI_BOOL sync_io, CVI_VOID *pcbParam, CVI_U32 cbParamSize,
 				MOD_ID_E enModId, ROTATION_E enRotation)
 {
 	struct mesh_gdc_cfg cfg;
-	struct base_exe_m_cb exe_cb;
 
 	memset(&cfg, 0, sizeof(cfg));
 	cfg.usage = usage;
@@ -167,11 +371,30 @@ static CVI_S32 _mesh_gdc_do_op_cb(enum GDC_USAGE usage, const CVI_VOID *pUsagePa
 	cfg.cbParamSize = cbParamSize;
 	cfg.enRotation = enRotation;
 
-	exe_cb.callee = E_MODULE_DWA;
-	exe_cb.caller = E_MODULE_VI;
-	exe_cb.cmd_id = DWA_CB_MESH_GDC_OP;
-	exe_cb.data   = &cfg;
-	return base_exe_module_cb(&exe_cb);
+	return vdev->frm_ops->gdc_op(&cfg);
+}
+
+static CVI_S32 _vi_gdc_submit(struct cvi_vi_dev *vdev, MMF_CHN_S chn, struct vb_s *vb, enum GDC_USAGE usage)
+{
+	struct _vi_gdc_cb_param cb_param = { .vdev = vdev, .chn = chn, .usage = usage};
+	struct cvi_gdc_mesh *pmesh = &g_vi_mesh[chn.s32ChnId];
+	CVI_S32 ret;
+
+	// the mesh is being replaced, turn the frame away like a full queue
+	if (atomic_read(&vi_gdc_held[chn.s32ChnId]))
+		return CVI_ERR_GDC_BUSY;
+
+	atomic_inc(&vi_gdc_inflight[chn.s32ChnId]);
+	ret = _mesh_gdc_do_op_cb(vdev, usage,
+		(usage == GDC_USAGE_LDC) ? &vdev->vi_ctx->stLDCAttr[chn.s32ChnId].stAttr : NULL
+		, vb, vdev->vi_ctx->chnAttr[chn.s32ChnId].enPixelFormat, pmesh->paddr
+		, CVI_FALSE, &cb_param
+		, sizeof(cb_param), CVI_ID_VI
+		, vdev->vi_ctx->enRotation[chn.s32ChnId]);
+	if (ret != CVI_SUCCESS && atomic_dec_and_test(&vi_gdc_inflight[chn.s32ChnId]))
+		wake_up(&vi_gdc_idle_wq);
+
+	return ret;
 }
 
 void _isp_snr_cfg_enq(struct cvi_isp_snr_update *snr_node, const enum cvi_isp_raw raw_num)
@@ -593,6 +816,8 @@ void _isp_preraw_fe_dma_setup(struct isp_ctx *ictx, enum cvi_isp_raw raw_num)
 	u32 raw_le, raw_se;
 	u32 rgbmap_le, rgbmap_se;
 
+	_mempool_tag(raw_num, VI_MEM_FE);
+
 	if (ictx->isp_pipe_cfg[raw_num].is_yuv_bypass_path) { //YUV sensor
 		if (!ictx->isp_pipe_cfg[raw_num].is_offline_scaler) //Online mode to scaler
 			_vi_yuv_dma_setup(ictx, raw_num);
@@ -726,6 +951,8 @@ void _isp_preraw_be_dma_setup(struct isp_ctx *ictx, enum cvi_isp_raw raw_max)
 		}
 	}
 
+	_mempool_tag(VI_MEM_OWNER_SHARED, VI_MEM_BE);
+
 	if (_is_fe_be_online(ictx)) { //fe->be->dram->post
 		if (ictx->is_slice_buf_on) {
 			DMA_SETUP_2(ISP_BLK_ID_DMA_CTL22, raw_num);
@@ -783,6 +1010,7 @@ void _isp_preraw_be_dma_setup(struct isp_ctx *ictx, enum cvi_isp_raw raw_max)
 		if (ictx->isp_pipe_cfg[raw_num].is_yuv_bypass_path)
 			continue;
 
+		_mempool_tag(raw_num, VI_MEM_BE);
 		// af
 		DMA_SETUP(ISP_BLK_ID_DMA_CTL21, raw_num);
 		isp_bufpool[raw_num].sts_mem[0].af.phy_addr = bufaddr;
@@ -829,6 +1057,7 @@ void _isp_rawtop_dma_setup(struct isp_ctx *ictx, enum cvi_isp_raw raw_max)
 		if (ictx->isp_pipe_cfg[raw_num].is_yuv_bypass_path) //YUV sensor
 			continue;
 
+		_mempool_tag(raw_num, VI_MEM_RAWTOP);
 		// lsc
 		DMA_SETUP(ISP_BLK_ID_DMA_CTL24, raw_num);
 		isp_bufpool[raw_num].lsc = bufaddr;
@@ -897,6 +1126,7 @@ void _isp_rgbtop_dma_setup(struct isp_ctx *ictx, enum cvi_isp_raw raw_max)
 		if (ictx->isp_pipe_cfg[raw_num].is_yuv_bypass_path) //YUV sensor
 			continue;
 
+		_mempool_tag(raw_num, VI_MEM_RGBTOP);
 		// hist_edge_v
 		DMA_SETUP_2(ISP_BLK_ID_DMA_CTL38, raw_num);
 		isp_bufpool[raw_num].sts_mem[0].hist_edge_v.phy_addr = bufaddr;
@@ -1006,6 +1236,7 @@ void _isp_yuvtop_dma_setup(struct isp_ctx *ictx, enum cvi_isp_raw raw_max)
 		if (ictx->isp_pipe_cfg[raw_num].is_yuv_bypass_path) //YUV sensor
 			continue;
 
+		_mempool_tag(raw_num, VI_MEM_YUVTOP);
 		// dci
 		//DMA_SETUP(ISP_BLK_ID_WDMA27);
 		DMA_SETUP(ISP_BLK_ID_DMA_CTL45, raw_num);
@@ -2828,7 +3059,10 @@ int vi_start_streaming(struct cvi_vi_dev *vdev)
 		return -1;
 	}
 
-	_vi_mempool_reset();
+	// Only release what gets set up again, the pool keeps its statistics.
+	for (raw_num = ISP_PRERAW_A; raw_num < ISP_PRERAW_VIRT_MAX; raw_num++)
+		_vi_mempool_free_pipe(raw_num);
+	_vi_mempool_free_pipe(VI_MEM_OWNER_SHARED);
 	vi_tuning_buf_clear();
 
 	_vi_scene_ctrl(vdev, &raw_max);
@@ -3020,6 +3254,95 @@ int vi_start_streaming(struct cvi_vi_dev *vdev)
 	return rc;
 }
 
+/* _vi_yuv_buf_chn: the isp chns [@chn_str, @chn_end) of yuv pipe @raw_num, as _vi_yuv_dma_setup() */
+static void _vi_yuv_buf_chn(struct isp_ctx *ctx, const enum cvi_isp_raw raw_num, u8 *chn_str, u8 *chn_end)
+{
+	*chn_str = (raw_num == ISP_PRERAW_A) ? 0 : ctx->rawb_chnstr_num;
+	*chn_end = (raw_num == ISP_PRERAW_A) ? ctx->rawb_chnstr_num : ctx->total_chn_num;
+}
+
+/* _vi_yuv_buf_idle: all yuv buffers of @raw_num wait in pre_out_queue, none is in be/post. */
+static bool _vi_yuv_buf_idle(struct isp_ctx *ctx, const enum cvi_isp_raw raw_num)
+{
+	unsigned long flags;
+	bool idle = true;
+	u8 chn, chn_end;
+
+	_vi_yuv_buf_chn(ctx, raw_num, &chn, &chn_end);
+
+	spin_lock_irqsave(&buf_lock, flags);
+	for (; chn < chn_end; chn++)
+		idle &= (pre_out_queue[chn].num_rdy == OFFLINE_YUV_BUF_NUM);
+	spin_unlock_irqrestore(&buf_lock, flags);
+
+	return idle;
+}
+
+/* _vi_yuv_buf_drain: free the yuv buffers of @raw_num, the pipe is stopped and idle. */
+static void _vi_yuv_buf_drain(struct isp_ctx *ctx, const enum cvi_isp_raw raw_num)
+{
+	struct isp_buffer *b;
+	u8 chn, chn_end;
+
+	_vi_yuv_buf_chn(ctx, raw_num, &chn, &chn_end);
+
+	for (; chn < chn_end; chn++)
+		while ((b = isp_buf_remove(&pre_out_queue[chn])) != NULL)
+			vfree(b);
+}
+
+/**
+ * vi_pipe_mem_reconfig - set up the buffers of one pipe again while the
+ *			 other pipes keep streaming.
+ *
+ * Only a yuv bypass pipe qualifies: all of its buffers are its own fe ones.
+ * An rgb pipe shares the be/post stages and needs vi_start_streaming().
+ * The extents the pipe frees are reused, the other pipes keep their
+ * addresses. The pipe is stopped and its frames in be/post are waited for,
+ * then the vi irq is held off while its queues and pool are replaced.
+ *
+ * @param raw_num: the pipe, its new attributes already set in ctx.
+ */
+int vi_pipe_mem_reconfig(struct cvi_vi_dev *vdev, const enum cvi_isp_raw raw_num)
+{
+	struct isp_ctx *ctx = &vdev->ctx;
+	u8 i;
+
+	if (raw_num >= ISP_PRERAW_MAX || !ctx->isp_pipe_enable[raw_num])
+		return -EINVAL;
+
+	if (!ctx->isp_pipe_cfg[raw_num].is_yuv_bypass_path) {
+		vi_pr(VI_ERR, "raw_%d is not yuv bypass, restart streaming to reconfigure\n", raw_num);
+		return -EOPNOTSUPP;
+	}
+
+	isp_streaming(ctx, false, raw_num);
+
+	// a frame already past fe brings its buffer back to pre_out_queue when done
+	for (i = 0; i < 100 && !_vi_yuv_buf_idle(ctx, raw_num); i++)
+		usleep_range(1000, 2000);
+
+	// keep the isr off the queues and pool while they are replaced
+	disable_irq(vdev->irq_num);
+	if (!_vi_yuv_buf_idle(ctx, raw_num)) {
+		enable_irq(vdev->irq_num);
+		isp_streaming(ctx, true, raw_num);
+		vi_pr(VI_ERR, "raw_%d yuv buffers still in use, not reconfigured\n", raw_num);
+		return -EBUSY;
+	}
+
+	_vi_yuv_buf_drain(ctx, raw_num);
+	_vi_mempool_free_pipe(raw_num);
+	_isp_preraw_fe_dma_setup(ctx, raw_num);
+	enable_irq(vdev->irq_num);
+
+	isp_streaming(ctx, true, raw_num);
+
+	vi_pr(VI_INFO, "raw_%d buffers set up again, byteused(0x%x)\n", raw_num, isp_mempool.byteused);
+
+	return 0;
+}
+
 /* abort streaming and wait for last buffer */
 int vi_stop_streaming(struct cvi_vi_dev *vdev)
 {
@@ -3132,6 +3455,8 @@ int vi_stop_streaming(struct cvi_vi_dev *vdev)
 	}
 
 	for (i = 0; i < ISP_PRERAW_VIRT_MAX; i++) {
+		// a late frame done must not publish buffers freed below
+		isp_raw_ring_stop(i);
 		while ((isp_b = isp_buf_remove(&raw_dump_b_dq[i])) != NULL)
 			vfree(isp_b);
 		while ((isp_b = isp_buf_remove(&raw_dump_b_se_dq[i])) != NULL)
@@ -3533,6 +3858,7 @@ static u8 _postraw_outbuf_empty(struct cvi_vi_dev *vdev, const enum cvi_isp_raw
 
 	if (cvi_isp_rdy_buf_empty(vdev, chn_num)) {
 		vi_pr(VI_DBG, "postraw chn_%d output buffer is empty\n", raw_num);
+		_vi_record_retry(vdev, raw_num);
 		ret = 1;
 	}
 
@@ -3642,6 +3968,7 @@ void _pre_hw_enque(
 					vi_fill_mlv_info(NULL, raw_num, &post_para.m_lv_i, false);
 					if (_vi_call_cb(E_MODULE_VPSS, VPSS_CB_VI_ONLINE_TRIGGER, &post_para) != 0) {
 						vi_pr(VI_DBG, "snr_num_%d, SC is running\n", raw_num);
+						_vi_record_retry(vdev, raw_num);
 						atomic_set(&vdev->pre_be_state[ISP_BE_CH0], ISP_PRE_BE_IDLE);
 						atomic_set(&vdev->postraw_state, ISP_POSTRAW_IDLE);
 						return;
@@ -4046,6 +4373,7 @@ static void _post_hw_enque(
 			post_para.bypass_num = gViCtx->bypass_frm[raw_num];
 			vi_fill_mlv_info(NULL, raw_num, &post_para.m_lv_i, false);
 			if (_vi_call_cb(E_MODULE_VPSS, VPSS_CB_VI_ONLINE_TRIGGER, &post_para) != 0) {
+				_vi_record_retry(vdev, raw_num);
 				atomic_set(&vdev->postraw_state, ISP_POSTRAW_IDLE);
 				return;
 			}
@@ -4114,6 +4442,7 @@ YUV_POSTRAW_TILE:
 			vi_fill_mlv_info(NULL, raw_num, &post_para.m_lv_i, false);
 			if (_vi_call_cb(E_MODULE_VPSS, VPSS_CB_VI_ONLINE_TRIGGER, &post_para) != 0) {
 				vi_pr(VI_DBG, "snr_num_%d, SC is running\n", raw_num);
+				_vi_record_retry(vdev, raw_num);
 				atomic_set(&vdev->pre_be_state[ISP_BE_CH0], ISP_PRE_BE_IDLE);
 				atomic_set(&vdev->postraw_state, ISP_POSTRAW_IDLE);
 				return;
@@ -4177,6 +4506,7 @@ YUV_POSTRAW:
 			vi_fill_mlv_info(NULL, raw_num, &post_para.m_lv_i, false);
 			if (_vi_call_cb(E_MODULE_VPSS, VPSS_CB_VI_ONLINE_TRIGGER, &post_para) != 0) {
 				vi_pr(VI_DBG, "snr_num_%d, SC is running\n", raw_num);
+				_vi_record_retry(vdev, raw_num);
 				atomic_set(&vdev->postraw_state, ISP_POSTRAW_IDLE);
 				return;
 			}
@@ -4230,6 +4560,7 @@ YUV_POSTRAW:
 					vi_fill_mlv_info(NULL, raw_num, &post_para.m_lv_i, false);
 					if (_vi_call_cb(E_MODULE_VPSS, VPSS_CB_VI_ONLINE_TRIGGER, &post_para) != 0) {
 						vi_pr(VI_DBG, "snr_num_%d, SC is not ready\n", raw_num);
+						_vi_record_retry(vdev, raw_num);
 						atomic_set(&vdev->pre_be_state[ISP_BE_CH0], ISP_PRE_BE_IDLE);
 						return;
 					}
@@ -4449,6 +4780,7 @@ static void _vi_sw_init(struct cvi_vi_dev *vdev)
 		vdev->postraw_frame_number[i]			= 0;
 		vdev->drop_frame_number[i]			= 0;
 		vdev->dump_frame_number[i]			= 0;
+		memset(&vdev->drop_stat[i], 0, sizeof(vdev->drop_stat[i]));
 		vdev->isp_int_flag[i]				= false;
 		vdev->ctx.mmap_grid_size[i]			= 3;
 		vdev->isp_err_times[i]				= 0;
@@ -5168,8 +5500,7 @@ static long _vi_s_ctrl(struct cvi_vi_dev *vdev, struct vi_ext_control *p)
 		if ((rval != 0) || (info.size == 0) || (info.paddr == 0))
 			break;
 
-		isp_mempool.base = info.paddr;
-		isp_mempool.size = info.size;
+		vi_mempool_init(&isp_mempool, info.paddr, info.size);
 
 		vi_pr(VI_INFO, "ISP dma buf paddr(0x%llx) size=0x%x\n",
 				isp_mempool.base, isp_mempool.size);
@@ -5416,9 +5747,8 @@ static long _vi_g_ctrl(struct cvi_vi_dev *vdev, struct vi_ext_control *p)
 		u8 raw_num = 0;
 
 		tmp_size = isp_mempool.size;
-		isp_mempool.base = 0xabde2000; //tmp addr only for check aligment
-		isp_mempool.size = 0x8000000;
-		isp_mempool.byteused = 0;
+		//tmp addr only for check aligment
+		vi_mempool_init(&isp_mempool, 0xabde2000, 0x8000000);
 
 		_vi_scene_ctrl(vdev, &raw_max);
 
@@ -5455,9 +5785,7 @@ static long _vi_g_ctrl(struct cvi_vi_dev *vdev, struct vi_ext_control *p)
 
 		p->value = isp_mempool.byteused;
 
-		isp_mempool.base	= 0;
-		isp_mempool.size	= tmp_size;
-		isp_mempool.byteused	= 0;
+		vi_mempool_init(&isp_mempool, 0, tmp_size);
 
 		rc = 0;
 		break;
@@ -5673,6 +6001,17 @@ int vi_mmap(struct file *file, struct vm_area_struct *vma)
 	vdev = file->private_data;
 	pos = vdev->shared_mem;
 
+	if (offset >= VI_RAW_RING_MMAP_OFFSET(0)) {
+		u8 raw_num = (offset - VI_RAW_RING_MMAP_OFFSET(0)) / PAGE_SIZE;
+
+		pos = isp_raw_ring_get(raw_num);
+		if (!pos || vm_size != PAGE_SIZE)
+			return -EINVAL;
+
+		// the mapping holds its own page ref, the page outlives isp_raw_ring_free() till munmap
+		return vm_insert_page(vma, vm_start, virt_to_page(pos)) ? -EAGAIN : 0;
+	}
+
 	if ((vm_size + offset) > VI_SHARE_MEM_SIZE)
 		return -EINVAL;
 
@@ -5841,13 +6180,154 @@ static void _vi_update_chnRealFrameRate(VI_CHN_STATUS_S *pstViChnStatus)
 	vi_pr(VI_DBG, "FrameRate=%d\n", pstViChnStatus->u32FrameRate);
 }
 #endif
+/* _vi_event_handler_wake: flag a frame-done on @id and kick the handler.
+ *
+ * Events accumulate in evt_pending, so a second pipe finishing before the
+ * handler runs is merged into the same wakeup instead of overwriting it.
+ */
+void _vi_event_handler_wake(struct cvi_vi_dev *vdev, const u8 id)
+{
+	if (test_and_set_bit(id, &vdev->evt_pending))
+		vdev->evt_stat.coalesced++;
+
+	wake_up(&vdev->vi_th[E_VI_TH_EVENT_HANDLER].wq);
+}
+
+/* _vi_event_handler_take: wait up to @timeout ms for frame-done events.
+ *
+ * Takes every event flagged so far into @pending in one go. Returns 0 on
+ * timeout, like wait_event_timeout().
+ */
+long _vi_event_handler_take(struct cvi_vi_dev *vdev, u32 timeout, unsigned long *pending)
+{
+	long ret;
+
+	ret = wait_event_timeout(vdev->vi_th[E_VI_TH_EVENT_HANDLER].wq,
+				READ_ONCE(vdev->evt_pending) != 0 || kthread_should_stop(),
+				msecs_to_jiffies(timeout) - 1);
+	*pending = xchg(&vdev->evt_pending, 0);
+
+	return ret;
+}
+
+/* _vi_event_handler_frame: hand a done frame of a vi chn on, or account why
+ * it is lost.
+ */
+void _vi_event_handler_frame(struct cvi_vi_dev *vdev, const struct _vi_buffer *b)
+{
+	MMF_CHN_S chn = {.enModId = CVI_ID_VI, .s32DevId = 0, .s32ChnId = b->chnId};
+	struct cvi_gdc_mesh *pmesh = NULL;
+	struct vb_s *vb = NULL;
+	VB_BLK blk = 0;
+	u64 post_ns;
+	s32 ret;
+
+	post_ns = timespec64_to_ns(&b->timestamp);
+	vi_lat_record(_vi_chn_to_raw(vdev->vi_ctx, b->chnId), VI_LAT_IRQ_TH, post_ns);
+
+	ret = vdev->frm_ops->dqbuf(chn, &blk);
+	if (ret != CVI_SUCCESS) {
+		if (blk == VB_INVALID_HANDLE)
+			vi_pr(VI_ERR, "chn(%d) can't get vb-blk.\n", chn.s32ChnId);
+		_vi_record_chn_drop(vdev, chn.s32ChnId, VI_DROP_NO_VB);
+		return;
+	}
+
+	((struct vb_s *)blk)->buf.dev_num = b->chnId;
+	((struct vb_s *)blk)->buf.frm_num = b->sequence;
+	((struct vb_s *)blk)->buf.u64PTS =
+			(CVI_U64)b->timestamp.tv_sec * 1000000 + b->timestamp.tv_nsec / 1000; //microsec
+
+	vdev->vi_ctx->chnStatus[chn.s32ChnId].u32IntCnt++;
+	vdev->vi_ctx->chnStatus[chn.s32ChnId].u32FrameNum++;
+	vdev->vi_ctx->chnStatus[chn.s32ChnId].u32RecvPic = b->sequence;
+
+	vi_pr(VI_DBG, "dqbuf chn_id=%d, frm_num=%d\n", b->chnId, b->sequence);
+
+	if (vdev->vi_ctx->bypass_frm[chn.s32ChnId] >= b->sequence) {
+		//Release buffer if bypass_frm is not zero
+		vdev->frm_ops->release(blk);
+		goto QBUF;
+	}
+
+	if (!vdev->vi_ctx->pipeAttr[chn.s32ChnId].bYuvBypassPath) {
+		vi_fill_mlv_info((struct vb_s *)blk, 0, NULL, true);
+		vi_fill_dis_info((struct vb_s *)blk);
+	}
+
+	// TODO: extchn only support works on original frame without GDC effect.
+	//_vi_handle_extchn(chn.s32ChnId, chn, blk, &bFisheyeOn);
+	//if (bFisheyeOn)
+		//goto VB_DONE;
+
+	pmesh = &g_vi_mesh[chn.s32ChnId];
+	vb = (struct vb_s *)blk;
+
+	mutex_lock(&pmesh->lock);
+	if (vdev->vi_ctx->stLDCAttr[chn.s32ChnId].bEnable ||
+	    vdev->vi_ctx->enRotation[chn.s32ChnId] != ROTATION_0) {
+		enum GDC_USAGE usage = vdev->vi_ctx->stLDCAttr[chn.s32ChnId].bEnable ?
+				       GDC_USAGE_LDC : GDC_USAGE_ROTATION;
+
+		ret = _vi_gdc_submit(vdev, chn, vb, usage);
+		mutex_unlock(&pmesh->lock);
+		if (ret != CVI_SUCCESS) {
+			if (ret == CVI_ERR_GDC_BUSY)
+				vi_pr(VI_WARN, "chn(%d) drop frame due to gdc queue full.\n",
+					     chn.s32ChnId);
+			else
+				vi_pr(VI_ERR, "gdc %s failed.\n",
+					(usage == GDC_USAGE_LDC) ? "LDC" : "rotation");
+			_vi_record_chn_drop(vdev, chn.s32ChnId, VI_DROP_GDC_BUSY);
+			// gdc didn't take the blk, release it here
+			vdev->frm_ops->release(blk);
+		}
+		goto QBUF;
+	}
+	mutex_unlock(&pmesh->lock);
+// VB_DONE:
+	if (vdev->frm_ops->done(chn, blk) == -ENOBUFS)
+		_vi_record_chn_drop(vdev, chn.s32ChnId, VI_DROP_QUEUE_FULL);
+	vi_lat_record(_vi_chn_to_raw(vdev->vi_ctx, b->chnId), VI_LAT_POST_QBUF, post_ns);
+QBUF:
+	// get another vb for next frame
+	vdev->frm_ops->qbuf(chn);
+}
+
+/* _vi_event_handler_drain: handle every frame done so far.
+ *
+ * @last_chn: set to the chn of the last frame, if any.
+ * Returns the number of frames handled.
+ */
+u32 _vi_event_handler_drain(struct cvi_vi_dev *vdev, s32 *last_chn)
+{
+	struct _vi_buffer b;
+	u32 frames;
+
+	for (frames = 0; vdev->frm_ops->next(&b) == CVI_SUCCESS; ++frames) {
+		*last_chn = b.chnId;
+		_vi_event_handler_frame(vdev, &b);
+	}
+
+	if (frames) {
+		vdev->evt_stat.wakeup++;
+		vdev->evt_stat.frame += frames;
+		vdev->evt_stat.deferred += frames - 1;
+		vdev->evt_stat.max_batch = max(vdev->evt_stat.max_batch, frames);
+	}
+
+	return frames;
+}
+
 static int _vi_event_handler_thread(void * arg)
 {
 	struct cvi_vi_dev *vdev = (struct cvi_vi_dev *)arg;
 	u32 timeout = 500;//ms
-	int ret = 0, flag = 0, ret2 = CVI_SUCCESS;
+	int ret = 0;
 	enum E_VI_TH th_id = E_VI_TH_EVENT_HANDLER;
 	MMF_CHN_S chn = {.enModId = CVI_ID_VI, .s32DevId = 0, .s32ChnId = 0};
+	unsigned long pending;
+	u32 frames;
 #ifdef VI_PROFILE
 	struct timespec64 time[2];
 	CVI_U32 sum = 0, duration, duration_max = 0, duration_min = 1000 * 1000;
@@ -5859,11 +6339,7 @@ static int _vi_event_handler_thread(void * arg)
 		_vi_update_chnRealFrameRate(&gViCtx->chnStatus[chn.s32ChnId]);
 		time[0] = ktime_to_timespec64(ktime_get());
 #endif
-		ret = wait_event_timeout(vdev->vi_th[th_id].wq,
-					vdev->vi_th[th_id].flag != 0 || kthread_should_stop(),
-					msecs_to_jiffies(timeout) - 1);
-		flag = vdev->vi_th[th_id].flag;
-		vdev->vi_th[th_id].flag = 0;
+		ret = _vi_event_handler_take(vdev, timeout, &pending);
 
 		if (kthread_should_stop()) {
 			pr_info("%s exit\n", vdev->vi_th[th_id].th_name);
@@ -5875,97 +6351,11 @@ static int _vi_event_handler_thread(void * arg)
 			vi_pr(VI_ERR, "vi_event_handler timeout(%d)ms\n", timeout);
 			_vi_timeout_chk(vdev);
 			continue;
-		} else {
-			struct _vi_buffer b;
-			VB_BLK blk = 0;
-			struct cvi_gdc_mesh *pmesh = NULL;
-			struct vb_s *vb = NULL;
-
-			//DQbuf from list.
-			if (vi_dqbuf(&b) == CVI_FAILURE) {
-				vi_pr(VI_WARN, "illegal wakeup raw_num[%d]\n", flag);
-				continue;
-			}
-			chn.s32ChnId = b.chnId;
-			ret2 = vb_dqbuf(chn, CHN_TYPE_OUT, &blk);
-			if (ret2 != CVI_SUCCESS) {
-				if (blk == VB_INVALID_HANDLE)
-					vi_pr(VI_ERR, "chn(%d) can't get vb-blk.\n", chn.s32ChnId);
-				continue;
-			}
-
-			((struct vb_s *)blk)->buf.dev_num = b.chnId;
-			((struct vb_s *)blk)->buf.frm_num = b.sequence;
-			((struct vb_s *)blk)->buf.u64PTS =
-					(CVI_U64)b.timestamp.tv_sec * 1000000 + b.timestamp.tv_nsec / 1000; //microsec
-
-			gViCtx->chnStatus[chn.s32ChnId].u32IntCnt++;
-			gViCtx->chnStatus[chn.s32ChnId].u32FrameNum++;
-			gViCtx->chnStatus[chn.s32ChnId].u32RecvPic = b.sequence;
-
-			vi_pr(VI_DBG, "dqbuf chn_id=%d, frm_num=%d\n", b.chnId, b.sequence);
-
-			if (gViCtx->bypass_frm[chn.s32ChnId] >= b.sequence) {
-				//Release buffer if bypass_frm is not zero
-				vb_release_block(blk);
-				goto QBUF;
-			}
-
-			if (!gViCtx->pipeAttr[chn.s32ChnId].bYuvBypassPath) {
-				vi_fill_mlv_info((struct vb_s *)blk, 0, NULL, true);
-				vi_fill_dis_info((struct vb_s *)blk);
-			}
-
-			// TODO: extchn only support works on original frame without GDC effect.
-			//_vi_handle_extchn(chn.s32ChnId, chn, blk, &bFisheyeOn);
-			//if (bFisheyeOn)
-				//goto VB_DONE;
-
-			pmesh = &g_vi_mesh[chn.s32ChnId];
-			vb = (struct vb_s *)blk;
-
-			if (mutex_trylock(&pmesh->lock)) {
-				if (gViCtx->stLDCAttr[chn.s32ChnId].bEnable) {
-					struct _vi_gdc_cb_param cb_param = { .chn = chn, .usage = GDC_USAGE_LDC};
-
-					if (_mesh_gdc_do_op_cb(GDC_USAGE_LDC, &gViCtx->stLDCAttr[chn.s32ChnId].stAttr
-						, vb, gViCtx->chnAttr[chn.s32ChnId].enPixelFormat, pmesh->paddr
-						, CVI_FALSE, &cb_param
-						, sizeof(cb_param), CVI_ID_VI
-						, gViCtx->enRotation[chn.s32ChnId]) != CVI_SUCCESS) {
-						mutex_unlock(&pmesh->lock);
-						vi_pr(VI_ERR, "gdc LDC failed.\n");
-					}
-					goto QBUF;
-				} else if (gViCtx->enRotation[chn.s32ChnId] != ROTATION_0) {
-					struct _vi_gdc_cb_param cb_param = { .chn = chn, .usage = GDC_USAGE_ROTATION};
-
-					if (_mesh_gdc_do_op_cb(GDC_USAGE_ROTATION, NULL
-						, vb, gViCtx->chnAttr[chn.s32ChnId].enPixelFormat, pmesh->paddr
-						, CVI_FALSE, &cb_param
-						, sizeof(cb_param), CVI_ID_VI
-						, gViCtx->enRotation[chn.s32ChnId]) != CVI_SUCCESS) {
-						mutex_unlock(&pmesh->lock);
-						vi_pr(VI_ERR, "gdc rotation failed.\n");
-					}
-					goto QBUF;
-				}
-				mutex_unlock(&pmesh->lock);
-			} else {
-				vi_pr(VI_WARN, "chn(%d) drop frame due to gdc op blocked.\n",
-					     chn.s32ChnId);
-				// release blk if gdc not done yet
-				vb_release_block(blk);
-				goto QBUF;
-			}
-// VB_DONE:
-			vb_done_handler(chn, CHN_TYPE_OUT, blk);
-QBUF:
-			// get another vb for next frame
-			if (vi_sdk_qbuf(chn) != CVI_SUCCESS)
-				vb_acquire_block(vi_sdk_qbuf, chn, gViCtx->blk_size[chn.s32ChnId],
-							gViCtx->chnAttr[chn.s32ChnId].u32BindVbPool);
 		}
+
+		frames = _vi_event_handler_drain(vdev, &chn.s32ChnId);
+		if (!frames)
+			vi_pr(VI_WARN, "illegal wakeup pending[%#lx]\n", pending);
 #ifdef VI_PROFILE
 		time[1] = ktime_to_timespec64(ktime_get());
 		duration = get_diff_in_us(time[0], time[1]);
@@ -6289,6 +6679,7 @@ void _vi_err_handler(struct cvi_vi_dev *vdev, const enum cvi_isp_raw err_raw_num
 
 	//Stop pre/postraw trigger go
 	atomic_set(&vdev->isp_err_handle_flag, 1);
+	_vi_record_drop(vdev, err_raw_num, -1, VI_DROP_ISP_ERR);
 
 	//step 1 : set frm vld = 0
 	isp_frm_err_handler(ctx, err_raw_num, 1);
@@ -6928,9 +7319,7 @@ static void _isp_yuv_bypass_handler(struct cvi_vi_dev *vdev, const enum cvi_isp_
 
 	cvi_isp_dqbuf_list(vdev, vdev->pre_fe_frm_num[raw_num][hw_chn_num], buf_chn);
 
-	vdev->vi_th[E_VI_TH_EVENT_HANDLER].flag = raw_num + 1;
-
-	wake_up(&vdev->vi_th[E_VI_TH_EVENT_HANDLER].wq);
+	_vi_event_handler_wake(vdev, raw_num);
 
 	if (cvi_isp_rdy_buf_empty(vdev, buf_chn))
 		vi_pr(VI_INFO, "fe_%d chn_num_%d yuv bypass outbuf is empty\n", raw_num, buf_chn);
@@ -6984,8 +7373,7 @@ static void _isp_sof_handler(struct cvi_vi_dev *vdev, const enum cvi_isp_raw raw
 		spin_lock_irqsave(&dq_lock, flags);
 		if (!list_empty(&dqbuf_q.list)) {
 			n = list_first_entry(&dqbuf_q.list, struct _isp_dqbuf_n, list);
-			vdev->vi_th[E_VI_TH_EVENT_HANDLER].flag = n->chn_id + 1;
-			wake_up(&vdev->vi_th[E_VI_TH_EVENT_HANDLER].wq);
+			_vi_event_handler_wake(vdev, n->chn_id);
 		}
 		spin_unlock_irqrestore(&dq_lock, flags);
 	}
@@ -7003,6 +7391,9 @@ static inline void _isp_pre_fe_done_handler(
 	enum cvi_isp_raw cur_raw = raw_num;
 	enum cvi_isp_raw next_raw = raw_num;
 
+	if (chn_num == ISP_FE_CH0)
+		vi_lat_mark(raw_num, VI_LAT_PT_FE);
+
 	/*
 	 * raw_num in fe_done means hw_raw
 	 * only enable is mux dev, cur_raw/next_raw will be not equal raw_num
@@ -7097,6 +7488,7 @@ static inline void _isp_pre_fe_done_handler(
 			b = isp_buf_remove(fe_out_q);
 			if (b == NULL) {
 				vi_pr(VI_ERR, "Pre_fe_%d chn_num_%d outbuf is empty\n", raw_num, chn_num);
+				_vi_record_drop(vdev, raw_num, -1, VI_DROP_NO_VB);
 				return;
 			}
 
@@ -7149,6 +7541,7 @@ static inline void _isp_pre_fe_done_handler(
 		b = isp_buf_remove(fe_out_q);
 		if (b == NULL) {
 			vi_pr(VI_ERR, "Pre_fe_%d chn_num_%d outbuf is empty\n", raw_num, chn_num);
+			_vi_record_drop(vdev, raw_num, -1, VI_DROP_NO_VB);
 			return;
 		}
 
@@ -7255,6 +7648,7 @@ static inline void _isp_pre_be_done_handler(
 		b = isp_buf_remove(be_out_q);
 		if (b == NULL) {
 			vi_pr(VI_ERR, "Pre_be chn_num_%d outbuf is empty\n", chn_num);
+			_vi_record_drop(vdev, raw_num, -1, VI_DROP_NO_VB);
 			return;
 		}
 
@@ -7480,9 +7874,7 @@ static void _isp_postraw_done_handler(struct cvi_vi_dev *vdev)
 
 		cvi_isp_dqbuf_list(vdev, vdev->postraw_frame_number[raw_num], chn_num);
 
-		vdev->vi_th[E_VI_TH_EVENT_HANDLER].flag = raw_num + 1;
-
-		wake_up(&vdev->vi_th[E_VI_TH_EVENT_HANDLER].wq);
+		_vi_event_handler_wake(vdev, raw_num);
 	}
 
 	if (!ctx->isp_pipe_cfg[raw_num].is_offline_preraw) {
@@ -7551,6 +7943,7 @@ void vi_irq_handler(struct cvi_vi_dev *vdev)
 	/* pre_fe0 ch0 frame start */
 	if (top_sts_2.bits.FRAME_START_FE0 & 0x1) {
 		vi_record_sof_perf(vdev, ISP_PRERAW_A, ISP_FE_CH0);
+		vi_lat_mark(ISP_PRERAW_A, VI_LAT_PT_SOF);
 
 		if (!vdev->ctx.isp_pipe_cfg[ISP_PRERAW_A].is_offline_preraw)
 			++vdev->pre_fe_sof_cnt[ISP_PRERAW_A][ISP_FE_CH0];
@@ -7583,6 +7976,8 @@ void vi_irq_handler(struct cvi_vi_dev *vdev)
 
 	/* pre_fe1 ch0 frame start */
 	if (top_sts_2.bits.FRAME_START_FE1 & 0x1) {
+		vi_lat_mark(ISP_PRERAW_B, VI_LAT_PT_SOF);
+
 		if (!vdev->ctx.isp_pipe_cfg[ISP_PRERAW_B].is_offline_preraw)
 			++vdev->pre_fe_sof_cnt[ISP_PRERAW_B][ISP_FE_CH0];
 
@@ -7607,6 +8002,8 @@ void vi_irq_handler(struct cvi_vi_dev *vdev)
 
 	/* pre_fe2 ch0 frame start */
 	if (top_sts_2.bits.FRAME_START_FE2 & 0x1) {
+		vi_lat_mark(ISP_PRERAW_C, VI_LAT_PT_SOF);
+
 		++vdev->pre_fe_sof_cnt[ISP_PRERAW_C][ISP_FE_CH0];
 		 vi_pr(VI_INFO, "pre_fe_%d sof chn_num=%d frm_num=%d\n",
 				ISP_PRERAW_C, ISP_FE_CH0, vdev->pre_fe_sof_cnt[ISP_PRERAW_C][ISP_FE_CH0]);
@@ -7702,6 +8099,7 @@ void vi_irq_handler(struct cvi_vi_dev *vdev)
 	/* pre_be ch0 frm done */
 	if (top_sts.bits.FRAME_DONE_BE & 0x1) {
 		vi_record_be_perf(vdev, ISP_PRERAW_A, ISP_BE_CH0);
+		vi_lat_mark(ctx->cam_id, VI_LAT_PT_BE);
 
 		_isp_pre_be_done_handler(vdev, ISP_BE_CH0);
 	}
@@ -7721,6 +8119,7 @@ void vi_irq_handler(struct cvi_vi_dev *vdev)
 	/* post frm done */
 	if (top_sts.bits.FRAME_DONE_POST) {
 		vi_record_post_end(vdev, ISP_PRERAW_A);
+		vi_lat_mark(ctx->cam_id, VI_LAT_PT_POST);
 
 		_isp_postraw_done_handler(vdev);
 	}
@@ -7756,6 +8155,8 @@ int vi_create_instance(struct platform_device *pdev)
 	}
 
 	gViCtx = (struct cvi_vi_ctx *)vdev->shared_mem;
+	vdev->vi_ctx = gViCtx;
+	vi_frm_ops_set(vdev, NULL);
 
 	_vi_init_param(vdev);
 
@@ -7808,6 +8209,7 @@ int vi_destroy_instance(struct platform_device *pdev)
 		vi_destory_thread(vdev, i);
 
 	vi_tuning_buf_release();
+	isp_raw_ring_free();
 
 	for (i = 0; i < ISP_PRERAW_VIRT_MAX; i++) {
 		sync_task_exit(i);
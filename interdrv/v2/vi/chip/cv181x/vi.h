@@ -31,6 +31,7 @@
 #include <reg_vip_sys.h>
 
 #include <vi_raw_dump.h>
+#include <vi_mempool.h>
 
 #define OFFLINE_RAW_BUF_NUM	2
 #define OFFLINE_PRE_BE_BUF_NUM	2
@@ -52,16 +53,7 @@ enum cvi_isp_preraw_state {
 	ISP_PRERAW_RUNNING,
 };
 
-/* struct mempool
- * @base: the address of the mempool
- * @size: the size of the mempool
- * @byteused: the number of bytes used
- */
-struct _mempool {
-	uint64_t base;
-	uint32_t size;
-	uint32_t byteused;
-} isp_mempool;
+struct _mempool isp_mempool;
 
 struct _membuf {
 	uint64_t bayer_le[OFFLINE_RAW_BUF_NUM];
@@ -146,13 +138,6 @@ struct _isp_event_q {
 	struct list_head	list;
 } event_q;
 
-struct _vi_buffer {
-	__u32			chnId;
-	__u32			sequence;
-	struct timespec64	timestamp;
-	__u32			reserved;
-};
-
 
 static u8 RGBMAP_BUF_IDX	= 2;
 
@@ -34,6 +34,54 @@ struct vi_thread_attr {
 	int (*th_handler)(void *arg);
 };
 
+enum vi_drop_cause {
+	VI_DROP_NO_VB,		// no output buffer to write or hand the frame to
+	VI_DROP_GDC_BUSY,	// ldc/rotation job refused by gdc
+	VI_DROP_QUEUE_FULL,	// bound module refused the frame
+	VI_DROP_ISP_ERR,	// frame lost to isp error recovery
+	VI_DROP_TIMEOUT,	// ldc/rotation job timed out in gdc
+	VI_DROP_CAUSE_MAX,
+};
+
+/**
+ * struct vi_drop_stat - frames lost by one pipe
+ *
+ * @cnt: drops per enum vi_drop_cause
+ * @last_ns: ktime_get_ns() of the latest drop per cause
+ * @retry: triggers put off because vpss or the output buffer wasn't ready,
+ *         the frame goes on a later trigger so they aren't drops
+ */
+struct vi_drop_stat {
+	u32 cnt[VI_DROP_CAUSE_MAX];
+	u64 last_ns[VI_DROP_CAUSE_MAX];
+	u32 retry;
+};
+
+struct _vi_buffer {
+	__u32			chnId;
+	__u32			sequence;
+	struct timespec64	timestamp;
+	__u32			reserved;
+};
+
+/**
+ * struct vi_evt_stat - frame-done events seen by vi_event_handler
+ *
+ * @wakeup: times the handler woke up with work
+ * @frame: frames dequeued
+ * @coalesced: events posted for a pipe whose previous event was still pending
+ * @deferred: frames beyond the first in one wakeup, which used to wait for
+ *            the next wakeup
+ * @max_batch: most frames drained in one wakeup
+ */
+struct vi_evt_stat {
+	u32 wakeup;
+	u32 frame;
+	u32 coalesced;
+	u32 deferred;
+	u32 max_batch;
+};
+
 /**
  * struct cvi_vi - VI IP abstraction
  */
@@ -92,6 +140,11 @@ struct cvi_vi_dev {
 	atomic_t			isp_streamon;
 	atomic_t			ol_sc_frm_done;
 	struct vi_thread_attr		vi_th[E_VI_TH_MAX];
+	unsigned long			evt_pending;
+	struct vi_evt_stat		evt_stat;
+	struct vi_drop_stat		drop_stat[ISP_PRERAW_VIRT_MAX];
+	struct cvi_vi_ctx		*vi_ctx;	// ctx the frame path reads, gViCtx
+	const struct vi_frm_ops		*frm_ops;	// see vi_frm_ops_set()
 };
 
 #ifdef __cplusplus
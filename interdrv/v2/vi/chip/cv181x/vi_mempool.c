@@ -0,0 +1,161 @@
+#include <linux/errno.h>
+#include <linux/string.h>
+#include <linux/types.h>
+#include <vi_mempool.h>
+
+/*
+ * The pool is kept as an address ordered list of extents covering
+ * [base, base + size). Allocation carves from the front of the largest free
+ * extent, so on a fresh pool it behaves exactly like the former bump
+ * allocator and the callers may still read the next address before they know
+ * the size. Freeing an owner merges its extents back with free neighbours.
+ *
+ * Only memmove/memset are used here, so the file can be built against a fake
+ * memory region outside the kernel.
+ */
+
+static int _mempool_largest_free(const struct _mempool *pool)
+{
+	uint32_t i, best_size = 0;
+	int best = -1;
+
+	for (i = 0; i < pool->nr_blk; i++) {
+		if (!pool->blk[i].used && pool->blk[i].size > best_size) {
+			best_size = pool->blk[i].size;
+			best = i;
+		}
+	}
+
+	return best;
+}
+
+/**
+ * vi_mempool_init - drop every allocation and cover [base, base + size).
+ *
+ * Statistics are cleared as well.
+ */
+void vi_mempool_init(struct _mempool *pool, uint64_t base, uint32_t size)
+{
+	memset(pool, 0, sizeof(*pool));
+
+	pool->base = base;
+	pool->size = size;
+	pool->owner = VI_MEM_OWNER_SHARED;
+	pool->type = VI_MEM_FE;
+
+	if (size) {
+		pool->blk[0].addr = base;
+		pool->blk[0].size = size;
+		pool->nr_blk = 1;
+	}
+}
+
+/**
+ * vi_mempool_tag - set owner and type recorded for the following allocations.
+ *
+ * @param owner: pipe number, or VI_MEM_OWNER_SHARED.
+ * @param type: buffer type, for usage statistics only.
+ */
+void vi_mempool_tag(struct _mempool *pool, uint8_t owner, enum vi_mem_type type)
+{
+	pool->owner = (owner < VI_MEM_OWNER_MAX) ? owner : VI_MEM_OWNER_SHARED;
+	pool->type = (type < VI_MEM_TYPE_MAX) ? type : VI_MEM_FE;
+}
+
+/**
+ * vi_mempool_cursor - address the next allocation will start at.
+ *
+ * @return: the end of the pool if nothing is free.
+ */
+uint64_t vi_mempool_cursor(const struct _mempool *pool)
+{
+	int i = _mempool_largest_free(pool);
+
+	return (i < 0) ? pool->base + pool->size : pool->blk[i].addr;
+}
+
+/**
+ * vi_mempool_alloc - acquire an extent of @size bytes at vi_mempool_cursor().
+ *
+ * @param size: the space acquired, already aligned by the caller.
+ * @return: negative if no enough space; o/w, the address of the buffer.
+ */
+int64_t vi_mempool_alloc(struct _mempool *pool, uint32_t size)
+{
+	struct _mempool_blk *b;
+	uint32_t end;
+	int i = _mempool_largest_free(pool);
+
+	if (i < 0)
+		return size ? -EINVAL : (int64_t)(pool->base + pool->size);
+	if (pool->blk[i].size < size)
+		return -EINVAL;
+	if (!size)
+		return pool->blk[i].addr;
+
+	if (pool->blk[i].size > size) {
+		if (pool->nr_blk >= VI_MEMPOOL_BLK_MAX)
+			return -ENOMEM;
+
+		memmove(&pool->blk[i + 1], &pool->blk[i], (pool->nr_blk - i) * sizeof(pool->blk[0]));
+		pool->nr_blk++;
+		pool->blk[i + 1].addr += size;
+		pool->blk[i + 1].size -= size;
+	}
+
+	b = &pool->blk[i];
+	b->size = size;
+	b->used = 1;
+	b->owner = pool->owner;
+	b->type = pool->type;
+
+	pool->byteused += size;
+	pool->bump_used += size;
+	pool->owner_used[b->owner] += size;
+	pool->type_used[b->type] += size;
+	if (pool->type_used[b->type] > pool->type_peak[b->type])
+		pool->type_peak[b->type] = pool->type_used[b->type];
+
+	end = (uint32_t)(b->addr + size - pool->base);
+	if (end > pool->peak)
+		pool->peak = end;
+
+	return b->addr;
+}
+
+/**
+ * vi_mempool_free_owner - release every extent allocated by @owner.
+ *
+ * Other owners' buffers are left in place, so one pipe can be reconfigured
+ * while the others keep their addresses. Once nothing is left allocated
+ * the next allocations are a new configuration, peak and bump_used restart.
+ */
+void vi_mempool_free_owner(struct _mempool *pool, uint8_t owner)
+{
+	struct _mempool_blk *b;
+	uint32_t i, j = 0;
+
+	for (i = 0; i < pool->nr_blk; i++) {
+		b = &pool->blk[i];
+		if (!b->used || b->owner != owner)
+			continue;
+
+		b->used = 0;
+		pool->byteused -= b->size;
+		pool->owner_used[b->owner] -= b->size;
+		pool->type_used[b->type] -= b->size;
+	}
+
+	for (i = 0; i < pool->nr_blk; i++) {
+		if (j && !pool->blk[j - 1].used && !pool->blk[i].used)
+			pool->blk[j - 1].size += pool->blk[i].size;
+		else
+			pool->blk[j++] = pool->blk[i];
+	}
+	pool->nr_blk = j;
+
+	if (!pool->byteused) {
+		pool->peak = 0;
+		pool->bump_used = 0;
+	}
+}
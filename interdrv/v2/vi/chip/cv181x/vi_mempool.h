@@ -0,0 +1,88 @@
+#ifndef __VI_MEMPOOL_H__
+#define __VI_MEMPOOL_H__
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+/*
+ * No includes on purpose: the includer provides the fixed width types, so
+ * the pool also builds against a fake memory region outside the kernel.
+ */
+
+#define VI_MEMPOOL_BLK_MAX	256
+
+/*
+ * Pipes own [0, VI_MEM_PIPE_MAX), then the stage-shared buffers.
+ * VI_MEM_PIPE_MAX follows ISP_PRERAW_VIRT_MAX, vi.c checks it at build time.
+ */
+#define VI_MEM_PIPE_MAX		5
+#define VI_MEM_OWNER_SHARED	VI_MEM_PIPE_MAX
+#define VI_MEM_OWNER_MAX	(VI_MEM_PIPE_MAX + 1)
+
+enum vi_mem_type {
+	VI_MEM_FE,
+	VI_MEM_BE,
+	VI_MEM_RAWTOP,
+	VI_MEM_RGBTOP,
+	VI_MEM_YUVTOP,
+	VI_MEM_TYPE_MAX,
+};
+
+/* struct _mempool_blk
+ * @addr: start address of the extent
+ * @size: size of the extent
+ * @owner: pipe which allocated it, or VI_MEM_OWNER_SHARED
+ * @type: enum vi_mem_type of the allocation
+ * @used: 0 if the extent is free
+ */
+struct _mempool_blk {
+	uint64_t addr;
+	uint32_t size;
+	uint8_t owner;
+	uint8_t type;
+	uint8_t used;
+};
+
+/* struct mempool
+ * @base: the address of the mempool
+ * @size: the size of the mempool
+ * @byteused: the number of bytes used
+ * @peak: the highest end offset used by the current configuration
+ * @bump_used: bytes a bump allocator would have consumed by the current
+ *             configuration, which starts whenever the pool is empty
+ * @owner/@type: tag applied to the following allocations
+ * @nr_blk/@blk: address ordered extents covering the whole pool
+ */
+struct _mempool {
+	uint64_t base;
+	uint32_t size;
+	uint32_t byteused;
+	uint32_t peak;
+	uint32_t bump_used;
+	uint32_t owner_used[VI_MEM_OWNER_MAX];
+	uint32_t type_used[VI_MEM_TYPE_MAX];
+	uint32_t type_peak[VI_MEM_TYPE_MAX];
+	uint8_t owner;
+	uint8_t type;
+	uint32_t nr_blk;
+	struct _mempool_blk blk[VI_MEMPOOL_BLK_MAX];
+};
+
+/*******************************************************************************
+ *	mempool interfaces
+ ******************************************************************************/
+void vi_mempool_init(struct _mempool *pool, uint64_t base, uint32_t size);
+void vi_mempool_tag(struct _mempool *pool, uint8_t owner, enum vi_mem_type type);
+uint64_t vi_mempool_cursor(const struct _mempool *pool);
+int64_t vi_mempool_alloc(struct _mempool *pool, uint32_t size);
+void vi_mempool_free_owner(struct _mempool *pool, uint8_t owner);
+
+struct seq_file;
+void vi_mempool_proc_show(struct seq_file *m);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __VI_MEMPOOL_H__ */
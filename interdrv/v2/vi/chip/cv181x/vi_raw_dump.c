@@ -5,6 +5,33 @@ struct isp_buffer *isp_byr[ISP_PRERAW_VIRT_MAX], *isp_byr_se[ISP_PRERAW_VIRT_MAX
 struct isp_queue raw_dump_b_q[ISP_PRERAW_VIRT_MAX], raw_dump_b_se_q[ISP_PRERAW_VIRT_MAX],
 	raw_dump_b_dq[ISP_PRERAW_VIRT_MAX], raw_dump_b_se_dq[ISP_PRERAW_VIRT_MAX];
 
+/* raw dump ring of one pipe, see struct cvi_vip_isp_raw_ring
+ * @page: page the recorder maps, only tail is read back from it
+ * @buf: isp_buffer of each published slot, until the recorder is done
+ * @head: next slot to publish
+ * @slot_num: slots in use, 0 while the ring is stopped
+ * @overrun: frames reused for lack of a free buffer
+ * @reclaim: slots before this one are back in raw_dump_b_q
+ * @lock: orders the isr's publish against start and stop
+ *
+ * head, slot_num and overrun are only copied out to the page, the recorder
+ * can't change what the isr indexes with.
+ */
+struct isp_raw_ring {
+	struct cvi_vip_isp_raw_ring *page;
+	struct isp_buffer *buf[VI_RAW_RING_MAX];
+	u32 head;
+	u32 slot_num;
+	u32 overrun;
+	u32 reclaim;
+	spinlock_t lock;
+};
+
+static struct isp_raw_ring raw_ring[ISP_PRERAW_MAX] = {
+	[0 ... ISP_PRERAW_MAX - 1] = { .lock = __SPIN_LOCK_UNLOCKED(raw_ring.lock) },
+};
+static DEFINE_MUTEX(raw_ring_lock);
+
 void _isp_fe_be_raw_dump_cfg(struct cvi_vi_dev *vdev, const enum cvi_isp_raw raw_num, const u8 chn_num)
 {
 	struct isp_ctx *ctx = &vdev->ctx;
@@ -367,6 +394,169 @@ int isp_put_smooth_raw_dump(struct cvi_vi_dev *vdev, struct cvi_vip_isp_raw_blk
 	return CVI_SUCCESS;
 }
 
+/**
+ * isp_raw_ring_get - get the ring page of @raw_num, allocated on first use.
+ *
+ * The page stays until isp_raw_ring_free(), so it may be mmapped at any time.
+ * A mapping takes a page ref of its own, free_page() only drops the driver's.
+ */
+struct cvi_vip_isp_raw_ring *isp_raw_ring_get(u8 raw_num)
+{
+	BUILD_BUG_ON(sizeof(struct cvi_vip_isp_raw_ring) > PAGE_SIZE);
+
+	if (raw_num >= ISP_PRERAW_MAX)
+		return NULL;
+
+	mutex_lock(&raw_ring_lock);
+	if (!raw_ring[raw_num].page)
+		raw_ring[raw_num].page = (struct cvi_vip_isp_raw_ring *)get_zeroed_page(GFP_KERNEL);
+	mutex_unlock(&raw_ring_lock);
+
+	return raw_ring[raw_num].page;
+}
+
+void isp_raw_ring_free(void)
+{
+	u8 raw_num;
+
+	for (raw_num = ISP_PRERAW_A; raw_num < ISP_PRERAW_MAX; raw_num++) {
+		if (raw_ring[raw_num].page) {
+			free_page((unsigned long)raw_ring[raw_num].page);
+			raw_ring[raw_num].page = NULL;
+		}
+	}
+}
+
+/**
+ * isp_raw_ring_stop - stop publishing and free the buffers still held by the
+ * recorder.
+ *
+ * Safe against the isr, once it returns no frame is published anymore.
+ * slot_num is cleared so the recorder can tell the ring is gone.
+ */
+void isp_raw_ring_stop(u8 raw_num)
+{
+	struct isp_raw_ring *ring;
+	struct isp_buffer *buf[VI_RAW_RING_MAX];
+	unsigned long flags;
+	u8 i;
+
+	if (raw_num >= ISP_PRERAW_MAX || !raw_ring[raw_num].page)
+		return;
+
+	ring = &raw_ring[raw_num];
+	spin_lock_irqsave(&ring->lock, flags);
+	memcpy(buf, ring->buf, sizeof(buf));
+	memset(ring->buf, 0, sizeof(ring->buf));
+	ring->slot_num = 0;
+	WRITE_ONCE(ring->page->slot_num, 0);
+	spin_unlock_irqrestore(&ring->lock, flags);
+
+	for (i = 0; i < VI_RAW_RING_MAX; i++)
+		vfree(buf[i]);
+}
+
+int isp_start_raw_ring(struct cvi_vi_dev *vdev, struct cvi_vip_isp_smooth_raw_param *pstSmoothRawParam)
+{
+	struct isp_raw_ring *ring;
+	unsigned long flags;
+	u8 raw_num = pstSmoothRawParam->raw_num;
+	int ret = 0;
+
+	if (raw_num >= ISP_PRERAW_MAX ||
+	    pstSmoothRawParam->frm_num < 2 || pstSmoothRawParam->frm_num > VI_RAW_RING_MAX) {
+		vi_pr(VI_ERR, "raw_%d ring frm_num(%d) should be 2~%d\n",
+			raw_num, pstSmoothRawParam->frm_num, VI_RAW_RING_MAX);
+		return -EINVAL;
+	}
+
+	if (vdev->ctx.isp_pipe_cfg[raw_num].is_hdr_on) {
+		vi_pr(VI_ERR, "raw_%d ring only supports linear mode\n", raw_num);
+		return -EINVAL;
+	}
+
+	if (atomic_read(&vdev->isp_smooth_raw_dump_en[raw_num]) != 0) {
+		vi_pr(VI_ERR, "raw_%d smooth raw dump is running\n", raw_num);
+		return -EBUSY;
+	}
+
+	if (!isp_raw_ring_get(raw_num))
+		return -ENOMEM;
+
+	ring = &raw_ring[raw_num];
+	spin_lock_irqsave(&ring->lock, flags);
+	memset(ring->page, 0, sizeof(*ring->page));
+	memset(ring->buf, 0, sizeof(ring->buf));
+	ring->head = 0;
+	ring->overrun = 0;
+	ring->reclaim = 0;
+	ring->slot_num = pstSmoothRawParam->frm_num;
+	ring->page->slot_num = ring->slot_num;
+	spin_unlock_irqrestore(&ring->lock, flags);
+
+	ret = isp_start_smooth_raw_dump(vdev, pstSmoothRawParam);
+	if (ret == 0)
+		atomic_set(&vdev->isp_smooth_raw_dump_en[raw_num], 3);
+	else
+		isp_raw_ring_stop(raw_num);
+
+	return ret;
+}
+
+static void _isp_raw_ring_publish(struct cvi_vi_dev *vdev, const enum cvi_isp_raw raw_num)
+{
+	struct isp_raw_ring *ring = &raw_ring[raw_num];
+	struct cvi_vip_isp_raw_ring_hdr *hdr;
+	struct isp_buffer *b = NULL;
+	unsigned long flags;
+	u32 tail, idx;
+
+	spin_lock_irqsave(&ring->lock, flags);
+	if (!ring->slot_num)
+		goto unlock;
+
+	//Give the slots the recorder is done with back to hw, ignore a bogus tail.
+	tail = READ_ONCE(ring->page->tail);
+	if (tail - ring->reclaim > ring->head - ring->reclaim)
+		tail = ring->reclaim;
+
+	for (; ring->reclaim != tail; ring->reclaim++) {
+		idx = ring->reclaim % ring->slot_num;
+		isp_buf_queue(&raw_dump_b_q[raw_num], ring->buf[idx]);
+		ring->buf[idx] = NULL;
+	}
+
+	while ((b = isp_buf_remove(&raw_dump_b_dq[raw_num])) != NULL) {
+		//Hw needs a buffer for the next frame, reuse this one if none is left.
+		if (isp_next_buf(&raw_dump_b_q[raw_num]) == NULL) {
+			ring->overrun++;
+			WRITE_ONCE(ring->page->overrun, ring->overrun);
+			isp_buf_queue(&raw_dump_b_q[raw_num], b);
+			continue;
+		}
+
+		idx = ring->head % ring->slot_num;
+		ring->buf[idx] = b;
+
+		hdr = &ring->page->hdr[idx];
+		hdr->phy_addr  = b->addr;
+		hdr->timestamp = ktime_get_ns();
+		hdr->frm_num   = b->frm_num;
+		hdr->size      = b->byr_size;
+		hdr->width     = b->crop_le.w;
+		hdr->height    = b->crop_le.h;
+		hdr->raw_num   = raw_num;
+
+		//hdr must be visible before the recorder sees the new head
+		smp_wmb();
+		ring->head++;
+		WRITE_ONCE(ring->page->head, ring->head);
+	}
+
+unlock:
+	spin_unlock_irqrestore(&ring->lock, flags);
+}
+
 void _isp_raw_dump_chk(struct cvi_vi_dev *vdev, const enum cvi_isp_raw raw_num, const uint32_t frm_num)
 {
 	switch (atomic_read(&vdev->isp_smooth_raw_dump_en[raw_num])) {
@@ -397,6 +587,8 @@ void _isp_raw_dump_chk(struct cvi_vi_dev *vdev, const enum cvi_isp_raw raw_num,
 
 		vi_pr(VI_DBG, "stop dump smooth\n");
 
+		isp_raw_ring_stop(raw_num);
+
 		while ((b = isp_buf_remove(&raw_dump_b_dq[raw_num])) != NULL)
 			vfree(b);
 		while ((b = isp_buf_remove(&raw_dump_b_se_dq[raw_num])) != NULL)
@@ -410,5 +602,14 @@ void _isp_raw_dump_chk(struct cvi_vi_dev *vdev, const enum cvi_isp_raw raw_num,
 		atomic_set(&vdev->isp_smooth_raw_dump_en[raw_num], 0);
 		return;
 	}
+	case 3:
+	{
+		vi_pr(VI_DBG, "raw ring frm=%d\n", frm_num);
+
+		_isp_raw_ring_publish(vdev, raw_num);
+
+		atomic_set(&vdev->isp_raw_dump_en[raw_num], 1);
+		return;
+	}
 	}
 }
@@ -26,6 +26,11 @@ int isp_put_smooth_raw_dump(struct cvi_vi_dev *vdev, struct cvi_vip_isp_raw_blk
 
 void _isp_raw_dump_chk(struct cvi_vi_dev *vdev, const enum cvi_isp_raw raw_num, const uint32_t frm_num);
 
+struct cvi_vip_isp_raw_ring *isp_raw_ring_get(u8 raw_num);
+void isp_raw_ring_stop(u8 raw_num);
+void isp_raw_ring_free(void);
+int isp_start_raw_ring(struct cvi_vi_dev *vdev, struct cvi_vip_isp_smooth_raw_param *pstSmoothRawParam);
+
 #ifdef __cplusplus
 }
 #endif
@@ -17,8 +17,11 @@
 
 extern struct cvi_vi_ctx *gViCtx;
 extern struct cvi_gdc_mesh g_vi_mesh[VI_MAX_CHN_NUM];
+extern CVI_S32 vi_gdc_hold(VI_CHN ViChn);
+extern void vi_gdc_unhold(VI_CHN ViChn);
 static struct cvi_vi_dev *gvdev;
 static struct mlv_i_s gmLVi[VI_MAX_DEV_NUM];
+static bool gmLViValid[VI_MAX_DEV_NUM];
 
 static struct crop_size_s dis_i_data[VI_MAX_DEV_NUM] = { 0 };
 static CVI_U32 dis_i_frm_num[VI_MAX_DEV_NUM] = { 0 };
@@ -126,8 +129,8 @@ void vi_fill_mlv_info(struct vb_s *blk, u8 dev, struct mlv_i_s *m_lv_i, u8 is_vp
 	if (is_vpss_offline) {
 		CVI_U8 snr_num = blk->buf.dev_num;
 
-		blk->buf.motion_lv = gmLVi[snr_num].mlv_i_level;
-		memcpy(blk->buf.motion_table, gmLVi[snr_num].mlv_i_table, MO_TBL_SIZE);
+		vb_set_motion(blk, gmLVi[snr_num].mlv_i_level,
+			gmLViValid[snr_num] ? gmLVi[snr_num].mlv_i_table : NULL);
 	} else {
 		CVI_U8 snr_num = dev;
 
@@ -143,6 +146,7 @@ CVI_S32 vi_set_motion_lv(struct mlv_info_s mlv_i)
 
 	gmLVi[mlv_i.sensor_num].mlv_i_level = mlv_i.mlv;
 	memcpy(gmLVi[mlv_i.sensor_num].mlv_i_table, mlv_i.mtable, MO_TBL_SIZE);
+	gmLViValid[mlv_i.sensor_num] = true;
 
 	return CVI_SUCCESS;
 }
@@ -332,6 +336,14 @@ CVI_S32 vi_start_pipe(VI_PIPE ViPipe)
 
 	vi_pr(VI_DBG, "pipe_%d start_pipe\n", ViPipe);
 
+	// started again while streaming: reconfigure a yuv pipe in place, an
+	// rgb pipe keeps its buffers till the next vi_start_streaming()
+	if (atomic_read(&gvdev->isp_streamon) && ViPipe < ISP_PRERAW_MAX &&
+	    ctx->isp_pipe_enable[ViPipe] && ctx->isp_pipe_cfg[ViPipe].is_yuv_bypass_path) {
+		if (vi_pipe_mem_reconfig(gvdev, ViPipe))
+			return CVI_ERR_VI_BUSY;
+	}
+
 	return CVI_SUCCESS;
 }
 
@@ -547,11 +559,15 @@ CVI_S32 vi_disable_chn(VI_CHN ViChn)
 		gViCtx->chnStatus[ViChn].u64PrevTime = 0;
 		gViCtx->chnStatus[ViChn].u32FrameRate = 0;
 
-		if (g_vi_mesh[ViChn].paddr && g_vi_mesh[ViChn].paddr != DEFAULT_MESH_PADDR) {
-			sys_ion_free(g_vi_mesh[ViChn].paddr);
+		// a mesh gdc may still read is left in place rather than freed
+		if (vi_gdc_hold(ViChn) == CVI_SUCCESS) {
+			if (g_vi_mesh[ViChn].paddr && g_vi_mesh[ViChn].paddr != DEFAULT_MESH_PADDR) {
+				sys_ion_free(g_vi_mesh[ViChn].paddr);
+			}
+			g_vi_mesh[ViChn].paddr = 0;
+			g_vi_mesh[ViChn].vaddr = 0;
 		}
-		g_vi_mesh[ViChn].paddr = 0;
-		g_vi_mesh[ViChn].vaddr = 0;
+		vi_gdc_unhold(ViChn);
 
 		if (ViChn == (gViCtx->total_chn_num - 1)) {
 
@@ -1062,12 +1078,17 @@ CVI_S32 vi_put_smooth_rawdump(VI_PIPE ViPipe, VIDEO_FRAME_INFO_S *pstFrameInfo)
 static CVI_S32 _vi_update_rotation_mesh(VI_CHN ViChn, ROTATION_E enRotation)
 {
 	struct cvi_gdc_mesh *pmesh = &g_vi_mesh[ViChn];
+	CVI_S32 ret;
 
-	mutex_lock(&pmesh->lock);
-	pmesh->paddr = DEFAULT_MESH_PADDR;
-	gViCtx->enRotation[ViChn] = enRotation;
-	mutex_unlock(&pmesh->lock);
-	return CVI_SUCCESS;
+	ret = vi_gdc_hold(ViChn);
+	if (ret == CVI_SUCCESS) {
+		mutex_lock(&pmesh->lock);
+		pmesh->paddr = DEFAULT_MESH_PADDR;
+		gViCtx->enRotation[ViChn] = enRotation;
+		mutex_unlock(&pmesh->lock);
+	}
+	vi_gdc_unhold(ViChn);
+	return ret;
 }
 
 static CVI_S32 _vi_update_ldc_mesh(VPSS_CHN ViChn, const VI_LDC_ATTR_S *pstLDCAttr
@@ -1075,6 +1096,17 @@ static CVI_S32 _vi_update_ldc_mesh(VPSS_CHN ViChn, const VI_LDC_ATTR_S *pstLDCAt
 {
 	CVI_U64 paddr_old;
 	struct cvi_gdc_mesh *pmesh = &g_vi_mesh[ViChn];
+	CVI_S32 ret;
+
+	// on a stuck gdc the old mesh and attrs stay. The new mesh was handed
+	// over to vi, nobody else frees it.
+	ret = vi_gdc_hold(ViChn);
+	if (ret != CVI_SUCCESS) {
+		vi_gdc_unhold(ViChn);
+		if (paddr && paddr != DEFAULT_MESH_PADDR)
+			sys_ion_free(paddr);
+		return ret;
+	}
 
 	mutex_lock(&pmesh->lock);
 	if (pmesh->paddr) {
@@ -1088,6 +1120,7 @@ static CVI_S32 _vi_update_ldc_mesh(VPSS_CHN ViChn, const VI_LDC_ATTR_S *pstLDCAt
 	gViCtx->stLDCAttr[ViChn] = *pstLDCAttr;
 	gViCtx->enRotation[ViChn] = enRotation;
 	mutex_unlock(&pmesh->lock);
+	vi_gdc_unhold(ViChn);
 
 	vi_pr(VI_DBG, "Chn(%d) mesh base(0x%llx)\n", ViChn, (unsigned long long)paddr);
 	vi_pr(VI_DBG, "bEnable=%d, apect=%d, xyratio=%d, xoffset=%d, yoffset=%d, ratio=%d\n",
@@ -1400,6 +1433,7 @@ long vi_sdk_ctrl(struct cvi_vi_dev *vdev, struct vi_ext_control *p)
 		break;
 	}
 	case VI_SDK_START_SMOOTH_RAWDUMP:
+	case VI_SDK_START_RAW_RING:
 	{
 		struct cvi_vip_isp_smooth_raw_param param;
 		struct cvi_vip_isp_raw_blk *raw_blk;
@@ -1425,7 +1459,10 @@ long vi_sdk_ctrl(struct cvi_vi_dev *vdev, struct vi_ext_control *p)
 		}
 
 		param.raw_blk = raw_blk;
-		rc = isp_start_smooth_raw_dump(vdev, &param);
+		if (id == VI_SDK_START_RAW_RING)
+			rc = isp_start_raw_ring(vdev, &param);
+		else
+			rc = isp_start_smooth_raw_dump(vdev, &param);
 
 		kfree(raw_blk);
 		break;
@@ -18,6 +18,27 @@ struct cvi_isp_buf {
 	struct list_head list;
 };
 
+struct mesh_gdc_cfg;
+
+/**
+ * struct vi_frm_ops - where vi_event_handler takes a done frame
+ *
+ * @next: take the next frame the isp finished, 0 if there is one
+ * @dqbuf: get the vb the frame was written to
+ * @gdc_op: hand an ldc/rotation job to dwa
+ * @done: pass the vb on to the bound modules
+ * @release: give the vb back to its pool
+ * @qbuf: queue a vb for the next frame
+ */
+struct vi_frm_ops {
+	int (*next)(struct _vi_buffer *b);
+	s32 (*dqbuf)(MMF_CHN_S chn, VB_BLK *blk);
+	s32 (*gdc_op)(struct mesh_gdc_cfg *cfg);
+	s32 (*done)(MMF_CHN_S chn, VB_BLK blk);
+	s32 (*release)(VB_BLK blk);
+	void (*qbuf)(MMF_CHN_S chn);
+};
+
 /*****************************************************************************
  *  vi function prototype for vi sdk layer
  ****************************************************************************/
@@ -25,11 +46,14 @@ int vi_create_thread(struct cvi_vi_dev *vdev, enum E_VI_TH th_id);
 void vi_destory_thread(struct cvi_vi_dev *vdev, enum E_VI_TH th_id);
 int vi_start_streaming(struct cvi_vi_dev *vdev);
 int vi_stop_streaming(struct cvi_vi_dev *vdev);
+int vi_pipe_mem_reconfig(struct cvi_vi_dev *vdev, const enum cvi_isp_raw raw_num);
 void cvi_isp_buf_queue_wrap(struct cvi_vi_dev *vdev, struct cvi_isp_buf *b);
 int vi_mac_clk_ctrl(struct cvi_vi_dev *vdev, u8 mac_num, u8 enable);
 int usr_pic_timer_init(struct cvi_vi_dev *vdev);
 void usr_pic_time_remove(void);
 void vi_destory_dbg_thread(struct cvi_vi_dev *vdev);
+int vi_dqbuf(struct _vi_buffer *b);
+void vi_frm_ops_set(struct cvi_vi_dev *vdev, const struct vi_frm_ops *ops);
 
 /*****************************************************************************
  *  vi sdk ioctl function prototype for vi layer
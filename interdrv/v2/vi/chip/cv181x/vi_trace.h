@@ -0,0 +1,44 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM cvi_vi
+
+#if !defined(__VI_TRACE_H__) || defined(TRACE_HEADER_MULTI_READ)
+#define __VI_TRACE_H__
+
+#include <linux/tracepoint.h>
+
+/* vi_drop: a frame lost by pipe @raw_num, @chn is -1 if no vi chn got it */
+TRACE_EVENT(vi_drop,
+	TP_PROTO(u8 raw_num, s32 chn, u32 cause, u32 cnt),
+	TP_ARGS(raw_num, chn, cause, cnt),
+
+	TP_STRUCT__entry(
+		__field(u8, raw_num)
+		__field(s32, chn)
+		__field(u32, cause)
+		__field(u32, cnt)
+	),
+
+	TP_fast_assign(
+		__entry->raw_num = raw_num;
+		__entry->chn = chn;
+		__entry->cause = cause;
+		__entry->cnt = cnt;
+	),
+
+	TP_printk("raw_%u chn %d cause %s cnt %u", __entry->raw_num, __entry->chn,
+		__print_symbolic(__entry->cause,
+			{ VI_DROP_NO_VB,	"no_vb" },
+			{ VI_DROP_GDC_BUSY,	"gdc_busy" },
+			{ VI_DROP_QUEUE_FULL,	"queue_full" },
+			{ VI_DROP_ISP_ERR,	"isp_err" },
+			{ VI_DROP_TIMEOUT,	"timeout" }),
+		__entry->cnt)
+);
+
+#endif /* __VI_TRACE_H__ */
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE vi_trace
+#include <trace/define_trace.h>
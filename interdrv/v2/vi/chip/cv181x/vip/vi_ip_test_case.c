@@ -1,6 +1,22 @@
 #include <vip/vi_drv.h>
 
 #ifdef PORTING_TEST
+#include <linux/hrtimer.h>
+#include <linux/kthread.h>
+#include <linux/sizes.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/cvi_errno.h>
+#include <linux/cvi_vi_ctx.h>
+#include <base_cb.h>
+#include <dwa_cb.h>
+#include <vi_cb.h>
+#include <vi_defines.h>
+#include <vi_sdk_layer.h>
+#include <vip/vi_perf_chk.h>
+#include <vi_mempool.h>
+#include <vi_raw_dump.h>
+#include "sys.h"
 
 /****************************************************************************
  * Global parameters
@@ -77,6 +93,12 @@ enum VI_TEST_CASE {
 	VI_TEST_CROP_YUV,
 	VI_TEST_CROP_RAW,
 	VI_TEST_PREEE_EE_DISABLE,
+	VI_TEST_EVENT_STORM,
+	VI_TEST_LDC_STUCK_GDC,
+	VI_TEST_LAT_HIST,
+	VI_TEST_MEMPOOL,
+	VI_TEST_DROP_STAT,
+	VI_TEST_RAW_RING,
 };
 
 extern int vi_ip_test_case;
@@ -93,6 +115,1066 @@ extern uint16_t c_lut_r_lut[];
 extern uint16_t c_lut_g_lut[];
 extern uint16_t c_lut_b_lut[];
 
+extern void _vi_event_handler_wake(struct cvi_vi_dev *vdev, const u8 id);
+extern long _vi_event_handler_take(struct cvi_vi_dev *vdev, u32 timeout, unsigned long *pending);
+extern void _vi_event_handler_frame(struct cvi_vi_dev *vdev, const struct _vi_buffer *b);
+extern u32 _vi_event_handler_drain(struct cvi_vi_dev *vdev, s32 *last_chn);
+extern int vi_cb(void *dev, enum ENUM_MODULES_ID caller, u32 cmd, void *arg);
+extern struct cvi_vi_ctx *gViCtx;
+extern struct cvi_gdc_mesh g_vi_mesh[VI_MAX_CHN_NUM];
+extern CVI_S32 vi_gdc_hold(VI_CHN ViChn);
+extern void vi_gdc_unhold(VI_CHN ViChn);
+extern CVI_S32 vi_set_chn_ldc_attr(VI_CHN ViChn, ROTATION_E enRotation,
+	const VI_LDC_ATTR_S *pstLDCAttr, CVI_U64 mesh_addr);
+
+/*******************************************************************************
+ *	Frame-done event storm
+ *
+ *	An hrtimer plays the isr: each tick some pipes finish a frame, queue it
+ *	and flag it with _vi_event_handler_wake(), pipe n every n+1 ticks so that
+ *	they collide often. A kthread plays vi_event_handler: every wakeup takes
+ *	the events with _vi_event_handler_take() and hands the queued frames to
+ *	_vi_event_handler_drain(), which runs each through
+ *	_vi_event_handler_frame(). The frames come from and go to mocks set with
+ *	vi_frm_ops_set() on a private vdev, the streaming one is left alone.
+ *
+ *	PASS if every frame reaches done in order, none waits for the handler's
+ *	timeout, and the worst isr to done latency stays below VI_EVT_STORM_LAT_MS.
+ ******************************************************************************/
+#define VI_EVT_STORM_PIPE_NUM	4
+#define VI_EVT_STORM_FRAMES	2000	// per pipe
+#define VI_EVT_STORM_TICK_US	100
+#define VI_EVT_STORM_TIMEOUT_MS	500	// as vi_event_handler
+#define VI_EVT_STORM_LAT_MS	50
+
+struct vi_evt_storm {
+	struct cvi_vi_dev *vdev;
+	struct hrtimer timer;
+	u32 tick;
+	bool done;
+	spinlock_t lock;
+	struct _vi_buffer *fifo;	// every frame posted, in order
+	u32 head;
+	u32 tail;
+	struct vb_s vb;
+	u32 posted[VI_EVT_STORM_PIPE_NUM];
+	u32 handled[VI_EVT_STORM_PIPE_NUM];
+	u32 out_of_order;
+	u32 empty;		// woken for frames an earlier wakeup drained
+	u32 timeout;		// timed out with frames waiting
+	u64 lat_max_ns;
+};
+
+static struct vi_evt_storm evt_storm;
+
+static int vi_evt_storm_next(struct _vi_buffer *b)
+{
+	struct vi_evt_storm *st = &evt_storm;
+	unsigned long flags;
+	int ret = -1;
+
+	spin_lock_irqsave(&st->lock, flags);
+	if (st->tail != st->head) {
+		*b = st->fifo[st->tail++];
+		ret = CVI_SUCCESS;
+	}
+	spin_unlock_irqrestore(&st->lock, flags);
+
+	return ret;
+}
+
+static s32 vi_evt_storm_dqbuf(MMF_CHN_S chn, VB_BLK *blk)
+{
+	*blk = (VB_BLK)(uintptr_t)&evt_storm.vb;
+	return CVI_SUCCESS;
+}
+
+static s32 vi_evt_storm_done(MMF_CHN_S chn, VB_BLK blk)
+{
+	struct vi_evt_storm *st = &evt_storm;
+	struct vb_s *vb = (struct vb_s *)blk;
+	u32 p = vb->buf.dev_num;
+
+	if (p >= VI_EVT_STORM_PIPE_NUM || vb->buf.frm_num != st->handled[p] + 1) {
+		st->out_of_order++;
+		return CVI_SUCCESS;
+	}
+	st->handled[p]++;
+	st->lat_max_ns = max(st->lat_max_ns, ktime_get_ns() - vb->buf.u64PTS * NSEC_PER_USEC);
+
+	return CVI_SUCCESS;
+}
+
+static s32 vi_evt_storm_release(VB_BLK blk)
+{
+	return CVI_SUCCESS;
+}
+
+static void vi_evt_storm_qbuf(MMF_CHN_S chn)
+{
+}
+
+static const struct vi_frm_ops vi_evt_storm_ops = {
+	.next		= vi_evt_storm_next,
+	.dqbuf		= vi_evt_storm_dqbuf,
+	.done		= vi_evt_storm_done,
+	.release	= vi_evt_storm_release,
+	.qbuf		= vi_evt_storm_qbuf,
+};
+
+static enum hrtimer_restart vi_evt_storm_fire(struct hrtimer *timer)
+{
+	struct vi_evt_storm *st = &evt_storm;
+	struct _vi_buffer *b;
+	bool done = true;
+	u8 p;
+
+	st->tick++;
+	for (p = 0; p < VI_EVT_STORM_PIPE_NUM; p++) {
+		if (st->posted[p] >= VI_EVT_STORM_FRAMES)
+			continue;
+		done = false;
+		if (st->tick % (p + 1))
+			continue;
+
+		// only the handler pops, the fifo holds every frame of the run
+		spin_lock(&st->lock);
+		b = &st->fifo[st->head];
+		b->chnId = p;
+		b->sequence = ++st->posted[p];
+		ktime_get_ts64(&b->timestamp);
+		st->head++;
+		spin_unlock(&st->lock);
+		_vi_event_handler_wake(st->vdev, p);
+	}
+
+	if (done) {
+		WRITE_ONCE(st->done, true);
+		return HRTIMER_NORESTART;
+	}
+	hrtimer_forward_now(timer, ns_to_ktime(VI_EVT_STORM_TICK_US * NSEC_PER_USEC));
+	return HRTIMER_RESTART;
+}
+
+static int vi_evt_storm_handler(void *arg)
+{
+	struct vi_evt_storm *st = arg;
+	unsigned long pending, flags;
+	s32 last = 0;
+
+	while (!kthread_should_stop()) {
+		if (!_vi_event_handler_take(st->vdev, VI_EVT_STORM_TIMEOUT_MS, &pending)) {
+			spin_lock_irqsave(&st->lock, flags);
+			if (st->tail != st->head)
+				st->timeout++;
+			spin_unlock_irqrestore(&st->lock, flags);
+			_vi_event_handler_drain(st->vdev, &last);
+			continue;
+		}
+		if (kthread_should_stop())
+			break;
+
+		if (!_vi_event_handler_drain(st->vdev, &last))
+			st->empty++;
+	}
+
+	return 0;
+}
+
+static void vi_test_event_storm(void)
+{
+	struct vi_evt_storm *st = &evt_storm;
+	struct vi_evt_stat *stat;
+	struct cvi_vi_ctx *ctx;
+	struct task_struct *handler;
+	bool pass = true;
+	u8 p;
+
+	memset(st, 0, sizeof(*st));
+	spin_lock_init(&st->lock);
+	st->vdev = vzalloc(sizeof(*st->vdev));
+	st->fifo = vzalloc(sizeof(*st->fifo) * VI_EVT_STORM_PIPE_NUM * VI_EVT_STORM_FRAMES);
+	ctx = vmalloc(sizeof(*ctx));
+	if (!st->vdev || !st->fifo || !ctx) {
+		vi_pr(VI_ERR, "event storm: no memory\n");
+		goto EXIT;
+	}
+
+	// one chn per pipe, straight to done
+	memcpy(ctx, gViCtx, sizeof(*ctx));
+	ctx->total_dev_num = VI_EVT_STORM_PIPE_NUM;
+	for (p = 0; p < VI_EVT_STORM_PIPE_NUM; p++) {
+		ctx->devAttr[p].chn_num = 1;
+		ctx->bypass_frm[p] = 0;
+		ctx->pipeAttr[p].bYuvBypassPath = CVI_TRUE;
+		ctx->stLDCAttr[p].bEnable = CVI_FALSE;
+		ctx->enRotation[p] = ROTATION_0;
+		memset(&ctx->chnStatus[p], 0, sizeof(ctx->chnStatus[p]));
+	}
+
+	st->vdev->vi_ctx = ctx;
+	vi_frm_ops_set(st->vdev, &vi_evt_storm_ops);
+	init_waitqueue_head(&st->vdev->vi_th[E_VI_TH_EVENT_HANDLER].wq);
+
+	handler = kthread_run(vi_evt_storm_handler, st, "vi_evt_storm");
+	if (IS_ERR(handler)) {
+		vi_pr(VI_ERR, "event storm: handler thread failed\n");
+		goto EXIT;
+	}
+
+	hrtimer_init(&st->timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	st->timer.function = vi_evt_storm_fire;
+	hrtimer_start(&st->timer, ns_to_ktime(VI_EVT_STORM_TICK_US * NSEC_PER_USEC), HRTIMER_MODE_REL);
+	while (!READ_ONCE(st->done))
+		msleep(20);
+	hrtimer_cancel(&st->timer);
+
+	// the last events are handled well within a timeout
+	msleep(VI_EVT_STORM_LAT_MS);
+	kthread_stop(handler);
+
+	for (p = 0; p < VI_EVT_STORM_PIPE_NUM; p++) {
+		vi_pr(VI_INFO, "event storm: pipe%d posted %d handled %d frame_num %d\n",
+			p, st->posted[p], st->handled[p], ctx->chnStatus[p].u32FrameNum);
+		if (st->handled[p] != VI_EVT_STORM_FRAMES ||
+		    ctx->chnStatus[p].u32FrameNum != VI_EVT_STORM_FRAMES)
+			pass = false;
+	}
+	stat = &st->vdev->evt_stat;
+	vi_pr(VI_INFO, "event storm: wakeup %d empty %d coalesced %d deferred %d max_batch %d\n",
+		stat->wakeup, st->empty, stat->coalesced, stat->deferred, stat->max_batch);
+	vi_pr(VI_INFO, "event storm: out_of_order %d timeout %d lat_max %llu us\n",
+		st->out_of_order, st->timeout, div_u64(st->lat_max_ns, NSEC_PER_USEC));
+	if (stat->frame != VI_EVT_STORM_PIPE_NUM * VI_EVT_STORM_FRAMES || st->out_of_order ||
+	    st->timeout || st->lat_max_ns > VI_EVT_STORM_LAT_MS * NSEC_PER_MSEC)
+		pass = false;
+
+	if (pass)
+		vi_pr(VI_INFO, "event storm PASS\n");
+	else
+		vi_pr(VI_ERR, "event storm FAIL\n");
+EXIT:
+	vfree(ctx);
+	vfree(st->fifo);
+	vfree(st->vdev);
+}
+
+/*******************************************************************************
+ *	LDC mesh update on a stuck gdc
+ *
+ *	A private vdev hands a rotated frame of an unused chn to a mock dwa that
+ *	takes the job and holds it like a hung engine. vi_set_chn_ldc_attr()
+ *	then has to give up on the hold, keep the old mesh and attrs, and free
+ *	the mesh it was given, which nobody else owns. The mock completes the
+ *	job afterwards, as dwa does on its timeout, and the chn becomes idle.
+ *
+ *	PASS if the update fails with CVI_ERR_VI_BUSY, the chn is left as it
+ *	was, the sys ion buffer count is back where it started, and a hold
+ *	succeeds once the job is done.
+ ******************************************************************************/
+#define VI_LDC_TEST_CHN		(VI_MAX_CHN_NUM - 1)
+#define VI_LDC_TEST_MESH_SIZE	SZ_4K
+
+struct vi_ldc_mock {
+	struct cvi_vi_dev *vdev;
+	struct vb_s vb;
+	void *job;		// cb param of the job the engine hangs on
+};
+
+static struct vi_ldc_mock ldc_mock;
+
+static s32 vi_ldc_mock_dqbuf(MMF_CHN_S chn, VB_BLK *blk)
+{
+	*blk = (VB_BLK)(uintptr_t)&ldc_mock.vb;
+	return CVI_SUCCESS;
+}
+
+static s32 vi_ldc_mock_gdc_op(struct mesh_gdc_cfg *cfg)
+{
+	if (ldc_mock.job)
+		return CVI_ERR_GDC_BUSY;
+
+	// as dwa: keep a copy of the cb param, the vi callback frees it
+	ldc_mock.job = vmalloc(cfg->cbParamSize);
+	if (!ldc_mock.job)
+		return CVI_ERR_GDC_NOMEM;
+	memcpy(ldc_mock.job, cfg->pcbParam, cfg->cbParamSize);
+
+	return CVI_SUCCESS;
+}
+
+static s32 vi_ldc_mock_done(MMF_CHN_S chn, VB_BLK blk)
+{
+	return CVI_SUCCESS;
+}
+
+static s32 vi_ldc_mock_release(VB_BLK blk)
+{
+	return CVI_SUCCESS;
+}
+
+static void vi_ldc_mock_qbuf(MMF_CHN_S chn)
+{
+}
+
+static const struct vi_frm_ops vi_ldc_mock_ops = {
+	.dqbuf		= vi_ldc_mock_dqbuf,
+	.gdc_op		= vi_ldc_mock_gdc_op,
+	.done		= vi_ldc_mock_done,
+	.release	= vi_ldc_mock_release,
+	.qbuf		= vi_ldc_mock_qbuf,
+};
+
+static void vi_test_ldc_stuck_gdc(void)
+{
+	struct cvi_gdc_mesh *pmesh = &g_vi_mesh[VI_LDC_TEST_CHN];
+	struct _vi_buffer b = {.chnId = VI_LDC_TEST_CHN, .sequence = 1};
+	struct sys_ion_frag_info before, after;
+	struct dwa_op_done_cfg done;
+	struct cvi_vi_ctx *ctx;
+	VI_LDC_ATTR_S attr, attr_old;
+	ROTATION_E rot_old;
+	CVI_U64 paddr_old;
+	uint64_t mesh;
+	void *mesh_v;
+	bool pass = true;
+	s32 ret;
+
+	if (gViCtx->total_chn_num > VI_LDC_TEST_CHN) {
+		vi_pr(VI_WARN, "ldc stuck gdc: chn%d in use, skip\n", VI_LDC_TEST_CHN);
+		return;
+	}
+
+	memset(&ldc_mock, 0, sizeof(ldc_mock));
+	ldc_mock.vdev = vzalloc(sizeof(*ldc_mock.vdev));
+	ctx = vmalloc(sizeof(*ctx));
+	if (!ldc_mock.vdev || !ctx) {
+		vi_pr(VI_ERR, "ldc stuck gdc: no memory\n");
+		goto EXIT;
+	}
+
+	memcpy(ctx, gViCtx, sizeof(*ctx));
+	ctx->bypass_frm[VI_LDC_TEST_CHN] = 0;
+	ctx->pipeAttr[VI_LDC_TEST_CHN].bYuvBypassPath = CVI_TRUE;
+	ctx->stLDCAttr[VI_LDC_TEST_CHN].bEnable = CVI_FALSE;
+	ctx->enRotation[VI_LDC_TEST_CHN] = ROTATION_90;
+	ldc_mock.vdev->vi_ctx = ctx;
+	vi_frm_ops_set(ldc_mock.vdev, &vi_ldc_mock_ops);
+
+	// the engine takes the frame and hangs
+	ktime_get_ts64(&b.timestamp);
+	_vi_event_handler_frame(ldc_mock.vdev, &b);
+	if (!ldc_mock.job) {
+		vi_pr(VI_ERR, "ldc stuck gdc: frame didn't go to gdc\n");
+		goto EXIT;
+	}
+
+	sys_ion_get_frag_info(&before);
+	if (sys_ion_alloc(&mesh, &mesh_v, (uint8_t *)"vi_ldc_test", VI_LDC_TEST_MESH_SIZE, false)) {
+		vi_pr(VI_ERR, "ldc stuck gdc: mesh alloc failed\n");
+		pass = false;
+		goto DONE;
+	}
+
+	paddr_old = pmesh->paddr;
+	attr_old = gViCtx->stLDCAttr[VI_LDC_TEST_CHN];
+	rot_old = gViCtx->enRotation[VI_LDC_TEST_CHN];
+	memset(&attr, 0, sizeof(attr));
+	attr.bEnable = CVI_TRUE;
+	ret = vi_set_chn_ldc_attr(VI_LDC_TEST_CHN, ROTATION_0, &attr, mesh);
+
+	if (ret != CVI_ERR_VI_BUSY) {
+		vi_pr(VI_ERR, "ldc stuck gdc: update ret %#x, expect %#x\n", ret, CVI_ERR_VI_BUSY);
+		pass = false;
+	}
+	if (pmesh->paddr != paddr_old ||
+	    gViCtx->stLDCAttr[VI_LDC_TEST_CHN].bEnable != attr_old.bEnable ||
+	    gViCtx->enRotation[VI_LDC_TEST_CHN] != rot_old) {
+		vi_pr(VI_ERR, "ldc stuck gdc: mesh 0x%llx, was 0x%llx\n",
+			(unsigned long long)pmesh->paddr, (unsigned long long)paddr_old);
+		pass = false;
+	}
+	sys_ion_get_frag_info(&after);
+	if (after.buf_num != before.buf_num) {
+		vi_pr(VI_ERR, "ldc stuck gdc: %d ion buffers, was %d\n", after.buf_num, before.buf_num);
+		pass = false;
+	}
+
+DONE:
+	// dwa gives up on the job, vi gets the frame back without output
+	done.pParam = ldc_mock.job;
+	done.blk = VB_INVALID_HANDLE;
+	vi_cb(ldc_mock.vdev, E_MODULE_DWA, VI_CB_GDC_OP_DONE, &done);
+
+	if (vi_gdc_hold(VI_LDC_TEST_CHN) != CVI_SUCCESS) {
+		vi_pr(VI_ERR, "ldc stuck gdc: chn still busy after the job\n");
+		pass = false;
+	}
+	vi_gdc_unhold(VI_LDC_TEST_CHN);
+
+	if (pass)
+		vi_pr(VI_INFO, "ldc stuck gdc PASS\n");
+	else
+		vi_pr(VI_ERR, "ldc stuck gdc FAIL\n");
+EXIT:
+	vfree(ctx);
+	vfree(ldc_mock.vdev);
+}
+
+/*******************************************************************************
+ *	Latency histograms
+ *
+ *	Feeds vi_lat_record() stages of known length and checks the bucket each
+ *	lands in, then replays isr marks: sof->fe with a delay in between, and a
+ *	dropped frame whose be mark must not pair with an old fe stamp.
+ *	Clears the histograms before and after.
+ ******************************************************************************/
+struct vi_lat_case {
+	u64 ns;
+	u8 bucket;
+};
+
+static const struct vi_lat_case vi_lat_cases[] = {
+	{ 500, 0 },			// below 1us
+	{ 1500, 0 },
+	{ 3000, 1 },
+	{ 96 * NSEC_PER_USEC, 6 },
+	{ 6 * NSEC_PER_MSEC, 12 },
+	{ 100ULL * NSEC_PER_SEC, VI_LAT_BUCKETS - 1 },	// clamped to the last
+};
+
+static void vi_test_lat_hist(void)
+{
+	const u8 raw = ISP_PRERAW_A;
+	struct vi_lat_hist h, prev;
+	bool pass = true;
+	u32 i;
+
+	vi_lat_hist_reset();
+
+	for (i = 0; i < ARRAY_SIZE(vi_lat_cases); i++) {
+		vi_lat_hist_get(raw, VI_LAT_POST_QBUF, &prev);
+		vi_lat_record(raw, VI_LAT_POST_QBUF, ktime_get_ns() - vi_lat_cases[i].ns);
+		vi_lat_hist_get(raw, VI_LAT_POST_QBUF, &h);
+		if (h.cnt != i + 1 ||
+		    h.bucket[vi_lat_cases[i].bucket] != prev.bucket[vi_lat_cases[i].bucket] + 1) {
+			vi_pr(VI_ERR, "lat case %d: %llu ns not in bucket %d\n",
+				i, vi_lat_cases[i].ns, vi_lat_cases[i].bucket);
+			pass = false;
+		}
+	}
+	// a start of 0 means no stamp, nothing is recorded
+	vi_lat_record(raw, VI_LAT_POST_QBUF, 0);
+	vi_lat_hist_get(raw, VI_LAT_POST_QBUF, &h);
+	if (h.cnt != ARRAY_SIZE(vi_lat_cases) || h.max_us < 100 * USEC_PER_SEC) {
+		vi_pr(VI_ERR, "lat cnt %d max %d us\n", h.cnt, h.max_us);
+		pass = false;
+	}
+
+	// sof -> fe, 200us lands in [128, 256)
+	vi_lat_mark(raw, VI_LAT_PT_SOF);
+	udelay(200);
+	vi_lat_mark(raw, VI_LAT_PT_FE);
+	vi_lat_hist_get(raw, VI_LAT_SOF_FE, &h);
+	if (h.cnt != 1 || h.max_us < 200) {
+		vi_pr(VI_ERR, "sof->fe cnt %d max %d us\n", h.cnt, h.max_us);
+		pass = false;
+	}
+
+	// the first be takes the fe stamp, the next one lost its fe and is skipped
+	vi_lat_mark(raw, VI_LAT_PT_BE);
+	vi_lat_mark(raw, VI_LAT_PT_SOF);
+	vi_lat_mark(raw, VI_LAT_PT_BE);
+	vi_lat_hist_get(raw, VI_LAT_FE_BE, &h);
+	if (h.cnt != 1) {
+		vi_pr(VI_ERR, "fe->be cnt %d, expect 1\n", h.cnt);
+		pass = false;
+	}
+
+	vi_lat_hist_reset();
+
+	if (pass)
+		vi_pr(VI_INFO, "latency histogram PASS\n");
+	else
+		vi_pr(VI_ERR, "latency histogram FAIL\n");
+}
+
+/*******************************************************************************
+ *	Mempool on a fake region
+ *
+ *	The pool only does bookkeeping, so a region nothing backs will do. Sets
+ *	up two pipes and shared buffers, reconfigures one pipe, and checks that
+ *	the other keeps its addresses, the freed space is reused, the usage
+ *	counters add up, and freeing everything starts a new configuration.
+ ******************************************************************************/
+#define VI_MEMPOOL_TEST_BASE	0x100000000ULL
+#define VI_MEMPOOL_TEST_SIZE	0x100000
+
+#define VI_MEMPOOL_CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			vi_pr(VI_ERR, "mempool check failed: %s\n", #cond); \
+			pass = false; \
+		} \
+	} while (0)
+
+static void vi_test_mempool(void)
+{
+	struct _mempool *pool;
+	int64_t a0, a1, b0, s0, b1;
+	bool pass = true;
+
+	pool = kzalloc(sizeof(*pool), GFP_KERNEL);
+	if (!pool) {
+		vi_pr(VI_ERR, "mempool: no memory\n");
+		return;
+	}
+	vi_mempool_init(pool, VI_MEMPOOL_TEST_BASE, VI_MEMPOOL_TEST_SIZE);
+
+	// a fresh pool hands out addresses like a bump allocator
+	vi_mempool_tag(pool, ISP_PRERAW_A, VI_MEM_FE);
+	VI_MEMPOOL_CHECK(vi_mempool_cursor(pool) == VI_MEMPOOL_TEST_BASE);
+	a0 = vi_mempool_alloc(pool, 0x10000);
+	a1 = vi_mempool_alloc(pool, 0x10000);
+	vi_mempool_tag(pool, ISP_PRERAW_B, VI_MEM_FE);
+	b0 = vi_mempool_alloc(pool, 0x20000);
+	vi_mempool_tag(pool, VI_MEM_OWNER_SHARED, VI_MEM_BE);
+	s0 = vi_mempool_alloc(pool, 0x8000);
+	VI_MEMPOOL_CHECK(a0 == VI_MEMPOOL_TEST_BASE);
+	VI_MEMPOOL_CHECK(a1 == a0 + 0x10000);
+	VI_MEMPOOL_CHECK(b0 == a1 + 0x10000);
+	VI_MEMPOOL_CHECK(s0 == b0 + 0x20000);
+	VI_MEMPOOL_CHECK(pool->byteused == 0x48000 && pool->peak == 0x48000);
+	VI_MEMPOOL_CHECK(pool->owner_used[ISP_PRERAW_A] == 0x20000);
+	VI_MEMPOOL_CHECK(pool->type_used[VI_MEM_FE] == 0x40000);
+
+	// no room and size 0
+	VI_MEMPOOL_CHECK(vi_mempool_alloc(pool, VI_MEMPOOL_TEST_SIZE) < 0);
+	VI_MEMPOOL_CHECK(vi_mempool_alloc(pool, 0) == s0 + 0x8000);
+
+	// reconfigure pipe B only, A and the shared buffers stay where they are
+	vi_mempool_free_owner(pool, ISP_PRERAW_B);
+	VI_MEMPOOL_CHECK(pool->byteused == 0x28000 && pool->owner_used[ISP_PRERAW_B] == 0);
+	VI_MEMPOOL_CHECK(pool->nr_blk == 5);
+	VI_MEMPOOL_CHECK(pool->blk[0].addr == a0 && pool->blk[0].used);
+	VI_MEMPOOL_CHECK(pool->blk[2].addr == b0 && !pool->blk[2].used);
+	VI_MEMPOOL_CHECK(pool->blk[3].addr == s0 && pool->blk[3].used);
+
+	// the tail is larger than the hole and gets the new buffer
+	vi_mempool_tag(pool, ISP_PRERAW_B, VI_MEM_FE);
+	b1 = vi_mempool_alloc(pool, 0x30000);
+	VI_MEMPOOL_CHECK(b1 == s0 + 0x8000);
+	VI_MEMPOOL_CHECK(pool->bump_used == 0x48000 + 0x30000);
+	VI_MEMPOOL_CHECK(pool->peak == 0x48000 + 0x30000);
+
+	// once the hole is the largest extent it is reused
+	vi_mempool_free_owner(pool, ISP_PRERAW_B);
+	vi_mempool_tag(pool, VI_MEM_OWNER_SHARED, VI_MEM_BE);
+	VI_MEMPOOL_CHECK(vi_mempool_alloc(pool, VI_MEMPOOL_TEST_SIZE - 0x48000) == s0 + 0x8000);
+	vi_mempool_tag(pool, ISP_PRERAW_B, VI_MEM_FE);
+	VI_MEMPOOL_CHECK(vi_mempool_alloc(pool, 0x20000) == b0);
+	VI_MEMPOOL_CHECK(pool->byteused == VI_MEMPOOL_TEST_SIZE);
+	VI_MEMPOOL_CHECK(pool->bump_used > pool->peak);
+
+	// all freed: extents merge back and a new configuration starts
+	vi_mempool_free_owner(pool, ISP_PRERAW_A);
+	vi_mempool_free_owner(pool, ISP_PRERAW_B);
+	vi_mempool_free_owner(pool, VI_MEM_OWNER_SHARED);
+	VI_MEMPOOL_CHECK(pool->byteused == 0 && pool->nr_blk == 1);
+	VI_MEMPOOL_CHECK(pool->blk[0].size == VI_MEMPOOL_TEST_SIZE);
+	VI_MEMPOOL_CHECK(pool->peak == 0 && pool->bump_used == 0);
+	VI_MEMPOOL_CHECK(pool->type_used[VI_MEM_FE] == 0 && pool->type_used[VI_MEM_BE] == 0);
+	VI_MEMPOOL_CHECK(vi_mempool_cursor(pool) == VI_MEMPOOL_TEST_BASE);
+
+	kfree(pool);
+
+	if (pass)
+		vi_pr(VI_INFO, "mempool PASS\n");
+	else
+		vi_pr(VI_ERR, "mempool FAIL\n");
+}
+
+/*******************************************************************************
+ *	Frame drop accounting
+ *
+ *	A private vdev hands its frames to mocks of vb and dwa set with
+ *	vi_frm_ops_set(), each case makes them fail the way one drop cause needs
+ *	and feeds a frame through _vi_event_handler_frame(). The vdev reads a
+ *	copy of the vi ctx where pipe A has chns 0 and 1 and pipe B chn 2, so the
+ *	drops of chn 1 have to land on pipe A and in the u32LostFrame of chn 1.
+ *	The live vdev and gViCtx are left alone.
+ *
+ *	isp errors and the retries come from the isr path and aren't covered.
+ ******************************************************************************/
+#define VI_DROP_TEST_CHN	1
+#define VI_DROP_TEST_RAW	ISP_PRERAW_A
+
+struct vi_drop_mock {
+	struct cvi_vi_dev *vdev;
+	struct vb_s vb;
+	s32 dqbuf_ret;
+	s32 gdc_ret;
+	bool gdc_timeout;	// take the job, complete it without output
+	s32 done_ret;
+	u32 release;
+};
+
+static struct vi_drop_mock drop_mock;
+
+static s32 vi_drop_mock_dqbuf(MMF_CHN_S chn, VB_BLK *blk)
+{
+	*blk = drop_mock.dqbuf_ret ? VB_INVALID_HANDLE : (VB_BLK)(uintptr_t)&drop_mock.vb;
+	return drop_mock.dqbuf_ret;
+}
+
+static s32 vi_drop_mock_gdc_op(struct mesh_gdc_cfg *cfg)
+{
+	struct dwa_op_done_cfg done;
+
+	if (drop_mock.gdc_ret)
+		return drop_mock.gdc_ret;
+
+	// as dwa: keep a copy of the cb param, the vi callback frees it
+	done.pParam = vmalloc(cfg->cbParamSize);
+	if (!done.pParam)
+		return CVI_ERR_GDC_NOMEM;
+	memcpy(done.pParam, cfg->pcbParam, cfg->cbParamSize);
+	done.blk = drop_mock.gdc_timeout ? VB_INVALID_HANDLE : (VB_BLK)(uintptr_t)&drop_mock.vb;
+	vi_cb(drop_mock.vdev, E_MODULE_DWA, VI_CB_GDC_OP_DONE, &done);
+
+	return CVI_SUCCESS;
+}
+
+static s32 vi_drop_mock_done(MMF_CHN_S chn, VB_BLK blk)
+{
+	return drop_mock.done_ret;
+}
+
+static s32 vi_drop_mock_release(VB_BLK blk)
+{
+	drop_mock.release++;
+	return CVI_SUCCESS;
+}
+
+static void vi_drop_mock_qbuf(MMF_CHN_S chn)
+{
+}
+
+static const struct vi_frm_ops vi_drop_mock_ops = {
+	.dqbuf		= vi_drop_mock_dqbuf,
+	.gdc_op		= vi_drop_mock_gdc_op,
+	.done		= vi_drop_mock_done,
+	.release	= vi_drop_mock_release,
+	.qbuf		= vi_drop_mock_qbuf,
+};
+
+static const struct {
+	const char *name;
+	s32 dqbuf_ret;
+	bool rotate;
+	s32 gdc_ret;
+	bool gdc_timeout;
+	s32 done_ret;
+	enum vi_drop_cause cause;	// VI_DROP_CAUSE_MAX if the frame goes on
+} vi_drop_cases[] = {
+	{"no vb", CVI_FAILURE, false, 0, false, 0, VI_DROP_NO_VB},
+	{"gdc busy", 0, true, CVI_ERR_GDC_BUSY, false, 0, VI_DROP_GDC_BUSY},
+	{"gdc error", 0, true, CVI_ERR_GDC_NOBUF, false, 0, VI_DROP_GDC_BUSY},
+	{"gdc timeout", 0, true, 0, true, 0, VI_DROP_TIMEOUT},
+	{"queue full", 0, false, 0, false, -ENOBUFS, VI_DROP_QUEUE_FULL},
+	{"gdc queue full", 0, true, 0, false, -ENOBUFS, VI_DROP_QUEUE_FULL},
+	{"done", 0, false, 0, false, 0, VI_DROP_CAUSE_MAX},
+	{"gdc done", 0, true, 0, false, 0, VI_DROP_CAUSE_MAX},
+};
+
+static void vi_test_drop_stat(void)
+{
+	struct cvi_vi_ctx *ctx;
+	struct vi_drop_stat prev, *stat;
+	struct _vi_buffer b = {.chnId = VI_DROP_TEST_CHN};
+	u32 lost, release, i;
+	bool pass = true;
+	u8 raw, j;
+
+	memset(&drop_mock, 0, sizeof(drop_mock));
+	drop_mock.vdev = vzalloc(sizeof(*drop_mock.vdev));
+	ctx = vmalloc(sizeof(*ctx));
+	if (!drop_mock.vdev || !ctx) {
+		vi_pr(VI_ERR, "drop stat: no memory\n");
+		vfree(drop_mock.vdev);
+		vfree(ctx);
+		return;
+	}
+
+	memcpy(ctx, gViCtx, sizeof(*ctx));
+	ctx->total_dev_num = 2;
+	ctx->devAttr[ISP_PRERAW_A].chn_num = 2;
+	ctx->devAttr[ISP_PRERAW_B].chn_num = 1;
+	ctx->bypass_frm[VI_DROP_TEST_CHN] = 0;
+	ctx->pipeAttr[VI_DROP_TEST_CHN].bYuvBypassPath = CVI_TRUE;
+	ctx->stLDCAttr[VI_DROP_TEST_CHN].bEnable = CVI_FALSE;
+	memset(&ctx->chnStatus[VI_DROP_TEST_CHN], 0, sizeof(ctx->chnStatus[VI_DROP_TEST_CHN]));
+
+	drop_mock.vdev->vi_ctx = ctx;
+	vi_frm_ops_set(drop_mock.vdev, &vi_drop_mock_ops);
+
+	stat = &drop_mock.vdev->drop_stat[VI_DROP_TEST_RAW];
+	for (i = 0; i < ARRAY_SIZE(vi_drop_cases); i++) {
+		drop_mock.dqbuf_ret = vi_drop_cases[i].dqbuf_ret;
+		drop_mock.gdc_ret = vi_drop_cases[i].gdc_ret;
+		drop_mock.gdc_timeout = vi_drop_cases[i].gdc_timeout;
+		drop_mock.done_ret = vi_drop_cases[i].done_ret;
+		ctx->enRotation[VI_DROP_TEST_CHN] = vi_drop_cases[i].rotate ? ROTATION_90 : ROTATION_0;
+
+		prev = *stat;
+		lost = ctx->chnStatus[VI_DROP_TEST_CHN].u32LostFrame;
+		release = drop_mock.release;
+
+		b.sequence = i + 1;
+		ktime_get_ts64(&b.timestamp);
+		_vi_event_handler_frame(drop_mock.vdev, &b);
+
+		for (j = 0; j < VI_DROP_CAUSE_MAX; j++) {
+			if (stat->cnt[j] != prev.cnt[j] + (j == vi_drop_cases[i].cause)) {
+				vi_pr(VI_ERR, "%s: cause %d cnt %d, was %d\n",
+					vi_drop_cases[i].name, j, stat->cnt[j], prev.cnt[j]);
+				pass = false;
+			}
+		}
+		if (vi_drop_cases[i].cause != VI_DROP_CAUSE_MAX &&
+		    stat->last_ns[vi_drop_cases[i].cause] <= prev.last_ns[vi_drop_cases[i].cause]) {
+			vi_pr(VI_ERR, "%s: drop time not updated\n", vi_drop_cases[i].name);
+			pass = false;
+		}
+		if (ctx->chnStatus[VI_DROP_TEST_CHN].u32LostFrame !=
+		    lost + (vi_drop_cases[i].cause != VI_DROP_CAUSE_MAX)) {
+			vi_pr(VI_ERR, "%s: lost frame %d, was %d\n", vi_drop_cases[i].name,
+				ctx->chnStatus[VI_DROP_TEST_CHN].u32LostFrame, lost);
+			pass = false;
+		}
+		// gdc turned the frame away, vi gives the blk back
+		if (drop_mock.release != release + (vi_drop_cases[i].cause == VI_DROP_GDC_BUSY)) {
+			vi_pr(VI_ERR, "%s: %d blk released\n", vi_drop_cases[i].name,
+				drop_mock.release - release);
+			pass = false;
+		}
+	}
+
+	// only pipe A lost frames, none of them is a retry
+	for (raw = ISP_PRERAW_A; raw < ISP_PRERAW_VIRT_MAX; raw++) {
+		stat = &drop_mock.vdev->drop_stat[raw];
+		for (j = 0; j < VI_DROP_CAUSE_MAX; j++) {
+			if (raw != VI_DROP_TEST_RAW && stat->cnt[j]) {
+				vi_pr(VI_ERR, "raw_%d cause %d cnt %d, expect 0\n", raw, j, stat->cnt[j]);
+				pass = false;
+			}
+		}
+		if (stat->retry) {
+			vi_pr(VI_ERR, "raw_%d retry %d, expect 0\n", raw, stat->retry);
+			pass = false;
+		}
+	}
+
+	vfree(ctx);
+	vfree(drop_mock.vdev);
+
+	if (pass)
+		vi_pr(VI_INFO, "drop stat PASS\n");
+	else
+		vi_pr(VI_ERR, "drop stat FAIL\n");
+}
+
+/*******************************************************************************
+ *	Raw dump ring on a fake isp
+ *
+ *	An hrtimer plays pre_fe at 4MP 30fps: each tick takes the buffer hw
+ *	wrote, stamps the frame number at both ends of it and reports it with
+ *	_isp_raw_dump_chk() like the frame done isr. A kthread plays the
+ *	recorder on the ring page, no ioctl per frame: it reads every new frame
+ *	in full, checks the stamps and hands the slot back by tail. The frames
+ *	are vmalloc memory whose addresses stand in for phy addrs. Runs on a
+ *	private vdev and the ring of pipe C.
+ *
+ *	1. the recorder keeps up: no overrun, every frame in order
+ *	2. the recorder stalls: the newest frame is reused and counted, held
+ *	   frames are never written, frame numbers skip by exactly the overrun
+ *	3. the recorder scribbles head, slot_num and a bogus tail into the page:
+ *	   the kernel publishes where it should and rewrites head
+ *	4. isp_raw_ring_stop() while frames still come: nothing is published
+ *	   after it
+ ******************************************************************************/
+#define VI_RAW_RING_TEST_RAW		ISP_PRERAW_C
+#define VI_RAW_RING_TEST_W		2560
+#define VI_RAW_RING_TEST_H		1440
+#define VI_RAW_RING_TEST_SIZE		(VI_RAW_RING_TEST_W * VI_RAW_RING_TEST_H * 3 / 2)	// raw12
+#define VI_RAW_RING_TEST_FPS		30
+#define VI_RAW_RING_TEST_SLOTS		3
+#define VI_RAW_RING_TEST_FRAMES		300	// 10s of phase 1
+#define VI_RAW_RING_TEST_STALL		30	// frames the recorder sleeps through
+#define VI_RAW_RING_TEST_CHUNK		SZ_64K
+
+struct vi_raw_ring_test {
+	struct cvi_vi_dev *vdev;
+	struct cvi_vip_isp_raw_ring *page;
+	struct hrtimer timer;
+	u8 *frame[VI_RAW_RING_TEST_SLOTS];
+	u8 *sink;
+	u32 limit;		// frames to produce so far
+	u32 produced;
+	u32 no_buf;		// ticks without a buffer for hw
+	bool pause;		// recorder stops reading
+	u32 tail;
+	u32 received;
+	u32 last_frm;
+	u32 skipped;		// frame numbers the recorder never saw
+	u32 corrupt;
+	u64 bytes;
+	u64 copy_max_ns;
+};
+
+static struct vi_raw_ring_test raw_ring_test;
+
+static void vi_raw_ring_stamp(u8 *frame, u32 frm_num)
+{
+	((u32 *)frame)[0] = frm_num;
+	((u32 *)(frame + VI_RAW_RING_TEST_SIZE))[-1] = frm_num;
+}
+
+static bool vi_raw_ring_stamp_ok(const u8 *frame, u32 frm_num)
+{
+	return ((const u32 *)frame)[0] == frm_num &&
+	       ((const u32 *)(frame + VI_RAW_RING_TEST_SIZE))[-1] == frm_num;
+}
+
+static enum hrtimer_restart vi_raw_ring_fire(struct hrtimer *timer)
+{
+	struct vi_raw_ring_test *st = &raw_ring_test;
+	struct isp_buffer *b;
+
+	if (st->produced < READ_ONCE(st->limit)) {
+		b = isp_buf_remove(&raw_dump_b_q[VI_RAW_RING_TEST_RAW]);
+		if (!b) {
+			st->no_buf++;
+		} else {
+			b->frm_num = ++st->produced;
+			b->byr_size = VI_RAW_RING_TEST_SIZE;
+			vi_raw_ring_stamp((u8 *)(uintptr_t)b->addr, b->frm_num);
+			isp_buf_queue(&raw_dump_b_dq[VI_RAW_RING_TEST_RAW], b);
+			_isp_raw_dump_chk(st->vdev, VI_RAW_RING_TEST_RAW, b->frm_num);
+		}
+	}
+
+	hrtimer_forward_now(timer, ns_to_ktime(NSEC_PER_SEC / VI_RAW_RING_TEST_FPS));
+	return HRTIMER_RESTART;
+}
+
+static int vi_raw_ring_recorder(void *arg)
+{
+	struct vi_raw_ring_test *st = arg;
+	struct cvi_vip_isp_raw_ring_hdr hdr;
+	const u8 *frame;
+	u64 t;
+	u32 off;
+
+	while (!kthread_should_stop()) {
+		if (READ_ONCE(st->pause) || READ_ONCE(st->page->head) == st->tail) {
+			usleep_range(1000, 2000);
+			continue;
+		}
+		smp_rmb();
+		hdr = st->page->hdr[st->tail % VI_RAW_RING_TEST_SLOTS];
+		frame = (const u8 *)(uintptr_t)hdr.phy_addr;
+
+		t = ktime_get_ns();
+		for (off = 0; off < hdr.size; off += VI_RAW_RING_TEST_CHUNK)
+			memcpy(st->sink, frame + off, min_t(u32, VI_RAW_RING_TEST_CHUNK, hdr.size - off));
+		st->copy_max_ns = max(st->copy_max_ns, ktime_get_ns() - t);
+		st->bytes += hdr.size;
+
+		// still the frame the header names, nothing wrote it while held
+		if (hdr.size != VI_RAW_RING_TEST_SIZE || hdr.width != VI_RAW_RING_TEST_W ||
+		    hdr.height != VI_RAW_RING_TEST_H || hdr.raw_num != VI_RAW_RING_TEST_RAW ||
+		    hdr.frm_num <= st->last_frm || !vi_raw_ring_stamp_ok(frame, hdr.frm_num)) {
+			vi_pr(VI_ERR, "raw ring: slot %d frm %d after %d, size %d %dx%d raw_%d\n",
+				st->tail, hdr.frm_num, st->last_frm, hdr.size, hdr.width,
+				hdr.height, hdr.raw_num);
+			st->corrupt++;
+		} else {
+			st->skipped += hdr.frm_num - st->last_frm - 1;
+			st->last_frm = hdr.frm_num;
+		}
+		st->received++;
+
+		smp_mb();
+		WRITE_ONCE(st->page->tail, ++st->tail);
+	}
+
+	return 0;
+}
+
+/* produce up to @frames in total and wait until the recorder read them all */
+static bool vi_raw_ring_run(struct vi_raw_ring_test *st, u32 frames)
+{
+	unsigned long timeout;
+
+	WRITE_ONCE(st->limit, frames);
+	timeout = jiffies + msecs_to_jiffies((frames - st->produced) * MSEC_PER_SEC /
+					     VI_RAW_RING_TEST_FPS + 2000);
+	while (READ_ONCE(st->produced) < frames ||
+	       (!READ_ONCE(st->pause) && READ_ONCE(st->page->head) != READ_ONCE(st->tail))) {
+		if (time_after(jiffies, timeout)) {
+			vi_pr(VI_ERR, "raw ring: stuck at frame %d of %d, head %d tail %d\n",
+				st->produced, frames, st->page->head, st->tail);
+			return false;
+		}
+		msleep(20);
+	}
+
+	return true;
+}
+
+static void vi_test_raw_ring(void)
+{
+	struct vi_raw_ring_test *st = &raw_ring_test;
+	struct cvi_vip_isp_raw_blk raw_blk[VI_RAW_RING_TEST_SLOTS];
+	struct cvi_vip_isp_smooth_raw_param param;
+	struct task_struct *recorder = NULL;
+	struct isp_buffer *b;
+	u32 overrun, head, produced;
+	bool pass = true;
+	u64 start_ns, ns;
+	u8 i;
+
+	memset(st, 0, sizeof(*st));
+	if (isp_next_buf(&raw_dump_b_q[VI_RAW_RING_TEST_RAW]) ||
+	    isp_next_buf(&raw_dump_b_dq[VI_RAW_RING_TEST_RAW])) {
+		vi_pr(VI_ERR, "raw ring: raw_%d is dumping\n", VI_RAW_RING_TEST_RAW);
+		return;
+	}
+
+	st->vdev = vzalloc(sizeof(*st->vdev));
+	st->sink = vmalloc(VI_RAW_RING_TEST_CHUNK);
+	for (i = 0; i < VI_RAW_RING_TEST_SLOTS; i++)
+		st->frame[i] = vmalloc(VI_RAW_RING_TEST_SIZE);
+	for (i = 0; i < VI_RAW_RING_TEST_SLOTS; i++)
+		if (!st->frame[i])
+			break;
+	if (!st->vdev || !st->sink || i < VI_RAW_RING_TEST_SLOTS) {
+		vi_pr(VI_ERR, "raw ring: no memory\n");
+		goto EXIT;
+	}
+
+	memset(raw_blk, 0, sizeof(raw_blk));
+	for (i = 0; i < VI_RAW_RING_TEST_SLOTS; i++) {
+		raw_blk[i].raw_dump.phy_addr = (uintptr_t)st->frame[i];
+		raw_blk[i].src_w = VI_RAW_RING_TEST_W;
+		raw_blk[i].src_h = VI_RAW_RING_TEST_H;
+	}
+	param.raw_blk = raw_blk;
+	param.raw_num = VI_RAW_RING_TEST_RAW;
+	param.frm_num = VI_RAW_RING_TEST_SLOTS;
+	if (isp_start_raw_ring(st->vdev, &param)) {
+		vi_pr(VI_ERR, "raw ring: start failed\n");
+		goto EXIT;
+	}
+	st->page = isp_raw_ring_get(VI_RAW_RING_TEST_RAW);
+
+	recorder = kthread_run(vi_raw_ring_recorder, st, "vi_raw_ring");
+	if (IS_ERR(recorder)) {
+		vi_pr(VI_ERR, "raw ring: recorder thread failed\n");
+		recorder = NULL;
+		goto STOP;
+	}
+
+	hrtimer_init(&st->timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	st->timer.function = vi_raw_ring_fire;
+	hrtimer_start(&st->timer, ns_to_ktime(NSEC_PER_SEC / VI_RAW_RING_TEST_FPS), HRTIMER_MODE_REL);
+
+	// 1. sustained 4MP 30fps
+	start_ns = ktime_get_ns();
+	pass &= vi_raw_ring_run(st, VI_RAW_RING_TEST_FRAMES);
+	ns = ktime_get_ns() - start_ns;
+	vi_pr(VI_INFO, "raw ring: %d frames %llu MB in %llu ms, copy max %llu us, period %lu us\n",
+		st->received, st->bytes >> 20, div_u64(ns, NSEC_PER_MSEC),
+		div_u64(st->copy_max_ns, NSEC_PER_USEC), USEC_PER_SEC / VI_RAW_RING_TEST_FPS);
+	if (st->page->overrun || st->skipped || st->corrupt || st->no_buf ||
+	    st->received != VI_RAW_RING_TEST_FRAMES) {
+		vi_pr(VI_ERR, "raw ring sustained: received %d overrun %d skipped %d corrupt %d no_buf %d\n",
+			st->received, st->page->overrun, st->skipped, st->corrupt, st->no_buf);
+		pass = false;
+	}
+
+	// 2. recorder stalls, the ring keeps 2 frames and hw the 3rd
+	WRITE_ONCE(st->pause, true);
+	pass &= vi_raw_ring_run(st, st->produced + VI_RAW_RING_TEST_STALL);
+	overrun = st->page->overrun;
+	WRITE_ONCE(st->pause, false);
+	// one more frame, so the recorder sees the gap
+	pass &= vi_raw_ring_run(st, st->produced + 1);
+	if (overrun != VI_RAW_RING_TEST_STALL - (VI_RAW_RING_TEST_SLOTS - 1) ||
+	    st->skipped != st->page->overrun || st->received + st->page->overrun != st->produced ||
+	    st->corrupt || st->no_buf) {
+		vi_pr(VI_ERR, "raw ring stall: overrun %d received %d skipped %d produced %d corrupt %d\n",
+			st->page->overrun, st->received, st->skipped, st->produced, st->corrupt);
+		pass = false;
+	}
+
+	// 3. the recorder writes junk, only a sane tail is taken
+	WRITE_ONCE(st->pause, true);
+	head = st->page->head;
+	st->page->head = 0xdead;
+	st->page->slot_num = VI_RAW_RING_MAX * 1000;
+	st->page->tail = st->tail + 100;
+	pass &= vi_raw_ring_run(st, st->produced + 1);
+	if (st->page->head != head + 1 ||
+	    st->page->hdr[head % VI_RAW_RING_TEST_SLOTS].frm_num != st->produced) {
+		vi_pr(VI_ERR, "raw ring junk: head %d expect %d\n", st->page->head, head + 1);
+		pass = false;
+	}
+	st->page->slot_num = VI_RAW_RING_TEST_SLOTS;
+	WRITE_ONCE(st->page->tail, st->tail);
+	WRITE_ONCE(st->pause, false);
+	pass &= vi_raw_ring_run(st, st->produced + VI_RAW_RING_TEST_FPS);
+	if (st->corrupt || st->received + st->page->overrun != st->produced) {
+		vi_pr(VI_ERR, "raw ring junk: received %d overrun %d produced %d corrupt %d\n",
+			st->received, st->page->overrun, st->produced, st->corrupt);
+		pass = false;
+	}
+
+	// 4. stop as vi_stop_streaming does, frames still coming
+	WRITE_ONCE(st->limit, U32_MAX);
+	msleep(MSEC_PER_SEC / VI_RAW_RING_TEST_FPS * 3);
+	isp_raw_ring_stop(VI_RAW_RING_TEST_RAW);
+	head = st->page->head;
+	produced = READ_ONCE(st->produced);
+	msleep(MSEC_PER_SEC / VI_RAW_RING_TEST_FPS * 5);
+	if (st->page->slot_num || st->page->head != head || READ_ONCE(st->produced) == produced) {
+		vi_pr(VI_ERR, "raw ring stop: slot_num %d head %d/%d produced %d/%d\n",
+			st->page->slot_num, st->page->head, head, st->produced, produced);
+		pass = false;
+	}
+
+	hrtimer_cancel(&st->timer);
+STOP:
+	if (recorder)
+		kthread_stop(recorder);
+	isp_raw_ring_stop(VI_RAW_RING_TEST_RAW);
+	while ((b = isp_buf_remove(&raw_dump_b_dq[VI_RAW_RING_TEST_RAW])) != NULL)
+		vfree(b);
+	while ((b = isp_buf_remove(&raw_dump_b_q[VI_RAW_RING_TEST_RAW])) != NULL)
+		vfree(b);
+
+	if (pass && recorder)
+		vi_pr(VI_INFO, "raw ring PASS\n");
+	else
+		vi_pr(VI_ERR, "raw ring FAIL\n");
+EXIT:
+	for (i = 0; i < VI_RAW_RING_TEST_SLOTS; i++)
+		vfree(st->frame[i]);
+	vfree(st->sink);
+	vfree(st->vdev);
+}
+
 /*******************************************************************************
  *	IPs test case config
  ******************************************************************************/
@@ -579,6 +1661,42 @@ void vi_ip_test_cases_init(struct isp_ctx *ctx)
 		ispblk_ynr_config(ctx, ISP_YNR_OUT_Y_OUT, 128);
 		break;
 	}
+	case VI_TEST_EVENT_STORM: //72
+	{
+		vi_pr(VI_INFO, "frame-done event storm\n");
+		vi_test_event_storm();
+		break;
+	}
+	case VI_TEST_LDC_STUCK_GDC: //73
+	{
+		vi_pr(VI_INFO, "ldc mesh update on a stuck gdc\n");
+		vi_test_ldc_stuck_gdc();
+		break;
+	}
+	case VI_TEST_LAT_HIST: //74
+	{
+		vi_pr(VI_INFO, "latency histograms\n");
+		vi_test_lat_hist();
+		break;
+	}
+	case VI_TEST_MEMPOOL: //75
+	{
+		vi_pr(VI_INFO, "mempool on a fake region\n");
+		vi_test_mempool();
+		break;
+	}
+	case VI_TEST_DROP_STAT: //76
+	{
+		vi_pr(VI_INFO, "frame drop accounting on mocked vb and dwa\n");
+		vi_test_drop_stat();
+		break;
+	}
+	case VI_TEST_RAW_RING: //77
+	{
+		vi_pr(VI_INFO, "raw dump ring on a fake isp\n");
+		vi_test_raw_ring();
+		break;
+	}
 	default:
 		break;
 	}
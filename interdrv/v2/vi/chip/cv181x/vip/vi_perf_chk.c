@@ -1,5 +1,8 @@
 #include <vi_defines.h>
 #include <linux/math64.h>
+#include <linux/module.h>
+#include <linux/seq_file.h>
+#include <vip/vi_perf_chk.h>
 
 // #define ISP_PERF_MEASURE
 #ifdef ISP_PERF_MEASURE
@@ -219,3 +222,133 @@ void vi_perf_record_dump(void)
 	time_chk.sof_end = false;
 #endif
 }
+
+/*******************************************************************************
+ *	Latency histograms
+ *
+ * Always built, one log2 histogram per pipe and stage. Bucket i counts
+ * latencies in [2^i, 2^(i+1)) us, the last bucket also holds everything
+ * above. Recording is a timestamp and a few increments, so it stays enabled
+ * in production; vi_lat_hist_en turns it off at runtime.
+ ******************************************************************************/
+static bool vi_lat_hist_en = true;
+module_param(vi_lat_hist_en, bool, 0644);
+
+static struct vi_lat_hist lat_hist[ISP_PRERAW_MAX][VI_LAT_STAGE_MAX];
+static u64 lat_stamp[ISP_PRERAW_MAX][VI_LAT_PT_MAX];
+
+static const char * const lat_stage_name[VI_LAT_STAGE_MAX] = {
+	"sof->fe", "fe->be", "be->post", "post->qbuf", "irq->thread",
+};
+
+static void _vi_lat_add(struct vi_lat_hist *h, u64 ns)
+{
+	u32 us = (u32)min_t(u64, div_u64(ns, 1000), U32_MAX);
+	u32 idx = us ? min_t(u32, fls(us) - 1, VI_LAT_BUCKETS - 1) : 0;
+
+	h->bucket[idx]++;
+	h->cnt++;
+	h->sum_us += us;
+	if (us > h->max_us)
+		h->max_us = us;
+}
+
+/* vi_lat_mark: stamp a pipeline point of @raw_num from the isr.
+ *
+ * Each point closes the stage started by the previous one. The previous
+ * stamp is consumed so a dropped frame can't pair with a later one.
+ */
+void vi_lat_mark(u8 raw_num, enum vi_lat_point pt)
+{
+	u64 now, start;
+
+	if (!vi_lat_hist_en || raw_num >= ISP_PRERAW_MAX)
+		return;
+
+	now = ktime_get_ns();
+	lat_stamp[raw_num][pt] = now;
+	if (pt == VI_LAT_PT_SOF)
+		return;
+
+	start = lat_stamp[raw_num][pt - 1];
+	lat_stamp[raw_num][pt - 1] = 0;
+	if (start && now >= start)
+		_vi_lat_add(&lat_hist[raw_num][pt - 1], now - start);
+}
+
+/* vi_lat_record: account @stage of @raw_num from @start_ns till now.
+ *
+ * @start_ns: ktime_get_ns() based start of the stage, 0 to skip.
+ */
+void vi_lat_record(u8 raw_num, enum vi_lat_stage stage, u64 start_ns)
+{
+	u64 now;
+
+	if (!vi_lat_hist_en || raw_num >= ISP_PRERAW_MAX || !start_ns)
+		return;
+
+	now = ktime_get_ns();
+	if (now >= start_ns)
+		_vi_lat_add(&lat_hist[raw_num][stage], now - start_ns);
+}
+
+void vi_lat_hist_get(u8 raw_num, enum vi_lat_stage stage, struct vi_lat_hist *h)
+{
+	if (raw_num >= ISP_PRERAW_MAX || stage >= VI_LAT_STAGE_MAX) {
+		memset(h, 0, sizeof(*h));
+		return;
+	}
+
+	*h = lat_hist[raw_num][stage];
+}
+
+void vi_lat_hist_reset(void)
+{
+	memset(lat_hist, 0, sizeof(lat_hist));
+	memset(lat_stamp, 0, sizeof(lat_stamp));
+}
+
+static u32 _vi_lat_pct(const struct vi_lat_hist *h, u32 pct)
+{
+	u64 acc = 0;
+	u32 i;
+
+	for (i = 0; i < VI_LAT_BUCKETS - 1; i++) {
+		acc += h->bucket[i];
+		if (acc * 100 >= (u64)h->cnt * pct)
+			break;
+	}
+
+	return 2U << i;
+}
+
+void vi_lat_hist_show(struct seq_file *m)
+{
+	struct vi_lat_hist h;
+	u8 raw_num, stage, i;
+
+	seq_printf(m, "[VI Latency Histogram] %s, us, log2 buckets\n", vi_lat_hist_en ? "on" : "off");
+
+	for (raw_num = ISP_PRERAW_A; raw_num < ISP_PRERAW_MAX; raw_num++) {
+		for (stage = 0; stage < VI_LAT_STAGE_MAX; stage++) {
+			h = lat_hist[raw_num][stage];
+			if (!h.cnt)
+				continue;
+
+			seq_printf(m, "Pipe%c %-12s cnt:%8u avg:%6llu max:%6u p50:<%u p99:<%u\n",
+					'A' + raw_num, lat_stage_name[stage], h.cnt,
+					div_u64(h.sum_us, h.cnt), h.max_us,
+					_vi_lat_pct(&h, 50), _vi_lat_pct(&h, 99));
+
+			for (i = 0; i < VI_LAT_BUCKETS; i++) {
+				if (!h.bucket[i])
+					continue;
+				if (i == VI_LAT_BUCKETS - 1)
+					seq_printf(m, " >=%u:%u", 1U << i, h.bucket[i]);
+				else
+					seq_printf(m, " <%u:%u", 2U << i, h.bucket[i]);
+			}
+			seq_puts(m, "\n");
+		}
+	}
+}
@@ -1,3 +1,6 @@
+#ifndef __VI_PERF_CHK_H__
+#define __VI_PERF_CHK_H__
+
 /*******************************************************************************
  *	Perf chk interfaces
  ******************************************************************************/
@@ -8,3 +11,41 @@ void vi_record_post_end(struct cvi_vi_dev *vdev, u8 raw_num);
 void vi_record_post_trigger(struct cvi_vi_dev *vdev, u8 raw_num);
 void vi_perf_record_dump(void);
 
+
+/*******************************************************************************
+ *	Latency histogram interfaces
+ ******************************************************************************/
+enum vi_lat_stage {
+	VI_LAT_SOF_FE,		// sof -> pre_fe frame done
+	VI_LAT_FE_BE,		// pre_fe frame done -> pre_be frame done
+	VI_LAT_BE_POST,		// pre_be frame done -> postraw frame done
+	VI_LAT_POST_QBUF,	// postraw frame done -> vb handed to the next module
+	VI_LAT_IRQ_TH,		// postraw frame done -> dequeued by event thread
+	VI_LAT_STAGE_MAX,
+};
+
+/* Must stay in pipeline order, the stage closed by a point is (point - 1). */
+enum vi_lat_point {
+	VI_LAT_PT_SOF,
+	VI_LAT_PT_FE,
+	VI_LAT_PT_BE,
+	VI_LAT_PT_POST,
+	VI_LAT_PT_MAX,
+};
+
+#define VI_LAT_BUCKETS	16
+
+struct vi_lat_hist {
+	u32 bucket[VI_LAT_BUCKETS];	// [i]: latencies in [2^i, 2^(i+1)) us
+	u32 cnt;
+	u32 max_us;
+	u64 sum_us;
+};
+
+void vi_lat_mark(u8 raw_num, enum vi_lat_point pt);
+void vi_lat_record(u8 raw_num, enum vi_lat_stage stage, u64 start_ns);
+void vi_lat_hist_get(u8 raw_num, enum vi_lat_stage stage, struct vi_lat_hist *h);
+void vi_lat_hist_reset(void);
+void vi_lat_hist_show(struct seq_file *m);
+
+#endif // __VI_PERF_CHK_H__
@@ -978,7 +978,8 @@ void _vo_gdc_callback(CVI_VOID *pParam, VB_BLK blk)
 
 	mutex_unlock(&vo_gdc_lock);
 
-	_vo_qbuf(blk);
+	if (blk != VB_INVALID_HANDLE)
+		_vo_qbuf(blk);
 	vfree(pParam);
 }
 
@@ -1161,6 +1162,8 @@ static int _vo_disp_thread(void *arg)
 				, gVoCtx->enRotation) != CVI_SUCCESS) {
 				mutex_unlock(&vo_gdc_lock);
 				vo_pr(VO_ERR, "gdc rotation failed.\n");
+				// gdc gives the blk back on failure
+				vb_release_block(blk);
 				continue;
 			}
 #if 0
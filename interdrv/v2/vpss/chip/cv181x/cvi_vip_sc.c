@@ -106,6 +106,47 @@ void cvi_sc_buf_remove_all(struct cvi_sc_vdev *vdev, const u8 grp_id)
 	spin_unlock_irqrestore(&vdev->rdy_lock, flags);
 }
 
+static u8 _sc_get_sbm_num(struct cvi_sc_vdev *sdev)
+{
+	u8 i, sbm_num = 0;
+
+	for (i = 0; i < VPSS_ONLINE_NUM; i++)
+		if (sdev->sb_enabled[i])
+			sbm_num++;
+
+	return sbm_num;
+}
+
+/* cvi_sc_commit_cfg: program chn_cfg into sc unless the registers already hold it.
+ *
+ * Registers keep their value between jobs, so a chn_cfg identical to the last
+ * one applied needs no MMIO at all. Tile jobs rewrite crop/scale per tile and
+ * fb-bound gop follows the disp's setting, so neither is ever cached.
+ *
+ * @param sdev: sc device
+ * @param chn_cfg: chn_cfg of the grp to run
+ * @param is_tile: if this job is processed in tiles
+ */
+void cvi_sc_commit_cfg(struct cvi_sc_vdev *sdev, const struct cvi_vpss_chn_cfg *chn_cfg, bool is_tile)
+{
+	u8 sbm_num = _sc_get_sbm_num(sdev);
+
+	if (!is_tile && !sdev->bind_fb && sdev->last_cfg_valid && sdev->last_sbm_num == sbm_num
+	    && !memcmp(&sdev->last_chn_cfg, chn_cfg, sizeof(*chn_cfg))) {
+		++sdev->cfg_skip_cnt;
+		return;
+	}
+
+	cvi_sc_update(sdev, chn_cfg);
+	++sdev->cfg_update_cnt;
+
+	sdev->last_cfg_valid = !is_tile && !sdev->bind_fb;
+	if (sdev->last_cfg_valid) {
+		memcpy(&sdev->last_chn_cfg, chn_cfg, sizeof(*chn_cfg));
+		sdev->last_sbm_num = sbm_num;
+	}
+}
+
 void cvi_sc_device_run(void *priv, bool is_tile, bool is_work_on_r_tile, u8 grp_id)
 {
 	struct cvi_sc_vdev *sdev = priv;
@@ -135,7 +176,19 @@ void cvi_sc_device_run(void *priv, bool is_tile, bool is_work_on_r_tile, u8 grp_
 	sclr_odma_set_addr(sdev->dev_idx, b->planes[0].addr, b->planes[1].addr, b->planes[2].addr);
 
 	if (!is_tile || !is_work_on_r_tile)
-		cvi_sc_update(sdev, &sdev->vpss_chn_cfg[grp_id]);
+		cvi_sc_commit_cfg(sdev, &sdev->vpss_chn_cfg[grp_id], is_tile);
+}
+
+/* cvi_sc_invalidate_cfg: forget the chn_cfg cached for sc.
+ *
+ * Must be called whenever sc's registers may have lost what cvi_sc_update
+ * programmed, e.g. reset or re-init, so the next job rewrites all of them.
+ *
+ * @param sdev: sc device
+ */
+void cvi_sc_invalidate_cfg(struct cvi_sc_vdev *sdev)
+{
+	sdev->last_cfg_valid = false;
 }
 
 /*************************************************************************
@@ -363,6 +416,7 @@ int cvi_sc_streamoff(struct cvi_sc_vdev *sdev, bool isForce)
 		sdev->sb_vc_ready[i] = false;
 		sclr_odma_clear_sb(sdev->dev_idx);
 	}
+	cvi_sc_invalidate_cfg(sdev);
 
 	atomic_set(&sdev->job_state, CVI_VIP_IDLE);
 
@@ -401,6 +455,9 @@ int sc_create_instance(struct platform_device *pdev)
 		sdev->sc_coef = CVI_SC_SCALING_COEF_BICUBIC;
 		sdev->tile_mode = 0;
 		sdev->is_cmdq = false;
+		sdev->last_cfg_valid = false;
+		sdev->cfg_update_cnt = 0;
+		sdev->cfg_skip_cnt = 0;
 		spin_lock_init(&sdev->rdy_lock);
 		atomic_set(&sdev->job_state, CVI_VIP_IDLE);
 		atomic_set(&sdev->is_streaming, 0);
@@ -489,7 +546,7 @@ sc_job_finish:
 
 void cvi_sc_update(struct cvi_sc_vdev *sdev, const struct cvi_vpss_chn_cfg *chn_cfg)
 {
-	u8 i, sbm_num = 0;
+	u8 sbm_num = _sc_get_sbm_num(sdev);
 	const struct cvi_vip_fmt *fmt;
 	struct sclr_odma_cfg *cfg;
 	struct sclr_cir_cfg cir_cfg;
@@ -662,10 +719,6 @@ void cvi_sc_update(struct cvi_sc_vdev *sdev, const struct cvi_vpss_chn_cfg *chn_
 	}
 
 	/* odma order : sb_mode -> sb_size -> sb_nb */
-	for (i = 0; i < VPSS_ONLINE_NUM; i++)
-		if (sdev->sb_enabled[i])
-			sbm_num++;
-
 	sclr_set_sclr_to_vc_sb(sdev->dev_idx, (sbm_num > 1) ? 2 : chn_cfg->sb_cfg.sb_mode,
 		chn_cfg->sb_cfg.sb_size, chn_cfg->sb_cfg.sb_nb, chn_cfg->sb_cfg.sb_wr_ctrl_idx);
 
@@ -11,6 +11,8 @@ int cvi_sc_streamoff(struct cvi_sc_vdev *sdev, bool isForce);
 void sc_irq_handler(union sclr_intr intr_status, struct cvi_vip_dev *bdev);
 void cvi_sc_device_run(void *priv, bool is_tile, bool is_work_on_r_tile, u8 grp_id);
 void cvi_sc_update(struct cvi_sc_vdev *sdev, const struct cvi_vpss_chn_cfg *chn_cfg);
+void cvi_sc_commit_cfg(struct cvi_sc_vdev *sdev, const struct cvi_vpss_chn_cfg *chn_cfg, bool is_tile);
+void cvi_sc_invalidate_cfg(struct cvi_sc_vdev *sdev);
 
 int sc_set_src_to_imgv(struct cvi_sc_vdev *sdev, u8 enable);
 int sc_set_vpss_chn_cfg(struct cvi_sc_vdev *sdev, struct cvi_vpss_chn_cfg *cfg);
@@ -17,10 +17,13 @@
 #include "vpss_common.h"
 #include "scaler.h"
 #include "vpss_core.h"
+#include "vpss.h"
 #include "sclr_test.h"
 #include "sys.h"
 #include "scaler_reg.h"
 #include "cmdq.h"
+#include "cvi_vip_sc.h"
+#include "reg.h"
 
 
 #define PROC_NAME	"cvitek/sclr_test"
@@ -1846,6 +1849,134 @@ int sclr_to_vc_sb_ktest(void *data)
 	return ret;
 }
 
+/* sc_cfg_cache_test: count MMIO writes of cvi_sc_commit_cfg on sc_d.
+ *
+ * An unchanged non-tile chn_cfg must be skipped without touching registers,
+ * while a changed chn_cfg, a tile job or a commit after invalidate must
+ * program everything again.
+ */
+static int sc_cfg_cache_test(void)
+{
+	struct cvi_sc_vdev *sdev = &pdev->sc_vdev[0];
+	struct cvi_vpss_chn_cfg cfg;
+	u32 full, cnt, skip;
+	int ret = 0;
+
+	memset(&cfg, 0, sizeof(cfg));
+	cfg.src_size.width = 1920;
+	cfg.src_size.height = 1080;
+	cfg.crop.width = 1920;
+	cfg.crop.height = 1080;
+	cfg.pixelformat = PIXEL_FORMAT_NV12;
+	cfg.bytesperline[0] = 1280;
+	cfg.bytesperline[1] = 1280;
+	cfg.dst_rect.width = 1280;
+	cfg.dst_rect.height = 720;
+	cfg.dst_size.width = 1280;
+	cfg.dst_size.height = 720;
+	cfg.sc_coef = CVI_SC_SCALING_COEF_BICUBIC;
+
+	cvi_sc_invalidate_cfg(sdev);
+
+	// first commit programs everything
+	cnt = reg_write_cnt;
+	cvi_sc_commit_cfg(sdev, &cfg, false);
+	full = reg_write_cnt - cnt;
+	pr_err("full commit: %d writes\n", full);
+	if (full == 0)
+		ret = -1;
+
+	// same cfg again, registers already hold it
+	skip = sdev->cfg_skip_cnt;
+	cnt = reg_write_cnt;
+	cvi_sc_commit_cfg(sdev, &cfg, false);
+	cnt = reg_write_cnt - cnt;
+	pr_err("same cfg: %d writes, skip %d\n", cnt, sdev->cfg_skip_cnt - skip);
+	if (cnt != 0 || sdev->cfg_skip_cnt != skip + 1)
+		ret = -1;
+
+	// changed cfg
+	cfg.dst_rect.width = 640;
+	cfg.dst_rect.height = 360;
+	cfg.dst_size.width = 640;
+	cfg.dst_size.height = 360;
+	cnt = reg_write_cnt;
+	cvi_sc_commit_cfg(sdev, &cfg, false);
+	cnt = reg_write_cnt - cnt;
+	pr_err("changed cfg: %d writes\n", cnt);
+	if (cnt == 0)
+		ret = -1;
+
+	// tile jobs are never cached
+	cnt = reg_write_cnt;
+	cvi_sc_commit_cfg(sdev, &cfg, true);
+	cvi_sc_commit_cfg(sdev, &cfg, true);
+	cnt = reg_write_cnt - cnt;
+	pr_err("2 tile commits: %d writes\n", cnt);
+	if (cnt < 2)
+		ret = -1;
+
+	// invalidate forces a full commit
+	cvi_sc_commit_cfg(sdev, &cfg, false);
+	cvi_sc_invalidate_cfg(sdev);
+	cnt = reg_write_cnt;
+	cvi_sc_commit_cfg(sdev, &cfg, false);
+	cnt = reg_write_cnt - cnt;
+	pr_err("after invalidate: %d writes\n", cnt);
+	if (cnt == 0)
+		ret = -1;
+
+	cvi_sc_invalidate_cfg(sdev);
+	pr_err("sc cfg cache test %s\n", ret ? "FAIL" : "PASS");
+
+	return ret;
+}
+
+/* vpss_chn_attr_stress_test: hammer SetChnAttr on grp 0 chn 0 for 5s.
+ *
+ * Meant to run while frames flow through grp 0. Reports how long each
+ * set_chn_attr took and how long the offline handler held the grp's ctx
+ * lock meanwhile.
+ */
+static int vpss_chn_attr_stress_test(void)
+{
+	VPSS_CHN_ATTR_S attr, old_attr;
+	struct vpss_grp_lock_stat *stat = vpss_get_grp_lock_stat(0);
+	unsigned long end = jiffies + 5 * HZ;
+	ktime_t t;
+	u32 cnt = 0, fail = 0, us, max_us = 0;
+	u64 sum_us = 0;
+
+	if (vpss_get_chn_attr(0, 0, &old_attr) != CVI_SUCCESS) {
+		pr_err("grp 0 chn 0 not available\n");
+		return -1;
+	}
+
+	stat->max_snap_ns = 0;
+	stat->max_lock_hold_us = 0;
+	attr = old_attr;
+	while (time_before(jiffies, end)) {
+		attr.bMirror = !attr.bMirror;
+		t = ktime_get();
+		if (vpss_set_chn_attr(0, 0, &attr) != CVI_SUCCESS)
+			fail++;
+		us = (u32)ktime_to_us(ktime_sub(ktime_get(), t));
+		sum_us += us;
+		if (us > max_us)
+			max_us = us;
+		cnt++;
+		usleep_range(500, 1000);
+	}
+	vpss_set_chn_attr(0, 0, &old_attr);
+
+	pr_err("set_chn_attr: %d calls, %d fail, avg %lld us, max %d us\n",
+		cnt, fail, cnt ? div_u64(sum_us, cnt) : 0, max_us);
+	pr_err("handler: max ctx lock hold %d us, max snapshot %d ns\n",
+		stat->max_lock_hold_us, stat->max_snap_ns);
+
+	return fail ? -1 : 0;
+}
+
 int sclr_force_img_in_trigger(void)
 {
 	enum sclr_img_in img_inst = SCL_IMG_V;
@@ -1876,6 +2007,8 @@ static void sclr_test_usage(struct seq_file *m)
 	seq_puts(m, " 10: DISP test 800x600 rgb packed\n");
 	seq_puts(m, " 23: Slice buffer: ldc to scaler, 320x240 nv21 -> 320x240 nv21\n");
 	seq_puts(m, " 24: Slice buffer: scaler to vc, 320x256 nv21 -> 320x240 nv21\n");
+	seq_puts(m, " 25: sc cfg cache, count mmio writes per commit\n");
+	seq_puts(m, " 26: grp scheduler simulation, round-robin vs deadline\n");
 	seq_puts(m, " 51: force img_in trigger\n");
 	seq_puts(m, "100: dump top register\n");
 	seq_puts(m, "11?: dump img_in register, 0:v, 1:d\n");
@@ -1883,6 +2016,7 @@ static void sclr_test_usage(struct seq_file *m)
 	seq_puts(m, "13?: dump sc odma register, 0:sc_d, 1:sc_v1, 2:sc_v2, 3:sc_v3\n");
 	seq_puts(m, "140: dump display register\n");
 	seq_puts(m, "15?: dump sc gop register, 0:sc_d, 1:sc_v1, 2:sc_v2, 3:sc_v3\n");
+	seq_puts(m, "160: stress SetChnAttr of grp0 chn0 for 5s, run with frames flowing\n");
 }
 
 static int sclr_test_proc_show(struct seq_file *m, void *v)
@@ -1971,6 +2105,7 @@ static ssize_t sclr_test_proc_write(struct file *file, const char __user *user_b
 {
 	uint32_t input_param = 0;
 	u32 old_shd_val = 0;
+	int i;
 
 	if (kstrtouint_from_user(user_buf, count, 0, &input_param)) {
 		pr_err("input parameter incorrect\n");
@@ -2052,6 +2187,14 @@ static ssize_t sclr_test_proc_write(struct file *file, const char __user *user_b
 		sclr_to_vc_sb_test();
 		break;
 
+	case 25:
+		sc_cfg_cache_test();
+		break;
+
+	case 26:
+		vpss_sched_sim();
+		break;
+
 	case 51:
 		sclr_force_img_in_trigger();
 		break;
@@ -2090,6 +2233,10 @@ static ssize_t sclr_test_proc_write(struct file *file, const char __user *user_b
 		sclr_dump_gop_register(input_param - 150);
 		break;
 
+	case 160:
+		vpss_chn_attr_stress_test();
+		break;
+
 	//case 200:
 	//	sclr_test_reset_vpss();
 	//	break;
@@ -2104,6 +2251,10 @@ static ssize_t sclr_test_proc_write(struct file *file, const char __user *user_b
 		sclr_top_reg_force_up();
 		close_clk();
 
+		// tests program sc behind the cfg cache
+		for (i = 0; i < SCL_MAX_INST; ++i)
+			cvi_sc_invalidate_cfg(&pdev->sc_vdev[i]);
+
 		sclr_test_enabled = 0;
 	}
 
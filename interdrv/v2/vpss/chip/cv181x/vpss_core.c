@@ -39,6 +39,7 @@
 u32 vpss_log_lv = 0;
 int single_vb;
 int debug;
+int vpss_sched_policy = VPSS_SCHED_POLICY_RR;
 int vip_clk_freq;
 static bool vpss_vo_cb_status;
 
@@ -208,6 +209,13 @@ module_param(single_vb, int, 0644);
 
 module_param(vip_clk_freq, int, 0644);
 
+/* vpss_sched_policy: how the offline handler picks the next grp
+ * 0: round-robin over grps with pending jobs (default)
+ * 1: by class, then earliest deadline of the oldest pending job. A batch
+ *    job waiting too long competes as a normal one.
+ */
+module_param(vpss_sched_policy, int, 0644);
+
 /*************************************************************************
  *	General functions
  *************************************************************************/
@@ -1406,6 +1414,9 @@ static int vpss_open(struct inode *inode, struct file *filep)
 
 		sclr_reg_shadow_sel(sdev->dev_idx, false);
 		sclr_init(sdev->dev_idx);
+		cvi_sc_invalidate_cfg(sdev);
+		sdev->cfg_update_cnt = 0;
+		sdev->cfg_skip_cnt = 0;
 		sclr_set_cfg(sdev->dev_idx, false, false, true, false);
 		sclr_reg_force_up(sdev->dev_idx);
 		if (!(debug & BIT(2)) && sdev->clk)
@@ -1624,9 +1635,14 @@ static int vpss_suspend(struct device *dev)
 
 static int vpss_resume(struct device *dev)
 {
+	struct cvi_vip_dev *bdev = dev_get_drvdata(dev);
+	u8 i;
+
 	dev_info(dev, "%s\n", __func__);
 
 	sclr_ctrl_init(true);
+	for (i = 0; i < ARRAY_SIZE(bdev->sc_vdev); i++)
+		cvi_sc_invalidate_cfg(&bdev->sc_vdev[i]);
 	//VIP_CLK_RATIO_CONFIG(ISP_TOP, 0x10);
 	//VIP_CLK_RATIO_CONFIG(LDC, 0x10);
 	//VIP_CLK_RATIO_CONFIG(IMG_D, 0x10);
@@ -175,6 +175,11 @@ struct cvi_img_vdev {
  * @tile_mode: sc's tile mode, both/left/right.
  * @is_streaming: to know if sc is stream-on.
  * @bind_fb: if sc use fb's gop.
+ * @last_chn_cfg: chn_cfg last programmed into sc's registers.
+ * @last_sbm_num: number of sb-enabled grps when @last_chn_cfg was programmed.
+ * @last_cfg_valid: if sc's registers still hold @last_chn_cfg.
+ * @cfg_update_cnt: number of jobs which reprogrammed sc's registers.
+ * @cfg_skip_cnt: number of jobs which reused the registers as-is.
  */
 struct cvi_sc_vdev {
 	DEFINE_SC_VDEV_PARAMS;
@@ -200,6 +205,12 @@ struct cvi_sc_vdev {
 	bool sb_enabled[VPSS_ONLINE_NUM];
 	bool sb_vc_ready[VPSS_ONLINE_NUM];
 	u64 sb_phy_addr[VPSS_ONLINE_NUM][3];
+
+	struct cvi_vpss_chn_cfg last_chn_cfg;
+	u8 last_sbm_num;
+	bool last_cfg_valid;
+	u32 cfg_update_cnt;
+	u32 cfg_skip_cnt;
 };
 
 /**
@@ -249,12 +260,64 @@ void cvi_vip_job_finish(struct cvi_img_vdev *idev);
 bool cvi_vip_job_is_queued(struct cvi_img_vdev *idev);
 int cvi_vip_set_rgn_cfg(const u8 inst, u8 layer, const struct cvi_rgn_cfg *cfg, const struct sclr_size *size);
 
+#define VPSS_SCHED_POLICY_RR        0
+#define VPSS_SCHED_POLICY_DEADLINE  1
+
+// depth of each grp's input waitq
+#define VPSS_GRP_WAITQ_DEPTH        (1 + CVI_VI_VPSS_EXTRA_BUF)
+// one arrival per job the input waitq can hold
+#define VPSS_SCHED_ARRIVAL_NUM      VPSS_GRP_WAITQ_DEPTH
+#define VPSS_SCHED_HIST_NUM         8
+
+/**
+ * @cfg: grp's scheduling attributes.
+ * @lock: protects the arrival ring, which is filled by qbuf and drained by the handler.
+ *        The ring mirrors the grp's input waitq and is flushed together with it.
+ * @arrival_us: arrival time of the grp's pending jobs, oldest at @head.
+ * @head: index of the oldest entry in @arrival_us.
+ * @num: number of valid entries in @arrival_us.
+ * @hist: queueing delay histogram, bucket i counts delays below (1 << i) ms,
+ *        the last one everything above.
+ * @max_delay_us: max queueing delay seen.
+ * @dispatch_cnt: number of jobs the scheduler picked for this grp.
+ */
+struct vpss_grp_sched {
+	struct vpss_grp_sched_cfg cfg;
+	spinlock_t lock;
+	u64 arrival_us[VPSS_SCHED_ARRIVAL_NUM];
+	u8 head;
+	u8 num;
+	u32 hist[VPSS_SCHED_HIST_NUM];
+	u32 max_delay_us;
+	u32 dispatch_cnt;
+};
+
+/**
+ * @snap_ns: time to snapshot the grp's ctx for the last job.
+ * @max_snap_ns: max of @snap_ns.
+ * @lock_hold_us: time the handler held the grp's ctx lock in one go, last hold.
+ * @max_lock_hold_us: max of @lock_hold_us.
+ */
+struct vpss_grp_lock_stat {
+	u32 snap_ns;
+	u32 max_snap_ns;
+	u32 lock_hold_us;
+	u32 max_lock_hold_us;
+};
+
 extern bool __clk_is_enabled(struct clk *clk);
 extern int debug;
+extern int vpss_sched_policy;
 
 void cvi_sc_frm_done_cb(struct cvi_vip_dev *dev);
 void cvi_sc_trigger_post(void *arg);
 struct cvi_vpss_ctx **vpss_get_shdw_ctx(void);
+struct vpss_grp_sched *vpss_get_grp_sched_stat(VPSS_GRP VpssGrp);
+struct vpss_grp_lock_stat *vpss_get_grp_lock_stat(VPSS_GRP VpssGrp);
+
+#if defined(CONFIG_SCLR_TEST)
+int vpss_sched_sim(void);
+#endif
 
 CVI_VOID vpss_img_sb_qbuf(struct cvi_img_vdev *idev, struct cvi_buffer *buf, struct vpss_grp_sbm_cfg *sbm_cfg);
 
@@ -19,6 +19,8 @@ static const char * const str_src[] = {"ISP", "DWA", "MEM"};
 static const char * const str_sclr_flip[] = {"No", "HFLIP", "VFLIP", "HVFLIP"};
 static const char * const str_sclr_odma_mode[] = {"CSC", "QUANT", "HSV", "DISABLE"};
 static const char * const str_sclr_fmt[] = {"YUV420", "YUV422", "RGB_PLANAR", "RGB_PACKED", "BGR_PACKED", "Y_ONLY"};
+static const char * const str_sched_class[] = {"RT", "NORMAL", "BATCH"};
+static const char * const str_sched_hist[] = {"<1ms", "<2ms", "<4ms", "<8ms", "<16ms", "<32ms", "<64ms", ">=64ms"};
 static const char * const str_sclr_csc[] = {"Disable", "2RGB_601_Limit", "2RGB_601_Full", "2RGB_709_Limit"
 	, "2RGB_709_Full", "2YUV_601_Limit", "2YUV_601_Full", "2YUV_709_Limit", "2YUV_709_Full"};
 
@@ -318,6 +320,51 @@ int vpss_ctx_proc_show(struct seq_file *m, void *v)
 		}
 	}
 
+	// VPSS GRP LOCK STATUS
+	seq_puts(m, "\n-------------------------------VPSS GRP LOCK STATUS-----------------------\n");
+	seq_printf(m, "%10s%20s%20s%20s%20s\n", "GrpID", "SnapTime(ns)", "MaxSnapTime(ns)",
+		"LockHold(us)", "MaxLockHold(us)");
+	for (i = 0; i < VPSS_MAX_GRP_NUM; ++i) {
+		if (pVpssCtx[i] && pVpssCtx[i]->isCreated) {
+			struct vpss_grp_lock_stat *stat = vpss_get_grp_lock_stat(i);
+
+			seq_printf(m, "%8s%2d%20d%20d%20d%20d\n",
+				"#",
+				i,
+				stat->snap_ns,
+				stat->max_snap_ns,
+				stat->lock_hold_us,
+				stat->max_lock_hold_us);
+		}
+	}
+
+	// VPSS GRP SCHED
+	seq_puts(m, "\n-------------------------------VPSS GRP SCHED-----------------------------\n");
+	seq_printf(m, "%10s%10s%20s%10s%15s%15s\n", "GrpID", "Class", "TargetLatency(us)", "Weight",
+		"DispatchCnt", "MaxDelay(us)");
+	seq_printf(m, "%10s", "");
+	for (j = 0; j < VPSS_SCHED_HIST_NUM; ++j)
+		seq_printf(m, "%10s", str_sched_hist[j]);
+	seq_puts(m, "\n");
+	for (i = 0; i < VPSS_MAX_GRP_NUM; ++i) {
+		if (pVpssCtx[i] && pVpssCtx[i]->isCreated) {
+			struct vpss_grp_sched *sched = vpss_get_grp_sched_stat(i);
+
+			seq_printf(m, "%8s%2d%10s%20d%10d%15d%15d\n",
+				"#",
+				i,
+				str_sched_class[sched->cfg.sched_class],
+				sched->cfg.target_latency_us,
+				sched->cfg.weight,
+				sched->dispatch_cnt,
+				sched->max_delay_us);
+			seq_printf(m, "%10s", "");
+			for (j = 0; j < VPSS_SCHED_HIST_NUM; ++j)
+				seq_printf(m, "%10d", sched->hist[j]);
+			seq_puts(m, "\n");
+		}
+	}
+
 	// VPSS CHN OUTPUT RESOLUTION
 	seq_puts(m, "\n-------------------------------VPSS CHN OUTPUT RESOLUTION-----------------\n");
 	seq_printf(m, "%10s%10s%10s%10s%10s%20s%10s%10s%10s\n",
@@ -414,6 +461,11 @@ int vpss_ctx_proc_show(struct seq_file *m, void *v)
 			bdev->img_vdev[i].isp_trig_fail_cnt[2],
 			bdev->img_vdev[i].irq_cnt[2]);
 	}
+	seq_printf(m, "%14s%20s%20s\n", "sc", "CfgUpdateCnt", "CfgSkipCnt");
+	for (i = 0; i < CVI_VIP_SC_MAX; ++i)
+		seq_printf(m, "%12s%2d%20d%20d\n", "#", i,
+			bdev->sc_vdev[i].cfg_update_cnt,
+			bdev->sc_vdev[i].cfg_skip_cnt);
 
 	// VPSS Slice buffer status
 	seq_puts(m, "\n-------------------------------VPSS CHN BUF WRAP ATTR---------------------\n");
@@ -69,6 +69,10 @@ void _reg_write_mask(uintptr_t addr, u32 mask, u32 data)
 #else
 static DEFINE_RAW_SPINLOCK(__io_lock);
 
+#if defined(CONFIG_SCLR_TEST)
+u32 reg_write_cnt;
+#endif
+
 void _reg_write_mask(uintptr_t addr, u32 mask, u32 data)
 {
 	unsigned long flags;
@@ -78,6 +82,9 @@ void _reg_write_mask(uintptr_t addr, u32 mask, u32 data)
 	value = readl_relaxed((void __iomem *)addr) & ~mask;
 	value |= (data & mask);
 	writel(value, (void __iomem *)addr);
+#if defined(CONFIG_SCLR_TEST)
+	reg_write_cnt++;
+#endif
 	raw_spin_unlock_irqrestore(&__io_lock, flags);
 }
 #endif
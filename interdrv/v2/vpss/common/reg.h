@@ -17,7 +17,15 @@ extern int dump_reg;
 
 #define _reg_read(addr) readl((void __iomem *)addr)
 
-#if 1
+#if defined(CONFIG_SCLR_TEST)
+// count MMIO writes for sclr_test, not precise if several cpus write at once
+extern u32 reg_write_cnt;
+#define _reg_write(addr, data) \
+	do { \
+		writel(data, (void __iomem *)addr); \
+		reg_write_cnt++; \
+	} while (0)
+#elif 1
 #define _reg_write(addr, data) writel(data, (void __iomem *)addr)
 #else
 #define _reg_write(addr, data) \
@@ -15,6 +15,7 @@
 #include <linux/cvi_vip.h>
 #include <linux/cvi_buffer.h>
 #include <linux/delay.h>
+#include <linux/sort.h>
 
 #include <base_cb.h>
 #include <vi_cb.h>
@@ -39,6 +40,12 @@
 
 #define YRATIO_SCALE         100
 
+#define VPSS_SCHED_DEFAULT_LATENCY_US  33333
+#define VPSS_SCHED_WEIGHT_DEF          16
+#define VPSS_SCHED_WEIGHT_MAX          1024
+// a batch job waiting this long competes as a normal one
+#define VPSS_SCHED_BATCH_AGE_US        (4 * VPSS_SCHED_DEFAULT_LATENCY_US)
+
 #define CTX_EVENT_WKUP       0x0001
 #define CTX_EVENT_EOF        0x0002
 #define CTX_EVENT_VI_ERR     0x0004
@@ -69,6 +76,7 @@ struct vpss_ext_ctx {
 	struct vpss_grp_sbm_cfg sbm_cfg;
 	CVI_U32 grp_state;
 	CVI_U8 scene;
+	CVI_U32 cfg_gen;	// bumped on every settings change, 0 if never set
 };
 
 static struct cvi_vip_dev *vip_dev;
@@ -78,8 +86,24 @@ static struct cvi_vpss_ctx *vpssCtx[VPSS_MAX_GRP_NUM] = { [0 ... VPSS_MAX_GRP_NU
 // cvi_vpss_ctx in uapi, internal extension version.
 static struct vpss_ext_ctx vpssExtCtx[VPSS_MAX_GRP_NUM];
 
+// Source of vpss_ext_ctx.cfg_gen, unique across grps so a work copy is
+// never mistaken for another grp's.
+static atomic_t vpssCfgGen = ATOMIC_INIT(0);
+
+// Scheduling attributes & queueing delay stats of each grp, kept out of
+// vpssExtCtx since reset_grp memsets that.
+static struct vpss_grp_sched vpssSched[VPSS_MAX_GRP_NUM];
+
+// How long the offline handler holds each grp's ctx lock & snapshots its ctx.
+static struct vpss_grp_lock_stat vpssLockStat[VPSS_MAX_GRP_NUM];
+
+// Held by the offline handler while it schedules a grp, and by stop/destroy,
+// so the grp can't be stopped or freed while its ctx lock is dropped for hw.
+static struct mutex vpssSchedLock[VPSS_MAX_GRP_NUM];
+
 // Motion level for vcodec
 static struct mlv_i_s g_mlv_i[VI_MAX_DEV_NUM];
+static CVI_BOOL g_mlv_valid[VI_MAX_DEV_NUM];
 
 static CVI_U8 isp_bypass_frm[VI_MAX_CHN_NUM];
 
@@ -103,6 +127,7 @@ struct vpss_handler_ctx {
 	CVI_U8 IntMask[VPSS_ONLINE_NUM];
 	CVI_U8 isr_evt[VPSS_ONLINE_NUM];
 	struct cvi_vpss_ctx vpssCtxWork[VPSS_ONLINE_NUM];
+	CVI_U32 snap_gen;	// cfg_gen of the offline work copy
 } handler_ctx[VPSS_IP_NUM];
 
 static struct cvi_gdc_mesh mesh[VPSS_MAX_GRP_NUM][VPSS_MAX_CHN_NUM];
@@ -446,7 +471,196 @@ CVI_VOID vpss_gdc_callback(CVI_VOID *pParam, VB_BLK blk)
 	vfree(pParam);
 }
 
-static VPSS_GRP findNextEnGrp(VPSS_GRP workingGrp, CVI_U8 u8VpssDev)
+static void _vpss_sched_reset(VPSS_GRP VpssGrp)
+{
+	struct vpss_grp_sched *sched = &vpssSched[VpssGrp];
+	unsigned long flags;
+
+	spin_lock_irqsave(&sched->lock, flags);
+	sched->cfg.VpssGrp = VpssGrp;
+	sched->cfg.sched_class = VPSS_SCHED_CLASS_NORMAL;
+	sched->cfg.target_latency_us = 0;
+	sched->cfg.weight = VPSS_SCHED_WEIGHT_DEF;
+	sched->head = 0;
+	sched->num = 0;
+	memset(sched->hist, 0, sizeof(sched->hist));
+	sched->max_delay_us = 0;
+	sched->dispatch_cnt = 0;
+	spin_unlock_irqrestore(&sched->lock, flags);
+}
+
+/* _vpss_sched_flush: drop the recorded arrivals of the grp.
+ *
+ * Called wherever the grp's input waitq is flushed or its jobs are no
+ * longer scheduled, so stale arrivals never age a later job's deadline.
+ *
+ * @param VpssGrp: the grp to flush.
+ */
+static void _vpss_sched_flush(VPSS_GRP VpssGrp)
+{
+	struct vpss_grp_sched *sched = &vpssSched[VpssGrp];
+	unsigned long flags;
+
+	spin_lock_irqsave(&sched->lock, flags);
+	sched->head = 0;
+	sched->num = 0;
+	spin_unlock_irqrestore(&sched->lock, flags);
+}
+
+/* _vpss_sched_arrive: record the arrival time of the grp's newly queued jobs.
+ *
+ * Only jobs actually sitting in the input waitq are recorded, i.e. the ring
+ * is topped up to the waitq's size. Wakeups without a queued frame, such as
+ * the one after a slice-buffer setup, leave it untouched.
+ *
+ * @param VpssGrp: the grp which got the job.
+ */
+static void _vpss_sched_arrive(VPSS_GRP VpssGrp)
+{
+	struct vpss_grp_sched *sched = &vpssSched[VpssGrp];
+	MMF_CHN_S chn = {.enModId = CVI_ID_VPSS, .s32DevId = VpssGrp, .s32ChnId = 0};
+	struct vb_jobs_t *jobs;
+	unsigned long flags;
+	u64 now_us = ktime_to_us(ktime_get());
+	u32 queued;
+
+	jobs = base_get_jobs_by_chn(chn, CHN_TYPE_IN);
+	if (!jobs || !jobs->inited)
+		return;
+
+	mutex_lock(&jobs->lock);
+	queued = FIFO_SIZE(&jobs->waitq);
+	mutex_unlock(&jobs->lock);
+	queued = min_t(u32, queued, VPSS_SCHED_ARRIVAL_NUM);
+
+	spin_lock_irqsave(&sched->lock, flags);
+	while (sched->num < queued) {
+		sched->arrival_us[(sched->head + sched->num) % VPSS_SCHED_ARRIVAL_NUM] = now_us;
+		sched->num++;
+	}
+	spin_unlock_irqrestore(&sched->lock, flags);
+}
+
+static u32 _vpss_sched_budget_us(const struct vpss_grp_sched_cfg *cfg)
+{
+	return cfg->target_latency_us ? cfg->target_latency_us
+		: VPSS_SCHED_DEFAULT_LATENCY_US * VPSS_SCHED_WEIGHT_DEF / cfg->weight;
+}
+
+/* _vpss_sched_before: if a job of class/deadline a is served before b. */
+static bool _vpss_sched_before(u8 class_a, u64 deadline_a, u8 class_b, u64 deadline_b)
+{
+	if (class_a != class_b)
+		return class_a < class_b;
+	return deadline_a < deadline_b;
+}
+
+/* _vpss_sched_key: class & deadline the grp's oldest pending job is served by.
+ *
+ * Jobs without a recorded arrival get U64_MAX, which keeps them behind
+ * every timed job of the same class. A batch job older than
+ * VPSS_SCHED_BATCH_AGE_US is served as a normal one, so a busy normal grp
+ * can't starve batch grps.
+ *
+ * @param sched: the grp's sched state.
+ * @param now_us: current time.
+ * @param deadline: returns the deadline.
+ * @return: the class.
+ */
+static u8 _vpss_sched_key(struct vpss_grp_sched *sched, u64 now_us, u64 *deadline)
+{
+	unsigned long flags;
+	u64 arrival_us = U64_MAX;
+	u32 budget_us;
+	u8 sched_class;
+
+	spin_lock_irqsave(&sched->lock, flags);
+	sched_class = sched->cfg.sched_class;
+	budget_us = _vpss_sched_budget_us(&sched->cfg);
+	if (sched->num)
+		arrival_us = sched->arrival_us[sched->head];
+	spin_unlock_irqrestore(&sched->lock, flags);
+
+	if (arrival_us == U64_MAX) {
+		*deadline = U64_MAX;
+		return sched_class;
+	}
+	if (sched_class == VPSS_SCHED_CLASS_BATCH && now_us >= arrival_us + VPSS_SCHED_BATCH_AGE_US)
+		sched_class = VPSS_SCHED_CLASS_NORMAL;
+	*deadline = arrival_us + budget_us;
+	return sched_class;
+}
+
+/* _vpss_sched_order: order grps the way the deadline policy serves them.
+ *
+ * Candidates are given in round-robin visiting order and only a strictly
+ * better key moves a grp ahead, so grps with equal keys keep rotating
+ * fairly. Also driven by vpss_sched_sim.
+ *
+ * @param sched: the candidates' sched state, in visiting order.
+ * @param num: number of candidates.
+ * @param now_us: current time.
+ * @param order: returns the indexes into @sched, first served first.
+ */
+static void _vpss_sched_order(struct vpss_grp_sched **sched, u8 num, u64 now_us, u8 *order)
+{
+	u64 order_deadline[VPSS_MAX_GRP_NUM];
+	u8 order_class[VPSS_MAX_GRP_NUM];
+	u64 deadline;
+	u8 sched_class, i, j;
+
+	for (i = 0; i < num; ++i) {
+		sched_class = _vpss_sched_key(sched[i], now_us, &deadline);
+		for (j = i; j > 0; --j) {
+			if (!_vpss_sched_before(sched_class, deadline, order_class[j - 1], order_deadline[j - 1]))
+				break;
+			order[j] = order[j - 1];
+			order_deadline[j] = order_deadline[j - 1];
+			order_class[j] = order_class[j - 1];
+		}
+		order[j] = i;
+		order_deadline[j] = deadline;
+		order_class[j] = sched_class;
+	}
+}
+
+/* _vpss_sched_dispatch: account the queueing delay of the job just picked.
+ *
+ * @param VpssGrp: the grp picked.
+ */
+static void _vpss_sched_dispatch(VPSS_GRP VpssGrp)
+{
+	struct vpss_grp_sched *sched = &vpssSched[VpssGrp];
+	unsigned long flags;
+	u64 now_us = ktime_to_us(ktime_get());
+	u32 delay_us, bucket;
+
+	spin_lock_irqsave(&sched->lock, flags);
+	sched->dispatch_cnt++;
+	if (sched->num) {
+		delay_us = (u32)min_t(u64, now_us - sched->arrival_us[sched->head], U32_MAX);
+		sched->head = (sched->head + 1) % VPSS_SCHED_ARRIVAL_NUM;
+		sched->num--;
+
+		bucket = min_t(u32, fls(delay_us / 1000), VPSS_SCHED_HIST_NUM - 1);
+		sched->hist[bucket]++;
+		if (delay_us > sched->max_delay_us)
+			sched->max_delay_us = delay_us;
+	}
+	spin_unlock_irqrestore(&sched->lock, flags);
+}
+
+/* _vpss_cfg_changed: the grp's settings changed, the handler must take a
+ * full snapshot of its ctx next time. Called with the grp's ctx lock held.
+ */
+static inline CVI_VOID _vpss_cfg_changed(VPSS_GRP VpssGrp)
+{
+	CVI_U32 gen = (CVI_U32)atomic_inc_return(&vpssCfgGen);
+
+	vpssExtCtx[VpssGrp].cfg_gen = gen ? gen : (CVI_U32)atomic_inc_return(&vpssCfgGen);
+}
+
+static VPSS_GRP findNextEnGrpRR(VPSS_GRP workingGrp, CVI_U8 u8VpssDev)
 {
 	VPSS_GRP i = workingGrp;
 	CVI_U8 count = 0;
@@ -474,6 +688,67 @@ static VPSS_GRP findNextEnGrp(VPSS_GRP workingGrp, CVI_U8 u8VpssDev)
 	return VPSS_MAX_GRP_NUM;
 }
 
+/* findNextEnGrpDeadline: pick the grp by class, then by earliest deadline.
+ *
+ * Candidates are visited in the same round-robin order as findNextEnGrpRR,
+ * see _vpss_sched_order.
+ */
+static VPSS_GRP findNextEnGrpDeadline(VPSS_GRP workingGrp, CVI_U8 u8VpssDev)
+{
+	VPSS_GRP i = workingGrp;
+	VPSS_GRP grp[VPSS_MAX_GRP_NUM];
+	struct vb_jobs_t *grp_jobs[VPSS_MAX_GRP_NUM];
+	struct vpss_grp_sched *sched[VPSS_MAX_GRP_NUM];
+	u8 order[VPSS_MAX_GRP_NUM];
+	CVI_U8 count = 0, num = 0, j;
+	struct vb_jobs_t *jobs;
+	MMF_CHN_S chn = {.enModId = CVI_ID_VPSS};
+
+	do {
+		++i;
+		if (i >= VPSS_MAX_GRP_NUM)
+			i = 0;
+
+		if (!vpssCtx[i] || !vpssCtx[i]->isCreated || !vpssCtx[i]->isStarted
+			|| (vpssCtx[i]->u8DevId != u8VpssDev))
+			continue;
+
+		chn.s32DevId = i;
+		jobs = base_get_jobs_by_chn(chn, CHN_TYPE_IN);
+		if (!jobs) {
+			CVI_TRACE_VPSS(CVI_DBG_INFO, "get jobs failed\n");
+			continue;
+		}
+
+		grp[num] = i;
+		grp_jobs[num] = jobs;
+		sched[num] = &vpssSched[i];
+		num++;
+	} while (++count < VPSS_MAX_GRP_NUM);
+
+	_vpss_sched_order(sched, num, ktime_to_us(ktime_get()), order);
+	for (j = 0; j < num; ++j)
+		if (!down_trylock(&grp_jobs[order[j]]->sem))
+			return grp[order[j]];
+
+	return VPSS_MAX_GRP_NUM;
+}
+
+static VPSS_GRP findNextEnGrp(VPSS_GRP workingGrp, CVI_U8 u8VpssDev)
+{
+	VPSS_GRP grp;
+
+	if (vpss_sched_policy == VPSS_SCHED_POLICY_RR)
+		grp = findNextEnGrpRR(workingGrp, u8VpssDev);
+	else
+		grp = findNextEnGrpDeadline(workingGrp, u8VpssDev);
+
+	if (grp != VPSS_MAX_GRP_NUM)
+		_vpss_sched_dispatch(grp);
+
+	return grp;
+}
+
 static CVI_U8 getWorkMask(struct cvi_vpss_ctx *ctx)
 {
 	CVI_U8 mask = 0;
@@ -558,8 +833,6 @@ static CVI_VOID _vpss_fill_cvi_buffer(MMF_CHN_S chn, struct vb_s *grp_vb_in,
 	if (grp_vb_in) {
 		buf->u64PTS = grp_vb_in->buf.u64PTS;
 		buf->frm_num = grp_vb_in->buf.frm_num;
-		buf->motion_lv = grp_vb_in->buf.motion_lv;
-		memcpy(buf->motion_table, grp_vb_in->buf.motion_table, MO_TBL_SIZE);
 	}
 }
 
@@ -588,6 +861,8 @@ static CVI_S32 vpss_qbuf(MMF_CHN_S chn, struct vb_s *grp_vb_in,
 		chn.s32DevId, chn.s32ChnId, addr[0], addr[1], addr[2]);
 
 	_vpss_fill_cvi_buffer(chn, grp_vb_in, vb_handle2PhysAddr(blk), buf, ctx);
+	if (grp_vb_in)
+		vb_copy_motion(vb, grp_vb_in);
 
 	if (vb->external) {
 		memcpy(buf->phy_addr, addr, sizeof(addr));
@@ -1000,6 +1275,7 @@ static CVI_S32 hw_start(VPSS_GRP VpssGrp, CVI_BOOL onoff, CVI_BOOL isForce, stru
 static void hw_reset(VPSS_GRP VpssGrp, struct cvi_vpss_ctx *ctx, CVI_BOOL bToggleReset)
 {
 	union vip_sys_reset val;
+	u8 i;
 
 	release_buffers(VpssGrp, ctx);
 
@@ -1013,6 +1289,8 @@ static void hw_reset(VPSS_GRP VpssGrp, struct cvi_vpss_ctx *ctx, CVI_BOOL bToggl
 		val.b.sc_v2 = 1;
 		val.b.sc_v3 = 1;
 		vip_toggle_reset(val);
+		for (i = CVI_VIP_SC_D; i < CVI_VIP_SC_MAX; ++i)
+			cvi_sc_invalidate_cfg(&vip_dev->sc_vdev[i]);
 	}
 
 	hw_start(VpssGrp, CVI_FALSE, bToggleReset, ctx);
@@ -1022,8 +1300,8 @@ static CVI_VOID _vpss_online_set_mlv_info(struct vb_s *blk)
 {
 	CVI_U8 snr_num = blk->buf.dev_num;
 
-	blk->buf.motion_lv = g_mlv_i[snr_num].mlv_i_level;
-	memcpy(blk->buf.motion_table, g_mlv_i[snr_num].mlv_i_table, sizeof(blk->buf.motion_table));
+	vb_set_motion(blk, g_mlv_i[snr_num].mlv_i_level,
+		g_mlv_valid[snr_num] ? g_mlv_i[snr_num].mlv_i_table : NULL);
 }
 
 static CVI_S32 _vpss_online_get_dpcm_wr_crop(CVI_U8 snr_num,
@@ -2615,23 +2893,89 @@ static CVI_VOID vpss_handle_online(struct vpss_handler_ctx *ctx)
 			vpssExtCtx[workingGrp].grp_state);
 }
 
-/**
- * @return: 0 if ready
+/* _vpss_lock_stat_update: account one hold of vpssCtx->lock by the handler.
+ *
+ * @param VpssGrp: the grp whose lock was held.
+ * @param hold: time the lock was held.
  */
-static CVI_S32 vpss_try_schedule_offline(struct vpss_handler_ctx *ctx)
+static void _vpss_lock_stat_update(VPSS_GRP VpssGrp, ktime_t hold)
+{
+	struct vpss_grp_lock_stat *stat = &vpssLockStat[VpssGrp];
+
+	stat->lock_hold_us = (u32)ktime_to_us(hold);
+	if (stat->lock_hold_us > stat->max_lock_hold_us)
+		stat->max_lock_hold_us = stat->lock_hold_us;
+}
+
+/* _vpss_snap_ctx: copy the grp's ctx into the handler's work copy.
+ *
+ * Settings only change under the api, which bumps the grp's cfg_gen. While
+ * the work copy is of the same generation only the state the handler and
+ * frame-rate control touch per frame is refreshed.
+ */
+static CVI_VOID _vpss_snap_ctx(struct vpss_handler_ctx *ctx, VPSS_GRP VpssGrp, struct cvi_vpss_ctx *vpss_ctx)
+{
+	struct cvi_vpss_ctx *src = vpssCtx[VpssGrp];
+	CVI_U32 gen = vpssExtCtx[VpssGrp].cfg_gen;
+	VPSS_CHN VpssChn;
+
+	if (!gen || gen != ctx->snap_gen) {
+		memcpy(vpss_ctx, src, sizeof(*vpss_ctx));
+		ctx->snap_gen = gen;
+		return;
+	}
+
+	vpss_ctx->isStarted = src->isStarted;
+	vpss_ctx->frame_crop = src->frame_crop;
+	vpss_ctx->s16OffsetTop = src->s16OffsetTop;
+	vpss_ctx->s16OffsetBottom = src->s16OffsetBottom;
+	vpss_ctx->s16OffsetLeft = src->s16OffsetLeft;
+	vpss_ctx->s16OffsetRight = src->s16OffsetRight;
+	vpss_ctx->stGrpWorkStatus = src->stGrpWorkStatus;
+	vpss_ctx->is_cfg_changed = src->is_cfg_changed;
+	for (VpssChn = 0; VpssChn < src->chnNum; ++VpssChn) {
+		vpss_ctx->stChnCfgs[VpssChn].isEnabled = src->stChnCfgs[VpssChn].isEnabled;
+		vpss_ctx->stChnCfgs[VpssChn].stChnWorkStatus = src->stChnCfgs[VpssChn].stChnWorkStatus;
+		vpss_ctx->stChnCfgs[VpssChn].is_cfg_changed = src->stChnCfgs[VpssChn].is_cfg_changed;
+	}
+}
+
+/* _vpss_sched_bail: give back the frame the handler took the grp's sem for.
+ *
+ * Called with vpssSchedLock held. A destroyed grp already dropped its waitq.
+ */
+static CVI_VOID _vpss_sched_bail(VPSS_GRP VpssGrp)
+{
+	MMF_CHN_S chn = {.enModId = CVI_ID_VPSS, .s32DevId = VpssGrp, .s32ChnId = 0};
+
+	if (!vpssCtx[VpssGrp] || !vpssCtx[VpssGrp]->isCreated)
+		return;
+	if (!base_mod_jobs_waitq_empty(chn, CHN_TYPE_IN))
+		_release_vpss_waitq(chn, CHN_TYPE_IN);
+}
+
+/* _vpss_sched_prepare: snapshot the grp and pick the chns to run.
+ *
+ * @return: the working mask, 0 if the frame was dropped.
+ */
+static CVI_U8 _vpss_sched_prepare(struct vpss_handler_ctx *ctx, struct cvi_vpss_ctx *vpss_ctx)
 {
 	VPSS_GRP workingGrp = ctx->workingGrp;
 	VPSS_CHN VpssChn;
 	CVI_U8 workingMask = 0;
-	struct cvi_vpss_ctx *vpss_ctx = CVI_NULL;
 	MMF_CHN_S chn = {.enModId = CVI_ID_VPSS, .s32DevId = workingGrp, .s32ChnId = 0};
-
-	ktime_get_ts64(&ctx->time);
+	struct vpss_grp_lock_stat *stat = &vpssLockStat[workingGrp];
+	ktime_t t_lock, t_snap;
 
 	mutex_lock(&vpssCtx[workingGrp]->lock);
+	t_lock = ktime_get();
 
-	vpss_ctx = &ctx->vpssCtxWork[0];
-	memcpy(vpss_ctx, vpssCtx[workingGrp], sizeof(*vpss_ctx));
+	_vpss_snap_ctx(ctx, workingGrp, vpss_ctx);
+
+	t_snap = ktime_get();
+	stat->snap_ns = (u32)ktime_to_ns(ktime_sub(t_snap, t_lock));
+	if (stat->snap_ns > stat->max_snap_ns)
+		stat->max_snap_ns = stat->snap_ns;
 
 	// sc's mask
 	workingMask = getWorkMask(vpss_ctx);
@@ -2642,20 +2986,41 @@ static CVI_S32 vpss_try_schedule_offline(struct vpss_handler_ctx *ctx)
 	if (workingMask == 0) {
 		CVI_TRACE_VPSS(CVI_DBG_NOTICE, "grp(%d) workingMask zero.\n", workingGrp);
 		_release_vpss_waitq(chn, CHN_TYPE_IN);
-		goto vpss_next_job;
+	} else {
+		vpssCtx[workingGrp]->is_cfg_changed = CVI_FALSE;
+		for (VpssChn = 0; VpssChn < vpssCtx[workingGrp]->chnNum; ++VpssChn)
+			vpssCtx[workingGrp]->stChnCfgs[VpssChn].is_cfg_changed = CVI_FALSE;
 	}
-	vpssCtx[workingGrp]->is_cfg_changed = CVI_FALSE;
-	for (VpssChn = 0; VpssChn < vpssCtx[workingGrp]->chnNum; ++VpssChn)
-		vpssCtx[workingGrp]->stChnCfgs[VpssChn].is_cfg_changed = CVI_FALSE;
 
-	//ktime_get_ts64(&time[0]);
+	mutex_unlock(&vpssCtx[workingGrp]->lock);
+	_vpss_lock_stat_update(workingGrp, ktime_sub(ktime_get(), t_lock));
+
+	return workingMask;
+}
 
-	if (hw_start(workingGrp, CVI_FALSE, CVI_FALSE, vpss_ctx) != CVI_SUCCESS) {
-		CVI_TRACE_VPSS(CVI_DBG_ERR, "grp(%d) stop before run NG.\n", workingGrp);
+/**
+ * @return: 0 if ready
+ *
+ * Called with vpssSchedLock held, once the previous job is stopped.
+ * vpssCtx->lock is only held while the grp's settings/buffers are
+ * prepared. Stream on, where the registers get programmed, runs on the
+ * snapshot without the lock so user-space ioctls aren't blocked for the
+ * duration.
+ */
+static CVI_S32 _vpss_try_schedule_offline(struct vpss_handler_ctx *ctx, CVI_U8 workingMask,
+					  struct cvi_vpss_ctx *vpss_ctx)
+{
+	VPSS_GRP workingGrp = ctx->workingGrp;
+	MMF_CHN_S chn = {.enModId = CVI_ID_VPSS, .s32DevId = workingGrp, .s32ChnId = 0};
+	ktime_t t_lock;
+
+	mutex_lock(&vpssCtx[workingGrp]->lock);
+	t_lock = ktime_get();
+
+	if (!vpssCtx[workingGrp]->isStarted) {
+		CVI_TRACE_VPSS(CVI_DBG_NOTICE, "grp(%d) stopped while unlocked.\n", workingGrp);
 		_release_vpss_waitq(chn, CHN_TYPE_IN);
-		hw_reset(workingGrp, vpss_ctx, CVI_FALSE);
-		vpssCtx[workingGrp]->stGrpWorkStatus.u32StartFailCnt++;
-		goto vpss_next_job;
+		goto vpss_next_job_unlock;
 	}
 
 	// commit hw settings of this vpss-grp.
@@ -2663,13 +3028,13 @@ static CVI_S32 vpss_try_schedule_offline(struct vpss_handler_ctx *ctx)
 		CVI_TRACE_VPSS(CVI_DBG_ERR, "grp(%d) apply hw settings NG.\n", workingGrp);
 		_release_vpss_waitq(chn, CHN_TYPE_IN);
 		vpssCtx[workingGrp]->stGrpWorkStatus.u32StartFailCnt++;
-		goto vpss_next_job;
+		goto vpss_next_job_unlock;
 	}
 
 	if (fill_buffers(workingGrp, vpss_ctx, ctx->online_from_isp) != CVI_SUCCESS) {
 		CVI_TRACE_VPSS(CVI_DBG_ERR, "grp(%d) fill buffer NG.\n", workingGrp);
 		vpssCtx[workingGrp]->stGrpWorkStatus.u32StartFailCnt++;
-		goto vpss_next_job;
+		goto vpss_next_job_unlock;
 	}
 
 	/* Configure vc h/w before vpss h/w */
@@ -2681,25 +3046,95 @@ static CVI_S32 vpss_try_schedule_offline(struct vpss_handler_ctx *ctx)
 	ctx->workingMask = workingMask;
 	vpssExtCtx[workingGrp].grp_state = GRP_STATE_HW_STARTED;
 
+	mutex_unlock(&vpssCtx[workingGrp]->lock);
+	_vpss_lock_stat_update(workingGrp, ktime_sub(ktime_get(), t_lock));
+
 	if (hw_start(workingGrp, CVI_TRUE, CVI_FALSE, vpss_ctx) != CVI_SUCCESS) {
 		CVI_TRACE_VPSS(CVI_DBG_ERR, "grp(%d) run NG.\n", workingGrp);
-		hw_reset(workingGrp, vpss_ctx, CVI_FALSE);
+		mutex_lock(&vpssCtx[workingGrp]->lock);
+		t_lock = ktime_get();
+		if (vpssCtx[workingGrp]->isStarted)
+			hw_reset(workingGrp, vpss_ctx, CVI_FALSE);
 		vpssCtx[workingGrp]->stGrpWorkStatus.u32StartFailCnt++;
-		goto vpss_next_job;
+		mutex_unlock(&vpssCtx[workingGrp]->lock);
+		_vpss_lock_stat_update(workingGrp, ktime_sub(ktime_get(), t_lock));
+		return CVI_FAILURE;
 	}
 
 	/* Configure vpss h/w before dwa h/w */
 	_notify_dwa_sbm_cfg_done(workingGrp);
 
-	/* Should use async sbm, the lock region is too big ! */
-	mutex_unlock(&vpssCtx[workingGrp]->lock);
-
 	CVI_TRACE_VPSS(CVI_DBG_DEBUG, "ctx[%d] workingGrp=%d, img_idx=%d\n",
 			ctx->u8VpssDev, ctx->workingGrp, ctx->img_idx);
 
 	// wait for h/w done
 	return CVI_SUCCESS;
 
+vpss_next_job_unlock:
+	mutex_unlock(&vpssCtx[workingGrp]->lock);
+	_vpss_lock_stat_update(workingGrp, ktime_sub(ktime_get(), t_lock));
+	return CVI_FAILURE;
+}
+
+/* vpss_try_schedule_offline: program and kick the hw for ctx->workingGrp.
+ *
+ * vpssSchedLock keeps stop/destroy from running while the grp's ctx lock
+ * is dropped for hw. It isn't held while the previous job is stopped: that
+ * may wait for the hw to go idle and only uses the snapshot, so the grp is
+ * checked again once the lock is retaken.
+ */
+static CVI_S32 vpss_try_schedule_offline(struct vpss_handler_ctx *ctx)
+{
+	VPSS_GRP workingGrp = ctx->workingGrp;
+	struct cvi_vpss_ctx *vpss_ctx = &ctx->vpssCtxWork[0];
+	CVI_U8 workingMask;
+	ktime_t t_lock;
+
+	ktime_get_ts64(&ctx->time);
+
+	mutex_lock(&vpssSchedLock[workingGrp]);
+	if (!vpssCtx[workingGrp] || !vpssCtx[workingGrp]->isStarted) {
+		CVI_TRACE_VPSS(CVI_DBG_NOTICE, "grp(%d) stopped before schedule.\n", workingGrp);
+		_vpss_sched_bail(workingGrp);
+		mutex_unlock(&vpssSchedLock[workingGrp]);
+		ctx->workingMask = 0;
+		return CVI_FAILURE;
+	}
+	workingMask = _vpss_sched_prepare(ctx, vpss_ctx);
+	mutex_unlock(&vpssSchedLock[workingGrp]);
+	if (workingMask == 0)
+		goto vpss_next_job;
+
+	if (hw_start(workingGrp, CVI_FALSE, CVI_FALSE, vpss_ctx) != CVI_SUCCESS) {
+		CVI_TRACE_VPSS(CVI_DBG_ERR, "grp(%d) stop before run NG.\n", workingGrp);
+		mutex_lock(&vpssSchedLock[workingGrp]);
+		_vpss_sched_bail(workingGrp);
+		// release_buffers races set_chn_attr's queue cleanup otherwise.
+		if (vpssCtx[workingGrp]) {
+			mutex_lock(&vpssCtx[workingGrp]->lock);
+			t_lock = ktime_get();
+			if (vpssCtx[workingGrp]->isStarted)
+				hw_reset(workingGrp, vpss_ctx, CVI_FALSE);
+			vpssCtx[workingGrp]->stGrpWorkStatus.u32StartFailCnt++;
+			mutex_unlock(&vpssCtx[workingGrp]->lock);
+			_vpss_lock_stat_update(workingGrp, ktime_sub(ktime_get(), t_lock));
+		}
+		mutex_unlock(&vpssSchedLock[workingGrp]);
+		goto vpss_next_job;
+	}
+
+	mutex_lock(&vpssSchedLock[workingGrp]);
+	if (!vpssCtx[workingGrp]) {
+		CVI_TRACE_VPSS(CVI_DBG_NOTICE, "grp(%d) destroyed while stopping.\n", workingGrp);
+		mutex_unlock(&vpssSchedLock[workingGrp]);
+		goto vpss_next_job;
+	}
+	if (_vpss_try_schedule_offline(ctx, workingMask, vpss_ctx) == CVI_SUCCESS) {
+		mutex_unlock(&vpssSchedLock[workingGrp]);
+		return CVI_SUCCESS;
+	}
+	mutex_unlock(&vpssSchedLock[workingGrp]);
+
 vpss_next_job:
 	// job done.
 	ctx->workingMask = 0;
@@ -2707,8 +3142,6 @@ vpss_next_job:
 	if (hw_start(workingGrp, CVI_FALSE, CVI_FALSE, vpss_ctx) != CVI_SUCCESS)
 		CVI_TRACE_VPSS(CVI_DBG_ERR, "grp(%d) stop at job-done NG.\n", workingGrp);
 
-	mutex_unlock(&vpssCtx[workingGrp]->lock);
-
 	return CVI_FAILURE;
 }
 
@@ -2798,6 +3231,7 @@ static void vpss_handle_offline(struct vpss_handler_ctx *ctx)
 {
 	VPSS_GRP workingGrp;
 	CVI_U8 workingMask;
+	CVI_BOOL picked = CVI_FALSE;
 	struct timespec64 time;
 	CVI_U64 duration64;
 	CVI_U32 state;
@@ -2822,6 +3256,7 @@ static void vpss_handle_offline(struct vpss_handler_ctx *ctx)
 
 		if (workingGrp == VPSS_MAX_GRP_NUM)
 			return;
+		picked = CVI_TRUE;
 	}
 
 	// Sanity check
@@ -2831,6 +3266,12 @@ static void vpss_handle_offline(struct vpss_handler_ctx *ctx)
 	}
 	if (!vpssCtx[workingGrp] || !vpssCtx[workingGrp]->isStarted) {
 		CVI_TRACE_VPSS(CVI_DBG_WARN, "Grp(%d) invalid,\n", workingGrp);
+		// findNextEnGrp took a frame's sem for it
+		if (picked) {
+			mutex_lock(&vpssSchedLock[workingGrp]);
+			_vpss_sched_bail(workingGrp);
+			mutex_unlock(&vpssSchedLock[workingGrp]);
+		}
 		ctx->workingGrp = VPSS_MAX_GRP_NUM;
 		ctx->workingMask = 0;
 		atomic_set(&ctx->events, 0);
@@ -2989,6 +3430,9 @@ void _vpss_GrpParamInit(VPSS_GRP VpssGrp)
 			vpssCtx[VpssGrp]->stChnCfgs[i].mosaic_handle[j] = RGN_INVALID_HANDLE;
 	}
 
+	_vpss_sched_reset(VpssGrp);
+	memset(&vpssLockStat[VpssGrp], 0, sizeof(vpssLockStat[VpssGrp]));
+
 	vpssExtCtx[VpssGrp].scene = 0xff;
 	for (i = PROC_AMP_BRIGHTNESS; i < PROC_AMP_MAX; ++i) {
 		vpss_get_proc_amp_ctrl(i, &ctrl);
@@ -3016,6 +3460,7 @@ static CVI_S32 _vpss_update_rotation_mesh(VPSS_GRP VpssGrp, VPSS_CHN VpssChn, RO
 	pmesh->paddr = DEFAULT_MESH_PADDR;
 
 	mutex_lock(&vpssCtx[VpssGrp]->lock);
+	_vpss_cfg_changed(VpssGrp);
 	vpssCtx[VpssGrp]->stChnCfgs[VpssChn].enRotation = enRotation;
 	mutex_unlock(&vpssCtx[VpssGrp]->lock);
 	return CVI_SUCCESS;
@@ -3038,6 +3483,7 @@ CVI_S32 _vpss_update_ldc_mesh(VPSS_GRP VpssGrp, VPSS_CHN VpssChn,
 	mutex_unlock(&pmesh->lock);
 
 	mutex_lock(&vpssCtx[VpssGrp]->lock);
+	_vpss_cfg_changed(VpssGrp);
 	vpssCtx[VpssGrp]->stChnCfgs[VpssChn].stLDCAttr = *pstLDCAttr;
 	vpssCtx[VpssGrp]->stChnCfgs[VpssChn].enRotation = enRotation;
 	mutex_unlock(&vpssCtx[VpssGrp]->lock);
@@ -3098,6 +3544,7 @@ void vpss_post_job(CVI_S32 VpssGrp)
 	}
 
 	vpssCtx[VpssGrp]->stGrpWorkStatus.u32RecvCnt++;
+	_vpss_sched_arrive(VpssGrp);
 	vpss_notify_wkup_evt(vpssCtx[VpssGrp]->u8DevId);
 }
 
@@ -3178,7 +3625,7 @@ CVI_S32 vpss_create_grp(VPSS_GRP VpssGrp, const VPSS_GRP_ATTR_S *pstGrpAttr)
 	vpssCtx[VpssGrp]->isCreated = CVI_TRUE;
 	memcpy(&vpssCtx[VpssGrp]->stGrpAttr, pstGrpAttr, sizeof(vpssCtx[VpssGrp]->stGrpAttr));
 
-	base_mod_jobs_init(chn, CHN_TYPE_IN, 1 + CVI_VI_VPSS_EXTRA_BUF, 1, 0);
+	base_mod_jobs_init(chn, CHN_TYPE_IN, VPSS_GRP_WAITQ_DEPTH, 1, 0);
 
 	mutex_init(&vpssCtx[VpssGrp]->lock);
 
@@ -3194,6 +3641,7 @@ CVI_S32 vpss_create_grp(VPSS_GRP VpssGrp, const VPSS_GRP_ATTR_S *pstGrpAttr)
 	CVI_TRACE_VPSS(CVI_DBG_INFO, "Grp(%d) VpssDev(%d) u32MaxW(%d) u32MaxH(%d) PixelFmt(%d)\n",
 		VpssGrp, pstGrpAttr->u8VpssDev, pstGrpAttr->u32MaxW, pstGrpAttr->u32MaxH, pstGrpAttr->enPixelFormat);
 	vpssCtx[VpssGrp]->is_cfg_changed = CVI_TRUE;
+	_vpss_cfg_changed(VpssGrp);
 
 	return CVI_SUCCESS;
 }
@@ -3210,12 +3658,15 @@ CVI_S32 vpss_destroy_grp(VPSS_GRP VpssGrp)
 	if (!vpssCtx[VpssGrp])
 		return CVI_SUCCESS;
 
+	mutex_lock(&vpssSchedLock[VpssGrp]);
 	// FIXME: free ion until dwa hardware stops
 	if (vpssCtx[VpssGrp]->isCreated) {
 		mutex_lock(&vpssCtx[VpssGrp]->lock);
+		_vpss_cfg_changed(VpssGrp);
 		vpssCtx[VpssGrp]->isCreated = CVI_FALSE;
 		vpssExtCtx[VpssGrp].sbm_cfg.sb_mode = 0;
 		base_mod_jobs_exit(chn, CHN_TYPE_IN);
+		_vpss_sched_flush(VpssGrp);
 
 		for (VpssChn = 0; VpssChn < vpssCtx[VpssGrp]->chnNum; ++VpssChn) {
 			vpssCtx[VpssGrp]->stChnCfgs[VpssChn].enRotation = ROTATION_0;
@@ -3235,6 +3686,7 @@ CVI_S32 vpss_destroy_grp(VPSS_GRP VpssGrp)
 	vpssCtx[VpssGrp]->hw_cfgs = NULL;
 	kfree(vpssCtx[VpssGrp]);
 	vpssCtx[VpssGrp] = NULL;
+	mutex_unlock(&vpssSchedLock[VpssGrp]);
 	CVI_TRACE_VPSS(CVI_DBG_INFO, "Grp(%d)\n", VpssGrp);
 
 	return CVI_SUCCESS;
@@ -3291,6 +3743,7 @@ CVI_S32 vpss_start_grp(VPSS_GRP VpssGrp)
 	}
 
 	mutex_lock(&vpssCtx[VpssGrp]->lock);
+	_vpss_cfg_changed(VpssGrp);
 	vpssCtx[VpssGrp]->isStarted = CVI_TRUE;
 	vpssExtCtx[VpssGrp].grp_state = GRP_STATE_IDLE;
 	mutex_unlock(&vpssCtx[VpssGrp]->lock);
@@ -3340,12 +3793,16 @@ CVI_S32 vpss_stop_grp(VPSS_GRP VpssGrp)
 
 	u8VpssDev = vpssCtx[VpssGrp]->u8DevId;
 
+	mutex_lock(&vpssSchedLock[VpssGrp]);
 	mutex_lock(&vpssCtx[VpssGrp]->lock);
+	_vpss_cfg_changed(VpssGrp);
 	vpssCtx[VpssGrp]->isStarted = CVI_FALSE;
 	if (handler_ctx[u8VpssDev].online_from_isp)
 		handler_ctx[u8VpssDev].online_chkMask &= ~BIT(VpssGrp);
 
 	mutex_unlock(&vpssCtx[VpssGrp]->lock);
+	mutex_unlock(&vpssSchedLock[VpssGrp]);
+	_vpss_sched_flush(VpssGrp);
 
 	/* Only change state from run to stop */
 	enabled = vpss_enable_handler_ctx(&handler_ctx[u8VpssDev]);
@@ -3370,6 +3827,7 @@ CVI_S32 vpss_stop_grp(VPSS_GRP VpssGrp)
 			/*if grp online && sbm ,disable channel should in grp stop*/
 			chn.s32ChnId = VpssChn;
 			mutex_lock(&vpssCtx[VpssGrp]->lock);
+			_vpss_cfg_changed(VpssGrp);
 			vpssCtx[VpssGrp]->stChnCfgs[VpssChn].isEnabled = CVI_FALSE;
 			if (vpssCtx[VpssGrp]->stChnCfgs[VpssChn].bufWrapPhyAddr) {
 				sys_ion_free(vpssCtx[VpssGrp]->stChnCfgs[VpssChn].bufWrapPhyAddr);
@@ -3407,6 +3865,7 @@ CVI_S32 vpss_reset_grp(VPSS_GRP VpssGrp)
 	mutex_lock(&vpssCtx[VpssGrp]->lock);
 	memset(vpssCtx[VpssGrp]->stChnCfgs, 0, sizeof(struct VPSS_CHN_CFG) * vpssCtx[VpssGrp]->chnNum);
 	memset(&vpssExtCtx[VpssGrp], 0, sizeof(vpssExtCtx[VpssGrp]));
+	_vpss_cfg_changed(VpssGrp);
 	_vpss_GrpParamInit(VpssGrp);
 	vpssCtx[VpssGrp]->is_cfg_changed = CVI_TRUE;
 	mutex_unlock(&vpssCtx[VpssGrp]->lock);
@@ -3505,6 +3964,7 @@ CVI_S32 vpss_set_grp_attr(VPSS_GRP VpssGrp, const VPSS_GRP_ATTR_S *pstGrpAttr)
 	}
 
 	mutex_lock(&vpssCtx[VpssGrp]->lock);
+	_vpss_cfg_changed(VpssGrp);
 	vpssCtx[VpssGrp]->stGrpAttr = *pstGrpAttr;
 	vpssCtx[VpssGrp]->u8DevId = u8DevUsed;
 	vpssCtx[VpssGrp]->chnNum = (stVPSSMode.enMode == VPSS_MODE_SINGLE) ?
@@ -3532,6 +3992,7 @@ CVI_S32 vpss_set_grp_csc(struct vpss_grp_csc_cfg *cfg)
 		return ret;
 
 	mutex_lock(&vpssCtx[VpssGrp]->lock);
+	_vpss_cfg_changed(VpssGrp);
 	for (i = 0; i < 3; i++) {
 		for (j = 0; j < 3; j++)
 			vpssExtCtx[VpssGrp].csc_cfg.coef[i][j] = cfg->coef[i][j];
@@ -3593,6 +4054,290 @@ CVI_S32 vpss_get_binscene(struct vpss_scene *cfg)
 	return CVI_SUCCESS;
 }
 
+CVI_S32 vpss_set_grp_sched(const struct vpss_grp_sched_cfg *cfg)
+{
+	CVI_S32 ret;
+	VPSS_GRP VpssGrp = cfg->VpssGrp;
+	struct vpss_grp_sched *sched;
+	unsigned long flags;
+
+	ret = CHECK_VPSS_GRP_VALID(VpssGrp);
+	if (ret != CVI_SUCCESS)
+		return ret;
+
+	ret = CHECK_VPSS_GRP_CREATED(VpssGrp);
+	if (ret != CVI_SUCCESS)
+		return ret;
+
+	if (cfg->sched_class >= VPSS_SCHED_CLASS_MAX) {
+		CVI_TRACE_VPSS(CVI_DBG_ERR, "Grp(%d) sched_class(%d) invalid.\n", VpssGrp, cfg->sched_class);
+		return CVI_ERR_VPSS_ILLEGAL_PARAM;
+	}
+	if (cfg->weight == 0 || cfg->weight > VPSS_SCHED_WEIGHT_MAX) {
+		CVI_TRACE_VPSS(CVI_DBG_ERR, "Grp(%d) weight(%d) out of range(1~%d).\n",
+			VpssGrp, cfg->weight, VPSS_SCHED_WEIGHT_MAX);
+		return CVI_ERR_VPSS_ILLEGAL_PARAM;
+	}
+
+	sched = &vpssSched[VpssGrp];
+	spin_lock_irqsave(&sched->lock, flags);
+	sched->cfg.sched_class = cfg->sched_class;
+	sched->cfg.target_latency_us = cfg->target_latency_us;
+	sched->cfg.weight = cfg->weight;
+	spin_unlock_irqrestore(&sched->lock, flags);
+
+	CVI_TRACE_VPSS(CVI_DBG_INFO, "Grp(%d) class(%d) target_latency(%dus) weight(%d)\n",
+		VpssGrp, cfg->sched_class, cfg->target_latency_us, cfg->weight);
+	return CVI_SUCCESS;
+}
+
+CVI_S32 vpss_get_grp_sched(struct vpss_grp_sched_cfg *cfg)
+{
+	CVI_S32 ret;
+	VPSS_GRP VpssGrp = cfg->VpssGrp;
+	unsigned long flags;
+
+	ret = CHECK_VPSS_GRP_VALID(VpssGrp);
+	if (ret != CVI_SUCCESS)
+		return ret;
+
+	ret = CHECK_VPSS_GRP_CREATED(VpssGrp);
+	if (ret != CVI_SUCCESS)
+		return ret;
+
+	spin_lock_irqsave(&vpssSched[VpssGrp].lock, flags);
+	*cfg = vpssSched[VpssGrp].cfg;
+	spin_unlock_irqrestore(&vpssSched[VpssGrp].lock, flags);
+
+	return CVI_SUCCESS;
+}
+
+struct vpss_grp_sched *vpss_get_grp_sched_stat(VPSS_GRP VpssGrp)
+{
+	return &vpssSched[VpssGrp];
+}
+
+struct vpss_grp_lock_stat *vpss_get_grp_lock_stat(VPSS_GRP VpssGrp)
+{
+	return &vpssLockStat[VpssGrp];
+}
+
+#if defined(CONFIG_SCLR_TEST)
+#define VPSS_SCHED_SIM_US    (2 * USEC_PER_SEC)
+#define VPSS_SCHED_SIM_JOBS  256
+#define VPSS_SCHED_SIM_GRP   4
+
+/*
+ * A recorded arrival pattern of one grp: @burst jobs every @period_us from
+ * @offset_us, each taking @service_us of hw time.
+ */
+struct vpss_sched_sim_grp {
+	const char *name;
+	struct vpss_grp_sched_cfg cfg;
+	u32 period_us;
+	u32 offset_us;
+	u8 burst;
+	u32 service_us;
+};
+
+// a display, a record and two analytics grps, the hw about 60% busy.
+static const struct vpss_sched_sim_grp sched_sim_mixed[VPSS_SCHED_SIM_GRP] = {
+	{ "display", { .VpssGrp = 0, .sched_class = VPSS_SCHED_CLASS_RT, .target_latency_us = 10000,
+		.weight = VPSS_SCHED_WEIGHT_DEF }, 33333, 0, 1, 4000 },
+	{ "record", { .VpssGrp = 1, .sched_class = VPSS_SCHED_CLASS_NORMAL, .target_latency_us = 0,
+		.weight = VPSS_SCHED_WEIGHT_DEF }, 33333, 5000, 1, 6000 },
+	{ "ai-0", { .VpssGrp = 2, .sched_class = VPSS_SCHED_CLASS_BATCH, .target_latency_us = 0,
+		.weight = VPSS_SCHED_WEIGHT_DEF }, 100000, 1000, 3, 5000 },
+	{ "ai-1", { .VpssGrp = 3, .sched_class = VPSS_SCHED_CLASS_BATCH, .target_latency_us = 0,
+		.weight = VPSS_SCHED_WEIGHT_DEF / 2 }, 100000, 2000, 3, 5000 },
+};
+
+// two normal grps keep the hw busy all the time, the batch grp only gets
+// in by aging.
+static const struct vpss_sched_sim_grp sched_sim_overload[VPSS_SCHED_SIM_GRP] = {
+	{ "display", { .VpssGrp = 0, .sched_class = VPSS_SCHED_CLASS_RT, .target_latency_us = 10000,
+		.weight = VPSS_SCHED_WEIGHT_DEF }, 33333, 0, 1, 4000 },
+	{ "rec-0", { .VpssGrp = 1, .sched_class = VPSS_SCHED_CLASS_NORMAL, .target_latency_us = 0,
+		.weight = VPSS_SCHED_WEIGHT_DEF }, 20000, 1000, 1, 9000 },
+	{ "rec-1", { .VpssGrp = 2, .sched_class = VPSS_SCHED_CLASS_NORMAL, .target_latency_us = 0,
+		.weight = VPSS_SCHED_WEIGHT_DEF }, 20000, 2000, 1, 9000 },
+	{ "ai-0", { .VpssGrp = 3, .sched_class = VPSS_SCHED_CLASS_BATCH, .target_latency_us = 0,
+		.weight = VPSS_SCHED_WEIGHT_DEF }, 100000, 3000, 1, 5000 },
+};
+
+/*
+ * One simulated grp: its arrival ring & class are kept in a vpss_grp_sched,
+ * as for a real grp, so the real picker can be run on it.
+ */
+struct vpss_sched_sim_q {
+	struct vpss_grp_sched sched;
+	u32 drop;
+	u32 lat_num;
+	u32 lat_us[VPSS_SCHED_SIM_JOBS];
+};
+
+static int _vpss_sched_sim_cmp(const void *a, const void *b)
+{
+	u32 x = *(const u32 *)a, y = *(const u32 *)b;
+
+	return (x > y) - (x < y);
+}
+
+/* _vpss_sched_sim_pick: the grp the given policy serves next.
+ *
+ * Grps with pending jobs are the ones whose sem findNextEnGrp* would get,
+ * they're handed to the real picker in the same visiting order.
+ */
+static int _vpss_sched_sim_pick(struct vpss_sched_sim_q *q, int last, int policy, u64 now_us)
+{
+	struct vpss_grp_sched *sched[VPSS_SCHED_SIM_GRP];
+	u8 grp[VPSS_SCHED_SIM_GRP], order[VPSS_SCHED_SIM_GRP];
+	u8 i, g, num = 0;
+
+	for (i = 1; i <= VPSS_SCHED_SIM_GRP; ++i) {
+		g = (last + i) % VPSS_SCHED_SIM_GRP;
+		if (!q[g].sched.num)
+			continue;
+		if (policy == VPSS_SCHED_POLICY_RR)
+			return g;
+		grp[num] = g;
+		sched[num] = &q[g].sched;
+		num++;
+	}
+	if (!num)
+		return -1;
+
+	_vpss_sched_order(sched, num, now_us, order);
+	return grp[order[0]];
+}
+
+/* _vpss_sched_sim_run: replay a pattern against one policy in virtual time.
+ *
+ * Arrivals beyond the waitq depth are dropped as vb_qbuf would. Latency is
+ * counted from arrival to the end of the job's hw run.
+ */
+static void _vpss_sched_sim_run(const struct vpss_sched_sim_grp *pattern, struct vpss_sched_sim_q *q,
+				int policy)
+{
+	struct vpss_grp_sched *sched;
+	u64 next_us[VPSS_SCHED_SIM_GRP];
+	u64 now_us = 0, arrival_us;
+	int g, last = VPSS_SCHED_SIM_GRP - 1;
+	u8 b;
+
+	memset(q, 0, sizeof(*q) * VPSS_SCHED_SIM_GRP);
+	for (g = 0; g < VPSS_SCHED_SIM_GRP; ++g) {
+		spin_lock_init(&q[g].sched.lock);
+		q[g].sched.cfg = pattern[g].cfg;
+		next_us[g] = pattern[g].offset_us;
+	}
+
+	for (;;) {
+		for (g = 0; g < VPSS_SCHED_SIM_GRP; ++g) {
+			sched = &q[g].sched;
+			while (next_us[g] <= now_us && next_us[g] < VPSS_SCHED_SIM_US) {
+				for (b = 0; b < pattern[g].burst; ++b) {
+					if (sched->num == VPSS_SCHED_ARRIVAL_NUM) {
+						q[g].drop++;
+						continue;
+					}
+					sched->arrival_us[(sched->head + sched->num) % VPSS_SCHED_ARRIVAL_NUM] =
+						next_us[g];
+					sched->num++;
+				}
+				next_us[g] += pattern[g].period_us;
+			}
+		}
+
+		g = _vpss_sched_sim_pick(q, last, policy, now_us);
+		if (g < 0) {
+			// idle, jump to the next arrival
+			arrival_us = U64_MAX;
+			for (g = 0; g < VPSS_SCHED_SIM_GRP; ++g)
+				if (next_us[g] < VPSS_SCHED_SIM_US)
+					arrival_us = min(arrival_us, next_us[g]);
+			if (arrival_us == U64_MAX)
+				break;
+			now_us = arrival_us;
+			continue;
+		}
+
+		sched = &q[g].sched;
+		arrival_us = sched->arrival_us[sched->head];
+		sched->head = (sched->head + 1) % VPSS_SCHED_ARRIVAL_NUM;
+		sched->num--;
+		now_us += pattern[g].service_us;
+		if (q[g].lat_num < VPSS_SCHED_SIM_JOBS)
+			q[g].lat_us[q[g].lat_num++] = (u32)(now_us - arrival_us);
+		last = g;
+	}
+}
+
+static void _vpss_sched_sim_report(const struct vpss_sched_sim_grp *pattern, struct vpss_sched_sim_q *q,
+				   const char *policy, u32 *max_us)
+{
+	int g;
+	u32 n;
+
+	pr_err("%s:\n", policy);
+	pr_err("%10s%8s%8s%12s%12s%12s\n", "grp", "jobs", "drop", "p50(us)", "p99(us)", "max(us)");
+	for (g = 0; g < VPSS_SCHED_SIM_GRP; ++g) {
+		n = q[g].lat_num;
+		max_us[g] = 0;
+		if (!n) {
+			pr_err("%10s%8d%8d\n", pattern[g].name, 0, q[g].drop);
+			continue;
+		}
+		sort(q[g].lat_us, n, sizeof(u32), _vpss_sched_sim_cmp, NULL);
+		max_us[g] = q[g].lat_us[n - 1];
+		pr_err("%10s%8d%8d%12d%12d%12d\n", pattern[g].name, n, q[g].drop,
+			q[g].lat_us[n / 2], q[g].lat_us[(n * 99) / 100], max_us[g]);
+	}
+}
+
+/* vpss_sched_sim: replay recorded arrival patterns against both schedulers.
+ *
+ * Deterministic, touches neither hw nor any grp's state. Passes if the
+ * deadline scheduler keeps the rt grp within its target latency plus one
+ * job of service, never does worse for it than round-robin, and an
+ * overloaded hw still serves the batch grp within its aging time plus a
+ * couple of jobs.
+ */
+int vpss_sched_sim(void)
+{
+	struct vpss_sched_sim_q *q;
+	u32 rr_max[VPSS_SCHED_SIM_GRP], dl_max[VPSS_SCHED_SIM_GRP];
+	const struct vpss_sched_sim_grp *rt = &sched_sim_mixed[0];
+	const struct vpss_sched_sim_grp *batch = &sched_sim_overload[3];
+	int ret = 0;
+
+	q = kcalloc(VPSS_SCHED_SIM_GRP, sizeof(*q), GFP_KERNEL);
+	if (!q)
+		return -ENOMEM;
+
+	_vpss_sched_sim_run(sched_sim_mixed, q, VPSS_SCHED_POLICY_RR);
+	_vpss_sched_sim_report(sched_sim_mixed, q, "mixed, round-robin", rr_max);
+	_vpss_sched_sim_run(sched_sim_mixed, q, VPSS_SCHED_POLICY_DEADLINE);
+	_vpss_sched_sim_report(sched_sim_mixed, q, "mixed, deadline", dl_max);
+
+	if (dl_max[0] > rr_max[0] || dl_max[0] > rt->cfg.target_latency_us + rt->service_us)
+		ret = -1;
+
+	_vpss_sched_sim_run(sched_sim_overload, q, VPSS_SCHED_POLICY_DEADLINE);
+	_vpss_sched_sim_report(sched_sim_overload, q, "overload, deadline", dl_max);
+
+	// it waits out the aging, then at most for the job on the hw & an rt one
+	if (!q[3].lat_num ||
+	    dl_max[3] > VPSS_SCHED_BATCH_AGE_US + 2 * sched_sim_overload[1].service_us +
+			sched_sim_overload[0].service_us + batch->service_us)
+		ret = -1;
+	pr_err("vpss sched sim %s\n", ret ? "FAIL" : "PASS");
+
+	kfree(q);
+	return ret;
+}
+#endif
+
 CVI_S32 vpss_get_all_proc_amp(struct vpss_all_proc_amp_cfg *cfg)
 {
 	CVI_U8 i, j;
@@ -3701,6 +4446,7 @@ CVI_S32 vpss_set_chn_attr(VPSS_GRP VpssGrp, VPSS_CHN VpssChn, const VPSS_CHN_ATT
 		, COMPRESS_MODE_NONE, DEFAULT_ALIGN, &stVbCalConfig);
 
 	mutex_lock(&vpssCtx[VpssGrp]->lock);
+	_vpss_cfg_changed(VpssGrp);
 	_clean_chn_vb_jobs(VpssGrp, VpssChn, &vpssCtx[VpssGrp]->stChnCfgs[VpssChn].stChnAttr, pstChnAttr);
 	memcpy(&vpssCtx[VpssGrp]->stChnCfgs[VpssChn].stChnAttr, pstChnAttr,
 		sizeof(vpssCtx[VpssGrp]->stChnCfgs[VpssChn].stChnAttr));
@@ -3766,6 +4512,7 @@ CVI_S32 vpss_enable_chn(VPSS_GRP VpssGrp, VPSS_CHN VpssChn)
 	}
 	u8VpssDev = vpssCtx[VpssGrp]->u8DevId;
 	mutex_lock(&vpssCtx[VpssGrp]->lock);
+	_vpss_cfg_changed(VpssGrp);
 
 	if (handler_ctx[u8VpssDev].online_from_isp)
 		base_mod_jobs_init(chn, CHN_TYPE_OUT, 1, 2, chn_cfg->stChnAttr.u32Depth);
@@ -3824,6 +4571,7 @@ CVI_S32 vpss_disable_chn(VPSS_GRP VpssGrp, VPSS_CHN VpssChn)
 	}
 
 	mutex_lock(&vpssCtx[VpssGrp]->lock);
+	_vpss_cfg_changed(VpssGrp);
 	vpssCtx[VpssGrp]->stChnCfgs[VpssChn].isEnabled = CVI_FALSE;
 	if (vpssCtx[VpssGrp]->stChnCfgs[VpssChn].bufWrapPhyAddr) {
 		sys_ion_free(vpssCtx[VpssGrp]->stChnCfgs[VpssChn].bufWrapPhyAddr);
@@ -3908,6 +4656,7 @@ CVI_S32 vpss_set_chn_crop(VPSS_GRP VpssGrp, VPSS_CHN VpssChn, const VPSS_CROP_IN
 	}
 
 	mutex_lock(&vpssCtx[VpssGrp]->lock);
+	_vpss_cfg_changed(VpssGrp);
 	vpssCtx[VpssGrp]->stChnCfgs[VpssChn].stCropInfo = *pstCropInfo;
 	vpssCtx[VpssGrp]->stChnCfgs[VpssChn].is_cfg_changed = CVI_TRUE;
 	mutex_unlock(&vpssCtx[VpssGrp]->lock);
@@ -3961,6 +4710,7 @@ CVI_S32 vpss_show_chn(VPSS_GRP VpssGrp, VPSS_CHN VpssChn)
 		return ret;
 
 	mutex_lock(&vpssCtx[VpssGrp]->lock);
+	_vpss_cfg_changed(VpssGrp);
 	vpssCtx[VpssGrp]->stChnCfgs[VpssChn].isMuted = CVI_FALSE;
 	vpssCtx[VpssGrp]->stChnCfgs[VpssChn].is_cfg_changed = CVI_TRUE;
 	mutex_unlock(&vpssCtx[VpssGrp]->lock);
@@ -3987,6 +4737,7 @@ CVI_S32 vpss_hide_chn(VPSS_GRP VpssGrp, VPSS_CHN VpssChn)
 		return CVI_SUCCESS;
 
 	mutex_lock(&vpssCtx[VpssGrp]->lock);
+	_vpss_cfg_changed(VpssGrp);
 	vpssCtx[VpssGrp]->stChnCfgs[VpssChn].isMuted = CVI_TRUE;
 	vpssCtx[VpssGrp]->stChnCfgs[VpssChn].is_cfg_changed = CVI_TRUE;
 	mutex_unlock(&vpssCtx[VpssGrp]->lock);
@@ -4066,6 +4817,7 @@ CVI_S32 vpss_set_grp_crop(VPSS_GRP VpssGrp, const VPSS_CROP_INFO_S *pstCropInfo)
 	}
 
 	mutex_lock(&vpssCtx[VpssGrp]->lock);
+	_vpss_cfg_changed(VpssGrp);
 	vpssCtx[VpssGrp]->stGrpCropInfo = *pstCropInfo;
 	if (pstCropInfo->bEnable) {
 		bool chk_width_even = IS_FMT_YUV420(vpssCtx[VpssGrp]->stGrpAttr.enPixelFormat) ||
@@ -4495,6 +5247,7 @@ CVI_S32 vpss_set_chn_align(VPSS_GRP VpssGrp, VPSS_CHN VpssChn, CVI_U32 u32Align)
 		DATA_BITWIDTH_8, COMPRESS_MODE_NONE, u32Align, &stVbCalConfig);
 
 	mutex_lock(&vpssCtx[VpssGrp]->lock);
+	_vpss_cfg_changed(VpssGrp);
 	vpssCtx[VpssGrp]->stChnCfgs[VpssChn].blk_size = stVbCalConfig.u32VBSize;
 	vpssCtx[VpssGrp]->stChnCfgs[VpssChn].align = u32Align;
 	mutex_unlock(&vpssCtx[VpssGrp]->lock);
@@ -4550,6 +5303,7 @@ CVI_S32 vpss_set_chn_scale_coef_level(VPSS_GRP VpssGrp, VPSS_CHN VpssChn, VPSS_S
 	}
 
 	mutex_lock(&vpssCtx[VpssGrp]->lock);
+	_vpss_cfg_changed(VpssGrp);
 	vpssCtx[VpssGrp]->stChnCfgs[VpssChn].enCoef = enCoef;
 	vpssCtx[VpssGrp]->stChnCfgs[VpssChn].is_cfg_changed = CVI_TRUE;
 	mutex_unlock(&vpssCtx[VpssGrp]->lock);
@@ -4618,6 +5372,7 @@ CVI_S32 vpss_set_chn_yratio(VPSS_GRP VpssGrp, VPSS_CHN VpssChn, CVI_U32 YRatio)
 	}
 
 	mutex_lock(&vpssCtx[VpssGrp]->lock);
+	_vpss_cfg_changed(VpssGrp);
 	vpssCtx[VpssGrp]->stChnCfgs[VpssChn].YRatio = YRatio;
 	vpssCtx[VpssGrp]->stChnCfgs[VpssChn].is_cfg_changed = CVI_TRUE;
 	mutex_unlock(&vpssCtx[VpssGrp]->lock);
@@ -4713,6 +5468,7 @@ CVI_S32 vpss_attach_vb_pool(VPSS_GRP VpssGrp, VPSS_CHN VpssChn, VB_POOL hVbPool)
 		return ret;
 
 	mutex_lock(&vpssCtx[VpssGrp]->lock);
+	_vpss_cfg_changed(VpssGrp);
 	vpssCtx[VpssGrp]->stChnCfgs[VpssChn].VbPool = hVbPool;
 	mutex_unlock(&vpssCtx[VpssGrp]->lock);
 
@@ -4738,6 +5494,7 @@ CVI_S32 vpss_detach_vb_pool(VPSS_GRP VpssGrp, VPSS_CHN VpssChn)
 		return ret;
 
 	mutex_lock(&vpssCtx[VpssGrp]->lock);
+	_vpss_cfg_changed(VpssGrp);
 	vpssCtx[VpssGrp]->stChnCfgs[VpssChn].VbPool = VB_INVALID_POOLID;
 	mutex_unlock(&vpssCtx[VpssGrp]->lock);
 
@@ -4830,6 +5587,7 @@ CVI_S32 vpss_set_chn_bufwrap_attr(VPSS_GRP VpssGrp, VPSS_CHN VpssChn, const VPSS
 			u32WrapBufferSize);
 
 	mutex_lock(&vpssCtx[VpssGrp]->lock);
+	_vpss_cfg_changed(VpssGrp);
 	vpssCtx[VpssGrp]->stChnCfgs[VpssChn].bufWrapPhyAddr = ion_paddr;
 	vpssCtx[VpssGrp]->stChnCfgs[VpssChn].u32BufWrapDepth = u32BufWrapDepth;
 	memcpy(&vpssCtx[VpssGrp]->stChnCfgs[VpssChn].stBufWrap, pstVpssChnBufWrap,
@@ -5042,6 +5800,9 @@ CVI_VOID vpss_set_mlv_info(CVI_U8 snr_num, struct mlv_i_s *p_m_lv_i)
 
 	g_mlv_i[snr_num].mlv_i_level = p_m_lv_i->mlv_i_level;
 	memcpy(g_mlv_i[snr_num].mlv_i_table, p_m_lv_i->mlv_i_table, sizeof(g_mlv_i[snr_num].mlv_i_table));
+	// an all-zero table is the same as no table, blks needn't carry it.
+	g_mlv_valid[snr_num] = memchr_inv(g_mlv_i[snr_num].mlv_i_table, 0,
+		sizeof(g_mlv_i[snr_num].mlv_i_table)) ? CVI_TRUE : CVI_FALSE;
 }
 
 CVI_VOID vpss_get_mlv_info(CVI_U8 snr_num, struct mlv_i_s *p_m_lv_i)
@@ -5087,11 +5848,19 @@ void vpss_mode_init(void *arg)
 
 void vpss_init(void *arg)
 {
+	VPSS_GRP VpssGrp;
+
 	if (!arg)
 		return;
 
 	vip_dev = (struct cvi_vip_dev *)arg;
 
+	for (VpssGrp = 0; VpssGrp < VPSS_MAX_GRP_NUM; ++VpssGrp) {
+		spin_lock_init(&vpssSched[VpssGrp].lock);
+		mutex_init(&vpssSchedLock[VpssGrp]);
+		_vpss_sched_reset(VpssGrp);
+	}
+
 	// CVI_SYS_Init()
 	vpss_mode_init(arg);
 
@@ -5143,6 +5912,7 @@ int vpss_set_grp_sbm(struct vpss_grp_sbm_cfg *cb_cfg)
 			sys_ion_free(sbm_cfg->ion_paddr);
 
 		mutex_lock(&vpssCtx[VpssGrp]->lock);
+		_vpss_cfg_changed(VpssGrp);
 		sbm_cfg->ion_paddr = 0;
 		sbm_cfg->sb_mode = 0;
 		mutex_unlock(&vpssCtx[VpssGrp]->lock);
@@ -5174,6 +5944,7 @@ int vpss_set_grp_sbm(struct vpss_grp_sbm_cfg *cb_cfg)
 	cb_cfg->ion_paddr = ion_paddr;
 
 	mutex_lock(&vpssCtx[VpssGrp]->lock);
+	_vpss_cfg_changed(VpssGrp);
 	vpssExtCtx[VpssGrp].sbm_cfg.sb_mode = sb_mode;
 	vpssExtCtx[VpssGrp].sbm_cfg.sb_size = sb_size;
 	vpssExtCtx[VpssGrp].sbm_cfg.sb_nb = sb_nb;
@@ -5252,6 +6023,7 @@ CVI_S32 vpss_set_rgn_lut_cfg(VPSS_GRP VpssGrp, VPSS_CHN VpssChn, struct cvi_rgn_
 	clk_enable(vip_dev->sc_vdev[dev_idx].clk);
 
 	mutex_lock(&vpssCtx[VpssGrp]->lock);
+	_vpss_cfg_changed(VpssGrp);
 	if (cfg->rgnex_en)
 		sclr_gop_setup_256LUT(0, cfg->lut_layer, cfg->lut_length, cfg->lut_addr);
 	else
@@ -91,6 +91,8 @@ CVI_S32 vpss_get_proc_amp_ctrl(PROC_AMP_E type, PROC_AMP_CTRL_S *ctrl);
 CVI_S32 vpss_get_proc_amp(VPSS_GRP VpssGrp, CVI_S32 *proc_amp);
 CVI_S32 vpss_get_all_proc_amp(struct vpss_all_proc_amp_cfg *cfg);
 CVI_S32 vpss_get_binscene(struct vpss_scene *cfg);
+CVI_S32 vpss_set_grp_sched(const struct vpss_grp_sched_cfg *cfg);
+CVI_S32 vpss_get_grp_sched(struct vpss_grp_sched_cfg *cfg);
 
 CVI_VOID vpss_set_mlv_info(CVI_U8 snr_num, struct mlv_i_s *p_m_lv_i);
 CVI_VOID vpss_get_mlv_info(CVI_U8 snr_num, struct mlv_i_s *p_m_lv_i);
@@ -475,6 +475,22 @@ long vpss_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 		break;
 	}
 
+	case CVI_VPSS_SET_GRP_SCHED:
+	{
+		struct vpss_grp_sched_cfg *cfg = (struct vpss_grp_sched_cfg *)kdata;
+
+		ret = vpss_set_grp_sched(cfg);
+		break;
+	}
+
+	case CVI_VPSS_GET_GRP_SCHED:
+	{
+		struct vpss_grp_sched_cfg *cfg = (struct vpss_grp_sched_cfg *)kdata;
+
+		ret = vpss_get_grp_sched(cfg);
+		break;
+	}
+
 	case CVI_VPSS_SET_BLD_CFG:
 	{
 		struct vpss_bld_cfg *cfg = (struct vpss_bld_cfg *)kdata;